@@ -0,0 +1,4 @@
+#include "build_version.h"
+const char* rocksdb_build_git_sha = "rocksdb_build_git_sha:d5133560eb887753f1607bb2c92f7a96226c91e3";
+const char* rocksdb_build_git_date = "rocksdb_build_git_date:2026-10-17";
+const char* rocksdb_build_compile_date = __DATE__;
@@ -17,6 +17,8 @@
 
 #pragma once
 
+#include <functional>
+#include <memory>
 #include <string>
 #include <system_error>
 
@@ -34,5 +36,14 @@ public:
   virtual std::error_code writeSync(IWriteBatch& batch) = 0;
 
   virtual std::error_code read(IReadBatch& batch) = 0;
+
+  // Calls handler for every key not less than startKey in ascending order until it returns false
+  virtual std::error_code iterate(const std::string& startKey, const std::function<bool(const std::string& key, const std::string& value)>& handler) = 0;
+
+  // Read-only view of the current state that later writes don't affect and that can be read from any thread.
+  // Returns null if the database can't make one.
+  virtual std::shared_ptr<IDataBase> createSnapshot() {
+    return nullptr;
+  }
 };
 }
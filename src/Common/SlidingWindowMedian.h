@@ -0,0 +1,108 @@
+// Copyright (c) 2012-2017, The CryptoNote developers, The Bytecoin developers
+//
+// This file is part of Bytecoin.
+//
+// Bytecoin is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Bytecoin is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with Bytecoin.  If not, see <http://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <cassert>
+#include <deque>
+#include <iterator>
+#include <set>
+
+namespace Common {
+
+// Median of the last windowSize pushed values, equal to medianValue() of the same values.
+// The window is split into a lower and an upper half so push is O(log n) and median is O(1).
+template <class T>
+class SlidingWindowMedian {
+public:
+  explicit SlidingWindowMedian(size_t windowSize) : windowSize(windowSize) {
+    assert(windowSize > 0);
+  }
+
+  void push(T value) {
+    if (values.size() == windowSize) {
+      erase(values.front());
+      values.pop_front();
+    }
+
+    values.push_back(value);
+    if (lower.empty() || !(*lower.rbegin() < value)) {
+      lower.insert(value);
+    } else {
+      upper.insert(value);
+    }
+
+    rebalance();
+  }
+
+  void clear() {
+    values.clear();
+    lower.clear();
+    upper.clear();
+  }
+
+  size_t size() const {
+    return values.size();
+  }
+
+  size_t getWindowSize() const {
+    return windowSize;
+  }
+
+  T median() const {
+    if (values.empty()) {
+      return T();
+    }
+
+    if (lower.size() > upper.size()) {
+      return *lower.rbegin();
+    }
+
+    return (*lower.rbegin() + *upper.begin()) / 2;
+  }
+
+private:
+  void erase(const T& value) {
+    if (!(*lower.rbegin() < value)) {
+      lower.erase(lower.find(value));
+    } else {
+      upper.erase(upper.find(value));
+    }
+
+    rebalance();
+  }
+
+  // lower holds the bigger half when the size is odd
+  void rebalance() {
+    if (lower.size() > upper.size() + 1) {
+      auto it = std::prev(lower.end());
+      upper.insert(*it);
+      lower.erase(it);
+    } else if (upper.size() > lower.size()) {
+      auto it = upper.begin();
+      lower.insert(*it);
+      upper.erase(it);
+    }
+  }
+
+  size_t windowSize;
+  std::deque<T> values;
+  std::multiset<T> lower;
+  std::multiset<T> upper;
+};
+
+}
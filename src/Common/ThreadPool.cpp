@@ -0,0 +1,138 @@
+// Copyright (c) 2012-2017, The CryptoNote developers, The Bytecoin developers
+//
+// This file is part of Bytecoin.
+//
+// Bytecoin is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Bytecoin is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with Bytecoin.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <exception>
+
+namespace Common {
+
+ThreadPool::ThreadPool(size_t threadCount) : stopped(false) {
+  assert(threadCount > 0);
+  threads.reserve(threadCount);
+  for (size_t i = 0; i < threadCount; ++i) {
+    threads.emplace_back(&ThreadPool::workerProcedure, this);
+  }
+}
+
+ThreadPool::~ThreadPool() {
+  {
+    std::unique_lock<std::mutex> lock(mutex);
+    stopped = true;
+  }
+
+  haveTask.notify_all();
+  for (auto& thread : threads) {
+    thread.join();
+  }
+}
+
+size_t ThreadPool::getThreadCount() const {
+  return threads.size();
+}
+
+void ThreadPool::post(std::function<void()>&& task) {
+  {
+    std::unique_lock<std::mutex> lock(mutex);
+    tasks.emplace_back(std::move(task));
+  }
+
+  haveTask.notify_one();
+}
+
+void ThreadPool::parallelFor(size_t count, const std::function<void(size_t)>& task) {
+  if (count == 0) {
+    return;
+  }
+
+  struct State {
+    std::atomic<size_t> nextIndex;
+    size_t runningHelpers;
+    std::exception_ptr exception;
+    std::mutex mutex;
+    std::condition_variable helpersFinished;
+  } state;
+
+  state.nextIndex = 0;
+  state.runningHelpers = 0;
+
+  auto drain = [&state, &task, count] {
+    for (size_t index = state.nextIndex++; index < count; index = state.nextIndex++) {
+      try {
+        task(index);
+      } catch (...) {
+        std::unique_lock<std::mutex> lock(state.mutex);
+        if (!state.exception) {
+          state.exception = std::current_exception();
+        }
+
+        state.nextIndex = count;
+      }
+    }
+  };
+
+  size_t helpersCount = std::min(threads.size(), count - 1);
+  state.runningHelpers = helpersCount;
+  for (size_t i = 0; i < helpersCount; ++i) {
+    post([&state, &drain] {
+      drain();
+
+      std::unique_lock<std::mutex> lock(state.mutex);
+      if (--state.runningHelpers == 0) {
+        state.helpersFinished.notify_one();
+      }
+    });
+  }
+
+  drain();
+
+  std::unique_lock<std::mutex> lock(state.mutex);
+  while (state.runningHelpers != 0) {
+    state.helpersFinished.wait(lock);
+  }
+
+  if (state.exception) {
+    std::rethrow_exception(state.exception);
+  }
+}
+
+void ThreadPool::workerProcedure() {
+  for (;;) {
+    std::function<void()> task;
+
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      while (!stopped && tasks.empty()) {
+        haveTask.wait(lock);
+      }
+
+      if (tasks.empty()) {
+        return;
+      }
+
+      task = std::move(tasks.front());
+      tasks.pop_front();
+    }
+
+    task();
+  }
+}
+
+}
@@ -0,0 +1,59 @@
+// Copyright (c) 2012-2017, The CryptoNote developers, The Bytecoin developers
+//
+// This file is part of Bytecoin.
+//
+// Bytecoin is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Bytecoin is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with Bytecoin.  If not, see <http://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace Common {
+
+// Fixed set of worker threads executing CPU-bound jobs. Blocking calls must not be made from a dispatcher context,
+// wrap them into System::RemoteContext instead.
+class ThreadPool {
+public:
+  explicit ThreadPool(size_t threadCount);
+  ~ThreadPool();
+
+  ThreadPool(const ThreadPool&) = delete;
+  ThreadPool& operator=(const ThreadPool&) = delete;
+
+  size_t getThreadCount() const;
+
+  // Enqueue task to be executed by one of the worker threads.
+  void post(std::function<void()>&& task);
+
+  // Call task(i) for every i in [0, count) using worker threads and the calling thread, return when all calls finished.
+  // The first exception thrown by a task is rethrown.
+  void parallelFor(size_t count, const std::function<void(size_t)>& task);
+
+private:
+  void workerProcedure();
+
+  std::vector<std::thread> threads;
+  std::deque<std::function<void()>> tasks;
+  std::mutex mutex;
+  std::condition_variable haveTask;
+  bool stopped;
+};
+
+}
@@ -101,7 +101,10 @@ static_assert(UPGRADE_VOTING_WINDOW > 1, "Bad UPGRADE_VOTING_WINDOW");
 
 const char     CRYPTONOTE_BLOCKS_FILENAME[]                  = "blocks.bin";
 const char     CRYPTONOTE_BLOCKINDEXES_FILENAME[]            = "blockindexes.bin";
+const char     CRYPTONOTE_BLOCK_SEGMENTS_FILENAME[]          = "blocksegment";
+const char     CRYPTONOTE_BLOCK_OFFSETS_FILENAME[]           = "blockoffsets.bin";
 const char     CRYPTONOTE_POOLDATA_FILENAME[]                = "poolstate.bin";
+const char     CRYPTONOTE_KEY_OUTPUTS_INDEX_FILENAME[]       = "keyoutputs.bin";
 const char     P2P_NET_DATA_FILENAME[]                       = "p2pstate.bin";
 const char     MINER_CONFIG_FILE_NAME[]                      = "miner_conf.json";
 const char     GENESIS_COINBASE_TX_HEX[]                     = "010101ff00018080b08a83b7f6d3980102fcea501416978d2999037fc1c64637c7a9eac489221727bba0a517e208520fa021010ea3cd76354383d23f3ee98ab2f095f1dfff82eb02e0004c372388658e1900bf";
@@ -120,6 +123,12 @@ const uint8_t  BLOCK_MINOR_VERSION_1                         =  1;
 
 const size_t   BLOCKS_IDS_SYNCHRONIZING_DEFAULT_COUNT        =  10000;  //by default, blocks ids count in synchronizing
 const size_t   BLOCKS_SYNCHRONIZING_DEFAULT_COUNT            =  100;    //by default, blocks count in blocks downloading
+const size_t   BLOCKS_SYNCHRONIZING_MIN_COUNT                =  10;     //blocks count in a download span from a slow peer
+const size_t   BLOCKS_SYNCHRONIZING_INITIAL_COUNT            =  20;     //blocks count in a download span from a peer without statistics
+const uint64_t BLOCKS_SYNCHRONIZING_MAX_BUFFERED_SIZE        =  64 * 1024 * 1024; //downloaded blocks waiting for the preceding ones
+const uint32_t BLOCKS_SYNCHRONIZING_SPAN_DURATION            =  2000;   // 2 seconds, download time a span is sized for
+const uint32_t BLOCKS_SYNCHRONIZING_INITIAL_TIMEOUT          =  30000;  // 30 seconds
+const uint32_t BLOCKS_SYNCHRONIZING_MIN_TIMEOUT              =  5000;   // 5 seconds
 const size_t   COMMAND_RPC_GET_BLOCKS_FAST_MAX_COUNT         =  1000;
 
 const int      P2P_DEFAULT_PORT                              =  29111;
@@ -138,6 +147,13 @@ const uint32_t P2P_DEFAULT_CONNECTION_TIMEOUT                = 5000;          //
 const uint32_t P2P_DEFAULT_PING_CONNECTION_TIMEOUT           = 2000;          // 2 seconds
 const uint64_t P2P_DEFAULT_INVOKE_TIMEOUT                    = 60 * 2 * 1000; // 2 minutes
 const size_t   P2P_DEFAULT_HANDSHAKE_INVOKE_TIMEOUT          = 5000;          // 5 seconds
+const uint32_t P2P_TRANSACTIONS_ANNOUNCE_INTERVAL            = 500;           // 0.5 seconds, transaction hashes are batched for this long
+const uint32_t P2P_TRANSACTIONS_REQUEST_TIMEOUT              = 10000;         // 10 seconds, then an announced transaction is requested from another peer
+const size_t   P2P_KNOWN_TRANSACTIONS_LIMIT                  = 20000;         // transaction hashes remembered per connection
+const size_t   P2P_REQUESTED_TRANSACTIONS_LIMIT              = 50000;         // announced transactions requested and not received yet
+const size_t   P2P_REQUESTED_TRANSACTIONS_PER_CONNECTION_LIMIT = 5000;        // of them requested from one connection
+const size_t   P2P_PENDING_BLOCKS_LIMIT                      = 16;            // compact blocks per connection waiting for their transactions
+const size_t   P2P_BLOCK_TRANSACTIONS_REQUEST_MAX_COUNT      = 10000;         // transactions of a relayed block requested at once
 
 const uint32_t  P2P_FAILED_ADDR_FORGET_SECONDS                  = (60*60);     //1 hour
 const uint32_t  P2P_IP_BLOCKTIME                                 = (60*60*24);  //24 hour
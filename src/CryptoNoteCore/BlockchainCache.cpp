@@ -22,6 +22,7 @@
 
 #include <boost/functional/hash.hpp>
 
+#include "Common/Math.h"
 #include "Common/StdInputStream.h"
 #include "Common/StdOutputStream.h"
 #include "Common/ShuffleGenerator.h"
@@ -42,6 +43,14 @@ namespace {
 UseGenesis addGenesisBlock = UseGenesis(true);
 UseGenesis skipGenesisBlock = UseGenesis(false);
 
+// number of last blocks the consensus rules look at
+size_t getConsensusWindowSize(const Currency& currency) {
+  return std::max({currency.difficultyBlocksCountByBlockVersion(BLOCK_MAJOR_VERSION_1),
+                   currency.difficultyBlocksCountByBlockVersion(BLOCK_MAJOR_VERSION_2),
+                   currency.difficultyBlocksCountByBlockVersion(BLOCK_MAJOR_VERSION_3),
+                   currency.timestampCheckWindow(), currency.rewardBlocksWindow()});
+}
+
 template <class T, class F>
 void splitGlobalIndexes(T& sourceContainer, T& destinationContainer, uint32_t splitBlockIndex, F lowerBoundFunction) {
   for (auto it = sourceContainer.begin(); it != sourceContainer.end();) {
@@ -111,7 +120,8 @@ bool serialize(PackedOutIndex& value, Common::StringView name, CryptoNote::ISeri
 
 BlockchainCache::BlockchainCache(const std::string& filename, const Currency& currency, Logging::ILogger& logger_,
                                  IBlockchainCache* parent, uint32_t splitBlockIndex)
-    : filename(filename), currency(currency), logger(logger_, "BlockchainCache"), parent(parent), storage(new BlockchainStorage(100)) {
+    : filename(filename), currency(currency), logger(logger_, "BlockchainCache"), parent(parent), storage(new BlockchainStorage(100)),
+      unitsCacheSize(getConsensusWindowSize(currency)), blockSizesMedian(currency.rewardBlocksWindow()) {
   if (parent == nullptr) {
     startIndex = 0;
 
@@ -209,6 +219,12 @@ void BlockchainCache::doPushBlock(const CachedBlock& cachedBlock,
 
   storage->pushBlock(std::move(rawBlock));
 
+  if (blockInfos.size() == 1) {
+    fillUnitsCache();
+  } else {
+    pushUnit(blockInfos.get<BlockIndexTag>().back());
+  }
+
   logger(Logging::DEBUGGING) << "Block " << cachedBlock.getBlockHash() << " successfully pushed";
 }
 
@@ -267,6 +283,9 @@ std::unique_ptr<IBlockchainCache> BlockchainCache::split(uint32_t splitBlockInde
   splitBlocks(*newCache, splitBlockIndex);
   splitKeyOutputsGlobalIndexes(*newCache, splitBlockIndex);
 
+  fillUnitsCache();
+  newCache->fillUnitsCache();
+
   fixChildrenParent(newCache.get());
   newCache->children = children;
   children = { newCache.get() };
@@ -321,6 +340,42 @@ void BlockchainCache::splitBlocks(BlockchainCache& newCache, uint32_t splitBlock
   logger(Logging::DEBUGGING) << "Blocks split completed";
 }
 
+void BlockchainCache::fillUnitsCache() {
+  unitsCache.clear();
+  blockSizesMedian.clear();
+
+  auto& blocksIndex = blockInfos.get<BlockIndexTag>();
+  size_t ownCount = std::min(blocksIndex.size(), unitsCacheSize);
+  if (parent != nullptr && ownCount < unitsCacheSize && startIndex > 0) {
+    size_t parentCount = unitsCacheSize - ownCount;
+    auto timestamps = parent->getLastTimestamps(parentCount, startIndex - 1, addGenesisBlock);
+    auto sizes = parent->getLastBlocksSizes(parentCount, startIndex - 1, addGenesisBlock);
+    auto difficulties = parent->getLastCumulativeDifficulties(parentCount, startIndex - 1, addGenesisBlock);
+    assert(timestamps.size() == sizes.size() && sizes.size() == difficulties.size());
+
+    for (size_t i = 0; i < timestamps.size(); ++i) {
+      CachedBlockInfo blockInfo = {};
+      blockInfo.timestamp = timestamps[i];
+      blockInfo.cumulativeDifficulty = difficulties[i];
+      blockInfo.blockSize = static_cast<uint32_t>(sizes[i]);
+      pushUnit(blockInfo);
+    }
+  }
+
+  std::for_each(std::prev(blocksIndex.end(), ownCount), blocksIndex.end(), [this] (const CachedBlockInfo& blockInfo) {
+    pushUnit(blockInfo);
+  });
+}
+
+void BlockchainCache::pushUnit(const CachedBlockInfo& blockInfo) {
+  unitsCache.push_back(blockInfo);
+  if (unitsCache.size() > unitsCacheSize) {
+    unitsCache.pop_front();
+  }
+
+  blockSizesMedian.push(blockInfo.blockSize);
+}
+
 void BlockchainCache::splitKeyOutputsGlobalIndexes(BlockchainCache& newCache, uint32_t splitBlockIndex) {
   auto lowerBoundFunction = [](std::vector<PackedOutIndex>::iterator begin, std::vector<PackedOutIndex>::iterator end,
                                uint32_t splitBlockIndex) -> std::vector<PackedOutIndex>::iterator {
@@ -586,6 +641,14 @@ BinaryArray BlockchainCache::getRawTransaction(uint32_t index, uint32_t transact
   }
 }
 
+bool BlockchainCache::keepsRawBlocks() const {
+  return true;
+}
+
+std::shared_ptr<IDataBase> BlockchainCache::createDatabaseSnapshot() {
+  return nullptr;
+}
+
 std::vector<BinaryArray>
 BlockchainCache::getRawTransactions(const std::vector<Crypto::Hash>& requestedTransactions) const {
   std::vector<Crypto::Hash> misses;
@@ -686,6 +749,13 @@ void BlockchainCache::load() {
   CryptoNote::BinaryInputStreamSerializer s(stream);
 
   serialize(s);
+  fillUnitsCache();
+}
+
+void BlockchainCache::startPushBatch() {
+}
+
+void BlockchainCache::commitPushBatch() {
 }
 
 bool BlockchainCache::isTransactionSpendTimeUnlocked(uint64_t unlockTime) const {
@@ -788,6 +858,72 @@ ExtractOutputKeysResult BlockchainCache::extractKeyOutputKeys(uint64_t amount, u
   });
 }
 
+std::vector<KeyOutputKeysResult> BlockchainCache::extractKeyOutputKeys(uint32_t blockIndex,
+                                                                      const std::vector<KeyOutputKeysRequest>& requests) const {
+  std::vector<KeyOutputKeysResult> results(requests.size());
+  std::vector<size_t> ownIndexesOffsets(requests.size());
+
+  // outputs older than this segment are collected from all requests and passed to the parent at once
+  std::vector<KeyOutputKeysRequest> parentRequests;
+  std::vector<size_t> parentRequestOwners;
+  for (size_t i = 0; i < requests.size(); ++i) {
+    const auto& request = requests[i];
+    assert(!request.globalIndexes.empty());
+    assert(std::is_sorted(request.globalIndexes.begin(), request.globalIndexes.end()));                                        // sorted
+    assert(std::adjacent_find(request.globalIndexes.begin(), request.globalIndexes.end()) == request.globalIndexes.end()); // unique
+
+    results[i].result = ExtractOutputKeysResult::SUCCESS;
+
+    auto globalIndexesIterator = keyOutputsGlobalIndexes.find(request.amount);
+    if (globalIndexesIterator == keyOutputsGlobalIndexes.end() || blockIndex < startIndex) {
+      ownIndexesOffsets[i] = request.globalIndexes.size();
+    } else {
+      auto parentIndexesEnd = std::lower_bound(request.globalIndexes.begin(), request.globalIndexes.end(), globalIndexesIterator->second.startIndex);
+      ownIndexesOffsets[i] = std::distance(request.globalIndexes.begin(), parentIndexesEnd);
+    }
+
+    if (ownIndexesOffsets[i] == 0) {
+      continue;
+    }
+
+    if (parent == nullptr) {
+      results[i].result = ExtractOutputKeysResult::INVALID_GLOBAL_INDEX;
+      continue;
+    }
+
+    parentRequests.push_back({request.amount, std::vector<uint32_t>(request.globalIndexes.begin(), request.globalIndexes.begin() + ownIndexesOffsets[i])});
+    parentRequestOwners.push_back(i);
+  }
+
+  if (!parentRequests.empty()) {
+    auto parentResults = parent->extractKeyOutputKeys(blockIndex, parentRequests);
+    for (size_t i = 0; i < parentResults.size(); ++i) {
+      results[parentRequestOwners[i]] = std::move(parentResults[i]);
+    }
+  }
+
+  for (size_t i = 0; i < requests.size(); ++i) {
+    const auto& request = requests[i];
+    auto& result = results[i];
+    if (result.result != ExtractOutputKeysResult::SUCCESS || ownIndexesOffsets[i] == request.globalIndexes.size()) {
+      continue;
+    }
+
+    Common::ArrayView<uint32_t> globalIndexes(request.globalIndexes.data(), request.globalIndexes.size());
+    result.result = extractKeyOutputs(request.amount, blockIndex, globalIndexes.unhead(ownIndexesOffsets[i]), [&] (const CachedTransactionInfo& info, PackedOutIndex index, uint32_t globalIndex) {
+      if (!isTransactionSpendTimeUnlocked(info.unlockTime, blockIndex)) {
+        return ExtractOutputKeysResult::OUTPUT_LOCKED;
+      }
+
+      assert(info.outputs[index.outputIndex].type() == typeid(KeyOutput));
+      result.publicKeys.push_back(boost::get<KeyOutput>(info.outputs[index.outputIndex]).key);
+      return ExtractOutputKeysResult::SUCCESS;
+    });
+  }
+
+  return results;
+}
+
 ExtractOutputKeysResult
 BlockchainCache::extractKeyOtputReferences(uint64_t amount, Common::ArrayView<uint32_t> globalIndexes,
                                            std::vector<std::pair<Crypto::Hash, size_t>>& outputReferences) const {
@@ -957,6 +1093,21 @@ std::vector<uint64_t> BlockchainCache::getLastUnits(size_t count, uint32_t block
                                                     std::function<uint64_t(const CachedBlockInfo&)> pred) const {
   assert(blockIndex <= getTopBlockIndex());
 
+  if (blockIndex == getTopBlockIndex()) {
+    size_t from = blockIndex + 1 - std::min<size_t>(count, blockIndex + 1);
+    if (!useGenesis && from == 0 && count != 0) {
+      from = 1;
+    }
+
+    size_t cacheStartIndex = blockIndex + 1 - unitsCache.size();
+    if (from >= cacheStartIndex) {
+      std::vector<uint64_t> result;
+      result.reserve(blockIndex + 1 - from);
+      std::transform(std::next(unitsCache.begin(), from - cacheStartIndex), unitsCache.end(), std::back_inserter(result), std::move(pred));
+      return result;
+    }
+  }
+
   size_t to = blockIndex < startIndex ? 0 : blockIndex - startIndex + 1;
   auto realCount = std::min(count, to);
   auto from = to - realCount;
@@ -983,6 +1134,20 @@ std::vector<uint64_t> BlockchainCache::getLastBlocksSizes(size_t count, uint32_t
   return getLastUnits(count, blockIndex, useGenesis, [](const CachedBlockInfo& cb) { return cb.blockSize; });
 }
 
+uint64_t BlockchainCache::getLastBlocksSizesMedian(size_t count) const {
+  return getLastBlocksSizesMedian(count, getTopBlockIndex(), skipGenesisBlock);
+}
+
+uint64_t BlockchainCache::getLastBlocksSizesMedian(size_t count, uint32_t blockIndex, UseGenesis useGenesis) const {
+  if (blockIndex == getTopBlockIndex() && count == blockSizesMedian.getWindowSize() &&
+      blockSizesMedian.size() == std::min<size_t>(count, blockIndex + 1) && (useGenesis || blockIndex >= count)) {
+    return blockSizesMedian.median();
+  }
+
+  auto sizes = getLastBlocksSizes(count, blockIndex, useGenesis);
+  return Common::medianValue(sizes);
+}
+
 Difficulty BlockchainCache::getDifficultyForNextBlock() const {
   return getDifficultyForNextBlock(getTopBlockIndex());
 }
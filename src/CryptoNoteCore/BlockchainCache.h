@@ -16,6 +16,7 @@
 // along with Bytecoin.  If not, see <http://www.gnu.org/licenses/>.
 
 #pragma once
+#include <deque>
 #include <map>
 #include <unordered_map>
 #include <vector>
@@ -29,6 +30,7 @@
 #include <boost/multi_index/random_access_index.hpp>
 
 #include "BlockchainStorage.h"
+#include "Common/SlidingWindowMedian.h"
 #include "Common/StringView.h"
 #include "Currency.h"
 #include "Difficulty.h"
@@ -116,6 +118,7 @@ ExtractOutputKeysResult extractTransactionPublicKeys(uint64_t amount, Common::Ar
 ExtractOutputKeysResult extractTransactionPublicKeys(uint64_t amount, uint32_t blockIndex, Common::ArrayView<uint32_t> globalIndexes, std::vector<Crypto::PublicKey>& publicKeys) const override;
   ExtractOutputKeysResult extractKeyOutputKeys(uint64_t amount, Common::ArrayView<uint32_t> globalIndexes, std::vector<Crypto::PublicKey>& publicKeys) const override;
   ExtractOutputKeysResult extractKeyOutputKeys(uint64_t amount, uint32_t blockIndex, Common::ArrayView<uint32_t> globalIndexes, std::vector<Crypto::PublicKey>& publicKeys) const override;
+  std::vector<KeyOutputKeysResult> extractKeyOutputKeys(uint32_t blockIndex, const std::vector<KeyOutputKeysRequest>& requests) const override;
 
   ExtractOutputKeysResult extractKeyOtputIndexes(uint64_t amount, Common::ArrayView<uint32_t> globalIndexes, std::vector<PackedOutIndex>& outIndexes) const override;
   ExtractOutputKeysResult extractKeyOtputReferences(uint64_t amount, Common::ArrayView<uint32_t> globalIndexes, std::vector<std::pair<Crypto::Hash, size_t>>& outputReferences) const override;
@@ -133,6 +136,8 @@ ExtractOutputKeysResult extractTransactionPublicKeys(uint64_t amount, uint32_t b
 
   std::vector<uint64_t> getLastBlocksSizes(size_t count) const override;
   std::vector<uint64_t> getLastBlocksSizes(size_t count, uint32_t blockIndex, UseGenesis) const override;
+  uint64_t getLastBlocksSizesMedian(size_t count) const override;
+  uint64_t getLastBlocksSizesMedian(size_t count, uint32_t blockIndex, UseGenesis) const override;
 
   std::vector<Difficulty> getLastCumulativeDifficulties(size_t count, uint32_t blockIndex, UseGenesis) const override;
   std::vector<Difficulty> getLastCumulativeDifficulties(size_t count) const override;
@@ -169,6 +174,8 @@ ExtractOutputKeysResult extractTransactionPublicKeys(uint64_t amount, uint32_t b
 
   virtual void save() override;
   virtual void load() override;
+  virtual void startPushBatch() override;
+  virtual void commitPushBatch() override;
 
   virtual std::vector<BinaryArray> getRawTransactions(const std::vector<Crypto::Hash> &transactions,
     std::vector<Crypto::Hash> &missedTransactions) const override;
@@ -178,6 +185,8 @@ ExtractOutputKeysResult extractTransactionPublicKeys(uint64_t amount, uint32_t b
     std::vector<Crypto::Hash> &missedTransactions) const override;
   virtual RawBlock getBlockByIndex(uint32_t index) const override;
   virtual BinaryArray getRawTransaction(uint32_t blockIndex, uint32_t transactionIndex) const override;
+  virtual bool keepsRawBlocks() const override;
+  virtual std::shared_ptr<IDataBase> createDatabaseSnapshot() override;
   virtual std::vector<Crypto::Hash> getTransactionHashes() const override;
   virtual std::vector<uint32_t> getRandomOutsByAmount(uint64_t amount, size_t count, uint32_t blockIndex, uint32_t startBlockIndex) const override;
   virtual std::vector<uint32_t> getRandomOutsByAmount(uint64_t amount, size_t count, uint32_t blockIndex) const override;
@@ -287,6 +296,12 @@ private:
   PaymentIdContainer paymentIds;
   std::unique_ptr<BlockchainStorage> storage;
 
+  // Consensus window of the blocks up to the top of this segment, blocks of parent segments included.
+  // Only timestamp, cumulativeDifficulty and blockSize are set for the blocks of parent segments.
+  std::deque<CachedBlockInfo> unitsCache;
+  size_t unitsCacheSize;
+  Common::SlidingWindowMedian<uint64_t> blockSizesMedian;
+
   std::vector<IBlockchainCache*> children;
  
   void serialize(ISerializer& s);
@@ -300,6 +315,9 @@ private:
   void splitKeyOutputsGlobalIndexes(BlockchainCache& newCache, uint32_t splitBlockIndex);
   void removePaymentId(const Crypto::Hash& transactionHash, BlockchainCache& newCache);
 
+  void fillUnitsCache();
+  void pushUnit(const CachedBlockInfo& blockInfo);
+
   uint32_t insertKeyOutputToGlobalIndex(uint64_t amount, PackedOutIndex output, uint32_t blockIndex);
 
   enum class OutputSearchResult : uint8_t {
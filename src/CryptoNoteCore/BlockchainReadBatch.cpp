@@ -127,6 +127,11 @@ BlockchainReadBatch& BlockchainReadBatch::requestTransactionsCount() {
   return *this;
 }
 
+BlockchainReadBatch& BlockchainReadBatch::requestSpentKeyImagesCount() {
+  state.spentKeyImagesCount.second = true;
+  return *this;
+}
+
 BlockchainReadBatch& BlockchainReadBatch::requestKeyOutputInfo(IBlockchainCache::Amount amount, IBlockchainCache::GlobalOutputIndex globalIndex) {
   state.keyOutputKeys.emplace(std::make_pair(amount, globalIndex), KeyOutputInfo{});
   return *this;
@@ -176,6 +181,10 @@ std::vector<std::string> BlockchainReadBatch::getRawKeys() const {
     rawKeys.emplace_back(DB::serializeKey(DB::TRANSACTION_HASH_TO_TRANSACTION_INFO_PREFIX, DB::TRANSACTIONS_COUNT_KEY));
   }
 
+  if (state.spentKeyImagesCount.second) {
+    rawKeys.emplace_back(DB::serializeKey(DB::BLOCK_INDEX_TO_KEY_IMAGE_PREFIX, DB::SPENT_KEY_IMAGES_COUNT_KEY));
+  }
+
   assert(!rawKeys.empty());
   return rawKeys;
 }
@@ -264,6 +273,10 @@ const std::pair<uint64_t, bool>& BlockchainReadResult::getTransactionsCount() co
   return state.transactionsCount;
 }
 
+const std::pair<uint64_t, bool>& BlockchainReadResult::getSpentKeyImagesCount() const {
+  return state.spentKeyImagesCount;
+}
+
 const KeyOutputKeyResult& BlockchainReadResult::getKeyOutputInfo() const {
   return state.keyOutputKeys;
 }
@@ -295,6 +308,7 @@ void BlockchainReadBatch::submitRawResult(const std::vector<std::string>& values
   DB::deserializeValue(state.lastBlockIndex, iter, DB::BLOCK_INDEX_TO_BLOCK_HASH_PREFIX);
   DB::deserializeValue(state.keyOutputAmountsCount, iter, DB::KEY_OUTPUT_AMOUNTS_COUNT_PREFIX);
   DB::deserializeValue(state.transactionsCount, iter, DB::TRANSACTION_HASH_TO_TRANSACTION_INFO_PREFIX);
+  DB::deserializeValue(state.spentKeyImagesCount, iter, DB::BLOCK_INDEX_TO_KEY_IMAGE_PREFIX);
 
   assert(iter == range.end());
   
@@ -321,7 +335,8 @@ inputCountByOutputKeys(std::move(state.inputCountByOutputKeys)),
 inputsByOutputKeys(std::move(state.inputsByOutputKeys)),
 transactionCountsByPaymentIds(std::move(state.transactionCountsByPaymentIds)),
 transactionHashesByPaymentIds(std::move(state.transactionHashesByPaymentIds)),
-transactionsCount(std::move(state.transactionsCount)) {
+transactionsCount(std::move(state.transactionsCount)),
+spentKeyImagesCount(std::move(state.spentKeyImagesCount)) {
 }
 
 size_t BlockchainReadState::size() const {
@@ -344,7 +359,8 @@ size_t BlockchainReadState::size() const {
     keyOutputKeys.size() +
     (lastBlockIndex.second ? 1 : 0) +
     (keyOutputAmountsCount.second ? 1 : 0) +
-    (transactionsCount.second ? 1 : 0);
+    (transactionsCount.second ? 1 : 0) +
+    (spentKeyImagesCount.second ? 1 : 0);
 }
 
 BlockchainReadResult::BlockchainReadResult(BlockchainReadResult&& result) : state(std::move(result.state)) {
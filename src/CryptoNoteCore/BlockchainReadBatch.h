@@ -85,6 +85,7 @@ std::unordered_map<std::pair<Crypto::PublicKey, uint32_t>, Crypto::KeyImage> inp
   std::pair<uint32_t, bool> lastBlockIndex = { 0, false };
   std::pair<uint32_t, bool> keyOutputAmountsCount = { {}, false };
   std::pair<uint64_t, bool> transactionsCount = { 0, false };
+  std::pair<uint64_t, bool> spentKeyImagesCount = { 0, false };
 
   BlockchainReadState() = default;
   BlockchainReadState(const BlockchainReadState&) = default;
@@ -119,6 +120,7 @@ public:
   const std::unordered_map<std::pair<Crypto::Hash, uint32_t>, Crypto::Hash>& getTransactionHashesByPaymentIds() const;
   const std::unordered_map<uint64_t, std::vector<Crypto::Hash> >& getBlockHashesByTimestamp() const;
   const std::pair<uint64_t, bool>& getTransactionsCount() const;
+  const std::pair<uint64_t, bool>& getSpentKeyImagesCount() const;
   const KeyOutputKeyResult& getKeyOutputInfo() const;
 
 private:
@@ -149,6 +151,7 @@ public:
   BlockchainReadBatch& requestTransactionHashByPaymentId(const Crypto::Hash& paymentId, uint32_t transactionIndexWithinPaymentId);
   BlockchainReadBatch& requestBlockHashesByTimestamp(uint64_t timestamp);
   BlockchainReadBatch& requestTransactionsCount();
+  BlockchainReadBatch& requestSpentKeyImagesCount();
   BlockchainReadBatch& requestKeyOutputInfo(IBlockchainCache::Amount amount, IBlockchainCache::GlobalOutputIndex globalIndex);
 
   std::vector<std::string> getRawKeys() const override;
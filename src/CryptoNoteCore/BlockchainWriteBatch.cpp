@@ -29,12 +29,19 @@ BlockchainWriteBatch::~BlockchainWriteBatch() {
 
 }
 
-BlockchainWriteBatch& BlockchainWriteBatch::insertSpentKeyImages(uint32_t blockIndex, const std::unordered_set<Crypto::KeyImage>& spentKeyImages) {
-  rawDataToInsert.reserve(rawDataToInsert.size() + spentKeyImages.size() + 1);
+BlockchainWriteBatch& BlockchainWriteBatch::insertSpentKeyImages(uint32_t blockIndex, const std::unordered_set<Crypto::KeyImage>& spentKeyImages,
+                                                                uint64_t totalSpentKeyImagesCount) {
+  rawDataToInsert.reserve(rawDataToInsert.size() + spentKeyImages.size() + 2);
   rawDataToInsert.emplace_back(DB::serialize(DB::BLOCK_INDEX_TO_KEY_IMAGE_PREFIX, blockIndex, spentKeyImages));
   for (const Crypto::KeyImage& keyImage : spentKeyImages) {
     rawDataToInsert.emplace_back(DB::serialize(DB::KEY_IMAGE_TO_BLOCK_INDEX_PREFIX, keyImage, blockIndex));
   }
+  insertSpentKeyImagesCount(totalSpentKeyImagesCount);
+  return *this;
+}
+
+BlockchainWriteBatch& BlockchainWriteBatch::insertSpentKeyImagesCount(uint64_t totalSpentKeyImagesCount) {
+  rawDataToInsert.emplace_back(DB::serialize(DB::BLOCK_INDEX_TO_KEY_IMAGE_PREFIX, DB::SPENT_KEY_IMAGES_COUNT_KEY, totalSpentKeyImagesCount));
   return *this;
 }
 
@@ -113,7 +120,8 @@ BlockchainWriteBatch& BlockchainWriteBatch::insertKeyOutputInfo(IBlockchainCache
   return *this;
 }
 
-BlockchainWriteBatch& BlockchainWriteBatch::removeSpentKeyImages(uint32_t blockIndex, const std::vector<Crypto::KeyImage>& spentKeyImages) {
+BlockchainWriteBatch& BlockchainWriteBatch::removeSpentKeyImages(uint32_t blockIndex, const std::vector<Crypto::KeyImage>& spentKeyImages,
+                                                                uint64_t totalSpentKeyImagesCount) {
   rawKeysToRemove.reserve(rawKeysToRemove.size() + spentKeyImages.size() + 1);
   rawKeysToRemove.emplace_back(DB::serializeKey(DB::BLOCK_INDEX_TO_KEY_IMAGE_PREFIX, blockIndex));
 
@@ -121,6 +129,8 @@ BlockchainWriteBatch& BlockchainWriteBatch::removeSpentKeyImages(uint32_t blockI
     rawKeysToRemove.emplace_back(DB::serializeKey(DB::KEY_IMAGE_TO_BLOCK_INDEX_PREFIX, keyImage));
   }
 
+  insertSpentKeyImagesCount(totalSpentKeyImagesCount);
+
   return *this;
 }
 
@@ -30,7 +30,8 @@ public:
   BlockchainWriteBatch();
   ~BlockchainWriteBatch();
 
-  BlockchainWriteBatch& insertSpentKeyImages(uint32_t blockIndex, const std::unordered_set<Crypto::KeyImage>& spentKeyImages);
+  BlockchainWriteBatch& insertSpentKeyImages(uint32_t blockIndex, const std::unordered_set<Crypto::KeyImage>& spentKeyImages, uint64_t totalSpentKeyImagesCount);
+  BlockchainWriteBatch& insertSpentKeyImagesCount(uint64_t totalSpentKeyImagesCount);
   BlockchainWriteBatch& insertCachedTransaction(const ExtendedTransactionInfo& transaction, uint64_t totalTxsCount);
   BlockchainWriteBatch& insertPaymentId(const Crypto::Hash& transactionHash, const Crypto::Hash paymentId, uint32_t totalTxsCountForPaymentId);
   BlockchainWriteBatch& insertInputOutputKey(Crypto::KeyImage inputKey, Crypto::PublicKey outputKey, uint32_t totalInputsCountForOutputKey);
@@ -42,7 +43,7 @@ public:
   BlockchainWriteBatch& insertTimestamp(uint64_t timestamp, const std::vector<Crypto::Hash>& blockHashes);
   BlockchainWriteBatch& insertKeyOutputInfo(IBlockchainCache::Amount amount, IBlockchainCache::GlobalOutputIndex globalIndex, const KeyOutputInfo& outputInfo);
 
-  BlockchainWriteBatch& removeSpentKeyImages(uint32_t blockIndex, const std::vector<Crypto::KeyImage>& spentKeyImages);
+  BlockchainWriteBatch& removeSpentKeyImages(uint32_t blockIndex, const std::vector<Crypto::KeyImage>& spentKeyImages, uint64_t totalSpentKeyImagesCount);
   BlockchainWriteBatch& removeCachedTransaction(const Crypto::Hash& transactionHash, uint64_t totalTxsCount);
   BlockchainWriteBatch& removePaymentId(const Crypto::Hash paymentId, uint32_t totalTxsCountForPaytmentId);
   BlockchainWriteBatch& removeInputOutputKey(const Crypto::PublicKey outputKey, uint32_t totalInputsCountForOutputKey);
@@ -0,0 +1,203 @@
+// Copyright (c) 2012-2017, The CryptoNote developers, The Bytecoin developers
+//
+// This file is part of Bytecoin.
+//
+// Bytecoin is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Bytecoin is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with Bytecoin.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "BufferedDataBase.h"
+
+#include <cassert>
+
+namespace CryptoNote {
+
+namespace {
+
+class RecordsWriteBatch: public IWriteBatch {
+public:
+  explicit RecordsWriteBatch(std::map<std::string, boost::optional<std::string>>& records) : records(records) {
+  }
+
+  virtual std::vector<std::pair<std::string, std::string>> extractRawDataToInsert() override {
+    std::vector<std::pair<std::string, std::string>> rawData;
+    for (auto& record : records) {
+      if (record.second) {
+        rawData.emplace_back(record.first, std::move(*record.second));
+      }
+    }
+
+    return rawData;
+  }
+
+  virtual std::vector<std::string> extractRawKeysToRemove() override {
+    std::vector<std::string> rawKeys;
+    for (auto& record : records) {
+      if (!record.second) {
+        rawKeys.push_back(record.first);
+      }
+    }
+
+    return rawKeys;
+  }
+
+private:
+  std::map<std::string, boost::optional<std::string>>& records;
+};
+
+class RawKeysReadBatch: public IReadBatch {
+public:
+  explicit RawKeysReadBatch(std::vector<std::string>&& rawKeys) : rawKeys(std::move(rawKeys)) {
+  }
+
+  virtual std::vector<std::string> getRawKeys() const override {
+    return rawKeys;
+  }
+
+  virtual void submitRawResult(const std::vector<std::string>& values, const std::vector<bool>& resultStates) override {
+    this->values = values;
+    this->resultStates = resultStates;
+  }
+
+  std::vector<std::string> rawKeys;
+  std::vector<std::string> values;
+  std::vector<bool> resultStates;
+};
+
+}
+
+BufferedDataBase::BufferedDataBase(IDataBase& database) : database(database), buffering(false), bufferedSize(0) {
+}
+
+void BufferedDataBase::startBuffering() {
+  buffering = true;
+}
+
+std::error_code BufferedDataBase::flush() {
+  buffering = false;
+  if (records.empty()) {
+    return std::error_code();
+  }
+
+  RecordsWriteBatch batch(records);
+  auto error = database.write(batch);
+  records.clear();
+  bufferedSize = 0;
+  return error;
+}
+
+bool BufferedDataBase::isBuffering() const {
+  return buffering;
+}
+
+size_t BufferedDataBase::getBufferedSize() const {
+  return bufferedSize;
+}
+
+std::error_code BufferedDataBase::write(IWriteBatch& batch) {
+  if (!buffering) {
+    return database.write(batch);
+  }
+
+  for (auto& kv : batch.extractRawDataToInsert()) {
+    bufferedSize += kv.first.size() + kv.second.size();
+    records[kv.first] = std::move(kv.second);
+  }
+
+  for (auto& key : batch.extractRawKeysToRemove()) {
+    bufferedSize += key.size();
+    records[key] = boost::none;
+  }
+
+  return std::error_code();
+}
+
+std::error_code BufferedDataBase::writeSync(IWriteBatch& batch) {
+  if (!buffering) {
+    return database.writeSync(batch);
+  }
+
+  auto error = write(batch);
+  if (error) {
+    return error;
+  }
+
+  RecordsWriteBatch bufferedBatch(records);
+  error = database.writeSync(bufferedBatch);
+  records.clear();
+  bufferedSize = 0;
+  return error;
+}
+
+std::error_code BufferedDataBase::read(IReadBatch& batch) {
+  if (records.empty()) {
+    return database.read(batch);
+  }
+
+  auto rawKeys = batch.getRawKeys();
+  std::vector<std::string> values(rawKeys.size());
+  std::vector<bool> resultStates(rawKeys.size());
+
+  std::vector<size_t> databaseKeyIndexes;
+  std::vector<std::string> databaseKeys;
+  for (size_t i = 0; i < rawKeys.size(); ++i) {
+    auto it = records.find(rawKeys[i]);
+    if (it == records.end()) {
+      databaseKeyIndexes.push_back(i);
+      databaseKeys.push_back(rawKeys[i]);
+    } else if (it->second) {
+      values[i] = *it->second;
+      resultStates[i] = true;
+    }
+  }
+
+  if (!databaseKeys.empty()) {
+    RawKeysReadBatch databaseBatch(std::move(databaseKeys));
+    auto error = database.read(databaseBatch);
+    if (error) {
+      return error;
+    }
+
+    assert(databaseBatch.values.size() == databaseKeyIndexes.size());
+    for (size_t i = 0; i < databaseKeyIndexes.size(); ++i) {
+      values[databaseKeyIndexes[i]] = std::move(databaseBatch.values[i]);
+      resultStates[databaseKeyIndexes[i]] = databaseBatch.resultStates[i];
+    }
+  }
+
+  batch.submitRawResult(values, resultStates);
+  return std::error_code();
+}
+
+std::error_code BufferedDataBase::iterate(const std::string& startKey, const std::function<bool(const std::string& key, const std::string& value)>& handler) {
+  // iteration is rare, the buffered records are written first instead of merging them into it
+  if (!records.empty()) {
+    bool wasBuffering = buffering;
+    auto error = flush();
+    buffering = wasBuffering;
+    if (error) {
+      return error;
+    }
+  }
+
+  return database.iterate(startKey, handler);
+}
+
+std::shared_ptr<IDataBase> BufferedDataBase::createSnapshot() {
+  if (buffering) {
+    return nullptr;
+  }
+
+  return database.createSnapshot();
+}
+
+}
@@ -0,0 +1,57 @@
+// Copyright (c) 2012-2017, The CryptoNote developers, The Bytecoin developers
+//
+// This file is part of Bytecoin.
+//
+// Bytecoin is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Bytecoin is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with Bytecoin.  If not, see <http://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <map>
+
+#include <boost/optional.hpp>
+
+#include "IDataBase.h"
+
+namespace CryptoNote {
+
+// Passes everything to the wrapped DB until startBuffering() is called. Then writes are kept in memory,
+// reads see them, and flush() writes all of them to the wrapped DB with one batch.
+class BufferedDataBase: public IDataBase {
+public:
+  explicit BufferedDataBase(IDataBase& database);
+
+  void startBuffering();
+  // Writes the buffered records and stops buffering
+  std::error_code flush();
+  bool isBuffering() const;
+  size_t getBufferedSize() const; //Bytes
+
+  virtual std::error_code write(IWriteBatch& batch) override;
+  virtual std::error_code writeSync(IWriteBatch& batch) override;
+  virtual std::error_code read(IReadBatch& batch) override;
+  // Writes the buffered records before iterating and keeps buffering, so the records buffered up to this call
+  // and the later ones are written with separate batches. The DB cache doesn't iterate while pushing blocks.
+  virtual std::error_code iterate(const std::string& startKey, const std::function<bool(const std::string& key, const std::string& value)>& handler) override;
+  // Buffered records aren't in the wrapped DB yet, so there is no snapshot while buffering
+  virtual std::shared_ptr<IDataBase> createSnapshot() override;
+
+private:
+  IDataBase& database;
+  bool buffering;
+  // none means the key is removed
+  std::map<std::string, boost::optional<std::string>> records;
+  size_t bufferedSize;
+};
+
+}
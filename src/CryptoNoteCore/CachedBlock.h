@@ -39,6 +39,7 @@ public:
   const BinaryArray& getBlockHashingBinaryArray() const;
   const BinaryArray& getParentBlockBinaryArray(bool headerOnly) const;
   const BinaryArray& getParentBlockHashingBinaryArray(bool headerOnly) const;
+  const BinaryArray& getBlockLongHashingBinaryArray() const;
   uint32_t getBlockIndex() const;
 
 private:
@@ -16,6 +16,7 @@
 // along with Bytecoin.  If not, see <http://www.gnu.org/licenses/>.
 
 #include <algorithm>
+#include <functional>
 #include <numeric>
 #include <set>
 #include <unordered_set>
@@ -24,6 +25,7 @@
 #include "Common/ShuffleGenerator.h"
 #include "Common/Math.h"
 #include "Common/MemoryInputStream.h"
+#include "Common/ScopeExit.h"
 #include "CryptoNoteTools.h"
 #include "CryptoNoteFormatUtils.h"
 #include "BlockchainCache.h"
@@ -38,6 +40,8 @@
 #include "CryptoNoteCore/UpgradeManager.h"
 #include "CryptoNoteProtocol/CryptoNoteProtocolHandlerCommon.h"
 
+#include <System/EventLock.h>
+#include <System/RemoteContext.h>
 #include <System/Timer.h>
 
 #include "TransactionApi.h"
@@ -56,6 +60,42 @@ std::vector<T> preallocateVector(size_t elements) {
 }
 UseGenesis addGenesisBlock = UseGenesis(true);
 
+bool isBlockAdded(const std::error_code& result) {
+  return result == error::AddBlockErrorCode::ADDED_TO_MAIN ||
+         result == error::AddBlockErrorCode::ADDED_TO_ALTERNATIVE ||
+         result == error::AddBlockErrorCode::ADDED_TO_ALTERNATIVE_AND_SWITCHED;
+}
+
+size_t getKeyInputsCount(const Transaction& transaction) {
+  return std::count_if(transaction.inputs.begin(), transaction.inputs.end(), [] (const TransactionInput& input) {
+    return input.type() == typeid(KeyInput);
+  });
+}
+
+// Requests for every key input of the block in order. Empty if some input has malformed output indexes,
+// validateTransaction reads those inputs itself and rejects them.
+std::vector<KeyOutputKeysRequest> getKeyOutputKeysRequests(const std::vector<CachedTransaction>& transactions) {
+  std::vector<KeyOutputKeysRequest> requests;
+  for (const auto& transaction : transactions) {
+    for (const auto& input : transaction.getTransaction().inputs) {
+      if (input.type() != typeid(KeyInput)) {
+        continue;
+      }
+
+      const KeyInput& in = boost::get<KeyInput>(input);
+      auto globalIndexes = relativeOutputOffsetsToAbsolute(in.outputIndexes);
+      if (globalIndexes.empty() ||
+          std::adjacent_find(globalIndexes.begin(), globalIndexes.end(), std::greater_equal<uint32_t>()) != globalIndexes.end()) {
+        return {};
+      }
+
+      requests.push_back({in.amount, std::move(globalIndexes)});
+    }
+  }
+
+  return requests;
+}
+
 class TransactionSpentInputsChecker {
 public:
   bool haveSpentInputs(const Transaction& transaction) {
@@ -155,8 +195,7 @@ int64_t getEmissionChange(const Currency& currency, IBlockchainCache& segment, u
   uint64_t reward = 0;
   int64_t emissionChange = 0;
   auto alreadyGeneratedCoins = segment.getAlreadyGeneratedCoins(previousBlockIndex);
-  auto lastBlocksSizes = segment.getLastBlocksSizes(currency.rewardBlocksWindow(), previousBlockIndex, addGenesisBlock);
-  auto blocksSizeMedian = Common::medianValue(lastBlocksSizes);
+  auto blocksSizeMedian = segment.getLastBlocksSizesMedian(currency.rewardBlocksWindow(), previousBlockIndex, addGenesisBlock);
   if (!currency.getBlockReward(cachedBlock.getBlock().majorVersion, blocksSizeMedian,
                                cumulativeSize, alreadyGeneratedCoins, cumulativeFee, reward, emissionChange)) {
     throw std::system_error(make_error_code(error::BlockValidationError::CUMULATIVE_BLOCK_SIZE_TOO_BIG));
@@ -187,20 +226,30 @@ uint32_t findCommonRoot(IMainChainStorage& storage, IBlockchainCache& rootSegmen
 }
 
 const std::chrono::seconds OUTDATED_TRANSACTION_POLLING_INTERVAL = std::chrono::seconds(60);
+const size_t RING_SIGNATURE_CACHE_SIZE = 100000;
+const uint32_t IMPORT_BLOCKS_PER_READ = 500;
 
 }
 
 Core::Core(const Currency& currency, Logging::ILogger& logger, Checkpoints&& checkpoints, System::Dispatcher& dispatcher,
-           std::unique_ptr<IBlockchainCacheFactory>&& blockchainCacheFactory, std::unique_ptr<IMainChainStorage>&& mainchainStorage)
-    : currency(currency), dispatcher(dispatcher), contextGroup(dispatcher), logger(logger, "Core"), checkpoints(std::move(checkpoints)),
-      upgradeManager(new UpgradeManager()), blockchainCacheFactory(std::move(blockchainCacheFactory)),
-      mainChainStorage(std::move(mainchainStorage)), initialized(false) {
+           std::unique_ptr<IBlockchainCacheFactory>&& blockchainCacheFactory, std::unique_ptr<IMainChainStorage>&& mainchainStorage,
+           const CoreConfig& coreConfig)
+    : currency(currency), dispatcher(dispatcher), contextGroup(dispatcher), logger(logger, "Core"), addBlockEvent(dispatcher),
+      checkpoints(std::move(checkpoints)), upgradeManager(new UpgradeManager()), blockchainCacheFactory(std::move(blockchainCacheFactory)),
+      mainChainStorage(std::move(mainchainStorage)), initialized(false), blockTemplateBodyValid(false),
+      blockTemplateCacheStatistics(BlockTemplateCacheStatistics{0, 0, 0}), ringSignatureCache(RING_SIGNATURE_CACHE_SIZE) {
+
+  addBlockEvent.set();
+  if (coreConfig.getValidationThreadsCount() > 1) {
+    validationThreadPool.reset(new Common::ThreadPool(coreConfig.getValidationThreadsCount()));
+    proofOfWorkService.reset(new ProofOfWorkService(dispatcher, *validationThreadPool));
+  }
 
   upgradeManager->addMajorBlockVersion(BLOCK_MAJOR_VERSION_2, currency.upgradeHeight(BLOCK_MAJOR_VERSION_2));
   upgradeManager->addMajorBlockVersion(BLOCK_MAJOR_VERSION_3, currency.upgradeHeight(BLOCK_MAJOR_VERSION_3));
 
   transactionPool = std::unique_ptr<ITransactionPoolCleanWrapper>(new TransactionPoolCleanWrapper(
-    std::unique_ptr<ITransactionPool>(new TransactionPool(logger)),
+    std::unique_ptr<ITransactionPool>(new TransactionPool(logger, coreConfig.getTransactionPoolMaxSize())),
     std::unique_ptr<ITimeProvider>(new RealTimeProvider()),
     logger,
     currency.mempoolTxLiveTime()));
@@ -497,6 +546,19 @@ void Core::getTransactions(const std::vector<Crypto::Hash>& transactionHashes, s
   missedHashes.insert(missedHashes.end(), leftTransactions.begin(), leftTransactions.end());
 }
 
+void Core::getPoolTransactions(const std::vector<Crypto::Hash>& transactionHashes, std::vector<BinaryArray>& transactions,
+                               std::vector<Crypto::Hash>& missedHashes) const {
+  throwIfNotInitialized();
+
+  for (const auto& transactionHash : transactionHashes) {
+    if (transactionPool->checkIfTransactionPresent(transactionHash)) {
+      transactions.emplace_back(transactionPool->getTransaction(transactionHash).getTransactionBinaryArray());
+    } else {
+      missedHashes.push_back(transactionHash);
+    }
+  }
+}
+
 Difficulty Core::getBlockDifficulty(uint32_t blockIndex) const {
   throwIfNotInitialized();
   IBlockchainCache* mainChain = chainsLeaves[0];
@@ -540,7 +602,13 @@ std::vector<Crypto::Hash> Core::findBlockchainSupplement(const std::vector<Crypt
 }
 
 std::error_code Core::addBlock(const CachedBlock& cachedBlock, RawBlock&& rawBlock) {
+  return addBlock(cachedBlock, std::move(rawBlock), nullptr);
+}
+
+std::error_code Core::addBlock(const CachedBlock& cachedBlock, RawBlock&& rawBlock, std::vector<CachedTransaction>* extractedTransactions) {
   throwIfNotInitialized();
+  // signatures may be checked in a remote context, so other blocks must wait until this one is added
+  System::EventLock addBlockLock(addBlockEvent);
   logger(Logging::DEBUGGING) << "Request to add block came for block " << cachedBlock.getBlockHash();
 
   if (hasBlock(cachedBlock.getBlockHash())) {
@@ -561,7 +629,12 @@ std::error_code Core::addBlock(const CachedBlock& cachedBlock, RawBlock&& rawBlo
 
   std::vector<CachedTransaction> transactions;
   uint64_t cumulativeSize = 0;
-  if (!extractTransactions(rawBlock.transactions, transactions, cumulativeSize)) {
+  if (extractedTransactions != nullptr) {
+    transactions = std::move(*extractedTransactions);
+    for (const auto& rawTransaction : rawBlock.transactions) {
+      cumulativeSize += rawTransaction.size();
+    }
+  } else if (!extractTransactions(rawBlock.transactions, transactions, cumulativeSize)) {
     logger(Logging::WARNING) << "Couldn't deserialize raw block transactions in block " << cachedBlock.getBlockHash();
     return error::AddBlockErrorCode::DESERIALIZATION_FAILED;
   }
@@ -605,23 +678,45 @@ std::error_code Core::addBlock(const CachedBlock& cachedBlock, RawBlock&& rawBlo
     return error::BlockValidationError::DIFFICULTY_OVERHEAD;
   }
 
+  // output keys referenced by the whole block are read at once instead of input by input
+  std::vector<KeyOutputKeysResult> blockOutputKeys;
+  if (!checkpoints.isInCheckpointZone(previousBlockIndex + 1)) {
+    auto outputKeysRequests = getKeyOutputKeysRequests(transactions);
+    if (!outputKeysRequests.empty()) {
+      blockOutputKeys = cache->extractKeyOutputKeys(previousBlockIndex, outputKeysRequests);
+    }
+  }
+
+  RingSignatureBatch signatureBatch;
+  RingSignatureBatch* deferredSignatures = validationThreadPool ? &signatureBatch : nullptr;
   uint64_t cumulativeFee = 0;
-  for (const auto& transaction : transactions) {
+  size_t keyInputsOffset = 0;
+  for (size_t i = 0; i < transactions.size(); ++i) {
+    const auto& transaction = transactions[i];
+    KeyOutputKeysResult* transactionOutputKeys = blockOutputKeys.empty() ? nullptr : blockOutputKeys.data() + keyInputsOffset;
     uint64_t fee = 0;
-    auto transactionValidationResult = validateTransaction(transaction, validatorState, cache, fee, previousBlockIndex);
+    auto transactionValidationResult = validateTransaction(transaction, validatorState, cache, fee, previousBlockIndex, deferredSignatures, i, transactionOutputKeys);
     if (transactionValidationResult) {
       logger(Logging::DEBUGGING) << "Failed to validate transaction " << transaction.getTransactionHash() << ": " << transactionValidationResult.message();
       return transactionValidationResult;
     }
 
     cumulativeFee += fee;
+    keyInputsOffset += getKeyInputsCount(transaction.getTransaction());
+  }
+
+  // ring signatures are checked by the validation thread pool while reward and proof of work are checked here
+  std::unique_ptr<System::RemoteContext<size_t>> signatureVerification;
+  if (!signatureBatch.empty()) {
+    signatureVerification.reset(new System::RemoteContext<size_t>(dispatcher, [this, &signatureBatch] {
+      return signatureBatch.verify(*validationThreadPool);
+    }));
   }
 
   uint64_t reward = 0;
   int64_t emissionChange = 0;
   auto alreadyGeneratedCoins = cache->getAlreadyGeneratedCoins(previousBlockIndex);
-  auto lastBlocksSizes = cache->getLastBlocksSizes(currency.rewardBlocksWindow(), previousBlockIndex, addGenesisBlock);
-  auto blocksSizeMedian = Common::medianValue(lastBlocksSizes);
+  auto blocksSizeMedian = cache->getLastBlocksSizesMedian(currency.rewardBlocksWindow(), previousBlockIndex, addGenesisBlock);
 
   if (!currency.getBlockReward(cachedBlock.getBlock().majorVersion, blocksSizeMedian,
                                cumulativeBlockSize, alreadyGeneratedCoins, cumulativeFee, reward, emissionChange)) {
@@ -640,9 +735,25 @@ std::error_code Core::addBlock(const CachedBlock& cachedBlock, RawBlock&& rawBlo
       logger(Logging::WARNING) << "Checkpoint block hash mismatch for block " << cachedBlock.getBlockHash();
       return error::BlockValidationError::CHECKPOINT_BLOCK_HASH_MISMATCH;
     }
-  } else if (!currency.checkProofOfWork(cryptoContext, cachedBlock, currentDifficulty)) {
-    logger(Logging::WARNING) << "Proof of work too weak for block " << cachedBlock.getBlockHash();
-    return error::BlockValidationError::PROOF_OF_WORK_TOO_WEAK;
+  } else {
+    if (proofOfWorkService) {
+      // the hash may already be calculated ahead by the service, otherwise checkProofOfWork calculates it
+      proofOfWorkService->waitBlockLongHash(cachedBlock);
+    }
+
+    if (!currency.checkProofOfWork(cryptoContext, cachedBlock, currentDifficulty)) {
+      logger(Logging::WARNING) << "Proof of work too weak for block " << cachedBlock.getBlockHash();
+      return error::BlockValidationError::PROOF_OF_WORK_TOO_WEAK;
+    }
+  }
+
+  if (signatureVerification) {
+    auto failedTransactionIndex = signatureVerification->get();
+    if (failedTransactionIndex != RingSignatureBatch::NO_FAILURE) {
+      logger(Logging::DEBUGGING) << "Failed to validate transaction " << transactions[failedTransactionIndex].getTransactionHash() << ": "
+                                 << make_error_code(error::TransactionValidationError::INPUT_INVALID_SIGNATURES).message();
+      return error::TransactionValidationError::INPUT_INVALID_SIGNATURES;
+    }
   }
 
   auto ret = error::AddBlockErrorCode::ADDED_TO_ALTERNATIVE;
@@ -682,7 +793,7 @@ std::error_code Core::addBlock(const CachedBlock& cachedBlock, RawBlock&& rawBlo
           updateMainChainSet();
 
           updateBlockMedianSize();
-          actualizePoolTransactions();
+          actualizePoolTransactionsAfterSwitch(chainsLeaves[endpointIndex]);
           copyTransactionsToPool(chainsLeaves[endpointIndex]);
 
           switchMainChainStorage(chainsLeaves[0]->getStartBlockIndex(), *chainsLeaves[0]);
@@ -756,11 +867,97 @@ void Core::actualizePoolTransactions() {
   for (auto& hash : hashes) {
     auto tx = pool.getTransaction(hash);
     pool.removeTransaction(hash);
+    updateBlockTemplateBodyOnRemove(hash);
+
+    if (!addTransactionToPool(std::move(tx))) {
+      notifyObservers(makeDelTransactionMessage({hash}, Messages::DeleteTransaction::Reason::NotActual));
+    }
+  }
+}
+
+void Core::actualizePoolTransactionsAfterSwitch(IBlockchainCache* previousMainChain) {
+  // Segments of the previous main chain that are not in the new one were split at the fork point
+  uint32_t splitBlockIndex = previousMainChain->getStartBlockIndex();
+  IBlockchainCache* commonSegment = previousMainChain;
+  for (; commonSegment != nullptr && mainChainSet.count(commonSegment) == 0; commonSegment = commonSegment->getParent()) {
+    splitBlockIndex = commonSegment->getStartBlockIndex();
+  }
+
+  assert(commonSegment != nullptr);
+
+  // Rules that depend on the top block index may change the validity of any pool transaction
+  uint32_t previousTopBlockIndex = previousMainChain->getTopBlockIndex();
+  uint32_t topBlockIndex = getTopBlockIndex();
+  if (topBlockIndex < previousTopBlockIndex ||
+      getBlockMajorVersionForHeight(topBlockIndex) != getBlockMajorVersionForHeight(previousTopBlockIndex) ||
+      (topBlockIndex > currency.keyImageCheckingBlockIndex()) != (previousTopBlockIndex > currency.keyImageCheckingBlockIndex()) ||
+      checkpoints.isInCheckpointZone(topBlockIndex + 1) != checkpoints.isInCheckpointZone(previousTopBlockIndex + 1)) {
+    logger(Logging::DEBUGGING) << "Chain switch changes top block dependent rules, validating the whole pool again";
+    actualizePoolTransactions();
+    return;
+  }
+
+  std::unordered_set<Crypto::KeyImage> attachedKeyImages;
+  for (auto segment = chainsLeaves[0]; segment != nullptr && segment->getStartBlockIndex() >= splitBlockIndex; segment = segment->getParent()) {
+    for (const auto& rawTransaction : segment->getRawTransactions(segment->getTransactionHashes())) {
+      CachedTransaction transaction(rawTransaction);
+      for (const auto& input : transaction.getTransaction().inputs) {
+        if (input.type() == typeid(KeyInput)) {
+          attachedKeyImages.insert(boost::get<KeyInput>(input).keyImage);
+        }
+      }
+    }
+  }
+
+  // Outputs created before the split have the same global indexes in both chains. They are counted in the segment
+  // both chains share: a new chain segment counts the outputs of the new segments below it as well
+  std::unordered_map<uint64_t, size_t> commonOutputsCount;
+  auto isAffected = [&](const CachedTransaction& transaction) {
+    for (const auto& input : transaction.getTransaction().inputs) {
+      if (input.type() != typeid(KeyInput)) {
+        continue;
+      }
+
+      const KeyInput& in = boost::get<KeyInput>(input);
+      if (attachedKeyImages.count(in.keyImage) != 0) {
+        return true;
+      }
+
+      auto it = commonOutputsCount.find(in.amount);
+      if (it == commonOutputsCount.end()) {
+        it = commonOutputsCount.emplace(in.amount, commonSegment->getKeyOutputsCountForAmount(in.amount, splitBlockIndex)).first;
+      }
+
+      uint64_t lastGlobalIndex = std::accumulate(in.outputIndexes.begin(), in.outputIndexes.end(), uint64_t(0));
+      if (lastGlobalIndex >= it->second) {
+        return true;
+      }
+    }
+
+    return false;
+  };
+
+  auto& pool = *transactionPool;
+  auto maxTransactionSize = getMaximumTransactionAllowedSize(blockMedianSize, currency);
+  size_t revalidatedCount = 0;
+  for (auto& hash : pool.getTransactionHashes()) {
+    const auto& poolTransaction = pool.getTransaction(hash);
+    if (poolTransaction.getTransactionBinaryArray().size() <= maxTransactionSize && !isAffected(poolTransaction)) {
+      continue;
+    }
+
+    auto tx = poolTransaction;
+    pool.removeTransaction(hash);
+    updateBlockTemplateBodyOnRemove(hash);
+    ++revalidatedCount;
 
     if (!addTransactionToPool(std::move(tx))) {
       notifyObservers(makeDelTransactionMessage({hash}, Messages::DeleteTransaction::Reason::NotActual));
     }
   }
+
+  logger(Logging::DEBUGGING) << "Chain switch at block " << splitBlockIndex << ": " << revalidatedCount << " of "
+                             << pool.getTransactionCount() + revalidatedCount << " pool transactions validated again";
 }
 
 void Core::actualizePoolTransactionsLite(const TransactionValidatorState& validatorState) {
@@ -774,6 +971,7 @@ void Core::actualizePoolTransactionsLite(const TransactionValidatorState& valida
 
     if (hasIntersections(validatorState, txState) || tx.getTransactionBinaryArray().size() > getMaximumTransactionAllowedSize(blockMedianSize, currency)) {
       pool.removeTransaction(hash);
+      updateBlockTemplateBodyOnRemove(hash);
       notifyObservers(makeDelTransactionMessage({ hash }, Messages::DeleteTransaction::Reason::NotActual));
     }
   }
@@ -827,6 +1025,118 @@ std::error_code Core::addBlock(RawBlock&& rawBlock) {
   return addBlock(cachedBlock, std::move(rawBlock));
 }
 
+std::vector<std::error_code> Core::addBlocks(const std::vector<CachedBlock>& cachedBlocks, std::vector<RawBlock>&& rawBlocks) {
+  throwIfNotInitialized();
+  assert(cachedBlocks.size() == rawBlocks.size());
+
+  std::vector<boost::optional<std::vector<CachedTransaction>>> transactions;
+  if (!validationThreadPool || cachedBlocks.size() < 2) {
+    transactions.resize(cachedBlocks.size());
+  } else {
+    // parsing doesn't depend on the chain state, so the whole batch is prepared at once
+    System::RemoteContext<std::vector<boost::optional<std::vector<CachedTransaction>>>> preparation(dispatcher, [this, &cachedBlocks, &rawBlocks] {
+      return prepareBlocks(cachedBlocks, rawBlocks);
+    });
+
+    transactions = preparation.get();
+  }
+
+  // long hashes are calculated a few blocks ahead of validation, the window is small enough
+  // to leave pool threads for ring signatures of the block being validated
+  Tools::ScopeExit cancelProofOfWork([this] {
+    if (proofOfWorkService) {
+      proofOfWorkService->cancel();
+    }
+  });
+
+  size_t nextProofOfWorkIndex = 0;
+  auto feedProofOfWork = [&](size_t validatedCount) {
+    if (!proofOfWorkService) {
+      return;
+    }
+
+    auto end = std::min(cachedBlocks.size(), validatedCount + validationThreadPool->getThreadCount());
+    for (; nextProofOfWorkIndex < end; ++nextProofOfWorkIndex) {
+      const auto& cachedBlock = cachedBlocks[nextProofOfWorkIndex];
+      if (!checkpoints.isInCheckpointZone(cachedBlock.getBlockIndex())) {
+        proofOfWorkService->push(cachedBlock);
+      }
+    }
+  };
+
+  std::vector<std::error_code> results;
+  results.reserve(cachedBlocks.size());
+  for (size_t index = 0; index < cachedBlocks.size(); ++index) {
+    feedProofOfWork(index);
+
+    auto extractedTransactions = transactions[index] ? &transactions[index].get() : nullptr;
+    auto result = addBlock(cachedBlocks[index], std::move(rawBlocks[index]), extractedTransactions);
+    results.push_back(result);
+
+    if (!isBlockAdded(result)) {
+      break;
+    }
+
+    dispatcher.yield();
+  }
+
+  return results;
+}
+
+std::vector<std::error_code> Core::addBlocks(std::vector<RawBlock>&& rawBlocks) {
+  throwIfNotInitialized();
+
+  std::vector<BlockTemplate> blockTemplates(rawBlocks.size());
+  std::vector<CachedBlock> cachedBlocks;
+  cachedBlocks.reserve(rawBlocks.size());
+
+  for (size_t index = 0; index < rawBlocks.size(); ++index) {
+    if (!fromBinaryArray(blockTemplates[index], rawBlocks[index].block)) {
+      break;
+    }
+
+    cachedBlocks.emplace_back(blockTemplates[index]);
+  }
+
+  bool deserializationFailed = cachedBlocks.size() != rawBlocks.size();
+  rawBlocks.resize(cachedBlocks.size());
+
+  auto results = addBlocks(cachedBlocks, std::move(rawBlocks));
+  if (deserializationFailed && (results.empty() || isBlockAdded(results.back()))) {
+    results.push_back(error::AddBlockErrorCode::DESERIALIZATION_FAILED);
+  }
+
+  return results;
+}
+
+std::vector<boost::optional<std::vector<CachedTransaction>>> Core::prepareBlocks(const std::vector<CachedBlock>& cachedBlocks,
+                                                                                  const std::vector<RawBlock>& rawBlocks) {
+  std::vector<boost::optional<std::vector<CachedTransaction>>> transactions(cachedBlocks.size());
+
+  validationThreadPool->parallelFor(cachedBlocks.size(), [this, &cachedBlocks, &rawBlocks, &transactions] (size_t index) {
+    try {
+      cachedBlocks[index].getBlockHash();
+    } catch (std::exception&) {
+      // malformed blocks are rejected by the sequential validation
+    }
+
+    std::vector<CachedTransaction> blockTransactions;
+    uint64_t cumulativeSize = 0;
+    if (!extractTransactions(rawBlocks[index].transactions, blockTransactions, cumulativeSize)) {
+      return;
+    }
+
+    for (const auto& transaction : blockTransactions) {
+      transaction.getTransactionHash();
+      transaction.getTransactionPrefixHash();
+    }
+
+    transactions[index] = std::move(blockTransactions);
+  });
+
+  return transactions;
+}
+
 std::error_code Core::submitBlock(BinaryArray&& rawBlockTemplate) {
   throwIfNotInitialized();
 
@@ -919,6 +1229,25 @@ auto bottomBlockLimit = currency.mixinStartHeight();
   return false;
 }
 
+std::shared_ptr<const MainChainSnapshot> Core::getMainChainSnapshot() {
+  throwIfNotInitialized();
+
+  IBlockchainCache* rootSegment = findMainChainSegmentContainingBlock(0);
+  if (mainChainSnapshot != nullptr && mainChainSnapshot->getTopBlockHash() == getTopBlockHash() &&
+      mainChainSnapshot->getDatabaseTopBlockIndex() == rootSegment->getTopBlockIndex()) {
+    return mainChainSnapshot;
+  }
+
+  mainChainSnapshot.reset();
+  auto database = rootSegment->createDatabaseSnapshot();
+  if (database != nullptr) {
+    mainChainSnapshot = std::make_shared<MainChainSnapshot>(currency, std::move(database), getTopBlockIndex(), getTopBlockHash(),
+                                                            rootSegment->getTopBlockIndex(), rootSegment->keepsRawBlocks());
+  }
+
+  return mainChainSnapshot;
+}
+
 bool Core::addTransactionToPool(const BinaryArray& transactionBinaryArray) {
   throwIfNotInitialized();
 
@@ -947,11 +1276,24 @@ bool Core::addTransactionToPool(CachedTransaction&& cachedTransaction) {
   }
 
   auto transactionHash = cachedTransaction.getTransactionHash();
-  if (!transactionPool->pushTransaction(std::move(cachedTransaction), std::move(validatorState))) {
-    logger(Logging::DEBUGGING) << "Failed to push transaction " << transactionHash << " to pool, already exists";
+  auto transactionSize = cachedTransaction.getTransactionBinaryArray().size();
+  auto transactionFee = cachedTransaction.getTransactionFee();
+  std::vector<Crypto::Hash> evictedTransactions;
+  if (!transactionPool->pushTransaction(std::move(cachedTransaction), std::move(validatorState), evictedTransactions)) {
+    logger(Logging::DEBUGGING) << "Failed to push transaction " << transactionHash << " to pool, rejected by pool";
     return false;
   }
 
+  if (!evictedTransactions.empty()) {
+    for (const auto& hash : evictedTransactions) {
+      updateBlockTemplateBodyOnRemove(hash);
+    }
+
+    notifyObservers(makeDelTransactionMessage(std::move(evictedTransactions), Messages::DeleteTransaction::Reason::Evicted));
+  }
+
+  updateBlockTemplateBodyOnPush(transactionHash, transactionSize, transactionFee);
+
   logger(Logging::DEBUGGING) << "Transaction " << transactionHash << " has been added to pool";
   return true;
 }
@@ -1069,9 +1411,17 @@ bool Core::getBlockTemplate(BlockTemplate& b, const AccountPublicAddress& adr, c
   assert(!chainsLeaves.empty());
   uint64_t alreadyGeneratedCoins = chainsLeaves[0]->getAlreadyGeneratedCoins();
 
-  size_t transactionsSize;
-  uint64_t fee;
-  fillBlockTemplate(b, medianSize, currency.maxBlockCumulativeSize(height), transactionsSize, fee);
+  size_t maxCumulativeSize = currency.maxBlockCumulativeSize(height);
+  if (blockTemplateBodyValid && blockTemplateBody.previousBlockHash == b.previousBlockHash &&
+      blockTemplateBody.medianSize == medianSize && blockTemplateBody.maxCumulativeSize == maxCumulativeSize) {
+    ++blockTemplateCacheStatistics.cacheHits;
+  } else {
+    rebuildBlockTemplateBody(b.previousBlockHash, medianSize, maxCumulativeSize);
+  }
+
+  b.transactionHashes = blockTemplateBody.transactionHashes;
+  size_t transactionsSize = blockTemplateBody.transactionsSize;
+  uint64_t fee = blockTemplateBody.fee;
 
   /*
      two-phase miner transaction generation: we don't know exact block size until we prepare block, but we don't know
@@ -1152,11 +1502,26 @@ bool Core::getBlockTemplate(BlockTemplate& b, const AccountPublicAddress& adr, c
   return false;
 }
 
+TransactionPoolStatistics Core::getTransactionPoolStatistics() const {
+  throwIfNotInitialized();
+  return transactionPool->getStatistics();
+}
+
+BlockTemplateCacheStatistics Core::getBlockTemplateCacheStatistics() const {
+  return blockTemplateCacheStatistics;
+}
+
 CoreStatistics Core::getCoreStatistics() const {
-  // TODO: implement it
-  assert(false);
+  throwIfNotInitialized();
+
   CoreStatistics result;
-  std::fill(reinterpret_cast<uint8_t*>(&result), reinterpret_cast<uint8_t*>(&result) + sizeof(result), 0);
+  result.transactionPoolSize = transactionPool->getTransactionCount();
+  result.blockchainHeight = getTopBlockIndex() + 1;
+  result.miningSpeed = 0;
+  result.alternativeBlockCount = getAlternativeBlockCount();
+  result.topBlockHashString = Common::podToHex(getTopBlockHash());
+  result.signatureCacheHits = ringSignatureCache.getHits();
+  result.signatureCacheMisses = ringSignatureCache.getMisses();
   return result;
 }
 
@@ -1237,7 +1602,9 @@ bool Core::extractTransactions(const std::vector<BinaryArray>& rawTransactions,
 }
 
 std::error_code Core::validateTransaction(const CachedTransaction& cachedTransaction, TransactionValidatorState& state,
-                                          IBlockchainCache* cache, uint64_t& fee, uint32_t blockIndex) {
+                                          IBlockchainCache* cache, uint64_t& fee, uint32_t blockIndex,
+                                          RingSignatureBatch* signatureBatch, size_t transactionIndex,
+                                          KeyOutputKeysResult* prefetchedOutputKeys) {
   // TransactionValidatorState currentState;
   const auto& transaction = cachedTransaction.getTransaction();
 uint8_t blockMajorVersion = getBlockMajorVersionForHeight(blockIndex);
@@ -1252,6 +1619,7 @@ auto error = validateSemantic(transaction, fee, blockIndex);
   }
 
   size_t inputIndex = 0;
+  size_t keyInputIndex = 0;
   for (const auto& input : transaction.inputs) {
     if (input.type() == typeid(KeyInput)) {
       const KeyInput& in = boost::get<KeyInput>(input);
@@ -1265,15 +1633,23 @@ auto error = validateSemantic(transaction, fee, blockIndex);
         }
 
         std::vector<PublicKey> outputKeys;
-        assert(!in.outputIndexes.empty());
+        ExtractOutputKeysResult result;
+        if (prefetchedOutputKeys != nullptr) {
+          result = prefetchedOutputKeys[keyInputIndex].result;
+          outputKeys = std::move(prefetchedOutputKeys[keyInputIndex].publicKeys);
+        } else {
+          assert(!in.outputIndexes.empty());
+
+          std::vector<uint32_t> globalIndexes(in.outputIndexes.size());
+          globalIndexes[0] = in.outputIndexes[0];
+          for (size_t i = 1; i < in.outputIndexes.size(); ++i) {
+            globalIndexes[i] = globalIndexes[i - 1] + in.outputIndexes[i];
+          }
 
-        std::vector<uint32_t> globalIndexes(in.outputIndexes.size());
-        globalIndexes[0] = in.outputIndexes[0];
-        for (size_t i = 1; i < in.outputIndexes.size(); ++i) {
-          globalIndexes[i] = globalIndexes[i - 1] + in.outputIndexes[i];
+          result = cache->extractKeyOutputKeys(in.amount, blockIndex, {globalIndexes.data(), globalIndexes.size()}, outputKeys);
         }
 
-        auto result = cache->extractKeyOutputKeys(in.amount, blockIndex, {globalIndexes.data(), globalIndexes.size()}, outputKeys);
+        keyInputIndex++;
         if (result == ExtractOutputKeysResult::INVALID_GLOBAL_INDEX) {
           return error::TransactionValidationError::INPUT_INVALID_GLOBAL_INDEX;
         }
@@ -1282,14 +1658,30 @@ auto error = validateSemantic(transaction, fee, blockIndex);
           return error::TransactionValidationError::INPUT_SPEND_LOCKED_OUT;
         }
 
+        bool checkKeyImage = blockIndex > currency.keyImageCheckingBlockIndex();
+        auto signatureKey = RingSignatureCache::getKey(cachedTransaction.getTransactionPrefixHash(), inputIndex, outputKeys,
+                                                       transaction.signatures[inputIndex], checkKeyImage);
+        if (ringSignatureCache.contains(signatureKey)) {
+          inputIndex++;
+          continue;
+        }
+
+        if (signatureBatch != nullptr) {
+          signatureBatch->addCheck(transactionIndex, cachedTransaction.getTransactionPrefixHash(), in.keyImage, std::move(outputKeys),
+                                   transaction.signatures[inputIndex].data(), checkKeyImage);
+          inputIndex++;
+          continue;
+        }
+
         std::vector<const Crypto::PublicKey*> outputKeyPointers;
         outputKeyPointers.reserve(outputKeys.size());
         std::for_each(outputKeys.begin(), outputKeys.end(), [&outputKeyPointers] (const Crypto::PublicKey& key) { outputKeyPointers.push_back(&key); });
         if (!Crypto::check_ring_signature(cachedTransaction.getTransactionPrefixHash(), in.keyImage, outputKeyPointers.data(),
-                                          outputKeyPointers.size(), transaction.signatures[inputIndex].data(),
-                                          blockIndex > currency.keyImageCheckingBlockIndex())) {
+                                          outputKeyPointers.size(), transaction.signatures[inputIndex].data(), checkKeyImage)) {
           return error::TransactionValidationError::INPUT_INVALID_SIGNATURES;
         }
+
+        ringSignatureCache.insert(signatureKey);
       }
 
     } else {
@@ -1520,6 +1912,8 @@ void Core::load() {
 
   assert(storageBlocksCount != 0); //we assume the storage has at least genesis block
 
+  checkRootSegmentRawBlocks();
+
   if (storageBlocksCount > dbBlocksCount) {
     logger(Logging::INFO) << "Importing blocks from blockchain storage";
     importBlocksFromStorage();
@@ -1541,6 +1935,28 @@ void Core::load() {
   initialized = true;
 }
 
+// A root segment without its own raw blocks reads them from the storage, so it can be neither cut
+// nor reimported unless the storage still holds every root segment block
+void Core::checkRootSegmentRawBlocks() {
+  if (chainsLeaves[0]->keepsRawBlocks()) {
+    return;
+  }
+
+  auto topIndex = chainsLeaves[0]->getTopBlockIndex();
+  if (mainChainStorage->getBlockCount() <= topIndex) {
+    logger(Logging::ERROR) << "DB keeps raw blocks in blockchain storage, but the storage has " << mainChainStorage->getBlockCount()
+                           << " blocks only, DB top block index is " << topIndex << ". Remove the DB to recreate it from the storage";
+    throw std::runtime_error("Blockchain storage doesn't contain DB blocks");
+  }
+
+  // blocks are chained by hashes, so the same top block means the same blocks below it
+  if (getBlockHash(mainChainStorage->getBlockByIndex(topIndex)) != chainsLeaves[0]->getTopBlockHash()) {
+    logger(Logging::ERROR) << "DB keeps raw blocks in blockchain storage, but the storage has another block at index " << topIndex
+                           << ". Remove the DB to recreate it from the storage";
+    throw std::runtime_error("Blockchain storage and DB are on different chains");
+  }
+}
+
 void Core::initRootSegment() {
   std::unique_ptr<IBlockchainCache> cache = this->blockchainCacheFactory->createRootBlockchainCache(currency);
 
@@ -1564,42 +1980,99 @@ void Core::importBlocksFromStorage() {
 
   auto previousBlockHash = getBlockHash(mainChainStorage->getBlockByIndex(commonIndex));
   auto blockCount = mainChainStorage->getBlockCount();
-  for (uint32_t i = commonIndex + 1; i < blockCount; ++i) {
-    RawBlock rawBlock = mainChainStorage->getBlockByIndex(i);
-    auto blockTemplate = extractBlockTemplate(rawBlock);
-    CachedBlock cachedBlock(blockTemplate);
+  for (uint32_t startIndex = commonIndex + 1; startIndex < blockCount; startIndex += IMPORT_BLOCKS_PER_READ) {
+    std::vector<RawBlock> rawBlocks = mainChainStorage->getBlocks(startIndex, IMPORT_BLOCKS_PER_READ);
+    std::vector<ImportedBlock> importedBlocks(rawBlocks.size());
+    std::vector<CachedBlock> cachedBlocks;
+    prepareImportedBlocks(rawBlocks, importedBlocks, cachedBlocks);
+
+    // the blocks of a read are written to the DB with one batch
+    chainsLeaves[0]->startPushBatch();
+    // on an error the blocks pushed so far are written as well, the cache already counts them
+    Tools::ScopeExit commitPushedBlocks([this] {
+      try {
+        chainsLeaves[0]->commitPushBatch();
+      } catch (std::exception& e) {
+        logger(Logging::ERROR) << "Failed to write imported blocks: " << e.what();
+      }
+    });
 
-    if (blockTemplate.previousBlockHash != previousBlockHash) {
-      logger(Logging::ERROR) << "Corrupted blockchain. Block with index " << i << " and hash " << cachedBlock.getBlockHash()
-                             << " has previous block hash " << blockTemplate.previousBlockHash << ", but parent has hash " << previousBlockHash
-                             << ". Resynchronize your daemon please.";
-      throw std::system_error(make_error_code(error::CoreErrorCode::CORRUPTED_BLOCKCHAIN));
-    }
+    for (size_t k = 0; k < rawBlocks.size(); ++k) {
+      uint32_t i = startIndex + static_cast<uint32_t>(k);
+      const BlockTemplate& blockTemplate = importedBlocks[k].blockTemplate;
+      const CachedBlock& cachedBlock = cachedBlocks[k];
 
-    previousBlockHash = cachedBlock.getBlockHash();
+      if (blockTemplate.previousBlockHash != previousBlockHash) {
+        logger(Logging::ERROR) << "Corrupted blockchain. Block with index " << i << " and hash " << cachedBlock.getBlockHash()
+                               << " has previous block hash " << blockTemplate.previousBlockHash << ", but parent has hash " << previousBlockHash
+                               << ". Resynchronize your daemon please.";
+        throw std::system_error(make_error_code(error::CoreErrorCode::CORRUPTED_BLOCKCHAIN));
+      }
 
-    std::vector<CachedTransaction> transactions;
-    uint64_t cumulativeSize = 0;
-    if (!extractTransactions(rawBlock.transactions, transactions, cumulativeSize)) {
-      logger(Logging::ERROR) << "Couldn't deserialize raw block transactions in block " << cachedBlock.getBlockHash();
-      throw std::system_error(make_error_code(error::AddBlockErrorCode::DESERIALIZATION_FAILED));
+      previousBlockHash = cachedBlock.getBlockHash();
+
+      if (!importedBlocks[k].transactionsExtracted) {
+        logger(Logging::ERROR) << "Couldn't deserialize raw block transactions in block " << cachedBlock.getBlockHash();
+        throw std::system_error(make_error_code(error::AddBlockErrorCode::DESERIALIZATION_FAILED));
+      }
+
+      const std::vector<CachedTransaction>& transactions = importedBlocks[k].transactions;
+      uint64_t cumulativeSize = importedBlocks[k].cumulativeSize + getObjectBinarySize(blockTemplate.baseTransaction);
+      TransactionValidatorState spentOutputs = extractSpentOutputs(transactions);
+      auto currentDifficulty = chainsLeaves[0]->getDifficultyForNextBlock(i - 1);
+
+      uint64_t cumulativeFee = std::accumulate(transactions.begin(), transactions.end(), UINT64_C(0), [] (uint64_t fee, const CachedTransaction& transaction) {
+        return fee + transaction.getTransactionFee();
+      });
+
+      int64_t emissionChange = getEmissionChange(currency, *chainsLeaves[0], i - 1, cachedBlock, cumulativeSize, cumulativeFee);
+      chainsLeaves[0]->pushBlock(cachedBlock, transactions, spentOutputs, cumulativeSize, emissionChange, currentDifficulty, std::move(rawBlocks[k]));
+
+      if (i % 1000 == 0) {
+        logger(Logging::INFO) << "Imported block with index " << i << " / " << (blockCount - 1);
+      }
     }
 
-    cumulativeSize += getObjectBinarySize(blockTemplate.baseTransaction);
-    TransactionValidatorState spentOutputs = extractSpentOutputs(transactions);
-    auto currentDifficulty = chainsLeaves[0]->getDifficultyForNextBlock(i - 1);
+    commitPushedBlocks.cancel();
+    chainsLeaves[0]->commitPushBatch();
+  }
+}
 
-    uint64_t cumulativeFee = std::accumulate(transactions.begin(), transactions.end(), UINT64_C(0), [] (uint64_t fee, const CachedTransaction& transaction) {
-      return fee + transaction.getTransactionFee();
-    });
+// Deserializes and hashes blocks read from the storage, using validation threads if there are any
+void Core::prepareImportedBlocks(const std::vector<RawBlock>& rawBlocks, std::vector<ImportedBlock>& importedBlocks,
+                                 std::vector<CachedBlock>& cachedBlocks) {
+  assert(importedBlocks.size() == rawBlocks.size());
 
-    int64_t emissionChange = getEmissionChange(currency, *chainsLeaves[0], i - 1, cachedBlock, cumulativeSize, cumulativeFee);
-    chainsLeaves[0]->pushBlock(cachedBlock, transactions, spentOutputs, cumulativeSize, emissionChange, currentDifficulty, std::move(rawBlock));
+  auto parallelFor = [this] (size_t count, const std::function<void(size_t)>& task) {
+    if (validationThreadPool) {
+      validationThreadPool->parallelFor(count, task);
+    } else {
+      for (size_t index = 0; index < count; ++index) {
+        task(index);
+      }
+    }
+  };
 
-    if (i % 1000 == 0) {
-      logger(Logging::INFO) << "Imported block with index " << i << " / " << (blockCount - 1);
+  parallelFor(rawBlocks.size(), [this, &rawBlocks, &importedBlocks] (size_t index) {
+    ImportedBlock& importedBlock = importedBlocks[index];
+    importedBlock.blockTemplate = extractBlockTemplate(rawBlocks[index]);
+    importedBlock.cumulativeSize = 0;
+    importedBlock.transactionsExtracted = extractTransactions(rawBlocks[index].transactions, importedBlock.transactions, importedBlock.cumulativeSize);
+    for (const auto& transaction : importedBlock.transactions) {
+      transaction.getTransactionHash();
+      transaction.getTransactionPrefixHash();
     }
+  });
+
+  // cached blocks refer to the templates, which stay in place now
+  cachedBlocks.reserve(importedBlocks.size());
+  for (const auto& importedBlock : importedBlocks) {
+    cachedBlocks.emplace_back(importedBlock.blockTemplate);
   }
+
+  parallelFor(cachedBlocks.size(), [&cachedBlocks] (size_t index) {
+    cachedBlocks[index].getBlockHash();
+  });
 }
 
 void Core::cutSegment(IBlockchainCache& segment, uint32_t startIndex) {
@@ -1827,8 +2300,7 @@ size_t Core::calculateCumulativeBlocksizeLimit(uint32_t height) const {
   assert(!chainsStorage.empty());
   assert(!chainsLeaves.empty());
   // FIXME: skip gensis here?
-  auto sizes = chainsLeaves[0]->getLastBlocksSizes(currency.rewardBlocksWindow());
-  uint64_t median = Common::medianValue(sizes);
+  uint64_t median = chainsLeaves[0]->getLastBlocksSizesMedian(currency.rewardBlocksWindow());
   if (median <= nextBlockGrantedFullRewardZone) {
     median = nextBlockGrantedFullRewardZone;
   }
@@ -1846,9 +2318,9 @@ void Core::fillBlockTemplate(BlockTemplate& block, size_t medianSize, size_t max
 
   TransactionSpentInputsChecker spentInputsChecker;
 
-  std::vector<CachedTransaction> poolTransactions = transactionPool->getPoolTransactions();
-  for (auto it = poolTransactions.rbegin(); it != poolTransactions.rend() && it->getTransactionFee() == 0; ++it) {
-    const CachedTransaction& transaction = *it;
+  std::vector<const CachedTransaction*> poolTransactions = transactionPool->getPoolTransactionsByPriority();
+  for (auto it = poolTransactions.rbegin(); it != poolTransactions.rend() && (*it)->getTransactionFee() == 0; ++it) {
+    const CachedTransaction& transaction = **it;
 
     auto transactionBlobSize = transaction.getTransactionBinaryArray().size();
     if (currency.fusionTxMaxSize() < transactionsSize + transactionBlobSize) {
@@ -1862,7 +2334,8 @@ void Core::fillBlockTemplate(BlockTemplate& block, size_t medianSize, size_t max
     }
   }
 
-  for (const auto& cachedTransaction : poolTransactions) {
+  for (const auto* transaction : poolTransactions) {
+    const CachedTransaction& cachedTransaction = *transaction;
     size_t blockSizeLimit = (cachedTransaction.getTransactionFee() == 0) ? medianSize : maxTotalSize;
 
     if (blockSizeLimit < transactionsSize + cachedTransaction.getTransactionBinaryArray().size()) {
@@ -1880,6 +2353,56 @@ void Core::fillBlockTemplate(BlockTemplate& block, size_t medianSize, size_t max
   }
 }
 
+void Core::rebuildBlockTemplateBody(const Crypto::Hash& previousBlockHash, size_t medianSize, size_t maxCumulativeSize) const {
+  BlockTemplate block;
+  fillBlockTemplate(block, medianSize, maxCumulativeSize, blockTemplateBody.transactionsSize, blockTemplateBody.fee);
+
+  blockTemplateBody.previousBlockHash = previousBlockHash;
+  blockTemplateBody.medianSize = medianSize;
+  blockTemplateBody.maxCumulativeSize = maxCumulativeSize;
+  blockTemplateBody.transactionHashes = std::move(block.transactionHashes);
+  blockTemplateBody.includesWholePool = blockTemplateBody.transactionHashes.size() == transactionPool->getTransactionCount();
+  blockTemplateBodyValid = true;
+
+  ++blockTemplateCacheStatistics.rebuilds;
+  logger(Logging::DEBUGGING) << "Block template rebuilt on top of " << previousBlockHash << ", "
+                             << blockTemplateBody.transactionHashes.size() << " transactions";
+}
+
+void Core::updateBlockTemplateBodyOnPush(const Crypto::Hash& transactionHash, size_t transactionSize, uint64_t transactionFee) {
+  if (!blockTemplateBodyValid) {
+    return;
+  }
+
+  // Pool transactions never share key images, so fillBlockTemplate only skips a transaction when it doesn't fit.
+  // If nothing was skipped and the new transaction fits under every size limit, a rebuild would select the whole pool again.
+  // Fusion transactions are also ordered by the fusion size limit, so they always trigger a rebuild.
+  size_t sizeLimit = std::min((125 * blockTemplateBody.medianSize) / 100, blockTemplateBody.maxCumulativeSize) - currency.minerTxBlobReservedSize();
+  sizeLimit = std::min(sizeLimit, blockTemplateBody.medianSize);
+  if (blockTemplateBody.includesWholePool && transactionFee != 0 && blockTemplateBody.transactionsSize + transactionSize <= sizeLimit) {
+    blockTemplateBody.transactionHashes.push_back(transactionHash);
+    blockTemplateBody.transactionsSize += transactionSize;
+    blockTemplateBody.fee += transactionFee;
+    ++blockTemplateCacheStatistics.incrementalUpdates;
+  } else {
+    blockTemplateBodyValid = false;
+  }
+}
+
+void Core::updateBlockTemplateBodyOnRemove(const Crypto::Hash& transactionHash) {
+  if (!blockTemplateBodyValid) {
+    return;
+  }
+
+  // A transaction left out of the template didn't take any space, so its removal doesn't change the selection
+  const auto& hashes = blockTemplateBody.transactionHashes;
+  if (std::find(hashes.begin(), hashes.end(), transactionHash) == hashes.end()) {
+    ++blockTemplateCacheStatistics.incrementalUpdates;
+  } else {
+    blockTemplateBodyValid = false;
+  }
+}
+
 void Core::deleteAlternativeChains() {
   while (chainsLeaves.size() > 1) {
     deleteLeaf(1);
@@ -2019,8 +2542,7 @@ BlockDetails Core::getBlockDetails(const Crypto::Hash& blockHash) const {
   uint64_t prevBlockGeneratedCoins = 0;
   blockDetails.sizeMedian = 0;
   if (blockDetails.index > 0) {
-    auto lastBlocksSizes = segment->getLastBlocksSizes(currency.rewardBlocksWindow(), blockDetails.index - 1, addGenesisBlock);
-    blockDetails.sizeMedian = Common::medianValue(lastBlocksSizes);
+    blockDetails.sizeMedian = segment->getLastBlocksSizesMedian(currency.rewardBlocksWindow(), blockDetails.index - 1, addGenesisBlock);
     prevBlockGeneratedCoins = segment->getAlreadyGeneratedCoins(blockDetails.index - 1);
   }
 
@@ -2310,6 +2832,10 @@ void Core::transactionPoolCleaningProcedure() {
       timer.sleep(OUTDATED_TRANSACTION_POLLING_INTERVAL);
 
       auto deletedTransactions = transactionPool->clean();
+      for (const auto& hash : deletedTransactions) {
+        updateBlockTemplateBodyOnRemove(hash);
+      }
+
       notifyObservers(makeDelTransactionMessage(std::move(deletedTransactions), Messages::DeleteTransaction::Reason::Outdated));
     }
   } catch (System::InterruptedException&) {
@@ -2324,9 +2850,7 @@ void Core::updateBlockMedianSize() {
 
   size_t nextBlockGrantedFullRewardZone = currency.blockGrantedFullRewardZoneByBlockVersion(upgradeManager->getBlockMajorVersion(mainChain->getTopBlockIndex() + 1));
 
-  auto lastBlockSizes = mainChain->getLastBlocksSizes(currency.rewardBlocksWindow());
-
-  blockMedianSize = std::max(Common::medianValue(lastBlockSizes), static_cast<uint64_t>(nextBlockGrantedFullRewardZone));
+  blockMedianSize = std::max(mainChain->getLastBlocksSizesMedian(currency.rewardBlocksWindow()), static_cast<uint64_t>(nextBlockGrantedFullRewardZone));
 }
 
 }
@@ -24,6 +24,7 @@
 #include "CachedTransaction.h"
 #include "Currency.h"
 #include "Checkpoints.h"
+#include "CoreConfig.h"
 #include "IBlockchainCache.h"
 #include "IBlockchainCacheFactory.h"
 #include "ICore.h"
@@ -33,20 +34,33 @@
 #include "ITransactionPoolCleaner.h"
 #include "IUpgradeManager.h"
 #include <Logging/LoggerMessage.h>
+#include "MainChainSnapshot.h"
 #include "MessageQueue.h"
+#include "ProofOfWorkService.h"
+#include "RingSignatureBatch.h"
+#include "RingSignatureCache.h"
 #include "TransactionValidatiorState.h"
 #include "SwappedVector.h"
 
 #include "CryptoNoteCore/MinerConfig.h"
 
+#include <Common/ThreadPool.h>
 #include <System/ContextGroup.h>
+#include <System/Event.h>
 
 namespace CryptoNote {
 
+struct BlockTemplateCacheStatistics {
+  uint64_t rebuilds;
+  uint64_t cacheHits;
+  uint64_t incrementalUpdates;
+};
+
 class Core : public ICore, public ICoreInformation {
 public:
   Core(const Currency& currency, Logging::ILogger& logger, Checkpoints&& checkpoints, System::Dispatcher& dispatcher,
-       std::unique_ptr<IBlockchainCacheFactory>&& blockchainCacheFactory, std::unique_ptr<IMainChainStorage>&& mainChainStorage);
+       std::unique_ptr<IBlockchainCacheFactory>&& blockchainCacheFactory, std::unique_ptr<IMainChainStorage>&& mainChainStorage,
+       const CoreConfig& coreConfig = CoreConfig());
   virtual ~Core();
 
   virtual bool addMessageQueue(MessageQueue<BlockchainMessage>&  messageQueue) override;
@@ -75,12 +89,15 @@ public:
   virtual bool hasTransaction(const Crypto::Hash& transactionHash) const override;
 virtual void extractKeyOutputKeys(const uint64_t amount, const std::vector<uint32_t>& absolute_offsets, std::vector<Crypto::PublicKey>& mixin_outputs) const override;
   virtual void getTransactions(const std::vector<Crypto::Hash>& transactionHashes, std::vector<BinaryArray>& transactions, std::vector<Crypto::Hash>& missedHashes) const override;
+  virtual void getPoolTransactions(const std::vector<Crypto::Hash>& transactionHashes, std::vector<BinaryArray>& transactions, std::vector<Crypto::Hash>& missedHashes) const override;
 
   virtual Difficulty getBlockDifficulty(uint32_t blockIndex) const override;
   virtual Difficulty getDifficultyForNextBlock() const override;
 
   virtual std::error_code addBlock(const CachedBlock& cachedBlock, RawBlock&& rawBlock) override;
   virtual std::error_code addBlock(RawBlock&& rawBlock) override;
+  virtual std::vector<std::error_code> addBlocks(const std::vector<CachedBlock>& cachedBlocks, std::vector<RawBlock>&& rawBlocks) override;
+  virtual std::vector<std::error_code> addBlocks(std::vector<RawBlock>&& rawBlocks) override;
 
   virtual std::error_code submitBlock(BinaryArray&& rawBlockTemplate) override;
 
@@ -98,6 +115,11 @@ virtual void extractKeyOutputKeys(const uint64_t amount, const std::vector<uint3
   virtual bool getBlockTemplate(BlockTemplate& b, const AccountPublicAddress& adr, const BinaryArray& extraNonce, Difficulty& difficulty, uint32_t& height) const override;
 
   virtual CoreStatistics getCoreStatistics() const override;
+  BlockTemplateCacheStatistics getBlockTemplateCacheStatistics() const;
+  TransactionPoolStatistics getTransactionPoolStatistics() const;
+  // Main chain view for reading on other threads, call it on the dispatcher thread.
+  // Returns null if the root segment can't make a database snapshot now, e.g. while blocks are imported in batches.
+  std::shared_ptr<const MainChainSnapshot> getMainChainSnapshot();
 
   //ICoreInformation
      Checkpoints get_checkpoints();
@@ -126,6 +148,9 @@ private:
   System::ContextGroup contextGroup;
   Logging::LoggerRef logger;
   Crypto::cn_context cryptoContext;
+  std::unique_ptr<Common::ThreadPool> validationThreadPool;
+  std::unique_ptr<ProofOfWorkService> proofOfWorkService;
+  System::Event addBlockEvent;
   Checkpoints checkpoints;
   std::unique_ptr<IUpgradeManager> upgradeManager;
   std::vector<std::unique_ptr<IBlockchainCache>> chainsStorage;
@@ -139,16 +164,48 @@ private:
   std::unique_ptr<IBlockchainCacheFactory> blockchainCacheFactory;
   std::unique_ptr<IMainChainStorage> mainChainStorage;
   bool initialized;
+  // reused until the main chain or its part stored in the database changes
+  std::shared_ptr<const MainChainSnapshot> mainChainSnapshot;
 
   size_t blockMedianSize;
 
+  // Transactions selected for the next block, reused by getBlockTemplate until the tip or the pool changes.
+  // The const getBlockTemplate updates it without a lock, so it must only be called on the dispatcher thread,
+  // never from RPC worker threads or main chain snapshots.
+  struct BlockTemplateBody {
+    Crypto::Hash previousBlockHash;
+    size_t medianSize;
+    size_t maxCumulativeSize;
+    std::vector<Crypto::Hash> transactionHashes;
+    size_t transactionsSize;
+    uint64_t fee;
+    bool includesWholePool;
+  };
+
+  mutable BlockTemplateBody blockTemplateBody;
+  mutable bool blockTemplateBodyValid;
+  mutable BlockTemplateCacheStatistics blockTemplateCacheStatistics;
+
+  RingSignatureCache ringSignatureCache;
+
+  // Block read from the main chain storage and deserialized ahead of pushing it to the DB
+  struct ImportedBlock {
+    BlockTemplate blockTemplate;
+    std::vector<CachedTransaction> transactions;
+    uint64_t cumulativeSize;
+    bool transactionsExtracted;
+  };
+
   void throwIfNotInitialized() const;
+  std::error_code addBlock(const CachedBlock& cachedBlock, RawBlock&& rawBlock, std::vector<CachedTransaction>* extractedTransactions);
+  std::vector<boost::optional<std::vector<CachedTransaction>>> prepareBlocks(const std::vector<CachedBlock>& cachedBlocks, const std::vector<RawBlock>& rawBlocks);
   bool extractTransactions(const std::vector<BinaryArray>& rawTransactions, std::vector<CachedTransaction>& transactions, uint64_t& cumulativeSize);
 
 bool f_getMixin(const Transaction& transaction, uint64_t& mixin);
 std::error_code validateMixin(const Transaction& transaction, uint8_t majorBlockVersion);
   std::error_code validateSemantic(const Transaction& transaction, uint64_t& fee, uint32_t blockIndex);
-  std::error_code validateTransaction(const CachedTransaction& transaction, TransactionValidatorState& state, IBlockchainCache* cache, uint64_t& fee, uint32_t blockIndex);
+  std::error_code validateTransaction(const CachedTransaction& transaction, TransactionValidatorState& state, IBlockchainCache* cache, uint64_t& fee, uint32_t blockIndex,
+    RingSignatureBatch* signatureBatch = nullptr, size_t transactionIndex = 0, KeyOutputKeysResult* prefetchedOutputKeys = nullptr);
   
   uint32_t findBlockchainSupplement(const std::vector<Crypto::Hash>& remoteBlockIds) const;
   std::vector<Crypto::Hash> getBlockHashes(uint32_t startBlockIndex, uint32_t maxCount) const;
@@ -182,6 +239,9 @@ std::error_code validateMixin(const Transaction& transaction, uint8_t majorBlock
   uint8_t getBlockMajorVersionForHeight(uint32_t height) const;
   size_t calculateCumulativeBlocksizeLimit(uint32_t height) const;
   void fillBlockTemplate(BlockTemplate& block, size_t medianSize, size_t maxCumulativeSize, size_t& transactionsSize, uint64_t& fee) const;
+  void rebuildBlockTemplateBody(const Crypto::Hash& previousBlockHash, size_t medianSize, size_t maxCumulativeSize) const;
+  void updateBlockTemplateBodyOnPush(const Crypto::Hash& transactionHash, size_t transactionSize, uint64_t transactionFee);
+  void updateBlockTemplateBodyOnRemove(const Crypto::Hash& transactionHash);
   void deleteAlternativeChains();
   void deleteLeaf(size_t leafIndex);
   void mergeMainChainSegments();
@@ -192,6 +252,7 @@ std::error_code validateMixin(const Transaction& transaction, uint8_t majorBlock
   void copyTransactionsToPool(IBlockchainCache* alt);
   
   void actualizePoolTransactions();
+  void actualizePoolTransactionsAfterSwitch(IBlockchainCache* previousMainChain);
   void actualizePoolTransactionsLite(const TransactionValidatorState& validatorState); //Checks pool txs only for double spend.
 
   void transactionPoolCleaningProcedure();
@@ -200,7 +261,9 @@ std::error_code validateMixin(const Transaction& transaction, uint8_t majorBlock
   bool isTransactionValidForPool(const CachedTransaction& cachedTransaction, TransactionValidatorState& validatorState);
 
   void initRootSegment();
+  void checkRootSegmentRawBlocks();
   void importBlocksFromStorage();
+  void prepareImportedBlocks(const std::vector<RawBlock>& rawBlocks, std::vector<ImportedBlock>& importedBlocks, std::vector<CachedBlock>& cachedBlocks);
   void cutSegment(IBlockchainCache& segment, uint32_t startIndex);
 
   void switchMainChainStorage(uint32_t splitBlockIndex, IBlockchainCache& newChain);
@@ -0,0 +1,84 @@
+// Copyright (c) 2012-2017, The CryptoNote developers, The Bytecoin developers
+//
+// This file is part of Bytecoin.
+//
+// Bytecoin is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Bytecoin is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with Bytecoin.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "CoreConfig.h"
+
+#include <thread>
+
+#include "Common/CommandLine.h"
+
+using namespace CryptoNote;
+
+namespace {
+
+const uint16_t DEFAULT_VALIDATION_THREADS_COUNT = 0;
+const uint64_t DEFAULT_TRANSACTION_POOL_MAX_SIZE = 0;
+
+const command_line::arg_descriptor<uint16_t> argValidationThreadsCount = { "validation-threads",
+  "Number of threads used to check ring signatures of incoming blocks. 0 - one per CPU core, 1 - check on the core thread", DEFAULT_VALIDATION_THREADS_COUNT};
+const command_line::arg_descriptor<uint64_t> argTransactionPoolMaxSize = { "mempool-max-size",
+  "Maximum summary size of transaction pool in bytes, the lowest fee rate transactions are evicted when it is full. 0 - no limit",
+  DEFAULT_TRANSACTION_POOL_MAX_SIZE};
+
+uint16_t resolveThreadsCount(uint16_t threadsCount) {
+  if (threadsCount != 0) {
+    return threadsCount;
+  }
+
+  unsigned hardwareThreads = std::thread::hardware_concurrency();
+  return static_cast<uint16_t>(hardwareThreads == 0 ? 1 : hardwareThreads);
+}
+
+} //namespace
+
+void CoreConfig::initOptions(boost::program_options::options_description& desc) {
+  command_line::add_arg(desc, argValidationThreadsCount);
+  command_line::add_arg(desc, argTransactionPoolMaxSize);
+}
+
+CoreConfig::CoreConfig() :
+  validationThreadsCount(resolveThreadsCount(DEFAULT_VALIDATION_THREADS_COUNT)),
+  transactionPoolMaxSize(DEFAULT_TRANSACTION_POOL_MAX_SIZE) {
+}
+
+bool CoreConfig::init(const boost::program_options::variables_map& vm) {
+  if (vm.count(argValidationThreadsCount.name) != 0) {
+    validationThreadsCount = resolveThreadsCount(command_line::get_arg(vm, argValidationThreadsCount));
+  }
+
+  if (vm.count(argTransactionPoolMaxSize.name) != 0) {
+    transactionPoolMaxSize = command_line::get_arg(vm, argTransactionPoolMaxSize);
+  }
+
+  return true;
+}
+
+uint16_t CoreConfig::getValidationThreadsCount() const {
+  return validationThreadsCount;
+}
+
+uint64_t CoreConfig::getTransactionPoolMaxSize() const {
+  return transactionPoolMaxSize;
+}
+
+void CoreConfig::setValidationThreadsCount(uint16_t validationThreadsCount) {
+  this->validationThreadsCount = resolveThreadsCount(validationThreadsCount);
+}
+
+void CoreConfig::setTransactionPoolMaxSize(uint64_t transactionPoolMaxSize) {
+  this->transactionPoolMaxSize = transactionPoolMaxSize;
+}
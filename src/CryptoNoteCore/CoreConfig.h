@@ -0,0 +1,43 @@
+// Copyright (c) 2012-2017, The CryptoNote developers, The Bytecoin developers
+//
+// This file is part of Bytecoin.
+//
+// Bytecoin is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Bytecoin is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with Bytecoin.  If not, see <http://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <cstdint>
+
+#include <boost/program_options.hpp>
+
+namespace CryptoNote {
+
+class CoreConfig {
+public:
+  CoreConfig();
+  static void initOptions(boost::program_options::options_description& desc);
+  bool init(const boost::program_options::variables_map& vm);
+
+  uint16_t getValidationThreadsCount() const;
+  uint64_t getTransactionPoolMaxSize() const;
+
+  void setValidationThreadsCount(uint16_t validationThreadsCount);
+  void setTransactionPoolMaxSize(uint64_t transactionPoolMaxSize);
+
+private:
+  uint16_t validationThreadsCount;
+  uint64_t transactionPoolMaxSize;
+};
+
+} //namespace CryptoNote
@@ -27,6 +27,8 @@ struct CoreStatistics {
   uint64_t miningSpeed;
   uint64_t alternativeBlockCount;
   std::string topBlockHashString;
+  uint64_t signatureCacheHits;
+  uint64_t signatureCacheMisses;
 
   void serialize(ISerializer& s) {    
     s(transactionPoolSize, "tx_pool_size");
@@ -34,6 +36,8 @@ struct CoreStatistics {
     s(miningSpeed, "mining_speed");
     s(alternativeBlockCount, "alternative_blocks");
     s(topBlockHashString, "top_block_id_str");
+    s(signatureCacheHits, "signature_cache_hits");
+    s(signatureCacheMisses, "signature_cache_misses");
   }
 };
 
@@ -78,7 +78,10 @@ bool Currency::init() {
     m_upgradeHeightV3 = static_cast<uint32_t>(-1);
     m_blocksFileName = "testnet_" + m_blocksFileName;
     m_blockIndexesFileName = "testnet_" + m_blockIndexesFileName;
+    m_blockSegmentsFileName = "testnet_" + m_blockSegmentsFileName;
+    m_blockOffsetsFileName = "testnet_" + m_blockOffsetsFileName;
     m_txPoolFileName = "testnet_" + m_txPoolFileName;
+    m_keyOutputsIndexFileName = "testnet_" + m_keyOutputsIndexFileName;
   }
 
   return true;
@@ -798,7 +801,10 @@ m_upgradeVotingWindow(currency.m_upgradeVotingWindow),
 m_upgradeWindow(currency.m_upgradeWindow),
 m_blocksFileName(currency.m_blocksFileName),
 m_blockIndexesFileName(currency.m_blockIndexesFileName),
+m_blockSegmentsFileName(currency.m_blockSegmentsFileName),
+m_blockOffsetsFileName(currency.m_blockOffsetsFileName),
 m_txPoolFileName(currency.m_txPoolFileName),
+m_keyOutputsIndexFileName(currency.m_keyOutputsIndexFileName),
 m_genesisBlockReward(currency.m_genesisBlockReward),
 m_minMixin(currency.m_minMixin),
 m_mandatoryMixinBlockVersion(currency.m_mandatoryMixinBlockVersion),
@@ -885,7 +891,10 @@ fusionTxMaxSize(parameters::MAX_TRANSACTION_SIZE_LIMIT * 30 / 100);
 
   blocksFileName(parameters::CRYPTONOTE_BLOCKS_FILENAME);
   blockIndexesFileName(parameters::CRYPTONOTE_BLOCKINDEXES_FILENAME);
+  blockSegmentsFileName(parameters::CRYPTONOTE_BLOCK_SEGMENTS_FILENAME);
+  blockOffsetsFileName(parameters::CRYPTONOTE_BLOCK_OFFSETS_FILENAME);
   txPoolFileName(parameters::CRYPTONOTE_POOLDATA_FILENAME);
+  keyOutputsIndexFileName(parameters::CRYPTONOTE_KEY_OUTPUTS_INDEX_FILENAME);
 
 	genesisCoinbaseTxHex(parameters::GENESIS_COINBASE_TX_HEX);
 	
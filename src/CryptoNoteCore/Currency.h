@@ -116,7 +116,10 @@ size_t difficultyBlocksCountByBlockVersion(uint8_t blockMajorVersion) const;
 
   const std::string& blocksFileName() const { return m_blocksFileName; }
   const std::string& blockIndexesFileName() const { return m_blockIndexesFileName; }
+  const std::string& blockSegmentsFileName() const { return m_blockSegmentsFileName; }
+  const std::string& blockOffsetsFileName() const { return m_blockOffsetsFileName; }
   const std::string& txPoolFileName() const { return m_txPoolFileName; }
+  const std::string& keyOutputsIndexFileName() const { return m_keyOutputsIndexFileName; }
 
   bool isBlockexplorer() const { return m_isBlockexplorer; }
   bool isTestnet() const { return m_testnet; }
@@ -239,7 +242,10 @@ private:
 
   std::string m_blocksFileName;
   std::string m_blockIndexesFileName;
+  std::string m_blockSegmentsFileName;
+  std::string m_blockOffsetsFileName;
   std::string m_txPoolFileName;
+  std::string m_keyOutputsIndexFileName;
 
   static const std::vector<uint64_t> PRETTY_AMOUNTS;
 
@@ -342,7 +348,10 @@ public:
 
   CurrencyBuilder& blocksFileName(const std::string& val) { m_currency.m_blocksFileName = val; return *this; }
   CurrencyBuilder& blockIndexesFileName(const std::string& val) { m_currency.m_blockIndexesFileName = val; return *this; }
+  CurrencyBuilder& blockSegmentsFileName(const std::string& val) { m_currency.m_blockSegmentsFileName = val; return *this; }
+  CurrencyBuilder& blockOffsetsFileName(const std::string& val) { m_currency.m_blockOffsetsFileName = val; return *this; }
   CurrencyBuilder& txPoolFileName(const std::string& val) { m_currency.m_txPoolFileName = val; return *this; }
+  CurrencyBuilder& keyOutputsIndexFileName(const std::string& val) { m_currency.m_keyOutputsIndexFileName = val; return *this; }
   
   CurrencyBuilder& isBlockexplorer(const bool val) { m_currency.m_isBlockexplorer = val; return *this; }
   CurrencyBuilder& genesisCoinbaseTxHex(const std::string& val) { m_currency.m_genesisCoinbaseTxHex = val; return *this; }
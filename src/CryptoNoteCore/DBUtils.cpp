@@ -15,6 +15,8 @@
 // You should have received a copy of the GNU Lesser General Public License
 // along with Bytecoin.  If not, see <http://www.gnu.org/licenses/>.
 
+#include <stdexcept>
+
 #include "DBUtils.h"
 
 namespace {
@@ -24,20 +26,59 @@ namespace {
 
 namespace CryptoNote {
 namespace DB {
+  namespace {
+    template <class Value>
+    std::string serializeInteger(Value value) {
+      std::string result(sizeof(value), '\0');
+      for (size_t i = 0; i < sizeof(value); ++i) {
+        result[i] = static_cast<char>(value >> (8 * i));
+      }
+
+      return result;
+    }
+
+    template <class Value>
+    void deserializeInteger(const std::string& serialized, Value& value, const std::string& name) {
+      if (serialized.size() != sizeof(value)) {
+        throw std::runtime_error("Unexpected size of DB value " + name);
+      }
+
+      value = 0;
+      for (size_t i = 0; i < sizeof(value); ++i) {
+        value |= static_cast<Value>(static_cast<uint8_t>(serialized[i])) << (8 * i);
+      }
+    }
+  }
+
+  std::string serialize(uint32_t value, const std::string& name) {
+    return serializeInteger(value);
+  }
+
+  std::string serialize(uint64_t value, const std::string& name) {
+    return serializeInteger(value);
+  }
+
   std::string serialize(const RawBlock& value, const std::string& name) {
-    std::stringstream ss;
-    Common::StdOutputStream stream(ss);
+    std::string result;
+    Common::StringOutputStream stream(result);
     CryptoNote::BinaryOutputStreamSerializer serializer(stream);
     
     serializer(const_cast<RawBlock&>(value).block, RAW_BLOCK_NAME);
     serializer(const_cast<RawBlock&>(value).transactions, RAW_TXS_NAME);
 
-    return ss.str();
+    return result;
+  }
+
+  void deserialize(const std::string& serialized, uint32_t& value, const std::string& name) {
+    deserializeInteger(serialized, value, name);
+  }
+
+  void deserialize(const std::string& serialized, uint64_t& value, const std::string& name) {
+    deserializeInteger(serialized, value, name);
   }
 
   void deserialize(const std::string& serialized, RawBlock& value, const std::string& name) {
-    std::stringstream ss(serialized);
-    Common::StdInputStream stream(ss);
+    Common::MemoryInputStream stream(serialized.data(), serialized.size());
     CryptoNote::BinaryInputStreamSerializer serializer(stream);
     serializer(value.block, RAW_BLOCK_NAME);
     serializer(value.transactions, RAW_TXS_NAME);
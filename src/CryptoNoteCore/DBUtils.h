@@ -18,15 +18,14 @@
 #pragma once
 
 #include <string>
-#include <sstream>
 
-#include "Common/StdOutputStream.h"
-#include "Serialization/KVBinaryOutputStreamSerializer.h"
+#include "Common/MemoryInputStream.h"
+#include "Common/StringOutputStream.h"
+#include "Serialization/BinaryInputStreamSerializer.h"
+#include "Serialization/BinaryOutputStreamSerializer.h"
 #include "Serialization/SerializationOverloads.h"
 #include "CryptoNoteCore/CryptoNoteFormatUtils.h"
 #include "CryptoNoteCore/CryptoNoteSerialization.h"
-#include "Common/StdInputStream.h"
-#include "Serialization/KVBinaryInputStreamSerializer.h"
 
 namespace CryptoNote {
 namespace DB {
@@ -59,41 +58,85 @@ namespace DB {
 
   const std::string TRANSACTIONS_COUNT_KEY = "txs_count";
 
+  const std::string SPENT_KEY_IMAGES_COUNT_KEY = "spent_key_images_count";
+
   const std::string KEY_OUTPUT_KEY_PREFIX = "j";
-  const std::string INPUT_KEYS_BY_OUTPUT_KEY = "input-keys-output-key";
+  const std::string INPUT_KEYS_BY_OUTPUT_KEY = "i";
+
+  // Keys are the prefix followed by fixed-width fields, integers are big-endian so keys sort numerically
+  inline void appendKey(std::string& key, uint32_t value) {
+    for (int shift = 24; shift >= 0; shift -= 8) {
+      key.push_back(static_cast<char>(value >> shift));
+    }
+  }
+
+  inline void appendKey(std::string& key, uint64_t value) {
+    for (int shift = 56; shift >= 0; shift -= 8) {
+      key.push_back(static_cast<char>(value >> shift));
+    }
+  }
+
+  inline void appendKey(std::string& key, const Crypto::Hash& value) {
+    key.append(reinterpret_cast<const char*>(&value), sizeof(value));
+  }
+
+  inline void appendKey(std::string& key, const Crypto::PublicKey& value) {
+    key.append(reinterpret_cast<const char*>(&value), sizeof(value));
+  }
+
+  inline void appendKey(std::string& key, const Crypto::KeyImage& value) {
+    key.append(reinterpret_cast<const char*>(&value), sizeof(value));
+  }
 
+  inline void appendKey(std::string& key, const std::string& value) {
+    key.append(value);
+  }
+
+  template <class First, class Second>
+  void appendKey(std::string& key, const std::pair<First, Second>& value) {
+    appendKey(key, value.first);
+    appendKey(key, value.second);
+  }
+
+  // Integer values are stored as fixed-width little-endian, other values in binary serialization format
   template <class Value>
   std::string serialize(const Value& value, const std::string& name) {
-    CryptoNote::KVBinaryOutputStreamSerializer serializer;
-    std::stringstream ss;
-    Common::StdOutputStream stream(ss);
+    std::string result;
+    Common::StringOutputStream stream(result);
+    CryptoNote::BinaryOutputStreamSerializer serializer(stream);
 
     serializer(const_cast<Value&>(value), name);
-    serializer.dump(stream);
 
-    return ss.str();
+    return result;
   }
 
+  std::string serialize(uint32_t value, const std::string& name);
+  std::string serialize(uint64_t value, const std::string& name);
   std::string serialize(const RawBlock& value, const std::string& name);
 
-  template <class Key, class Value>
-  std::pair<std::string, std::string> serialize(const std::string& keyPrefix, const Key& key, const Value& value) {
-    return{ DB::serialize(std::make_pair(keyPrefix, key), keyPrefix), DB::serialize(value, keyPrefix) };
-  }
-
   template <class Key>
   std::string serializeKey(const std::string& keyPrefix, const Key& key) {
-    return DB::serialize(std::make_pair(keyPrefix, key), keyPrefix);
+    std::string result;
+    result.reserve(keyPrefix.size() + sizeof(key));
+    result.append(keyPrefix);
+    appendKey(result, key);
+    return result;
+  }
+
+  template <class Key, class Value>
+  std::pair<std::string, std::string> serialize(const std::string& keyPrefix, const Key& key, const Value& value) {
+    return{ DB::serializeKey(keyPrefix, key), DB::serialize(value, keyPrefix) };
   }
 
   template <class Value>
   void deserialize(const std::string& serialized, Value& value, const std::string& name) {
-    std::stringstream ss(serialized);
-    Common::StdInputStream stream(ss);
-    CryptoNote::KVBinaryInputStreamSerializer serializer(stream);
+    Common::MemoryInputStream stream(serialized.data(), serialized.size());
+    CryptoNote::BinaryInputStreamSerializer serializer(stream);
     serializer(value, name);
   }
 
+  void deserialize(const std::string& serialized, uint32_t& value, const std::string& name);
+  void deserialize(const std::string& serialized, uint64_t& value, const std::string& name);
   void deserialize(const std::string& serialized, RawBlock& value, const std::string& name);
 
   template <class Key, class Value>
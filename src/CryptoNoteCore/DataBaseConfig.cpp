@@ -17,6 +17,8 @@
 
 #include "DataBaseConfig.h"
 
+#include <algorithm>
+
 #include <boost/utility/value_init.hpp>
 
 #include <Common/Util.h>
@@ -31,8 +33,11 @@ namespace {
 
 const uint64_t WRITE_BUFFER_MB_DEFAULT_SIZE = 256;
 const uint64_t READ_BUFFER_MB_DEFAULT_SIZE = 10;
+const uint64_t KEY_OUTPUTS_CACHE_MB_DEFAULT_SIZE = 0;
 const uint32_t DEFAULT_MAX_OPEN_FILES = 100;
 const uint16_t DEFAULT_BACKGROUND_THREADS_COUNT = 2;
+const std::string DEFAULT_COMPRESSION = "lz4";
+const std::vector<std::string> COMPRESSIONS = { "lz4", "zstd", "none" };
 
 const uint64_t MEGABYTE = 1024 * 1024;
 
@@ -40,6 +45,9 @@ const command_line::arg_descriptor<uint16_t>    argBackgroundThreadsCount = { "d
 const command_line::arg_descriptor<uint32_t>    argMaxOpenFiles = { "db-max-open-files", "Number of open files that can be used by the DB", DEFAULT_MAX_OPEN_FILES};
 const command_line::arg_descriptor<uint64_t>    argWriteBufferSize = { "db-write-buffer-size", "Size of data base write buffer in megabytes", WRITE_BUFFER_MB_DEFAULT_SIZE};
 const command_line::arg_descriptor<uint64_t>    argReadCacheSize = { "db-read-cache-size", "Size of data base read cache in megabytes", READ_BUFFER_MB_DEFAULT_SIZE};
+const command_line::arg_descriptor<uint64_t>    argKeyOutputsCacheSize = { "db-key-outputs-cache-size", "Memory in megabytes for key outputs of the most used amounts, 0 disables the cache", KEY_OUTPUTS_CACHE_MB_DEFAULT_SIZE};
+const command_line::arg_descriptor<std::string> argCompression = { "db-compression", "Compression of cold data base levels and raw blocks: lz4, zstd or none", DEFAULT_COMPRESSION};
+const command_line::arg_descriptor<bool>        argRawBlocksInStorage = { "db-raw-blocks-in-storage", "Keep raw blocks in blockchain storage only, data base keeps indexes pointing into it. Changing it recreates data base"};
 
 } //namespace
 
@@ -48,6 +56,9 @@ void DataBaseConfig::initOptions(boost::program_options::options_description& de
   command_line::add_arg(desc, argMaxOpenFiles);
   command_line::add_arg(desc, argWriteBufferSize);
   command_line::add_arg(desc, argReadCacheSize);
+  command_line::add_arg(desc, argKeyOutputsCacheSize);
+  command_line::add_arg(desc, argCompression);
+  command_line::add_arg(desc, argRawBlocksInStorage);
 }
 
 DataBaseConfig::DataBaseConfig() :
@@ -56,6 +67,9 @@ DataBaseConfig::DataBaseConfig() :
   maxOpenFiles(DEFAULT_MAX_OPEN_FILES),
   writeBufferSize(WRITE_BUFFER_MB_DEFAULT_SIZE * MEGABYTE),
   readCacheSize(READ_BUFFER_MB_DEFAULT_SIZE * MEGABYTE),
+  keyOutputsCacheSize(KEY_OUTPUTS_CACHE_MB_DEFAULT_SIZE * MEGABYTE),
+  compression(DEFAULT_COMPRESSION),
+  rawBlocksInMainChainStorage(false),
   testnet(false) {
 }
 
@@ -76,6 +90,22 @@ bool DataBaseConfig::init(const boost::program_options::variables_map& vm) {
     readCacheSize = command_line::get_arg(vm, argReadCacheSize) * MEGABYTE;
   }
 
+  if (vm.count(argKeyOutputsCacheSize.name) != 0 && !vm[argKeyOutputsCacheSize.name].defaulted()) {
+    keyOutputsCacheSize = command_line::get_arg(vm, argKeyOutputsCacheSize) * MEGABYTE;
+  }
+
+  if (vm.count(argCompression.name) != 0 && !vm[argCompression.name].defaulted()) {
+    compression = command_line::get_arg(vm, argCompression);
+    if (std::find(COMPRESSIONS.begin(), COMPRESSIONS.end(), compression) == COMPRESSIONS.end()) {
+      throw boost::program_options::validation_error(boost::program_options::validation_error::invalid_option_value,
+        argCompression.name, compression);
+    }
+  }
+
+  if (command_line::has_arg(vm, argRawBlocksInStorage)) {
+    rawBlocksInMainChainStorage = true;
+  }
+
   if (vm.count(command_line::arg_data_dir.name) != 0 && (!vm[command_line::arg_data_dir.name].defaulted() || dataDir == Tools::getDefaultDataDirectory())) {
     dataDir = command_line::get_arg(vm, command_line::arg_data_dir);
   }
@@ -109,6 +139,18 @@ uint64_t DataBaseConfig::getReadCacheSize() const {
   return readCacheSize;
 }
 
+uint64_t DataBaseConfig::getKeyOutputsCacheSize() const {
+  return keyOutputsCacheSize;
+}
+
+const std::string& DataBaseConfig::getCompression() const {
+  return compression;
+}
+
+bool DataBaseConfig::getRawBlocksInMainChainStorage() const {
+  return rawBlocksInMainChainStorage;
+}
+
 bool DataBaseConfig::getTestnet() const {
   return testnet;
 }
@@ -137,6 +179,18 @@ void DataBaseConfig::setReadCacheSize(uint64_t readCacheSize) {
   this->readCacheSize = readCacheSize;
 }
 
+void DataBaseConfig::setKeyOutputsCacheSize(uint64_t keyOutputsCacheSize) {
+  this->keyOutputsCacheSize = keyOutputsCacheSize;
+}
+
+void DataBaseConfig::setCompression(const std::string& compression) {
+  this->compression = compression;
+}
+
+void DataBaseConfig::setRawBlocksInMainChainStorage(bool rawBlocksInMainChainStorage) {
+  this->rawBlocksInMainChainStorage = rawBlocksInMainChainStorage;
+}
+
 void DataBaseConfig::setTestnet(bool testnet) {
   this->testnet = testnet;
 }
@@ -37,6 +37,9 @@ public:
   uint32_t getMaxOpenFiles() const;
   uint64_t getWriteBufferSize() const; //Bytes
   uint64_t getReadCacheSize() const; //Bytes
+  uint64_t getKeyOutputsCacheSize() const; //Bytes
+  const std::string& getCompression() const;
+  bool getRawBlocksInMainChainStorage() const;
   bool getTestnet() const;
 
   void setConfigFolderDefaulted(bool defaulted);
@@ -45,6 +48,9 @@ public:
   void setMaxOpenFiles(uint32_t maxOpenFiles);
   void setWriteBufferSize(uint64_t writeBufferSize); //Bytes
   void setReadCacheSize(uint64_t readCacheSize); //Bytes
+  void setKeyOutputsCacheSize(uint64_t keyOutputsCacheSize); //Bytes
+  void setCompression(const std::string& compression);
+  void setRawBlocksInMainChainStorage(bool rawBlocksInMainChainStorage);
   void setTestnet(bool testnet);
 
 private:
@@ -54,6 +60,9 @@ private:
   uint32_t maxOpenFiles;
   uint64_t writeBufferSize;
   uint64_t readCacheSize;
+  uint64_t keyOutputsCacheSize;
+  std::string compression;
+  bool rawBlocksInMainChainStorage;
   bool testnet;
 };
 } //namespace CryptoNote
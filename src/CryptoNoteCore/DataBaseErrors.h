@@ -27,7 +27,8 @@ enum class DataBaseErrorCodes : int {
   NOT_INITIALIZED = 1,
   ALREADY_INITIALIZED,
   INTERNAL_ERROR,
-  IO_ERROR
+  IO_ERROR,
+  READ_ONLY
 };
 
 class DataBaseErrorCategory : public std::error_category {
@@ -48,6 +49,7 @@ public:
       case static_cast<int>(DataBaseErrorCodes::ALREADY_INITIALIZED) : return "Object has been already initialized";
       case static_cast<int>(DataBaseErrorCodes::INTERNAL_ERROR) : return "Internal error";
       case static_cast<int>(DataBaseErrorCodes::IO_ERROR) : return "IO error";
+      case static_cast<int>(DataBaseErrorCodes::READ_ONLY) : return "Database is read-only";
       default: return "Unknown error";
     }
   }
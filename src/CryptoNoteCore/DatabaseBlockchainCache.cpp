@@ -22,6 +22,7 @@
 
 #include <boost/iterator/iterator_facade.hpp>
 
+#include <Common/Math.h>
 #include <Common/ShuffleGenerator.h>
 
 #include "BlockchainUtils.h"
@@ -31,6 +32,7 @@
 #include <CryptoNoteCore/BlockchainStorage.h>
 #include <CryptoNoteCore/CryptoNoteTools.h>
 #include <CryptoNoteCore/CryptoNoteBasicImpl.h>
+#include <CryptoNoteCore/DatabaseSchemeMigrator.h>
 #include "CryptoNoteCore/TransactionExtra.h"
 
 namespace CryptoNote {
@@ -38,6 +40,11 @@ namespace CryptoNote {
 namespace {
 
 const uint32_t ONE_DAY_SECONDS = 60 * 60 * 24;
+const uint32_t SPENT_KEY_IMAGES_FILTER_BLOCKS_PER_READ = 1000;
+// the filter is rebuilt from the database when it fills up, the headroom keeps that rare
+const uint64_t SPENT_KEY_IMAGES_FILTER_MIN_HEADROOM = 1 << 20;
+const size_t RANDOM_OUTPUTS_OVERSAMPLING_FACTOR = 2;
+const uint32_t KEY_OUTPUTS_INDEX_OUTPUTS_PER_READ = 10000;
 const CachedBlockInfo NULL_CACHED_BLOCK_INFO {NULL_HASH, 0, 0, 0, 0, 0};
 
 bool requestPackedOutputs(IBlockchainCache::Amount amount, Common::ArrayView<uint32_t> globalIndexes, IDataBase& database, std::vector<PackedOutIndex>& result) {
@@ -155,16 +162,6 @@ bool requestExtendedTransactionInfos(const std::vector<Crypto::Hash>& transactio
   return true;
 }
 
-//returns ExtendedTransactionInfos in the same order as packedOuts are
-bool requestExtendedTransactionInfos(const std::vector<PackedOutIndex>& packedOuts, IDataBase& database, std::vector<ExtendedTransactionInfo>& result) {
-  std::vector<Crypto::Hash> transactionHashes;
-  if (!requestTransactionHashesForGlobalOutputIndexes(packedOuts, database, transactionHashes)) {
-    return false;
-  }
-
-  return requestExtendedTransactionInfos(transactionHashes, database, result);
-}
-
 uint64_t roundToMidnight(uint64_t timestamp) {
   if (timestamp > static_cast<uint64_t>(std::numeric_limits<time_t>::max())) {
     throw std::runtime_error("Timestamp is too big");
@@ -192,24 +189,6 @@ std::pair<boost::optional<uint32_t>, bool> requestClosestBlockIndexByTimestamp(u
   return result;
 }
 
-bool requestRawBlock(IDataBase& database, uint32_t blockIndex, RawBlock& block) {
-  auto batch = BlockchainReadBatch().requestRawBlock(blockIndex);
-
-  auto error = database.read(batch);
-  if (error) {
-    //may be throw in all similiar functions???
-    return false;
-  }
-
-  auto result = batch.extractResult();
-  if (result.getRawBlocks().count(blockIndex) == 0) {
-    return false;
-  }
-
-  block = result.getRawBlocks().at(blockIndex);
-  return true;
-}
-
 Transaction extractTransaction(const RawBlock& block, uint32_t transactionIndex) {
   assert(transactionIndex < block.transactions.size() + 1);
 
@@ -258,26 +237,6 @@ size_t requestPaymentIdTransactionsCount(IDataBase& database, const Crypto::Hash
   return result.getTransactionCountByPaymentIds().at(paymentId);
 }
 
-bool requestPaymentId(IDataBase& database, const Crypto::Hash& transactionHash, Crypto::Hash& paymentId) {
-  std::vector<CachedTransactionInfo> cachedTransactions;
-
-  if (!requestCachedTransactionInfos({transactionHash}, database, cachedTransactions)) {
-    return false;
-  }
-
-  if (cachedTransactions.empty()) {
-    return false;
-  }
-
-  RawBlock block;
-  if (!requestRawBlock(database, cachedTransactions[0].blockIndex, block)) {
-    return false;
-  }
-
-  Transaction transaction = extractTransaction(block, cachedTransactions[0].transactionIndex);
-  return getPaymentIdFromTxExtra(transaction.extra, paymentId);
-}
-
 uint32_t requestKeyOutputGlobalIndexesCountForAmount(IBlockchainCache::Amount amount, IDataBase& database) {
   auto batch = BlockchainReadBatch().requestKeyOutputGlobalIndexesCountForAmount(amount);
   auto dbError = database.read(batch);
@@ -294,6 +253,65 @@ uint32_t requestKeyOutputGlobalIndexesCountForAmount(IBlockchainCache::Amount am
   }
 }
 
+size_t getSpentKeyImagesFilterCapacity(uint64_t keyImagesCount) {
+  return static_cast<size_t>(keyImagesCount + std::max(keyImagesCount / 2, SPENT_KEY_IMAGES_FILTER_MIN_HEADROOM));
+}
+
+// TODO: pass time
+bool isSpendTimeUnlocked(const Currency& currency, uint64_t unlockTime, uint32_t blockIndex) {
+  if (unlockTime < currency.maxBlockHeight()) {
+    // interpret as block index
+    return blockIndex + currency.lockedTxAllowedDeltaBlocks() >= unlockTime;
+  }
+
+  // interpret as time
+  return static_cast<uint64_t>(time(nullptr)) + currency.lockedTxAllowedDeltaSeconds() >= unlockTime;
+}
+
+// Mixins are taken from unlocked outputs of blocks in (startBlockIndex, blockIndex - mined money unlock window]
+bool isSuitableRandomOutput(const Currency& currency, uint32_t blockIndex, uint32_t startBlockIndex, PackedOutIndex packedOut, uint64_t unlockTime) {
+  uint32_t upperBlockIndex = 0;
+  if (blockIndex > currency.minedMoneyUnlockWindow()) {
+    upperBlockIndex = blockIndex - currency.minedMoneyUnlockWindow();
+  }
+
+  return packedOut.blockIndex > startBlockIndex && packedOut.blockIndex <= upperBlockIndex &&
+         isSpendTimeUnlocked(currency, unlockTime, blockIndex);
+}
+
+// Draws global indexes in random order until the filter has picked enough of them or all of them are drawn.
+// The filter appends suitable candidates to the result in the order they were drawn, so the result doesn't depend
+// on how many were drawn at once.
+template <typename CandidatesFilter>
+std::vector<uint32_t> pickRandomOutputs(uint32_t amountOutputsCount, size_t count, CandidatesFilter filter) {
+  auto outputsToPick = std::min(static_cast<uint32_t>(count), amountOutputsCount);
+
+  std::vector<uint32_t> resultOuts;
+  resultOuts.reserve(outputsToPick);
+
+  ShuffleGenerator<uint32_t, Crypto::random_engine<uint32_t>> generator(amountOutputsCount);
+
+  bool sequenceEnded = false;
+  while (resultOuts.size() < outputsToPick && !sequenceEnded) {
+    // Some candidates are usually filtered out, so draw more than needed to resolve most requests with a single read
+    size_t candidatesCount = (outputsToPick - resultOuts.size()) * RANDOM_OUTPUTS_OVERSAMPLING_FACTOR;
+    std::vector<uint32_t> candidates;
+    candidates.reserve(candidatesCount);
+
+    try {
+      while (candidates.size() < candidatesCount) {
+        candidates.push_back(generator());
+      }
+    } catch (const SequenceEnded&) {
+      sequenceEnded = true;
+    }
+
+    filter(candidates, outputsToPick, resultOuts);
+  }
+
+  return resultOuts;
+}
+
 class DbOutputConstIterator: public boost::iterator_facade<DbOutputConstIterator, const PackedOutIndex, boost::random_access_traversal_tag /*boost::forward_traversal_tag*/> {
 public:
   DbOutputConstIterator(std::function<PackedOutIndex (IBlockchainCache::Amount amount, uint32_t globalOutputIndex)> retriever_,
@@ -378,15 +396,6 @@ void mergeOutputsSplitBoundaries(std::map<IBlockchainCache::Amount, IBlockchainC
   }
 }
 
-void cutTail(std::deque<CachedBlockInfo>& cache, size_t count) {
-  if (count >= cache.size()) {
-    cache.clear();
-    return;
-  }
-
-  cache.erase(std::next(cache.begin(), cache.size() - count), cache.end());
-}
-
 const std::string DB_VERSION_KEY = "db_scheme_version";
 
 class DatabaseVersionReadBatch: public IReadBatch {
@@ -433,7 +442,49 @@ private:
   uint32_t schemeVersion;
 };
 
-const uint32_t CURRENT_DB_SCHEME_VERSION = 2;
+const std::string RAW_BLOCKS_LOCATION_KEY = "raw_blocks_location";
+const std::string RAW_BLOCKS_IN_MAIN_CHAIN_STORAGE = "main_chain_storage";
+
+// Absent location means the raw blocks are kept in the DB
+class RawBlocksLocationReadBatch: public IReadBatch {
+public:
+  virtual ~RawBlocksLocationReadBatch() {}
+
+  virtual std::vector<std::string> getRawKeys() const override {
+    return {RAW_BLOCKS_LOCATION_KEY};
+  }
+
+  virtual void submitRawResult(const std::vector<std::string>& values, const std::vector<bool>& resultStates) override {
+    assert(values.size() == 1);
+    assert(resultStates.size() == values.size());
+
+    inMainChainStorage = resultStates[0] && values[0] == RAW_BLOCKS_IN_MAIN_CHAIN_STORAGE;
+  }
+
+  bool isInMainChainStorage() const {
+    return inMainChainStorage;
+  }
+
+private:
+  bool inMainChainStorage = false;
+};
+
+class RawBlocksLocationWriteBatch: public IWriteBatch {
+public:
+  virtual ~RawBlocksLocationWriteBatch() {}
+
+  virtual std::vector<std::pair<std::string, std::string> > extractRawDataToInsert() override {
+    return {make_pair(RAW_BLOCKS_LOCATION_KEY, RAW_BLOCKS_IN_MAIN_CHAIN_STORAGE)};
+  }
+
+  virtual std::vector<std::string> extractRawKeysToRemove() override {
+    return {};
+  }
+};
+
+// Version 2 stored keys and values in KV-binary format
+const uint32_t KV_BINARY_DB_SCHEME_VERSION = 2;
+const uint32_t CURRENT_DB_SCHEME_VERSION = 3;
 
 }
 
@@ -443,8 +494,12 @@ struct DatabaseBlockchainCache::ExtendedPushedBlockInfo {
 };
 
 
-DatabaseBlockchainCache::DatabaseBlockchainCache(const Currency& curr, IDataBase& dataBase, IBlockchainCacheFactory& blockchainCacheFactory, Logging::ILogger& _logger)
-    : currency(curr), database(dataBase), blockchainCacheFactory(blockchainCacheFactory), logger(_logger, "DatabaseBlockchainCache") {
+DatabaseBlockchainCache::DatabaseBlockchainCache(const Currency& curr, IDataBase& dataBase, IBlockchainCacheFactory& blockchainCacheFactory, Logging::ILogger& _logger,
+                                                 const std::string& keyOutputsIndexFile, uint64_t keyOutputsMemoryLimit,
+                                                 const IMainChainStorage* rawBlocksStorage)
+    : currency(curr), bufferedDatabase(dataBase), database(bufferedDatabase), blockchainCacheFactory(blockchainCacheFactory), logger(_logger, "DatabaseBlockchainCache"),
+      blockSizesMedian(curr.rewardBlocksWindow()), keyOutputsIndexFile(keyOutputsIndexFile), keyOutputsIndex(keyOutputsMemoryLimit),
+      rawBlocksStorage(rawBlocksStorage), spentKeyImagesCount(0) {
   DatabaseVersionReadBatch readBatch;
   auto ec = database.read(readBatch);
   if (ec) {
@@ -464,10 +519,22 @@ DatabaseBlockchainCache::DatabaseBlockchainCache(const Currency& curr, IDataBase
     logger(Logging::DEBUGGING) << "Current db scheme version: " << *version;
   }
 
+  if (rawBlocksStorage != nullptr) {
+    RawBlocksLocationWriteBatch locationBatch;
+    auto writeError = database.write(locationBatch);
+    if (writeError) {
+      throw std::system_error(writeError);
+    }
+  }
+
   if (getTopBlockIndex() == 0) {
     logger(Logging::DEBUGGING) << "top block index is nill, add genesis block";
     addGenesisBlock(CachedBlock (currency.genesisBlock()));
   }
+
+  buildSpentKeyImagesFilter();
+  initKeyOutputsIndex();
+  fillUnitsCache();
 }
 
 bool DatabaseBlockchainCache::checkDBSchemeVersion(IDataBase& database, Logging::ILogger& _logger) {
@@ -484,7 +551,7 @@ bool DatabaseBlockchainCache::checkDBSchemeVersion(IDataBase& database, Logging:
     //DB scheme version not found. Looks like it was just created.
     return true;
   } else if (*version < CURRENT_DB_SCHEME_VERSION) {
-    logger(Logging::WARNING) << "DB scheme version is less than expected. Expected version " << CURRENT_DB_SCHEME_VERSION << ". Actual version " << *version << ". DB will be destroyed and recreated from blocks.bin file.";
+    logger(Logging::WARNING) << "DB scheme version is less than expected. Expected version " << CURRENT_DB_SCHEME_VERSION << ". Actual version " << *version << ".";
     return false;
   } else if (*version > CURRENT_DB_SCHEME_VERSION) {
     logger(Logging::ERROR) << "DB scheme version is greater than expected. Expected version " << CURRENT_DB_SCHEME_VERSION << ". Actual version " << *version << ". Please update your software.";
@@ -494,6 +561,65 @@ bool DatabaseBlockchainCache::checkDBSchemeVersion(IDataBase& database, Logging:
   }
 }
 
+bool DatabaseBlockchainCache::checkRawBlocksLocation(IDataBase& database, Logging::ILogger& _logger, bool rawBlocksInMainChainStorage) {
+  Logging::LoggerRef logger(_logger, "DatabaseBlockchainCache");
+
+  DatabaseVersionReadBatch versionBatch;
+  auto ec = database.read(versionBatch);
+  if (ec) {
+    throw std::system_error(ec);
+  }
+
+  if (!versionBatch.getDbSchemeVersion()) {
+    //Looks like DB was just created.
+    return true;
+  }
+
+  RawBlocksLocationReadBatch locationBatch;
+  ec = database.read(locationBatch);
+  if (ec) {
+    throw std::system_error(ec);
+  }
+
+  if (locationBatch.isInMainChainStorage() == rawBlocksInMainChainStorage) {
+    return true;
+  }
+
+  logger(Logging::WARNING) << "DB keeps raw blocks " << (locationBatch.isInMainChainStorage() ? "in blockchain storage" : "in DB")
+                           << ", but they are requested " << (rawBlocksInMainChainStorage ? "in blockchain storage" : "in DB")
+                           << ". DB will be destroyed and recreated from blockchain storage.";
+  return false;
+}
+
+bool DatabaseBlockchainCache::migrateDBScheme(IDataBase& database, Logging::ILogger& _logger) {
+  Logging::LoggerRef logger(_logger, "DatabaseBlockchainCache");
+
+  DatabaseVersionReadBatch readBatch;
+  auto ec = database.read(readBatch);
+  if (ec) {
+    throw std::system_error(ec);
+  }
+
+  auto version = readBatch.getDbSchemeVersion();
+  if (!version || *version != KV_BINARY_DB_SCHEME_VERSION) {
+    logger(Logging::WARNING) << "DB scheme can't be converted. DB will be destroyed and recreated from blocks.bin file.";
+    return false;
+  }
+
+  logger(Logging::INFO) << "Converting DB scheme from version " << *version << " to version " << CURRENT_DB_SCHEME_VERSION;
+  DatabaseSchemeMigrator migrator(database, _logger);
+  migrator.convertKVBinaryRecords();
+
+  DatabaseVersionWriteBatch writeBatch(CURRENT_DB_SCHEME_VERSION);
+  auto writeError = database.writeSync(writeBatch);
+  if (writeError) {
+    throw std::system_error(writeError);
+  }
+
+  logger(Logging::INFO) << "DB scheme converted";
+  return true;
+}
+
 void DatabaseBlockchainCache::deleteClosestTimestampBlockIndex(BlockchainWriteBatch& writeBatch, uint32_t splitBlockIndex) {
   auto batch = BlockchainReadBatch().requestCachedBlock(splitBlockIndex);
   auto blockResult = readDatabase(batch);
@@ -555,13 +681,19 @@ std::unique_ptr<IBlockchainCache> DatabaseBlockchainCache::split(uint32_t splitB
     auto& validatorState = std::get<2>(*it);
     uint64_t timestamp = std::get<3>(*it);
 
-    writeBatch.removeCachedBlock(blockHash, blockIndex).removeRawBlock(blockIndex);
+    writeBatch.removeCachedBlock(blockHash, blockIndex);
+    if (rawBlocksStorage == nullptr) {
+      writeBatch.removeRawBlock(blockIndex);
+    }
+
     requestDeleteSpentOutputs(writeBatch,
                               blockIndex,
                               validatorState);
     requestRemoveTimestamp(writeBatch, timestamp, blockHash);
   }
 
+  // key images of the deleted blocks stay in spentKeyImagesFilter, checkIfSpent answers them from the database
+
   auto deletingTransactionHashes = requestTransactionHashesFromBlockIndex(splitBlockIndex);
   requestDeleteTransactions(writeBatch, deletingTransactionHashes);
 requestDeleteOutputKeys(writeBatch, deletingTransactionHashes);
@@ -592,7 +724,9 @@ requestDeleteOutputKeys(writeBatch, deletingTransactionHashes);
     throw std::runtime_error(err.message());
   }
 
-  cutTail(unitsCache, currentTop + 1 - splitBlockIndex);
+  for (const auto& boundary : keyIndexSplitBoundaries) {
+    keyOutputsIndex.truncate(boundary.first, boundary.second);
+  }
 
   children.push_back(cache.get());
   logger(Logging::TRACE) << "Delete successfull";
@@ -602,6 +736,9 @@ requestDeleteOutputKeys(writeBatch, deletingTransactionHashes);
   topBlockHash = boost::none;
   transactionsCount = boost::none;
 
+  // reload the window so it covers as many blocks of the remaining chain as before the split
+  fillUnitsCache();
+
   logger(Logging::DEBUGGING) << "split completed";
   // return new cache
   return cache;
@@ -702,7 +839,7 @@ void DatabaseBlockchainCache::requestDeletePaymentIds(BlockchainWriteBatch& writ
 
   for (const auto& hash: transactionHashes) {
     Crypto::Hash paymentId;
-    if (!requestPaymentId(database, hash, paymentId)) {
+    if (!requestPaymentId(hash, paymentId)) {
       continue;
     }
 
@@ -737,7 +874,9 @@ void DatabaseBlockchainCache::requestDeleteSpentOutputs(BlockchainWriteBatch& wr
 
   std::vector<Crypto::KeyImage> spentKeys(spentOutputs.spentKeyImages.begin(), spentOutputs.spentKeyImages.end());
 
-  writeBatch.removeSpentKeyImages(blockIndex, spentKeys);
+  assert(spentKeyImagesCount >= spentKeys.size());
+  spentKeyImagesCount -= spentKeys.size();
+  writeBatch.removeSpentKeyImages(blockIndex, spentKeys, spentKeyImagesCount);
 }
 
 void DatabaseBlockchainCache::requestDeleteKeyOutputs(BlockchainWriteBatch& writeBatch,
@@ -985,7 +1124,8 @@ void DatabaseBlockchainCache::pushBlock(const CachedBlock& cachedBlock,
   blockInfo.blockSize = static_cast<uint32_t>(blockSize);
   blockInfo.timestamp = cachedBlock.getBlock().timestamp;
 
-  batch.insertSpentKeyImages(getTopBlockIndex() + 1, validatorState.spentKeyImages);
+  spentKeyImagesCount += validatorState.spentKeyImages.size();
+  batch.insertSpentKeyImages(getTopBlockIndex() + 1, validatorState.spentKeyImages, spentKeyImagesCount);
 
   auto txHashes = cachedBlock.getBlock().transactionHashes;
   auto baseTransaction = cachedBlock.getBlock().baseTransaction;
@@ -995,7 +1135,12 @@ void DatabaseBlockchainCache::pushBlock(const CachedBlock& cachedBlock,
   txHashes.insert(txHashes.begin(), cachedBaseTransaction.getTransactionHash());
 
   batch.insertCachedBlock(blockInfo, getTopBlockIndex() + 1, txHashes);
-  batch.insertRawBlock(getTopBlockIndex() + 1, std::move(rawBlock));
+  if (rawBlocksStorage == nullptr) {
+    batch.insertRawBlock(getTopBlockIndex() + 1, std::move(rawBlock));
+  } else {
+    assert(rawBlocksStorage->getBlockCount() > getTopBlockIndex() + 1);
+  }
+
 
   auto transactionIndex = 0;
   pushTransaction(cachedBaseTransaction, getTopBlockIndex() + 1, transactionIndex++, batch);
@@ -1022,14 +1167,45 @@ void DatabaseBlockchainCache::pushBlock(const CachedBlock& cachedBlock,
     throw std::runtime_error(res.message());
   }
 
+  // outputs are pushed in the same order pushTransaction assigned their global indexes
+  transactionIndex = 0;
+  pushKeyOutputsToIndex(cachedBaseTransaction, getTopBlockIndex() + 1, transactionIndex++);
+  for (const auto& transaction: cachedTransactions) {
+    pushKeyOutputsToIndex(transaction, getTopBlockIndex() + 1, transactionIndex++);
+  }
+
   topBlockIndex = *topBlockIndex + 1;
   topBlockHash = cachedBlock.getBlockHash();
+
+  for (const auto& keyImage : validatorState.spentKeyImages) {
+    spentKeyImagesFilter.insert(keyImage);
+  }
+
+  if (spentKeyImagesFilter.size() > spentKeyImagesFilter.capacity()) {
+    buildSpentKeyImagesFilter();
+  }
+
   logger(Logging::DEBUGGING) << "push block " << cachedBlock.getBlockHash() << " completed";
 
+  pushUnit(blockInfo);
+}
+
+void DatabaseBlockchainCache::fillUnitsCache() {
+  unitsCache.clear();
+  blockSizesMedian.clear();
+
+  for (const auto& blockInfo: getLastDbUnits(getTopBlockIndex(), unitsCacheSize, UseGenesis{true})) {
+    pushUnit(blockInfo);
+  }
+}
+
+void DatabaseBlockchainCache::pushUnit(const CachedBlockInfo& blockInfo) {
   unitsCache.push_back(blockInfo);
   if (unitsCache.size() > unitsCacheSize) {
     unitsCache.pop_front();
   }
+
+  blockSizesMedian.push(blockInfo.blockSize);
 }
 
 PushedBlockInfo DatabaseBlockchainCache::getPushedBlockInfo(uint32_t blockIndex) const {
@@ -1037,6 +1213,11 @@ PushedBlockInfo DatabaseBlockchainCache::getPushedBlockInfo(uint32_t blockIndex)
 }
 
 bool DatabaseBlockchainCache::checkIfSpent(const Crypto::KeyImage& keyImage, uint32_t blockIndex) const {
+  // almost every key image checked was never spent, the filter answers those without reading the database
+  if (!spentKeyImagesFilter.mayContain(keyImage)) {
+    return false;
+  }
+
   auto batch = BlockchainReadBatch().requestBlockIndexBySpentKeyImage(keyImage);
   auto res = database.read(batch);
   if (res) {
@@ -1058,15 +1239,8 @@ bool DatabaseBlockchainCache::isTransactionSpendTimeUnlocked(uint64_t unlockTime
   return isTransactionSpendTimeUnlocked(unlockTime, getTopBlockIndex());
 }
 
-// TODO: pass time
 bool DatabaseBlockchainCache::isTransactionSpendTimeUnlocked(uint64_t unlockTime, uint32_t blockIndex) const {
-  if (unlockTime < currency.maxBlockHeight()) {
-    // interpret as block index
-    return blockIndex + currency.lockedTxAllowedDeltaBlocks() >= unlockTime;
-  }
-
-  // interpret as time
-  return static_cast<uint64_t>(time(nullptr)) + currency.lockedTxAllowedDeltaSeconds() >= unlockTime;
+  return isSpendTimeUnlocked(currency, unlockTime, blockIndex);
 }
 
 ExtractOutputKeysResult
@@ -1095,7 +1269,7 @@ DatabaseBlockchainCache::extractTransactionPublicKeys(uint64_t amount, uint32_t
     }
 
     RawBlock block;
-    if (!requestRawBlock(database, cachedTransactions[0].blockIndex, block)) {
+    if (!requestRawBlock(cachedTransactions[0].blockIndex, block)) {
       return ExtractOutputKeysResult::INVALID_GLOBAL_INDEX;
     }
 
@@ -1118,23 +1292,129 @@ ExtractOutputKeysResult
 DatabaseBlockchainCache::extractKeyOutputKeys(uint64_t amount, uint32_t blockIndex,
                                               Common::ArrayView<uint32_t> globalIndexes,
                                               std::vector<Crypto::PublicKey>& publicKeys) const {
-  return extractKeyOutputs(amount, blockIndex, globalIndexes, [this, &publicKeys, blockIndex] (const CachedTransactionInfo& info, PackedOutIndex index, uint32_t globalIndex) {
-    if (!isTransactionSpendTimeUnlocked(info.unlockTime, blockIndex)) {
+  auto column = keyOutputsIndex.getColumn(amount);
+  if (column != nullptr) {
+    return extractKeyOutputKeys(*column, blockIndex, std::set<uint32_t>(globalIndexes.begin(), globalIndexes.end()), publicKeys);
+  }
+
+  return requestKeyOutputKeys(currency, database, amount, blockIndex, globalIndexes, publicKeys);
+}
+
+ExtractOutputKeysResult DatabaseBlockchainCache::requestKeyOutputKeys(const Currency& currency, IDataBase& database, uint64_t amount,
+                                                                      uint32_t blockIndex, Common::ArrayView<uint32_t> globalIndexes,
+                                                                      std::vector<Crypto::PublicKey>& publicKeys) {
+  BlockchainReadBatch batch;
+  for (auto globalIndex : globalIndexes) {
+    batch.requestKeyOutputInfo(amount, globalIndex);
+  }
+
+  auto dbError = database.read(batch);
+  if (dbError) {
+    throw std::system_error(dbError, "Cannot perform requestKeyOutputKeys query");
+  }
+
+  // outputs are visited in the order of their global indexes, absent ones are skipped
+  auto result = batch.extractResult();
+  std::map<std::pair<IBlockchainCache::Amount, IBlockchainCache::GlobalOutputIndex>, KeyOutputInfo> sortedOutputs(
+    result.getKeyOutputInfo().begin(), result.getKeyOutputInfo().end());
+  for (const auto& kv : sortedOutputs) {
+    if (!isSpendTimeUnlocked(currency, kv.second.unlockTime, blockIndex)) {
+      return ExtractOutputKeysResult::OUTPUT_LOCKED;
+    }
+
+    publicKeys.push_back(kv.second.publicKey);
+  }
+
+  return ExtractOutputKeysResult::SUCCESS;
+}
+
+std::vector<KeyOutputKeysResult> DatabaseBlockchainCache::extractKeyOutputKeys(uint32_t blockIndex,
+                                                                              const std::vector<KeyOutputKeysRequest>& requests) const {
+  // one read for the whole block, the batch drops repeated outputs
+  BlockchainReadBatch batch;
+  bool hasDatabaseRequests = false;
+  for (const auto& request : requests) {
+    if (keyOutputsIndex.getColumn(request.amount) != nullptr) {
+      continue;
+    }
+
+    for (auto globalIndex : request.globalIndexes) {
+      batch.requestKeyOutputInfo(request.amount, globalIndex);
+      hasDatabaseRequests = true;
+    }
+  }
+
+  BlockchainReadResult readResult = hasDatabaseRequests ? readDatabase(batch) : BlockchainReadResult(BlockchainReadState());
+  const auto& outputs = readResult.getKeyOutputInfo();
+
+  std::vector<KeyOutputKeysResult> results(requests.size());
+  for (size_t i = 0; i < requests.size(); ++i) {
+    auto& result = results[i];
+    result.result = ExtractOutputKeysResult::SUCCESS;
+
+    // outputs are visited in the same order as extractKeyOutputs does, absent ones are skipped as well
+    std::set<uint32_t> globalIndexes(requests[i].globalIndexes.begin(), requests[i].globalIndexes.end());
+    auto column = keyOutputsIndex.getColumn(requests[i].amount);
+    if (column != nullptr) {
+      result.result = extractKeyOutputKeys(*column, blockIndex, globalIndexes, result.publicKeys);
+      continue;
+    }
+
+    for (auto globalIndex : globalIndexes) {
+      auto it = outputs.find(std::make_pair(requests[i].amount, globalIndex));
+      if (it == outputs.end()) {
+        continue;
+      }
+
+      if (!isTransactionSpendTimeUnlocked(it->second.unlockTime, blockIndex)) {
+        logger(Logging::DEBUGGING) << "extractKeyOutputKeys: output " << globalIndex << " is locked";
+        result.result = ExtractOutputKeysResult::OUTPUT_LOCKED;
+        break;
+      }
+
+      result.publicKeys.push_back(it->second.publicKey);
+    }
+  }
+
+  return results;
+}
+
+ExtractOutputKeysResult DatabaseBlockchainCache::extractKeyOutputKeys(const KeyOutputsColumn& column, uint32_t blockIndex,
+                                                                      const std::set<uint32_t>& globalIndexes,
+                                                                      std::vector<Crypto::PublicKey>& publicKeys) const {
+  for (auto globalIndex : globalIndexes) {
+    if (globalIndex >= column.size()) {
+      continue;
+    }
+
+    if (!isTransactionSpendTimeUnlocked(column.unlockTimes[globalIndex], blockIndex)) {
       logger(Logging::DEBUGGING) << "extractKeyOutputKeys: output " << globalIndex << " is locked";
       return ExtractOutputKeysResult::OUTPUT_LOCKED;
     }
 
-    auto& output = info.outputs[index.outputIndex];
-    assert(output.type() == typeid(KeyOutput));
-    publicKeys.push_back(boost::get<KeyOutput>(output).key);
+    publicKeys.push_back(column.publicKeys[globalIndex]);
+  }
 
-    return ExtractOutputKeysResult::SUCCESS;
-  });
+  return ExtractOutputKeysResult::SUCCESS;
 }
 
 ExtractOutputKeysResult DatabaseBlockchainCache::extractKeyOtputIndexes(uint64_t amount,
                                                                         Common::ArrayView<uint32_t> globalIndexes,
                                                                         std::vector<PackedOutIndex>& outIndexes) const {
+  auto column = keyOutputsIndex.getColumn(amount);
+  if (column != nullptr) {
+    for (auto globalIndex : globalIndexes) {
+      if (globalIndex >= column->size()) {
+        logger(Logging::DEBUGGING) << "extractKeyOtputIndexes failed: global index " << globalIndex << " not found";
+        return ExtractOutputKeysResult::INVALID_GLOBAL_INDEX;
+      }
+
+      outIndexes.push_back(column->packedOuts[globalIndex]);
+    }
+
+    return ExtractOutputKeysResult::SUCCESS;
+  }
+
   if (!requestPackedOutputs(amount, globalIndexes, database, outIndexes)) {
     logger(Logging::ERROR) << "extractKeyOtputIndexes failed: failed to read database";
     return ExtractOutputKeysResult::INVALID_GLOBAL_INDEX;
@@ -1255,6 +1535,20 @@ std::vector<uint64_t> DatabaseBlockchainCache::getLastBlocksSizes(size_t count,
   return getLastUnits(count, blockIndex, useGenesis, [](const CachedBlockInfo& cb) { return cb.blockSize; });
 }
 
+uint64_t DatabaseBlockchainCache::getLastBlocksSizesMedian(size_t count) const {
+  return getLastBlocksSizesMedian(count, getTopBlockIndex(), UseGenesis{true});
+}
+
+uint64_t DatabaseBlockchainCache::getLastBlocksSizesMedian(size_t count, uint32_t blockIndex, UseGenesis useGenesis) const {
+  if (blockIndex == getTopBlockIndex() && count == blockSizesMedian.getWindowSize() &&
+      blockSizesMedian.size() == std::min<size_t>(count, blockIndex + 1) && (useGenesis || blockIndex >= count)) {
+    return blockSizesMedian.median();
+  }
+
+  auto sizes = getLastBlocksSizes(count, blockIndex, useGenesis);
+  return Common::medianValue(sizes);
+}
+
 std::vector<Difficulty> DatabaseBlockchainCache::getLastCumulativeDifficulties(size_t count, uint32_t blockIndex,
                                                                                UseGenesis useGenesis) const {
   return getLastUnits(count, blockIndex, useGenesis,
@@ -1465,6 +1759,15 @@ uint32_t DatabaseBlockchainCache::getStartBlockIndex() const {
 }
 
 size_t DatabaseBlockchainCache::getKeyOutputsCountForAmount(uint64_t amount, uint32_t blockIndex) const {
+  auto column = keyOutputsIndex.getColumn(amount);
+  if (column != nullptr) {
+    auto it = std::lower_bound(column->packedOuts.begin(), column->packedOuts.end(), blockIndex, [] (const PackedOutIndex& output, uint32_t blockIndex) {
+      return output.blockIndex < blockIndex;
+    });
+
+    return static_cast<size_t>(std::distance(column->packedOuts.begin(), it));
+  }
+
   uint32_t outputsCount = requestKeyOutputGlobalIndexesCountForAmount(amount, database);
 
   auto getOutput = std::bind(retrieveKeyOutput, std::placeholders::_1, std::placeholders::_2, std::ref(database));
@@ -1537,11 +1840,35 @@ size_t DatabaseBlockchainCache::getChildCount() const {
 }
 
 void DatabaseBlockchainCache::save() {
+  if (bufferedDatabase.isBuffering()) {
+    commitPushBatch();
+  }
+
+  if (keyOutputsIndex.getMemoryLimit() == 0 || keyOutputsIndexFile.empty()) {
+    return;
+  }
+
+  if (!keyOutputsIndex.save(keyOutputsIndexFile, getTopBlockIndex(), getTopBlockHash())) {
+    logger(Logging::WARNING) << "Failed to save key outputs index to " << keyOutputsIndexFile;
+  }
 }
 
 void DatabaseBlockchainCache::load() {
 }
 
+void DatabaseBlockchainCache::startPushBatch() {
+  bufferedDatabase.startBuffering();
+}
+
+void DatabaseBlockchainCache::commitPushBatch() {
+  logger(Logging::DEBUGGING) << "Writing batched blocks, " << bufferedDatabase.getBufferedSize() << " bytes";
+  auto error = bufferedDatabase.flush();
+  if (error) {
+    logger(Logging::ERROR) << "commitPushBatch failed: failed to write to database, " << error.message();
+    throw std::runtime_error(error.message());
+  }
+}
+
 std::vector<BinaryArray>
 DatabaseBlockchainCache::getRawTransactions(const std::vector<Crypto::Hash>& transactions,
                                             std::vector<Crypto::Hash>& missedTransactions) const {
@@ -1567,15 +1894,15 @@ void DatabaseBlockchainCache::getRawTransactions(const std::vector<Crypto::Hash>
   }
 
   auto res = readDatabase(batch);
+  std::set<uint32_t> blockIndexes;
   for (auto& tx : res.getCachedTransactions()) {
-    batch.requestRawBlock(tx.second.blockIndex);
+    blockIndexes.insert(tx.second.blockIndex);
   }
 
-  auto blocks = readDatabase(batch);
+  auto blocksMap = requestRawBlocks(blockIndexes);
 
   foundTransactions.reserve(foundTransactions.size() + transactions.size());
   auto& hashesMap = res.getCachedTransactions();
-  auto& blocksMap = blocks.getRawBlocks();
   for (const auto& hash: transactions) {
     auto transactionIt = hashesMap.find(hash);
     if (transactionIt == hashesMap.end()) {
@@ -1602,11 +1929,23 @@ void DatabaseBlockchainCache::getRawTransactions(const std::vector<Crypto::Hash>
 }
 
 RawBlock DatabaseBlockchainCache::getBlockByIndex(uint32_t index) const {
+  if (rawBlocksStorage != nullptr) {
+    return rawBlocksStorage->getBlockByIndex(index);
+  }
+
   auto batch = BlockchainReadBatch().requestRawBlock(index);
   auto res = readDatabase(batch);
   return std::move(res.getRawBlocks().at(index));
 }
 
+bool DatabaseBlockchainCache::keepsRawBlocks() const {
+  return rawBlocksStorage == nullptr;
+}
+
+std::shared_ptr<IDataBase> DatabaseBlockchainCache::createDatabaseSnapshot() {
+  return bufferedDatabase.createSnapshot();
+}
+
 BinaryArray DatabaseBlockchainCache::getRawTransaction(uint32_t blockIndex, uint32_t transactionIndex) const {
   return getBlockByIndex(blockIndex).transactions.at(transactionIndex);
 }
@@ -1623,78 +1962,62 @@ std::vector<uint32_t> DatabaseBlockchainCache::getRandomOutsByAmount(uint64_t am
 
 std::vector<uint32_t> DatabaseBlockchainCache::getRandomOutsByAmount(uint64_t amount, size_t count,
                                              uint32_t blockIndex, uint32_t startBlockIndex) const {
-  auto batch = BlockchainReadBatch().requestKeyOutputGlobalIndexesCountForAmount(amount);
-  auto result = readDatabase(batch);
-  auto outputsCount = result.getKeyOutputGlobalIndexesCountForAmounts();
-  auto outputsToPick = std::min(static_cast<uint32_t>(count), outputsCount[amount]);
-
-  std::vector<uint32_t> resultOuts;
-  resultOuts.reserve(outputsToPick);
-
-  ShuffleGenerator<uint32_t, Crypto::random_engine<uint32_t>> generator(outputsCount[amount]);
-
-  while (outputsToPick) {
-    std::vector<uint32_t> globalIndexes;
-    globalIndexes.reserve(outputsToPick);
+  auto column = keyOutputsIndex.getColumn(amount);
+  if (column == nullptr) {
+    return requestRandomOutsByAmount(currency, database, amount, count, blockIndex, startBlockIndex);
+  }
 
-    try {
-      for (uint32_t i = 0, j = 0; i < outputsToPick; )  {
-        globalIndexes.push_back(generator());
-        std::vector<uint32_t> lastIndexVector;
-        lastIndexVector.push_back(globalIndexes.back());
-        std::vector<PackedOutIndex> outputs;
-        if (extractKeyOtputIndexes(amount, Common::ArrayView<uint32_t>(lastIndexVector.data(), lastIndexVector.size()), outputs) != ExtractOutputKeysResult::SUCCESS) {
-        logger(Logging::DEBUGGING) << "getRandomOutsByAmount: failed to extract key output indexes";
-          throw std::runtime_error("Invalid output index"); //TODO: make error code
+  return pickRandomOutputs(static_cast<uint32_t>(column->size()), count,
+    [this, column, blockIndex, startBlockIndex] (const std::vector<uint32_t>& candidates, size_t outputsToPick, std::vector<uint32_t>& resultOuts) {
+      for (auto globalIndex : candidates) {
+        if (resultOuts.size() == outputsToPick) {
+          break;
         }
 
-        std::vector<ExtendedTransactionInfo> transactions;
-        if (!requestExtendedTransactionInfos(outputs, database, transactions)) {
-          logger(Logging::TRACE) << "getRandomOutsByAmount: requestExtendedTransactionInfos failed";
-          throw std::runtime_error("Error while requesting transactions"); //TODO: make error code
-        }
-        if (startBlockIndex >= transactions[0].blockIndex) {
-          globalIndexes.pop_back();
-        } else {
-          ++i;
+        if (isSuitableRandomOutput(currency, blockIndex, startBlockIndex, column->packedOuts[globalIndex], column->unlockTimes[globalIndex])) {
+          resultOuts.push_back(globalIndex);
         }
       }
-      //std::generate_n(std::back_inserter(globalIndexes), outputsToPick, generator);
-    } catch (const SequenceEnded&) {
-      logger(Logging::TRACE) << "getRandomOutsByAmount: generator reached sequence end";
-      return resultOuts;
-    }
+    });
+}
 
-    std::vector<PackedOutIndex> outputs;
-    if (extractKeyOtputIndexes(amount, Common::ArrayView<uint32_t>(globalIndexes.data(), globalIndexes.size()), outputs) != ExtractOutputKeysResult::SUCCESS) {
-      logger(Logging::DEBUGGING) << "getRandomOutsByAmount: failed to extract key output indexes";
-      throw std::runtime_error("Invalid output index"); //TODO: make error code
-    }
+std::vector<uint32_t> DatabaseBlockchainCache::requestRandomOutsByAmount(const Currency& currency, IDataBase& database, uint64_t amount,
+                                                                         size_t count, uint32_t blockIndex, uint32_t startBlockIndex) {
+  uint32_t amountOutputsCount = requestKeyOutputGlobalIndexesCountForAmount(amount, database);
 
-    std::vector<ExtendedTransactionInfo> transactions;
-    if (!requestExtendedTransactionInfos(outputs, database, transactions)) {
-      logger(Logging::TRACE) << "getRandomOutsByAmount: requestExtendedTransactionInfos failed";
-      throw std::runtime_error("Error while requesting transactions"); //TODO: make error code
-    }
+  return pickRandomOutputs(amountOutputsCount, count,
+    [&currency, &database, amount, blockIndex, startBlockIndex] (const std::vector<uint32_t>& candidates, size_t outputsToPick, std::vector<uint32_t>& resultOuts) {
+      BlockchainReadBatch candidatesBatch;
+      for (auto globalIndex : candidates) {
+        candidatesBatch.requestKeyOutputGlobalIndexForAmount(amount, globalIndex);
+        candidatesBatch.requestKeyOutputInfo(amount, globalIndex);
+      }
 
-    assert(globalIndexes.size() == transactions.size());
+      auto dbError = database.read(candidatesBatch);
+      if (dbError) {
+        throw std::system_error(dbError, "Cannot perform requestRandomOutsByAmount query");
+      }
 
-    uint32_t uppperBlockIndex = 0;
-    if (blockIndex > currency.minedMoneyUnlockWindow()) {
-      uppperBlockIndex = blockIndex - currency.minedMoneyUnlockWindow();
-    }
+      auto candidatesResult = candidatesBatch.extractResult();
+      const auto& packedOuts = candidatesResult.getKeyOutputGlobalIndexesForAmounts();
+      const auto& outputInfos = candidatesResult.getKeyOutputInfo();
 
-    for (size_t i = 0; i < transactions.size(); ++i) {
-      if (!isTransactionSpendTimeUnlocked(transactions[i].unlockTime, blockIndex) || transactions[i].blockIndex > uppperBlockIndex) {
-        continue;
-      }
+      for (auto globalIndex : candidates) {
+        if (resultOuts.size() == outputsToPick) {
+          break;
+        }
 
-      resultOuts.push_back(globalIndexes[i]);
-      --outputsToPick;
-    }
-  }
+        auto packedOut = packedOuts.find(std::make_pair(amount, globalIndex));
+        auto outputInfo = outputInfos.find(std::make_pair(amount, globalIndex));
+        if (packedOut == packedOuts.end() || outputInfo == outputInfos.end()) {
+          throw std::runtime_error("Invalid output index"); //TODO: make error code
+        }
 
-  return resultOuts;
+        if (isSuitableRandomOutput(currency, blockIndex, startBlockIndex, packedOut->second, outputInfo->second.unlockTime)) {
+          resultOuts.push_back(globalIndex);
+        }
+      }
+    });
 }
 
 ExtractOutputKeysResult DatabaseBlockchainCache::extractKeyOutputs(
@@ -1796,10 +2119,13 @@ DatabaseBlockchainCache::ExtendedPushedBlockInfo DatabaseBlockchainCache::getExt
   assert(blockIndex <= getTopBlockIndex());
 
   auto batch = BlockchainReadBatch()
-    .requestRawBlock(blockIndex)
     .requestCachedBlock(blockIndex)
     .requestSpentKeyImagesByBlock(blockIndex);
 
+  if (rawBlocksStorage == nullptr) {
+    batch.requestRawBlock(blockIndex);
+  }
+
   if (blockIndex > 0) {
     batch.requestCachedBlock(blockIndex - 1);
   }
@@ -1810,7 +2136,7 @@ DatabaseBlockchainCache::ExtendedPushedBlockInfo DatabaseBlockchainCache::getExt
 
   ExtendedPushedBlockInfo extendedInfo;
 
-  extendedInfo.pushedBlockInfo.rawBlock = dbResult.getRawBlocks().at(blockIndex);
+  extendedInfo.pushedBlockInfo.rawBlock = rawBlocksStorage == nullptr ? dbResult.getRawBlocks().at(blockIndex) : rawBlocksStorage->getBlockByIndex(blockIndex);
   extendedInfo.pushedBlockInfo.blockSize = blockInfo.blockSize;
   extendedInfo.pushedBlockInfo.blockDifficulty = blockInfo.cumulativeDifficulty - previousBlockInfo.cumulativeDifficulty;
   extendedInfo.pushedBlockInfo.generatedCoins = blockInfo.alreadyGeneratedCoins - previousBlockInfo.alreadyGeneratedCoins;
@@ -1851,6 +2177,247 @@ BlockchainReadResult DatabaseBlockchainCache::readDatabase(BlockchainReadBatch&
   return batch.extractResult();
 }
 
+bool DatabaseBlockchainCache::requestRawBlock(uint32_t blockIndex, RawBlock& block) const {
+  if (rawBlocksStorage != nullptr) {
+    if (blockIndex >= rawBlocksStorage->getBlockCount()) {
+      return false;
+    }
+
+    block = rawBlocksStorage->getBlockByIndex(blockIndex);
+    return true;
+  }
+
+  auto batch = BlockchainReadBatch().requestRawBlock(blockIndex);
+
+  auto error = database.read(batch);
+  if (error) {
+    //may be throw in all similiar functions???
+    return false;
+  }
+
+  auto result = batch.extractResult();
+  if (result.getRawBlocks().count(blockIndex) == 0) {
+    return false;
+  }
+
+  block = result.getRawBlocks().at(blockIndex);
+  return true;
+}
+
+std::unordered_map<uint32_t, RawBlock> DatabaseBlockchainCache::requestRawBlocks(const std::set<uint32_t>& blockIndexes) const {
+  std::unordered_map<uint32_t, RawBlock> blocks;
+  if (rawBlocksStorage != nullptr) {
+    for (auto blockIndex: blockIndexes) {
+      if (blockIndex < rawBlocksStorage->getBlockCount()) {
+        blocks.emplace(blockIndex, rawBlocksStorage->getBlockByIndex(blockIndex));
+      }
+    }
+
+    return blocks;
+  }
+
+  if (blockIndexes.empty()) {
+    return blocks;
+  }
+
+  BlockchainReadBatch batch;
+  for (auto blockIndex: blockIndexes) {
+    batch.requestRawBlock(blockIndex);
+  }
+
+  return readDatabase(batch).getRawBlocks();
+}
+
+bool DatabaseBlockchainCache::requestPaymentId(const Crypto::Hash& transactionHash, Crypto::Hash& paymentId) const {
+  std::vector<CachedTransactionInfo> cachedTransactions;
+
+  if (!requestCachedTransactionInfos({transactionHash}, database, cachedTransactions)) {
+    return false;
+  }
+
+  if (cachedTransactions.empty()) {
+    return false;
+  }
+
+  RawBlock block;
+  if (!requestRawBlock(cachedTransactions[0].blockIndex, block)) {
+    return false;
+  }
+
+  Transaction transaction = extractTransaction(block, cachedTransactions[0].transactionIndex);
+  return getPaymentIdFromTxExtra(transaction.extra, paymentId);
+}
+
+void DatabaseBlockchainCache::buildSpentKeyImagesFilter() {
+  auto countBatch = BlockchainReadBatch().requestSpentKeyImagesCount();
+  auto storedCount = readDatabase(countBatch).getSpentKeyImagesCount();
+
+  // databases written before the count was stored are sized by the transaction count, and counted while reading
+  uint64_t expectedCount = storedCount.second ? storedCount.first : getTransactionCount() * 2;
+  logger(Logging::DEBUGGING) << "Building spent key images filter for " << expectedCount << " key images";
+
+  KeyImageFilter filter(getSpentKeyImagesFilterCapacity(expectedCount));
+  fillSpentKeyImagesFilter(filter);
+  if (filter.size() > filter.capacity()) {
+    logger(Logging::DEBUGGING) << "Rebuilding spent key images filter for " << filter.size() << " key images";
+    filter = KeyImageFilter(getSpentKeyImagesFilterCapacity(filter.size()));
+    fillSpentKeyImagesFilter(filter);
+  }
+
+  spentKeyImagesCount = filter.size();
+  spentKeyImagesFilter = std::move(filter);
+  logger(Logging::DEBUGGING) << "Spent key images filter contains " << spentKeyImagesFilter.size() << " key images, uses "
+                             << spentKeyImagesFilter.memoryUsage() << " bytes";
+
+  if (!storedCount.second || storedCount.first != spentKeyImagesCount) {
+    BlockchainWriteBatch batch;
+    batch.insertSpentKeyImagesCount(spentKeyImagesCount);
+    auto error = database.write(batch);
+    if (error) {
+      throw std::system_error(error, "Couldn't write spent key images count");
+    }
+  }
+}
+
+void DatabaseBlockchainCache::fillSpentKeyImagesFilter(KeyImageFilter& filter) const {
+  uint32_t topIndex = getTopBlockIndex();
+  for (uint32_t startIndex = 0; startIndex <= topIndex; startIndex += SPENT_KEY_IMAGES_FILTER_BLOCKS_PER_READ) {
+    uint32_t endIndex = std::min(topIndex, startIndex + SPENT_KEY_IMAGES_FILTER_BLOCKS_PER_READ - 1);
+
+    BlockchainReadBatch batch;
+    for (uint32_t blockIndex = startIndex; blockIndex <= endIndex; ++blockIndex) {
+      batch.requestSpentKeyImagesByBlock(blockIndex);
+    }
+
+    auto result = readDatabase(batch);
+    for (const auto& blockKeyImages : result.getSpentKeyImagesByBlock()) {
+      for (const auto& keyImage : blockKeyImages.second) {
+        filter.insert(keyImage);
+      }
+    }
+  }
+}
+
+void DatabaseBlockchainCache::initKeyOutputsIndex() {
+  if (keyOutputsIndex.getMemoryLimit() == 0) {
+    return;
+  }
+
+  if (!keyOutputsIndexFile.empty() && keyOutputsIndex.load(keyOutputsIndexFile, getTopBlockIndex(), getTopBlockHash())) {
+    if (checkKeyOutputsIndex()) {
+      logger(Logging::DEBUGGING) << "Key outputs index loaded from " << keyOutputsIndexFile;
+    } else {
+      logger(Logging::WARNING) << "Key outputs index file " << keyOutputsIndexFile << " doesn't match the database, rebuilding it";
+      buildKeyOutputsIndex();
+    }
+  } else {
+    buildKeyOutputsIndex();
+  }
+
+  logger(Logging::INFO) << "Key outputs of " << keyOutputsIndex.getAmounts().size() << " amounts are kept in memory, "
+                        << keyOutputsIndex.memoryUsage() / (1024 * 1024) << " MB";
+}
+
+void DatabaseBlockchainCache::buildKeyOutputsIndex() {
+  logger(Logging::DEBUGGING) << "Building key outputs index";
+  keyOutputsIndex.clear();
+
+  auto amountsCount = readDatabase(BlockchainReadBatch().requestKeyOutputAmountsCount()).getKeyOutputAmountsCount();
+  if (amountsCount == 0) {
+    return;
+  }
+
+  BlockchainReadBatch amountsBatch;
+  for (uint32_t i = 0; i < amountsCount; ++i) {
+    amountsBatch.requestKeyOutputAmount(i);
+  }
+
+  auto amountsResult = readDatabase(amountsBatch);
+  BlockchainReadBatch countsBatch;
+  for (const auto& amount : amountsResult.getKeyOutputAmounts()) {
+    countsBatch.requestKeyOutputGlobalIndexesCountForAmount(amount.second);
+  }
+
+  auto counts = readDatabase(countsBatch).getKeyOutputGlobalIndexesCountForAmounts();
+  std::vector<std::pair<Amount, uint32_t>> amounts(counts.begin(), counts.end());
+  std::sort(amounts.begin(), amounts.end(), [] (const std::pair<Amount, uint32_t>& left, const std::pair<Amount, uint32_t>& right) {
+    return left.second != right.second ? left.second > right.second : left.first < right.first;
+  });
+
+  // the amounts with the most outputs go first, smaller ones fill the rest of the limit
+  for (const auto& amount : amounts) {
+    if (amount.second == 0 || !keyOutputsIndex.canAdd(amount.second)) {
+      continue;
+    }
+
+    keyOutputsIndex.addAmount(amount.first);
+    for (uint32_t startIndex = 0; startIndex < amount.second; startIndex += KEY_OUTPUTS_INDEX_OUTPUTS_PER_READ) {
+      uint32_t endIndex = std::min(amount.second, startIndex + KEY_OUTPUTS_INDEX_OUTPUTS_PER_READ);
+
+      BlockchainReadBatch batch;
+      for (uint32_t globalIndex = startIndex; globalIndex < endIndex; ++globalIndex) {
+        batch.requestKeyOutputGlobalIndexForAmount(amount.first, globalIndex);
+        batch.requestKeyOutputInfo(amount.first, globalIndex);
+      }
+
+      auto result = readDatabase(batch);
+      const auto& packedOuts = result.getKeyOutputGlobalIndexesForAmounts();
+      const auto& outputInfos = result.getKeyOutputInfo();
+      for (uint32_t globalIndex = startIndex; globalIndex < endIndex; ++globalIndex) {
+        auto key = std::make_pair(amount.first, globalIndex);
+        auto packedOut = packedOuts.find(key);
+        auto outputInfo = outputInfos.find(key);
+        if (packedOut == packedOuts.end() || outputInfo == outputInfos.end()) {
+          logger(Logging::ERROR) << "Failed to build key outputs index: output " << globalIndex << " of amount " << amount.first << " not found";
+          throw std::runtime_error("Key output not found");
+        }
+
+        keyOutputsIndex.push(amount.first, packedOut->second, outputInfo->second.publicKey, outputInfo->second.unlockTime);
+      }
+    }
+  }
+}
+
+bool DatabaseBlockchainCache::checkKeyOutputsIndex() const {
+  auto amounts = keyOutputsIndex.getAmounts();
+  if (amounts.empty()) {
+    return true;
+  }
+
+  BlockchainReadBatch batch;
+  for (auto amount : amounts) {
+    batch.requestKeyOutputGlobalIndexesCountForAmount(amount);
+  }
+
+  auto counts = readDatabase(batch).getKeyOutputGlobalIndexesCountForAmounts();
+  for (auto amount : amounts) {
+    auto it = counts.find(amount);
+    uint32_t count = it != counts.end() ? it->second : 0;
+    if (keyOutputsIndex.getColumn(amount)->size() != count) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+void DatabaseBlockchainCache::pushKeyOutputsToIndex(const CachedTransaction& cachedTransaction, uint32_t blockIndex,
+                                                    uint16_t transactionBlockIndex) {
+  const auto& outputs = cachedTransaction.getTransaction().outputs;
+  for (size_t i = 0; i < outputs.size(); ++i) {
+    if (outputs[i].target.type() != typeid(KeyOutput)) {
+      continue;
+    }
+
+    PackedOutIndex poi;
+    poi.blockIndex = blockIndex;
+    poi.transactionIndex = transactionBlockIndex;
+    poi.outputIndex = static_cast<uint16_t>(i);
+
+    keyOutputsIndex.push(outputs[i].amount, poi, boost::get<KeyOutput>(outputs[i].target).key, cachedTransaction.getTransaction().unlockTime);
+  }
+}
+
 void DatabaseBlockchainCache::addGenesisBlock(CachedBlock&& genesisBlock) {
   uint64_t minerReward = 0;
   for (const TransactionOutput& output : genesisBlock.getBlock().baseTransaction.outputs) {
@@ -1873,7 +2440,10 @@ void DatabaseBlockchainCache::addGenesisBlock(CachedBlock&& genesisBlock) {
   pushTransaction(cachedBaseTransaction, 0, 0, batch);
 
   batch.insertCachedBlock(blockInfo, 0, {cachedBaseTransaction.getTransactionHash()});
-  batch.insertRawBlock(0, {toBinaryArray(genesisBlock.getBlock()), {}});
+  if (rawBlocksStorage == nullptr) {
+    batch.insertRawBlock(0, {toBinaryArray(genesisBlock.getBlock()), {}});
+  }
+
   batch.insertClosestTimestampBlockIndex(roundToMidnight(genesisBlock.getBlock().timestamp), 0);
 
   auto res = database.write(batch);
@@ -1884,7 +2454,7 @@ void DatabaseBlockchainCache::addGenesisBlock(CachedBlock&& genesisBlock) {
 
   topBlockHash = genesisBlock.getBlockHash();
 
-  unitsCache.push_back(blockInfo);
+  pushUnit(blockInfo);
 }
 
 }
@@ -17,6 +17,9 @@
 
 #pragma once
 
+#include <set>
+
+#include "Common/SlidingWindowMedian.h"
 #include "Common/StringView.h"
 #include "Currency.h"
 #include "Difficulty.h"
@@ -25,8 +28,12 @@
 #include <IDataBase.h>
 #include <CryptoNoteCore/BlockchainReadBatch.h>
 #include <CryptoNoteCore/BlockchainWriteBatch.h>
+#include <CryptoNoteCore/BufferedDataBase.h>
 #include <CryptoNoteCore/DatabaseCacheData.h>
 #include <CryptoNoteCore/IBlockchainCacheFactory.h>
+#include <CryptoNoteCore/IMainChainStorage.h>
+#include <CryptoNoteCore/KeyImageFilter.h>
+#include <CryptoNoteCore/KeyOutputsMemoryIndex.h>
 
 namespace CryptoNote {
 
@@ -45,11 +52,27 @@ public:
   /*
    * Constructs new DatabaseBlockchainCache object. Currnetly, only factories that produce 
    * BlockchainCache objects as children are supported.
+   * Key outputs of the most used amounts are kept in memory up to keyOutputsMemoryLimit bytes,
+   * the memory copy is saved to keyOutputsIndexFile on save() and loaded from it on the next start.
+   * If rawBlocksStorage is set, raw blocks aren't written to the database, they are read from
+   * rawBlocksStorage by the transaction locators instead. The storage must get every block before the cache.
    */
   DatabaseBlockchainCache(const Currency& currency, IDataBase& dataBase,
-                          IBlockchainCacheFactory& blockchainCacheFactory, Logging::ILogger& logger);
+                          IBlockchainCacheFactory& blockchainCacheFactory, Logging::ILogger& logger,
+                          const std::string& keyOutputsIndexFile = std::string(), uint64_t keyOutputsMemoryLimit = 0,
+                          const IMainChainStorage* rawBlocksStorage = nullptr);
 
   static bool checkDBSchemeVersion(IDataBase& dataBase, Logging::ILogger& logger);
+  // Returns false if the DB keeps its raw blocks elsewhere than requested, such a DB has to be recreated
+  static bool checkRawBlocksLocation(IDataBase& dataBase, Logging::ILogger& logger, bool rawBlocksInMainChainStorage);
+  // Converts a DB of an older scheme in place, returns false if its scheme can't be converted
+  static bool migrateDBScheme(IDataBase& dataBase, Logging::ILogger& logger);
+
+  // Read key outputs from the given DB only, so they also work with a DB snapshot on another thread
+  static std::vector<uint32_t> requestRandomOutsByAmount(const Currency& currency, IDataBase& dataBase, uint64_t amount, size_t count,
+                                                         uint32_t blockIndex, uint32_t startBlockIndex);
+  static ExtractOutputKeysResult requestKeyOutputKeys(const Currency& currency, IDataBase& dataBase, uint64_t amount, uint32_t blockIndex,
+                                                      Common::ArrayView<uint32_t> globalIndexes, std::vector<Crypto::PublicKey>& publicKeys);
 
   /*
    * This methods splits cache, upper part (ie blocks with indexes larger than splitBlockIndex)
@@ -77,6 +100,7 @@ ExtractOutputKeysResult extractTransactionPublicKeys(uint64_t amount, uint32_t b
   ExtractOutputKeysResult extractKeyOutputKeys(uint64_t amount, uint32_t blockIndex,
                                                Common::ArrayView<uint32_t> globalIndexes,
                                                std::vector<Crypto::PublicKey>& publicKeys) const override;
+  std::vector<KeyOutputKeysResult> extractKeyOutputKeys(uint32_t blockIndex, const std::vector<KeyOutputKeysRequest>& requests) const override;
 
   ExtractOutputKeysResult extractKeyOtputIndexes(uint64_t amount, Common::ArrayView<uint32_t> globalIndexes,
                                                  std::vector<PackedOutIndex>& outIndexes) const override;
@@ -97,6 +121,8 @@ ExtractOutputKeysResult extractTransactionPublicKeys(uint64_t amount, uint32_t b
 
   std::vector<uint64_t> getLastBlocksSizes(size_t count) const override;
   std::vector<uint64_t> getLastBlocksSizes(size_t count, uint32_t blockIndex, UseGenesis) const override;
+  uint64_t getLastBlocksSizesMedian(size_t count) const override;
+  uint64_t getLastBlocksSizesMedian(size_t count, uint32_t blockIndex, UseGenesis) const override;
 
   std::vector<Difficulty> getLastCumulativeDifficulties(size_t count, uint32_t blockIndex, UseGenesis) const override;
   std::vector<Difficulty> getLastCumulativeDifficulties(size_t count) const override;
@@ -144,6 +170,8 @@ ExtractOutputKeysResult extractTransactionPublicKeys(uint64_t amount, uint32_t b
 
   virtual void save() override;
   virtual void load() override;
+  virtual void startPushBatch() override;
+  virtual void commitPushBatch() override;
 
   virtual std::vector<BinaryArray> getRawTransactions(const std::vector<Crypto::Hash>& transactions,
                                                       std::vector<Crypto::Hash>& missedTransactions) const override;
@@ -151,6 +179,8 @@ ExtractOutputKeysResult extractTransactionPublicKeys(uint64_t amount, uint32_t b
   void getRawTransactions(const std::vector<Crypto::Hash>& transactions, std::vector<BinaryArray>& foundTransactions,
                           std::vector<Crypto::Hash>& missedTransactions) const override;
   virtual RawBlock getBlockByIndex(uint32_t index) const override;
+  virtual bool keepsRawBlocks() const override;
+  virtual std::shared_ptr<IDataBase> createDatabaseSnapshot() override;
   virtual BinaryArray getRawTransaction(uint32_t blockIndex, uint32_t transactionIndex) const override;
   virtual std::vector<Crypto::Hash> getTransactionHashes() const override;
   virtual std::vector<uint32_t> getRandomOutsByAmount(uint64_t amount, size_t count, uint32_t blockIndex, uint32_t startBlockIndex) const override;
@@ -167,17 +197,24 @@ virtual std::vector<Crypto::KeyImage> getInputsByOutputKey(const Crypto::PublicK
 
 private:
   const Currency& currency;
+  BufferedDataBase bufferedDatabase;
   IDataBase& database;
   IBlockchainCacheFactory& blockchainCacheFactory;
   mutable boost::optional<uint32_t> topBlockIndex;
   mutable boost::optional<Crypto::Hash> topBlockHash;
   mutable boost::optional<uint64_t> transactionsCount;
+  uint64_t spentKeyImagesCount;
   mutable boost::optional<uint32_t> keyOutputAmountsCount;
   mutable std::unordered_map<Amount, int32_t> keyOutputCountsForAmounts;
   std::vector<IBlockchainCache*> children;
   Logging::LoggerRef logger;
   std::deque<CachedBlockInfo> unitsCache;
   const size_t unitsCacheSize = 1000;
+  Common::SlidingWindowMedian<uint64_t> blockSizesMedian;
+  KeyImageFilter spentKeyImagesFilter;
+  std::string keyOutputsIndexFile;
+  KeyOutputsMemoryIndex keyOutputsIndex;
+  const IMainChainStorage* rawBlocksStorage;
 
   struct ExtendedPushedBlockInfo;
   ExtendedPushedBlockInfo getExtendedPushedBlockInfo(uint32_t blockIndex) const;
@@ -185,8 +222,21 @@ private:
   void deleteClosestTimestampBlockIndex(BlockchainWriteBatch& writeBatch, uint32_t splitBlockIndex);
   CachedBlockInfo getCachedBlockInfo(uint32_t index) const;
   BlockchainReadResult readDatabase(BlockchainReadBatch& batch) const;
+  bool requestRawBlock(uint32_t blockIndex, RawBlock& block) const;
+  std::unordered_map<uint32_t, RawBlock> requestRawBlocks(const std::set<uint32_t>& blockIndexes) const;
+  bool requestPaymentId(const Crypto::Hash& transactionHash, Crypto::Hash& paymentId) const;
 
   void addSpentKeyImage(const Crypto::KeyImage& keyImage, uint32_t blockIndex);
+  void buildSpentKeyImagesFilter();
+  void fillSpentKeyImagesFilter(KeyImageFilter& filter) const;
+  void initKeyOutputsIndex();
+  void buildKeyOutputsIndex();
+  bool checkKeyOutputsIndex() const;
+  void pushKeyOutputsToIndex(const CachedTransaction& cachedTransaction, uint32_t blockIndex, uint16_t transactionBlockIndex);
+  ExtractOutputKeysResult extractKeyOutputKeys(const KeyOutputsColumn& column, uint32_t blockIndex, const std::set<uint32_t>& globalIndexes,
+                                               std::vector<Crypto::PublicKey>& publicKeys) const;
+  void fillUnitsCache();
+  void pushUnit(const CachedBlockInfo& blockInfo);
   void pushTransaction(const CachedTransaction& cachedTransaction,
                        uint32_t blockIndex,
                        uint16_t transactionBlockIndex,
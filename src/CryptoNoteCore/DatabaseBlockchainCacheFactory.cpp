@@ -24,7 +24,11 @@
 
 namespace CryptoNote {
 
-DatabaseBlockchainCacheFactory::DatabaseBlockchainCacheFactory(IDataBase& database, Logging::ILogger& logger): database(database), logger(logger) {
+DatabaseBlockchainCacheFactory::DatabaseBlockchainCacheFactory(IDataBase& database, Logging::ILogger& logger,
+                                                               const std::string& keyOutputsIndexFile, uint64_t keyOutputsMemoryLimit,
+                                                               const IMainChainStorage* rawBlocksStorage)
+    : database(database), logger(logger), keyOutputsIndexFile(keyOutputsIndexFile), keyOutputsMemoryLimit(keyOutputsMemoryLimit),
+      rawBlocksStorage(rawBlocksStorage) {
 
 }
 
@@ -33,7 +37,8 @@ DatabaseBlockchainCacheFactory::~DatabaseBlockchainCacheFactory() {
 }
 
 std::unique_ptr<IBlockchainCache> DatabaseBlockchainCacheFactory::createRootBlockchainCache(const Currency& currency) {
-  return std::unique_ptr<IBlockchainCache> (new DatabaseBlockchainCache(currency, database, *this, logger));
+  return std::unique_ptr<IBlockchainCache> (new DatabaseBlockchainCache(currency, database, *this, logger, keyOutputsIndexFile, keyOutputsMemoryLimit,
+                                                                              rawBlocksStorage));
 }
 
 std::unique_ptr<IBlockchainCache> DatabaseBlockchainCacheFactory::createBlockchainCache(const Currency& currency, IBlockchainCache* parent, uint32_t startIndex) {
@@ -17,16 +17,21 @@
 
 #pragma once
 
+#include <string>
+
 #include "IBlockchainCacheFactory.h"
 #include <Logging/LoggerMessage.h>
 
 namespace CryptoNote {
 
 class IDataBase;
+class IMainChainStorage;
 
 class DatabaseBlockchainCacheFactory: public IBlockchainCacheFactory {
 public:
-  explicit DatabaseBlockchainCacheFactory(IDataBase& database, Logging::ILogger& logger);
+  explicit DatabaseBlockchainCacheFactory(IDataBase& database, Logging::ILogger& logger,
+                                          const std::string& keyOutputsIndexFile = std::string(), uint64_t keyOutputsMemoryLimit = 0,
+                                          const IMainChainStorage* rawBlocksStorage = nullptr);
   virtual ~DatabaseBlockchainCacheFactory();
 
   virtual std::unique_ptr<IBlockchainCache> createRootBlockchainCache(const Currency& currency) override;
@@ -35,6 +40,9 @@ public:
 private:
   IDataBase& database;
   Logging::ILogger& logger;
+  std::string keyOutputsIndexFile;
+  uint64_t keyOutputsMemoryLimit;
+  const IMainChainStorage* rawBlocksStorage;
 };
 
 } //namespace CryptoNote
@@ -0,0 +1,206 @@
+// Copyright (c) 2012-2017, The CryptoNote developers, The Bytecoin developers
+//
+// This file is part of Bytecoin.
+//
+// Bytecoin is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Bytecoin is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with Bytecoin.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "DatabaseSchemeMigrator.h"
+
+#include <functional>
+#include <system_error>
+
+#include "Common/MemoryInputStream.h"
+#include "Serialization/KVBinaryInputStreamSerializer.h"
+
+#include "BlockchainCache.h"
+#include "DatabaseCacheData.h"
+#include "DBUtils.h"
+
+using namespace CryptoNote;
+
+namespace {
+
+const std::string LEGACY_INPUT_KEYS_BY_OUTPUT_KEY = "input-keys-output-key";
+
+// every KV-binary record starts with the storage signature, records of newer schemes never do
+const char KV_BINARY_SIGNATURE_BYTE = 0x01;
+
+const size_t RECORDS_PER_BATCH = 10000;
+
+class MigrationWriteBatch : public IWriteBatch {
+public:
+  MigrationWriteBatch(std::vector<std::pair<std::string, std::string>>& rawData, std::vector<std::string>& rawKeys) :
+    rawData(rawData), rawKeys(rawKeys) {
+  }
+
+  virtual std::vector<std::pair<std::string, std::string>> extractRawDataToInsert() override {
+    return std::move(rawData);
+  }
+
+  virtual std::vector<std::string> extractRawKeysToRemove() override {
+    return std::move(rawKeys);
+  }
+
+private:
+  std::vector<std::pair<std::string, std::string>>& rawData;
+  std::vector<std::string>& rawKeys;
+};
+
+template <class Value>
+void deserializeKVBinary(const std::string& serialized, Value& value, const std::string& name) {
+  Common::MemoryInputStream stream(serialized.data(), serialized.size());
+  KVBinaryInputStreamSerializer serializer(stream);
+  serializer(value, name);
+}
+
+template <class Value>
+void deserializeLegacyValue(const std::string& serialized, Value& value, const std::string& name) {
+  deserializeKVBinary(serialized, value, name);
+}
+
+// raw blocks have always been stored in binary format
+void deserializeLegacyValue(const std::string& serialized, RawBlock& value, const std::string& name) {
+  DB::deserialize(serialized, value, name);
+}
+
+using RecordConverter = std::function<bool(const std::string& key, const std::string& value, std::pair<std::string, std::string>& record)>;
+
+template <class Key, class Value>
+RecordConverter makeConverter(const std::string& legacyPrefix, const std::string& prefix) {
+  return [legacyPrefix, prefix] (const std::string& key, const std::string& value, std::pair<std::string, std::string>& record) {
+    std::pair<std::string, Key> legacyKey;
+    try {
+      deserializeKVBinary(key, legacyKey, legacyPrefix);
+    } catch (std::exception&) {
+      return false;
+    }
+
+    if (legacyKey.first != legacyPrefix) {
+      return false;
+    }
+
+    Value legacyValue;
+    deserializeLegacyValue(value, legacyValue, legacyPrefix);
+    record = DB::serialize(prefix, legacyKey.second, legacyValue);
+    return true;
+  };
+}
+
+template <class Key, class Value>
+RecordConverter makeConverter(const std::string& prefix) {
+  return makeConverter<Key, Value>(prefix, prefix);
+}
+
+// Converters of every record kind, kinds sharing a prefix are told apart by the key type.
+// Hash keys must be tried before string keys since a hash is read as a string as well.
+const std::vector<RecordConverter>& getRecordConverters() {
+  static const std::vector<RecordConverter> converters {
+    makeConverter<uint32_t, std::vector<Crypto::KeyImage>>(DB::BLOCK_INDEX_TO_KEY_IMAGE_PREFIX),
+    makeConverter<uint32_t, std::vector<Crypto::Hash>>(DB::BLOCK_INDEX_TO_TX_HASHES_PREFIX),
+    makeConverter<uint32_t, RawBlock>(DB::BLOCK_INDEX_TO_RAW_BLOCK_PREFIX),
+    makeConverter<Crypto::Hash, uint32_t>(DB::BLOCK_HASH_TO_BLOCK_INDEX_PREFIX),
+    makeConverter<uint32_t, CachedBlockInfo>(DB::BLOCK_INDEX_TO_BLOCK_INFO_PREFIX),
+    makeConverter<Crypto::KeyImage, uint32_t>(DB::KEY_IMAGE_TO_BLOCK_INDEX_PREFIX),
+    makeConverter<std::string, uint32_t>(DB::BLOCK_INDEX_TO_BLOCK_HASH_PREFIX),
+    makeConverter<Crypto::Hash, ExtendedTransactionInfo>(DB::TRANSACTION_HASH_TO_TRANSACTION_INFO_PREFIX),
+    makeConverter<std::string, uint64_t>(DB::TRANSACTION_HASH_TO_TRANSACTION_INFO_PREFIX),
+    makeConverter<IBlockchainCache::Amount, uint32_t>(DB::KEY_OUTPUT_AMOUNT_PREFIX),
+    makeConverter<std::pair<IBlockchainCache::Amount, uint32_t>, PackedOutIndex>(DB::KEY_OUTPUT_AMOUNT_PREFIX),
+    makeConverter<uint64_t, uint32_t>(DB::CLOSEST_TIMESTAMP_BLOCK_INDEX_PREFIX),
+    makeConverter<Crypto::Hash, uint32_t>(DB::PAYMENT_ID_TO_TX_HASH_PREFIX),
+    makeConverter<std::pair<Crypto::Hash, uint32_t>, Crypto::Hash>(DB::PAYMENT_ID_TO_TX_HASH_PREFIX),
+    makeConverter<uint64_t, std::vector<Crypto::Hash>>(DB::TIMESTAMP_TO_BLOCKHASHES_PREFIX),
+    makeConverter<uint32_t, IBlockchainCache::Amount>(DB::KEY_OUTPUT_AMOUNTS_COUNT_PREFIX),
+    makeConverter<std::string, uint32_t>(DB::KEY_OUTPUT_AMOUNTS_COUNT_PREFIX),
+    makeConverter<std::pair<IBlockchainCache::Amount, IBlockchainCache::GlobalOutputIndex>, KeyOutputInfo>(DB::KEY_OUTPUT_KEY_PREFIX),
+    makeConverter<Crypto::PublicKey, uint32_t>(LEGACY_INPUT_KEYS_BY_OUTPUT_KEY, DB::INPUT_KEYS_BY_OUTPUT_KEY),
+    makeConverter<std::pair<Crypto::PublicKey, uint32_t>, Crypto::KeyImage>(LEGACY_INPUT_KEYS_BY_OUTPUT_KEY, DB::INPUT_KEYS_BY_OUTPUT_KEY)
+  };
+
+  return converters;
+}
+
+}
+
+DatabaseSchemeMigrator::DatabaseSchemeMigrator(IDataBase& database, Logging::ILogger& logger) :
+  database(database), logger(logger, "DatabaseSchemeMigrator"), convertedCount(0), skippedCount(0) {
+}
+
+void DatabaseSchemeMigrator::convertKVBinaryRecords() {
+  logger(Logging::INFO) << "Converting DB records to fixed-width keys, this can take a while...";
+
+  std::string startKey(1, KV_BINARY_SIGNATURE_BYTE);
+  bool finished = false;
+  while (!finished) {
+    finished = true;
+    auto ec = database.iterate(startKey, [&] (const std::string& key, const std::string& value) {
+      if (key.empty() || key[0] != KV_BINARY_SIGNATURE_BYTE) {
+        return false;
+      }
+
+      convertKVBinaryRecord(key, value);
+      if (convertedKeys.size() < RECORDS_PER_BATCH) {
+        return true;
+      }
+
+      // skipped records stay in place, so continue after the last seen key
+      startKey = key;
+      startKey.push_back('\0');
+      finished = false;
+      return false;
+    });
+
+    if (ec) {
+      throw std::system_error(ec);
+    }
+
+    flush();
+  }
+
+  logger(Logging::INFO) << "DB records converted: " << convertedCount;
+  if (skippedCount != 0) {
+    logger(Logging::WARNING) << "Unknown DB records skipped: " << skippedCount;
+  }
+}
+
+void DatabaseSchemeMigrator::convertKVBinaryRecord(const std::string& key, const std::string& value) {
+  std::pair<std::string, std::string> record;
+  for (const RecordConverter& converter : getRecordConverters()) {
+    if (converter(key, value, record)) {
+      convertedRecords.emplace_back(std::move(record));
+      convertedKeys.push_back(key);
+      return;
+    }
+  }
+
+  ++skippedCount;
+}
+
+void DatabaseSchemeMigrator::flush() {
+  if (convertedKeys.empty()) {
+    return;
+  }
+
+  size_t count = convertedKeys.size();
+  MigrationWriteBatch batch(convertedRecords, convertedKeys);
+  auto ec = database.write(batch);
+  if (ec) {
+    throw std::system_error(ec);
+  }
+
+  convertedRecords.clear();
+  convertedKeys.clear();
+  convertedCount += count;
+  logger(Logging::DEBUGGING) << "DB records converted: " << convertedCount;
+}
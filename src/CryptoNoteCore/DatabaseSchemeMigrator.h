@@ -0,0 +1,51 @@
+// Copyright (c) 2012-2017, The CryptoNote developers, The Bytecoin developers
+//
+// This file is part of Bytecoin.
+//
+// Bytecoin is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Bytecoin is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with Bytecoin.  If not, see <http://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include "IDataBase.h"
+#include "Logging/LoggerRef.h"
+
+namespace CryptoNote {
+
+// Converts DB records in place, the DB must not be used by anybody else meanwhile
+class DatabaseSchemeMigrator {
+public:
+  DatabaseSchemeMigrator(IDataBase& database, Logging::ILogger& logger);
+
+  // Rewrites records with KV-binary keys and values (scheme 2) to fixed-width keys and binary values.
+  // Records are converted in batches, so an interrupted conversion can be resumed.
+  void convertKVBinaryRecords();
+
+private:
+  void convertKVBinaryRecord(const std::string& key, const std::string& value);
+  void flush();
+
+  IDataBase& database;
+  Logging::LoggerRef logger;
+
+  std::vector<std::pair<std::string, std::string>> convertedRecords;
+  std::vector<std::string> convertedKeys;
+  size_t convertedCount;
+  size_t skippedCount;
+};
+
+}
@@ -0,0 +1,313 @@
+// Copyright (c) 2012-2017, The CryptoNote developers, The Bytecoin developers
+//
+// This file is part of Bytecoin.
+//
+// Bytecoin is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Bytecoin is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with Bytecoin.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "FlatMainChainStorage.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <iomanip>
+#include <sstream>
+
+#include <boost/filesystem.hpp>
+
+#include "CryptoNoteTools.h"
+#include "Logging/LoggerRef.h"
+#include "MainChainStorage.h"
+
+namespace CryptoNote {
+
+namespace {
+
+const unsigned SEGMENT_OFFSET_BITS = 40;
+const uint64_t SEGMENT_OFFSET_MASK = (UINT64_C(1) << SEGMENT_OFFSET_BITS) - 1;
+const uint32_t CONVERSION_PROGRESS_BLOCKS = 10000;
+
+uint64_t getSegment(uint64_t offset) {
+  return offset >> SEGMENT_OFFSET_BITS;
+}
+
+uint64_t getSegmentOffset(uint64_t offset) {
+  return offset & SEGMENT_OFFSET_MASK;
+}
+
+uint32_t readUint32(const uint8_t* data) {
+  uint32_t value;
+  std::memcpy(&value, data, sizeof(value));
+  return value;
+}
+
+void writeUint32(uint8_t*& data, uint32_t value) {
+  std::memcpy(data, &value, sizeof(value));
+  data += sizeof(value);
+}
+
+void writeBytes(uint8_t*& data, const BinaryArray& bytes) {
+  if (!bytes.empty()) {
+    std::memcpy(data, bytes.data(), bytes.size());
+    data += bytes.size();
+  }
+}
+
+// Block record: block size, transactions count, transaction sizes, block, transactions
+uint64_t getRecordSize(const RawBlock& rawBlock) {
+  uint64_t size = 2 * sizeof(uint32_t) + rawBlock.block.size();
+  for (const auto& transaction : rawBlock.transactions) {
+    size += sizeof(uint32_t) + transaction.size();
+  }
+
+  return size;
+}
+
+RawBlockView parseRecord(const uint8_t* data, uint64_t size) {
+  if (size < 2 * sizeof(uint32_t)) {
+    throw std::runtime_error("Corrupted block record");
+  }
+
+  uint32_t blockSize = readUint32(data);
+  uint32_t transactionsCount = readUint32(data + sizeof(uint32_t));
+  uint64_t headerSize = (2 + static_cast<uint64_t>(transactionsCount)) * sizeof(uint32_t);
+  if (headerSize > size) {
+    throw std::runtime_error("Corrupted block record");
+  }
+
+  RawBlockView view;
+  const uint8_t* part = data + headerSize;
+  const uint8_t* end = data + size;
+  if (blockSize > static_cast<uint64_t>(end - part)) {
+    throw std::runtime_error("Corrupted block record");
+  }
+
+  view.block = Common::ArrayView<uint8_t>(part, blockSize);
+  part += blockSize;
+
+  view.transactions.reserve(transactionsCount);
+  for (uint32_t i = 0; i < transactionsCount; ++i) {
+    uint32_t transactionSize = readUint32(data + (2 + i) * sizeof(uint32_t));
+    if (transactionSize > static_cast<uint64_t>(end - part)) {
+      throw std::runtime_error("Corrupted block record");
+    }
+
+    view.transactions.emplace_back(part, transactionSize);
+    part += transactionSize;
+  }
+
+  return view;
+}
+
+RawBlock toRawBlock(const RawBlockView& view) {
+  RawBlock rawBlock;
+  rawBlock.block.assign(view.block.getData(), view.block.getData() + view.block.getSize());
+  rawBlock.transactions.reserve(view.transactions.size());
+  for (const auto& transaction : view.transactions) {
+    rawBlock.transactions.emplace_back(transaction.getData(), transaction.getData() + transaction.getSize());
+  }
+
+  return rawBlock;
+}
+
+}
+
+const uint64_t FlatMainChainStorage::DEFAULT_SEGMENT_SIZE;
+
+FlatMainChainStorage::FlatMainChainStorage(const std::string& segmentsFilename, const std::string& offsetsFilename, uint64_t segmentSize)
+    : segmentsFilename(segmentsFilename), segmentSize(segmentSize) {
+  offsets.open(offsetsFilename);
+  // the segments are written without flushing as well, the data reaches the disk with the page cache
+  offsets.setAutoFlush(false);
+
+  if (!offsets.empty()) {
+    for (uint64_t segment = 0; segment <= getSegment(offsets.back()); ++segment) {
+      openSegment(segment);
+    }
+  }
+}
+
+FlatMainChainStorage::~FlatMainChainStorage() {
+  std::error_code ignore;
+  for (auto& segment : segments) {
+    segment->flush(segment->data(), segment->size(), ignore);
+  }
+
+  offsets.flush();
+}
+
+void FlatMainChainStorage::pushBlock(const RawBlock& rawBlock) {
+  uint64_t recordSize = getRecordSize(rawBlock);
+
+  uint64_t segment = 0;
+  uint64_t segmentOffset = 0;
+  if (!offsets.empty()) {
+    segment = getSegment(offsets.back());
+    segmentOffset = getSegmentOffset(offsets.back());
+    if (segmentOffset + recordSize > segments[segment]->size()) {
+      ++segment;
+      segmentOffset = 0;
+    }
+  }
+
+  if (segment >= segments.size()) {
+    createSegment(segment, std::max(segmentSize, recordSize));
+  } else if (segmentOffset + recordSize > segments[segment]->size()) {
+    // a segment left from popped blocks can be too small for a large block
+    createSegment(segment, std::max(segmentSize, recordSize));
+  }
+
+  uint8_t* data = segments[segment]->data() + segmentOffset;
+  writeUint32(data, static_cast<uint32_t>(rawBlock.block.size()));
+  writeUint32(data, static_cast<uint32_t>(rawBlock.transactions.size()));
+  for (const auto& transaction : rawBlock.transactions) {
+    writeUint32(data, static_cast<uint32_t>(transaction.size()));
+  }
+
+  writeBytes(data, rawBlock.block);
+  for (const auto& transaction : rawBlock.transactions) {
+    writeBytes(data, transaction);
+  }
+
+  offsets.push_back((segment << SEGMENT_OFFSET_BITS) | (segmentOffset + recordSize));
+}
+
+void FlatMainChainStorage::popBlock() {
+  offsets.pop_back();
+}
+
+RawBlock FlatMainChainStorage::getBlockByIndex(uint32_t index) const {
+  return toRawBlock(getBlockView(index));
+}
+
+uint32_t FlatMainChainStorage::getBlockCount() const {
+  return static_cast<uint32_t>(offsets.size());
+}
+
+std::vector<RawBlock> FlatMainChainStorage::getBlocks(uint32_t startIndex, uint32_t count) const {
+  std::vector<RawBlock> blocks;
+  if (startIndex >= getBlockCount()) {
+    return blocks;
+  }
+
+  uint32_t endIndex = startIndex + std::min(count, getBlockCount() - startIndex);
+  blocks.reserve(endIndex - startIndex);
+  for (uint32_t index = startIndex; index < endIndex; ++index) {
+    blocks.push_back(toRawBlock(getBlockView(index)));
+  }
+
+  return blocks;
+}
+
+void FlatMainChainStorage::clear() {
+  offsets.clear();
+  segments.clear();
+}
+
+RawBlockView FlatMainChainStorage::getBlockView(uint32_t index) const {
+  if (index >= offsets.size()) {
+    throw std::out_of_range("Block index " + std::to_string(index) + " is out of range. Blocks count: " + std::to_string(offsets.size()));
+  }
+
+  uint64_t size;
+  const uint8_t* data = getBlockData(index, size);
+  return parseRecord(data, size);
+}
+
+std::string FlatMainChainStorage::getSegmentFilename(uint64_t segment) const {
+  std::ostringstream filename;
+  filename << segmentsFilename << '.' << std::setw(5) << std::setfill('0') << segment;
+  return filename.str();
+}
+
+void FlatMainChainStorage::openSegment(uint64_t segment) {
+  assert(segment == segments.size());
+
+  std::unique_ptr<System::MemoryMappedFile> file(new System::MemoryMappedFile());
+  file->open(getSegmentFilename(segment));
+  segments.push_back(std::move(file));
+}
+
+void FlatMainChainStorage::createSegment(uint64_t segment, uint64_t size) {
+  assert(segment <= segments.size());
+
+  std::unique_ptr<System::MemoryMappedFile> file(new System::MemoryMappedFile());
+  file->create(getSegmentFilename(segment), size, true);
+  if (segment == segments.size()) {
+    segments.push_back(std::move(file));
+  } else {
+    segments[segment] = std::move(file);
+  }
+}
+
+const uint8_t* FlatMainChainStorage::getBlockData(uint32_t index, uint64_t& size) const {
+  uint64_t end = offsets[index];
+  uint64_t segment = getSegment(end);
+  uint64_t start = 0;
+  if (index > 0 && getSegment(offsets[index - 1]) == segment) {
+    start = getSegmentOffset(offsets[index - 1]);
+  }
+
+  if (segment >= segments.size() || getSegmentOffset(end) > segments[segment]->size() || start > getSegmentOffset(end)) {
+    throw std::runtime_error("Corrupted block offsets index");
+  }
+
+  size = getSegmentOffset(end) - start;
+  return segments[segment]->data() + start;
+}
+
+std::unique_ptr<IMainChainStorage> createFlatMainChainStorage(const std::string& dataDir, const Currency& currency, Logging::ILogger& logger) {
+  Logging::LoggerRef log(logger, "FlatMainChainStorage");
+
+  boost::filesystem::path segmentsFilename = boost::filesystem::path(dataDir) / currency.blockSegmentsFileName();
+  boost::filesystem::path offsetsFilename = boost::filesystem::path(dataDir) / currency.blockOffsetsFileName();
+  boost::filesystem::path blocksFilename = boost::filesystem::path(dataDir) / currency.blocksFileName();
+  boost::filesystem::path indexesFilename = boost::filesystem::path(dataDir) / currency.blockIndexesFileName();
+
+  if (!boost::filesystem::exists(offsetsFilename) && boost::filesystem::exists(blocksFilename) && boost::filesystem::exists(indexesFilename)) {
+    // the offsets index appears only after all blocks are copied, an interrupted conversion starts over
+    std::string temporaryOffsetsFilename = offsetsFilename.string() + ".tmp";
+    boost::filesystem::remove(temporaryOffsetsFilename);
+    boost::filesystem::remove(temporaryOffsetsFilename + ".bak");
+
+    {
+      MainChainStorage swappedStorage(blocksFilename.string(), indexesFilename.string());
+      FlatMainChainStorage flatStorage(segmentsFilename.string(), temporaryOffsetsFilename);
+      uint32_t blockCount = swappedStorage.getBlockCount();
+      log(Logging::INFO) << "Converting " << blockCount << " blocks of " << blocksFilename.string() << " to the flat block storage";
+
+      for (uint32_t index = 0; index < blockCount; ++index) {
+        flatStorage.pushBlock(swappedStorage.getBlockByIndex(index));
+        if ((index + 1) % CONVERSION_PROGRESS_BLOCKS == 0) {
+          log(Logging::INFO) << "Converted " << (index + 1) << " / " << blockCount << " blocks";
+        }
+      }
+    }
+
+    boost::filesystem::rename(temporaryOffsetsFilename, offsetsFilename);
+    boost::filesystem::remove(blocksFilename);
+    boost::filesystem::remove(indexesFilename);
+    log(Logging::INFO) << "Block storage conversion completed";
+  }
+
+  std::unique_ptr<IMainChainStorage> storage(new FlatMainChainStorage(segmentsFilename.string(), offsetsFilename.string()));
+  if (storage->getBlockCount() == 0) {
+    RawBlock genesis;
+    genesis.block = toBinaryArray(currency.genesisBlock());
+    storage->pushBlock(genesis);
+  }
+
+  return storage;
+}
+
+}
@@ -0,0 +1,73 @@
+// Copyright (c) 2012-2017, The CryptoNote developers, The Bytecoin developers
+//
+// This file is part of Bytecoin.
+//
+// Bytecoin is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Bytecoin is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with Bytecoin.  If not, see <http://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "Common/ArrayView.h"
+#include "Common/FileMappedVector.h"
+#include "IMainChainStorage.h"
+#include "Currency.h"
+#include "Logging/ILogger.h"
+#include "System/MemoryMappedFile.h"
+
+namespace CryptoNote {
+
+// Raw block parts pointing into the mapped storage, valid until the block is popped or the storage is cleared
+struct RawBlockView {
+  Common::ArrayView<uint8_t> block;
+  std::vector<Common::ArrayView<uint8_t>> transactions;
+};
+
+// Blocks are appended to preallocated memory mapped segment files, each block is a header with part sizes followed by the parts.
+// The FileMappedVector index keeps the end offset of every block, the segment number is kept in the offset's high bits.
+class FlatMainChainStorage: public IMainChainStorage {
+public:
+  static const uint64_t DEFAULT_SEGMENT_SIZE = 256 * 1024 * 1024;
+
+  FlatMainChainStorage(const std::string& segmentsFilename, const std::string& offsetsFilename, uint64_t segmentSize = DEFAULT_SEGMENT_SIZE);
+  virtual ~FlatMainChainStorage();
+
+  virtual void pushBlock(const RawBlock& rawBlock) override;
+  virtual void popBlock() override;
+
+  virtual RawBlock getBlockByIndex(uint32_t index) const override;
+  virtual uint32_t getBlockCount() const override;
+  virtual std::vector<RawBlock> getBlocks(uint32_t startIndex, uint32_t count) const override;
+
+  virtual void clear() override;
+
+  RawBlockView getBlockView(uint32_t index) const;
+
+private:
+  std::string getSegmentFilename(uint64_t segment) const;
+  void openSegment(uint64_t segment);
+  void createSegment(uint64_t segment, uint64_t size);
+  const uint8_t* getBlockData(uint32_t index, uint64_t& size) const;
+
+  std::string segmentsFilename;
+  uint64_t segmentSize;
+  Common::FileMappedVector<uint64_t> offsets;
+  std::vector<std::unique_ptr<System::MemoryMappedFile>> segments;
+};
+
+std::unique_ptr<IMainChainStorage> createFlatMainChainStorage(const std::string& dataDir, const Currency& currency, Logging::ILogger& logger);
+
+}
@@ -17,6 +17,7 @@
 
 #pragma once
 
+#include <memory>
 #include <vector>
 
 #include <CryptoNote.h>
@@ -30,6 +31,7 @@
 
 namespace CryptoNote {
 
+class IDataBase;
 class ISerializer;
 struct TransactionValidatorState;
 
@@ -49,6 +51,17 @@ union PackedOutIndex {
   uint64_t packedValue;
 };
 
+// Output references of one key input
+struct KeyOutputKeysRequest {
+  uint64_t amount;
+  std::vector<uint32_t> globalIndexes;
+};
+
+struct KeyOutputKeysResult {
+  ExtractOutputKeysResult result;
+  std::vector<Crypto::PublicKey> publicKeys;
+};
+
 const uint32_t INVALID_BLOCK_INDEX = std::numeric_limits<uint32_t>::max();
 
 struct PushedBlockInfo {
@@ -85,6 +98,10 @@ public:
 
   virtual RawBlock getBlockByIndex(uint32_t index) const = 0;
   virtual BinaryArray getRawTransaction(uint32_t blockIndex, uint32_t transactionIndex) const = 0;
+  // False if the segment reads raw blocks from the main chain storage, it can't be split above the storage top then
+  virtual bool keepsRawBlocks() const = 0;
+  // Snapshot of the database the segment is stored in, null for segments kept in memory
+  virtual std::shared_ptr<IDataBase> createDatabaseSnapshot() = 0;
   virtual std::unique_ptr<IBlockchainCache> split(uint32_t splitBlockIndex) = 0;
   virtual void pushBlock(
       const CachedBlock& cachedBlock,
@@ -105,6 +122,8 @@ virtual ExtractOutputKeysResult extractTransactionPublicKeys(uint64_t amount, Co
 virtual ExtractOutputKeysResult extractTransactionPublicKeys(uint64_t amount, uint32_t blockIndex, Common::ArrayView<uint32_t> globalIndexes, std::vector<Crypto::PublicKey>& publicKeys) const = 0;
   virtual ExtractOutputKeysResult extractKeyOutputKeys(uint64_t amount, Common::ArrayView<uint32_t> globalIndexes, std::vector<Crypto::PublicKey>& publicKeys) const = 0;
   virtual ExtractOutputKeysResult extractKeyOutputKeys(uint64_t amount, uint32_t blockIndex, Common::ArrayView<uint32_t> globalIndexes, std::vector<Crypto::PublicKey>& publicKeys) const = 0;
+  // Resolves the inputs of a whole block at once, results are in the order of requests
+  virtual std::vector<KeyOutputKeysResult> extractKeyOutputKeys(uint32_t blockIndex, const std::vector<KeyOutputKeysRequest>& requests) const = 0;
 
   virtual ExtractOutputKeysResult extractKeyOtputIndexes(uint64_t amount, Common::ArrayView<uint32_t> globalIndexes, std::vector<PackedOutIndex>& outIndexes) const = 0;
   virtual ExtractOutputKeysResult extractKeyOtputReferences(uint64_t amount, Common::ArrayView<uint32_t> globalIndexes, std::vector<std::pair<Crypto::Hash, size_t>>& outputReferences) const = 0;
@@ -126,6 +145,9 @@ virtual ExtractOutputKeysResult extractTransactionPublicKeys(uint64_t amount, ui
 
   virtual std::vector<uint64_t> getLastBlocksSizes(size_t count) const = 0;
   virtual std::vector<uint64_t> getLastBlocksSizes(size_t count, uint32_t blockIndex, UseGenesis) const = 0;
+  // Medians of getLastBlocksSizes() with the same arguments
+  virtual uint64_t getLastBlocksSizesMedian(size_t count) const = 0;
+  virtual uint64_t getLastBlocksSizesMedian(size_t count, uint32_t blockIndex, UseGenesis) const = 0;
 
   virtual std::vector<Difficulty> getLastCumulativeDifficulties(size_t count, uint32_t blockIndex, UseGenesis) const = 0;
   virtual std::vector<Difficulty> getLastCumulativeDifficulties(size_t count) const = 0;
@@ -173,6 +195,11 @@ virtual ExtractOutputKeysResult extractTransactionPublicKeys(uint64_t amount, ui
   virtual void save() = 0;
   virtual void load() = 0;
 
+  // Blocks pushed after startPushBatch may be kept in memory until commitPushBatch writes all of them at once.
+  // The pushed blocks are counted by the cache right away, so a batch must be committed on every exit path.
+  virtual void startPushBatch() = 0;
+  virtual void commitPushBatch() = 0;
+
   virtual std::vector<uint64_t> getLastUnits(size_t count, uint32_t blockIndex, UseGenesis use,
                                              std::function<uint64_t(const CachedBlockInfo&)> pred) const = 0;
   virtual std::vector<Crypto::Hash> getTransactionHashes() const = 0;
@@ -71,12 +71,18 @@ virtual void extractKeyOutputKeys(const uint64_t amount, const std::vector<uint3
   virtual void getTransactions(const std::vector<Crypto::Hash>& transactionHashes,
                                std::vector<BinaryArray>& transactions,
                                std::vector<Crypto::Hash>& missedHashes) const = 0;
+  virtual void getPoolTransactions(const std::vector<Crypto::Hash>& transactionHashes,
+                                   std::vector<BinaryArray>& transactions,
+                                   std::vector<Crypto::Hash>& missedHashes) const = 0;
 
   virtual Difficulty getBlockDifficulty(uint32_t blockIndex) const = 0;
   virtual Difficulty getDifficultyForNextBlock() const = 0;
 
   virtual std::error_code addBlock(const CachedBlock& cachedBlock, RawBlock&& rawBlock) = 0;
   virtual std::error_code addBlock(RawBlock&& rawBlock) = 0;
+  // adds blocks in order and stops after the first one which wasn't added, so the result may be shorter than the input
+  virtual std::vector<std::error_code> addBlocks(const std::vector<CachedBlock>& cachedBlocks, std::vector<RawBlock>&& rawBlocks) = 0;
+  virtual std::vector<std::error_code> addBlocks(std::vector<RawBlock>&& rawBlocks) = 0;
 
   virtual std::error_code submitBlock(BinaryArray&& rawBlockTemplate) = 0;
 
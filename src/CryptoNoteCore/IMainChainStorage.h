@@ -17,6 +17,8 @@
 
 #pragma once 
 
+#include <vector>
+
 #include <CryptoNote.h>
 
 namespace CryptoNote {
@@ -31,6 +33,16 @@ public:
   virtual RawBlock getBlockByIndex(uint32_t index) const = 0;
   virtual uint32_t getBlockCount() const = 0;
 
+  // Returns up to count blocks starting from startIndex, storages override it to read them in one pass
+  virtual std::vector<RawBlock> getBlocks(uint32_t startIndex, uint32_t count) const {
+    std::vector<RawBlock> blocks;
+    for (uint32_t index = startIndex; index < getBlockCount() && index - startIndex < count; ++index) {
+      blocks.push_back(getBlockByIndex(index));
+    }
+
+    return blocks;
+  }
+
   virtual void clear() = 0;
 };
 
@@ -22,9 +22,20 @@ namespace CryptoNote {
 
 struct TransactionValidatorState;
 
+struct TransactionPoolStatistics {
+  uint64_t size;
+  uint64_t maxSize;
+  uint64_t evictedTransactions;
+  uint64_t rejectedLowFeeRate;
+  uint64_t rejectedTooLarge;
+  uint64_t rejectedDuplicates;
+  uint64_t rejectedConflicting;
+};
+
 class ITransactionPool {
 public:
-  virtual bool pushTransaction(CachedTransaction&& tx, TransactionValidatorState&& transactionState) = 0;
+  // Transactions evicted to make room for the pushed one are appended to evictedTransactions
+  virtual bool pushTransaction(CachedTransaction&& tx, TransactionValidatorState&& transactionState, std::vector<Crypto::Hash>& evictedTransactions) = 0;
   virtual const CachedTransaction& getTransaction(const Crypto::Hash& hash) const = 0;
   virtual bool removeTransaction(const Crypto::Hash& hash) = 0;
 
@@ -34,6 +45,9 @@ public:
 
   virtual const TransactionValidatorState& getPoolTransactionValidationState() const = 0;
   virtual std::vector<CachedTransaction> getPoolTransactions() const = 0;
+  // Highest fee rate first, valid until the pool is modified
+  virtual std::vector<const CachedTransaction*> getPoolTransactionsByPriority() const = 0;
+  virtual TransactionPoolStatistics getStatistics() const = 0;
 
   virtual uint64_t getTransactionReceiveTime(const Crypto::Hash& hash) const = 0;
   virtual std::vector<Crypto::Hash> getTransactionHashesByPaymentId(const Crypto::Hash& paymentId) const = 0;
@@ -0,0 +1,106 @@
+// Copyright (c) 2012-2017, The CryptoNote developers, The Bytecoin developers
+//
+// This file is part of Bytecoin.
+//
+// Bytecoin is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Bytecoin is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with Bytecoin.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "KeyImageFilter.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace CryptoNote {
+
+namespace {
+
+const size_t BLOCK_BITS = 512;
+const size_t BLOCK_WORDS = BLOCK_BITS / 64;
+// 12 bits per key image with 8 probes keep false positives around half a percent
+const size_t BITS_PER_KEY_IMAGE = 12;
+const size_t PROBES = 8;
+const size_t MIN_CAPACITY = 1024;
+
+uint64_t mix(uint64_t value) {
+  value ^= value >> 33;
+  value *= 0xff51afd7ed558ccdULL;
+  value ^= value >> 33;
+  value *= 0xc4ceb9fe1a85ec53ULL;
+  value ^= value >> 33;
+  return value;
+}
+
+}
+
+KeyImageFilter::KeyImageFilter(size_t capacity) :
+  insertedCount(0),
+  filterCapacity(std::max(capacity, MIN_CAPACITY)),
+  seed(Crypto::rand<uint64_t>()) {
+  blockCount = (filterCapacity * BITS_PER_KEY_IMAGE + BLOCK_BITS - 1) / BLOCK_BITS;
+  words.assign(blockCount * BLOCK_WORDS, 0);
+}
+
+void KeyImageFilter::insert(const Crypto::KeyImage& keyImage) {
+  Position position = getPosition(keyImage);
+  uint64_t* block = &words[position.block * BLOCK_WORDS];
+  for (size_t i = 0; i < PROBES; ++i) {
+    unsigned bit = static_cast<unsigned>(position.bits[i / 4] >> (16 * (i % 4))) & (BLOCK_BITS - 1);
+    block[bit / 64] |= uint64_t(1) << (bit % 64);
+  }
+
+  ++insertedCount;
+}
+
+bool KeyImageFilter::mayContain(const Crypto::KeyImage& keyImage) const {
+  Position position = getPosition(keyImage);
+  const uint64_t* block = &words[position.block * BLOCK_WORDS];
+  for (size_t i = 0; i < PROBES; ++i) {
+    unsigned bit = static_cast<unsigned>(position.bits[i / 4] >> (16 * (i % 4))) & (BLOCK_BITS - 1);
+    if ((block[bit / 64] & (uint64_t(1) << (bit % 64))) == 0) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+size_t KeyImageFilter::size() const {
+  return insertedCount;
+}
+
+size_t KeyImageFilter::capacity() const {
+  return filterCapacity;
+}
+
+size_t KeyImageFilter::memoryUsage() const {
+  return words.size() * sizeof(uint64_t);
+}
+
+// Key images come from transactions, so they are mixed with a random seed before choosing bits
+KeyImageFilter::Position KeyImageFilter::getPosition(const Crypto::KeyImage& keyImage) const {
+  uint64_t parts[4];
+  static_assert(sizeof(parts) == sizeof(keyImage.data), "Unexpected key image size");
+  std::memcpy(parts, keyImage.data, sizeof(parts));
+
+  uint64_t first = mix(parts[0] ^ seed);
+  uint64_t second = mix(parts[1] ^ first);
+  uint64_t third = mix(parts[2] ^ parts[3] ^ second);
+
+  Position position;
+  position.block = static_cast<size_t>(first % blockCount);
+  position.bits[0] = second;
+  position.bits[1] = third;
+  return position;
+}
+
+}
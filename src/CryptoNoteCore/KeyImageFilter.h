@@ -0,0 +1,59 @@
+// Copyright (c) 2012-2017, The CryptoNote developers, The Bytecoin developers
+//
+// This file is part of Bytecoin.
+//
+// Bytecoin is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Bytecoin is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with Bytecoin.  If not, see <http://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "crypto/crypto.h"
+
+namespace CryptoNote {
+
+// Blocked Bloom filter over key images. A negative answer is exact, a positive one may be false.
+// All bits of a key image live in one 64-byte block, so a lookup touches a single cache line.
+// Key images can't be removed, the owner rebuilds the filter to drop them.
+class KeyImageFilter {
+public:
+  explicit KeyImageFilter(size_t capacity = 0);
+
+  void insert(const Crypto::KeyImage& keyImage);
+  bool mayContain(const Crypto::KeyImage& keyImage) const;
+
+  // Number of insertions, duplicates included
+  size_t size() const;
+  // Number of key images the filter is sized for, the false positive rate grows past it
+  size_t capacity() const;
+  size_t memoryUsage() const;
+
+private:
+  struct Position {
+    size_t block;
+    uint64_t bits[2];
+  };
+
+  Position getPosition(const Crypto::KeyImage& keyImage) const;
+
+  std::vector<uint64_t> words;
+  size_t blockCount;
+  size_t insertedCount;
+  size_t filterCapacity;
+  uint64_t seed;
+};
+
+}
@@ -0,0 +1,263 @@
+// Copyright (c) 2012-2017, The CryptoNote developers, The Bytecoin developers
+//
+// This file is part of Bytecoin.
+//
+// Bytecoin is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Bytecoin is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with Bytecoin.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "KeyOutputsMemoryIndex.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+
+#include "System/MemoryMappedFile.h"
+
+namespace CryptoNote {
+
+namespace {
+
+const uint64_t FILE_MAGIC = 0x3158444954554f4bULL; // "KOUTIDX1"
+const uint32_t FILE_VERSION = 1;
+
+// The file is a header, a table of amounts and then the packedOuts, publicKeys and unlockTimes columns of every amount.
+// All records have fixed size and 8 bytes alignment, so the columns can be mapped in place.
+struct FileHeader {
+  uint64_t magic;
+  uint32_t version;
+  uint32_t topBlockIndex;
+  Crypto::Hash topBlockHash;
+  uint64_t amountsCount;
+};
+
+struct FileAmount {
+  uint64_t amount;
+  uint64_t outputsCount;
+};
+
+static_assert(sizeof(PackedOutIndex) == sizeof(uint64_t), "PackedOutIndex is expected to be packed into 8 bytes");
+static_assert(sizeof(FileHeader) % 8 == 0, "FileHeader size is expected to be a multiple of 8");
+
+template<class T>
+void copyToFile(uint8_t*& position, const std::vector<T>& values) {
+  if (!values.empty()) {
+    std::memcpy(position, values.data(), values.size() * sizeof(T));
+    position += values.size() * sizeof(T);
+  }
+}
+
+template<class T>
+void copyFromFile(const uint8_t*& position, size_t count, std::vector<T>& values) {
+  values.resize(count);
+  if (count != 0) {
+    std::memcpy(values.data(), position, count * sizeof(T));
+    position += count * sizeof(T);
+  }
+}
+
+}
+
+KeyOutputsMemoryIndex::KeyOutputsMemoryIndex(uint64_t memoryLimit) : memoryLimit(memoryLimit), outputsCount(0) {
+}
+
+uint64_t KeyOutputsMemoryIndex::getMemoryLimit() const {
+  return memoryLimit;
+}
+
+uint64_t KeyOutputsMemoryIndex::memoryUsage() const {
+  return outputsCount * outputMemoryUsage();
+}
+
+uint64_t KeyOutputsMemoryIndex::outputMemoryUsage() {
+  return sizeof(PackedOutIndex) + sizeof(Crypto::PublicKey) + sizeof(uint64_t);
+}
+
+bool KeyOutputsMemoryIndex::canAdd(size_t count) const {
+  return (outputsCount + count) * outputMemoryUsage() <= memoryLimit;
+}
+
+const KeyOutputsColumn* KeyOutputsMemoryIndex::getColumn(uint64_t amount) const {
+  auto it = columns.find(amount);
+  return it != columns.end() ? &it->second : nullptr;
+}
+
+std::vector<uint64_t> KeyOutputsMemoryIndex::getAmounts() const {
+  std::vector<uint64_t> amounts;
+  amounts.reserve(columns.size());
+  for (const auto& column : columns) {
+    amounts.push_back(column.first);
+  }
+
+  std::sort(amounts.begin(), amounts.end());
+  return amounts;
+}
+
+void KeyOutputsMemoryIndex::addAmount(uint64_t amount) {
+  columns.emplace(amount, KeyOutputsColumn());
+}
+
+void KeyOutputsMemoryIndex::push(uint64_t amount, PackedOutIndex packedOut, const Crypto::PublicKey& publicKey, uint64_t unlockTime) {
+  auto it = columns.find(amount);
+  if (it == columns.end()) {
+    return;
+  }
+
+  it->second.packedOuts.push_back(packedOut);
+  it->second.publicKeys.push_back(publicKey);
+  it->second.unlockTimes.push_back(unlockTime);
+  ++outputsCount;
+
+  shrinkToLimit();
+}
+
+void KeyOutputsMemoryIndex::truncate(uint64_t amount, size_t count) {
+  auto it = columns.find(amount);
+  if (it == columns.end() || it->second.size() <= count) {
+    return;
+  }
+
+  outputsCount -= it->second.size() - count;
+  it->second.packedOuts.resize(count);
+  it->second.publicKeys.resize(count);
+  it->second.unlockTimes.resize(count);
+}
+
+void KeyOutputsMemoryIndex::clear() {
+  columns.clear();
+  outputsCount = 0;
+}
+
+bool KeyOutputsMemoryIndex::save(const std::string& path, uint32_t topBlockIndex, const Crypto::Hash& topBlockHash) const {
+  auto amounts = getAmounts();
+
+  FileHeader header;
+  header.magic = FILE_MAGIC;
+  header.version = FILE_VERSION;
+  header.topBlockIndex = topBlockIndex;
+  header.topBlockHash = topBlockHash;
+  header.amountsCount = amounts.size();
+
+  uint64_t size = sizeof(FileHeader) + amounts.size() * sizeof(FileAmount) + memoryUsage();
+
+  std::error_code ec;
+  System::MemoryMappedFile file;
+  file.create(path + ".tmp", size, true, ec);
+  if (ec) {
+    return false;
+  }
+
+  uint8_t* position = file.data();
+  std::memcpy(position, &header, sizeof(header));
+  position += sizeof(header);
+
+  for (auto amount : amounts) {
+    FileAmount fileAmount;
+    fileAmount.amount = amount;
+    fileAmount.outputsCount = columns.at(amount).size();
+    std::memcpy(position, &fileAmount, sizeof(fileAmount));
+    position += sizeof(fileAmount);
+  }
+
+  for (auto amount : amounts) {
+    const auto& column = columns.at(amount);
+    copyToFile(position, column.packedOuts);
+    copyToFile(position, column.publicKeys);
+    copyToFile(position, column.unlockTimes);
+  }
+
+  assert(position == file.data() + size);
+
+  file.flush(file.data(), size, ec);
+  if (!ec) {
+    file.rename(path, ec);
+  }
+
+  std::error_code closeError;
+  file.close(closeError);
+  return !ec && !closeError;
+}
+
+bool KeyOutputsMemoryIndex::load(const std::string& path, uint32_t topBlockIndex, const Crypto::Hash& topBlockHash) {
+  clear();
+
+  std::error_code ec;
+  System::MemoryMappedFile file;
+  file.open(path, ec);
+  if (ec) {
+    return false;
+  }
+
+  const uint8_t* position = file.data();
+  const uint8_t* end = position + file.size();
+
+  FileHeader header;
+  if (file.size() < sizeof(header)) {
+    return false;
+  }
+
+  std::memcpy(&header, position, sizeof(header));
+  position += sizeof(header);
+  if (header.magic != FILE_MAGIC || header.version != FILE_VERSION || header.topBlockIndex != topBlockIndex ||
+      header.topBlockHash != topBlockHash) {
+    return false;
+  }
+
+  if (header.amountsCount > static_cast<uint64_t>(end - position) / sizeof(FileAmount)) {
+    return false;
+  }
+
+  std::vector<FileAmount> amounts(header.amountsCount);
+  uint64_t totalOutputsCount = 0;
+  for (auto& fileAmount : amounts) {
+    std::memcpy(&fileAmount, position, sizeof(fileAmount));
+    position += sizeof(fileAmount);
+    totalOutputsCount += fileAmount.outputsCount;
+  }
+
+  if (totalOutputsCount > static_cast<uint64_t>(end - position) / outputMemoryUsage() ||
+      totalOutputsCount * outputMemoryUsage() != static_cast<uint64_t>(end - position)) {
+    return false;
+  }
+
+  for (const auto& fileAmount : amounts) {
+    if (columns.count(fileAmount.amount) != 0) {
+      clear();
+      return false;
+    }
+
+    auto& column = columns[fileAmount.amount];
+    auto count = static_cast<size_t>(fileAmount.outputsCount);
+    copyFromFile(position, count, column.packedOuts);
+    copyFromFile(position, count, column.publicKeys);
+    copyFromFile(position, count, column.unlockTimes);
+  }
+
+  outputsCount = totalOutputsCount;
+  // the limit might have been lowered since the file was saved
+  shrinkToLimit();
+  return true;
+}
+
+void KeyOutputsMemoryIndex::shrinkToLimit() {
+  while (!columns.empty() && memoryUsage() > memoryLimit) {
+    auto smallest = std::min_element(columns.begin(), columns.end(), [] (const std::pair<const uint64_t, KeyOutputsColumn>& left,
+                                                                          const std::pair<const uint64_t, KeyOutputsColumn>& right) {
+      return left.second.size() < right.second.size();
+    });
+
+    outputsCount -= smallest->second.size();
+    columns.erase(smallest);
+  }
+}
+
+}
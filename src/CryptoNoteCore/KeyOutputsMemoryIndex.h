@@ -0,0 +1,74 @@
+// Copyright (c) 2012-2017, The CryptoNote developers, The Bytecoin developers
+//
+// This file is part of Bytecoin.
+//
+// Bytecoin is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Bytecoin is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with Bytecoin.  If not, see <http://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "IBlockchainCache.h"
+
+namespace CryptoNote {
+
+// Key outputs of one amount, the global output index is the position in the columns
+struct KeyOutputsColumn {
+  std::vector<PackedOutIndex> packedOuts;
+  std::vector<Crypto::PublicKey> publicKeys;
+  std::vector<uint64_t> unlockTimes;
+
+  size_t size() const { return packedOuts.size(); }
+};
+
+// Memory copy of the key outputs of the amounts chosen by the owner, usually the ones with the most outputs.
+// The owner keeps it in sync with the database, amounts that don't fit the memory limit are dropped starting from the smallest.
+// The columns are saved to a file of fixed size records, it is loaded only if it was saved at the expected top block.
+class KeyOutputsMemoryIndex {
+public:
+  explicit KeyOutputsMemoryIndex(uint64_t memoryLimit = 0);
+
+  uint64_t getMemoryLimit() const;
+  uint64_t memoryUsage() const;
+  static uint64_t outputMemoryUsage();
+  // Tells whether an amount with the given number of outputs fits the rest of the memory limit
+  bool canAdd(size_t outputsCount) const;
+
+  // Returns nullptr if the amount isn't kept in memory
+  const KeyOutputsColumn* getColumn(uint64_t amount) const;
+  std::vector<uint64_t> getAmounts() const;
+
+  void addAmount(uint64_t amount);
+  // Does nothing if the amount isn't kept in memory
+  void push(uint64_t amount, PackedOutIndex packedOut, const Crypto::PublicKey& publicKey, uint64_t unlockTime);
+  // Removes outputs with global indexes starting from outputsCount
+  void truncate(uint64_t amount, size_t outputsCount);
+  void clear();
+
+  bool save(const std::string& path, uint32_t topBlockIndex, const Crypto::Hash& topBlockHash) const;
+  bool load(const std::string& path, uint32_t topBlockIndex, const Crypto::Hash& topBlockHash);
+
+private:
+  void shrinkToLimit();
+
+  uint64_t memoryLimit;
+  uint64_t outputsCount;
+  std::unordered_map<uint64_t, KeyOutputsColumn> columns;
+};
+
+}
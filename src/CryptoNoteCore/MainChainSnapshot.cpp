@@ -0,0 +1,167 @@
+// Copyright (c) 2012-2017, The CryptoNote developers, The Bytecoin developers
+//
+// This file is part of Bytecoin.
+//
+// Bytecoin is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Bytecoin is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with Bytecoin.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "MainChainSnapshot.h"
+
+#include <algorithm>
+#include <system_error>
+
+#include "Common/StringTools.h"
+#include "CryptoNoteTools.h"
+#include "DatabaseBlockchainCache.h"
+
+namespace CryptoNote {
+
+MainChainSnapshot::MainChainSnapshot(const Currency& currency, std::shared_ptr<IDataBase> database, uint32_t topBlockIndex,
+                                     const Crypto::Hash& topBlockHash, uint32_t databaseTopBlockIndex, bool hasRawBlocks) :
+  currency(currency), database(std::move(database)), topBlockIndex(topBlockIndex), topBlockHash(topBlockHash),
+  databaseTopBlockIndex(databaseTopBlockIndex), hasRawBlocks(hasRawBlocks) {
+}
+
+uint32_t MainChainSnapshot::getTopBlockIndex() const {
+  return topBlockIndex;
+}
+
+const Crypto::Hash& MainChainSnapshot::getTopBlockHash() const {
+  return topBlockHash;
+}
+
+uint32_t MainChainSnapshot::getDatabaseTopBlockIndex() const {
+  return databaseTopBlockIndex;
+}
+
+uint32_t MainChainSnapshot::getBlockIndex(const Crypto::Hash& blockHash) const {
+  auto batch = BlockchainReadBatch().requestBlockIndexByBlockHash(blockHash);
+  auto result = readDatabase(batch);
+  auto it = result.getBlockIndexesByBlockHashes().find(blockHash);
+  if (it == result.getBlockIndexesByBlockHashes().end()) {
+    // the block may be kept in memory, or in another chain
+    throw OutOfSnapshotError("Block " + Common::podToHex(blockHash) + " isn't in the snapshot");
+  }
+
+  return it->second;
+}
+
+std::vector<CachedBlockInfo> MainChainSnapshot::getBlockInfos(uint32_t startIndex, uint32_t count) const {
+  checkRange(startIndex, count);
+
+  BlockchainReadBatch batch;
+  for (uint32_t i = 0; i < count; ++i) {
+    batch.requestCachedBlock(startIndex + i);
+  }
+
+  auto result = readDatabase(batch);
+  std::vector<CachedBlockInfo> blockInfos;
+  blockInfos.reserve(count);
+  for (uint32_t i = 0; i < count; ++i) {
+    blockInfos.push_back(result.getCachedBlocks().at(startIndex + i));
+  }
+
+  return blockInfos;
+}
+
+std::vector<RawBlock> MainChainSnapshot::getBlocks(uint32_t startIndex, uint32_t count) const {
+  if (!hasRawBlocks) {
+    throw OutOfSnapshotError("Raw blocks are kept in the main chain storage");
+  }
+
+  checkRange(startIndex, count);
+
+  BlockchainReadBatch batch;
+  for (uint32_t i = 0; i < count; ++i) {
+    batch.requestRawBlock(startIndex + i);
+  }
+
+  auto result = readDatabase(batch);
+  std::vector<RawBlock> rawBlocks;
+  rawBlocks.reserve(count);
+  for (uint32_t i = 0; i < count; ++i) {
+    rawBlocks.push_back(result.getRawBlocks().at(startIndex + i));
+  }
+
+  return rawBlocks;
+}
+
+BlockTemplate MainChainSnapshot::getBlockByIndex(uint32_t blockIndex) const {
+  auto rawBlocks = getBlocks(blockIndex, 1);
+
+  BlockTemplate block;
+  if (!fromBinaryArray(block, rawBlocks.front().block)) {
+    throw std::runtime_error("Couldn't deserialize block " + std::to_string(blockIndex));
+  }
+
+  return block;
+}
+
+BlockTemplate MainChainSnapshot::getBlockByHash(const Crypto::Hash& blockHash) const {
+  return getBlockByIndex(getBlockIndex(blockHash));
+}
+
+Difficulty MainChainSnapshot::getBlockDifficulty(uint32_t blockIndex) const {
+  if (blockIndex == 0) {
+    return getBlockInfos(0, 1).front().cumulativeDifficulty;
+  }
+
+  auto blockInfos = getBlockInfos(blockIndex - 1, 2);
+  return blockInfos[1].cumulativeDifficulty - blockInfos[0].cumulativeDifficulty;
+}
+
+bool MainChainSnapshot::getRandomOutputs(uint64_t amount, uint16_t count, std::vector<uint32_t>& globalIndexes,
+                                         std::vector<Crypto::PublicKey>& publicKeys) const {
+  if (count == 0) {
+    return true;
+  }
+
+  auto upperBlockLimit = topBlockIndex - currency.minedMoneyUnlockWindow();
+  if (upperBlockLimit < currency.minedMoneyUnlockWindow()) {
+    return false;
+  }
+
+  // outputs of the blocks kept in memory would never be picked
+  if (upperBlockLimit > databaseTopBlockIndex) {
+    throw OutOfSnapshotError("Unlocked outputs are above the database top block");
+  }
+
+  globalIndexes = DatabaseBlockchainCache::requestRandomOutsByAmount(currency, *database, amount, count, topBlockIndex,
+                                                                     currency.mixinStartHeight());
+  if (globalIndexes.empty()) {
+    return false;
+  }
+
+  std::sort(globalIndexes.begin(), globalIndexes.end());
+
+  return DatabaseBlockchainCache::requestKeyOutputKeys(currency, *database, amount, topBlockIndex,
+    {globalIndexes.data(), globalIndexes.size()}, publicKeys) == ExtractOutputKeysResult::SUCCESS;
+}
+
+void MainChainSnapshot::checkRange(uint32_t startIndex, uint32_t count) const {
+  if (static_cast<uint64_t>(startIndex) + count > static_cast<uint64_t>(databaseTopBlockIndex) + 1) {
+    throw OutOfSnapshotError("Blocks " + std::to_string(startIndex) + " - " + std::to_string(startIndex + count - 1) +
+                             " aren't in the snapshot");
+  }
+}
+
+BlockchainReadResult MainChainSnapshot::readDatabase(BlockchainReadBatch& batch) const {
+  auto error = database->read(batch);
+  if (error) {
+    throw std::system_error(error, "Cannot read the main chain snapshot");
+  }
+
+  return batch.extractResult();
+}
+
+}
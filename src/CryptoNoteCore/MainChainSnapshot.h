@@ -0,0 +1,73 @@
+// Copyright (c) 2012-2017, The CryptoNote developers, The Bytecoin developers
+//
+// This file is part of Bytecoin.
+//
+// Bytecoin is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Bytecoin is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with Bytecoin.  If not, see <http://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <stdexcept>
+#include <vector>
+
+#include "BlockchainReadBatch.h"
+#include "Currency.h"
+#include "IDataBase.h"
+
+namespace CryptoNote {
+
+// Thrown when a request needs main chain data the snapshot doesn't have, the core has to serve it then
+class OutOfSnapshotError : public std::runtime_error {
+public:
+  explicit OutOfSnapshotError(const std::string& message) : std::runtime_error(message) {
+  }
+};
+
+// Immutable view of the main chain at one top block, it can be read from any thread.
+// Blocks are read from a snapshot of the database, blocks above the database top are kept in memory by the core
+// and aren't visible here.
+class MainChainSnapshot {
+public:
+  MainChainSnapshot(const Currency& currency, std::shared_ptr<IDataBase> database, uint32_t topBlockIndex,
+                    const Crypto::Hash& topBlockHash, uint32_t databaseTopBlockIndex, bool hasRawBlocks);
+
+  uint32_t getTopBlockIndex() const;
+  const Crypto::Hash& getTopBlockHash() const;
+  uint32_t getDatabaseTopBlockIndex() const;
+
+  uint32_t getBlockIndex(const Crypto::Hash& blockHash) const;
+  std::vector<CachedBlockInfo> getBlockInfos(uint32_t startIndex, uint32_t count) const;
+  std::vector<RawBlock> getBlocks(uint32_t startIndex, uint32_t count) const;
+  BlockTemplate getBlockByIndex(uint32_t blockIndex) const;
+  BlockTemplate getBlockByHash(const Crypto::Hash& blockHash) const;
+  Difficulty getBlockDifficulty(uint32_t blockIndex) const;
+
+  // Same as Core::getRandomOutputs at the snapshot top
+  bool getRandomOutputs(uint64_t amount, uint16_t count, std::vector<uint32_t>& globalIndexes,
+                        std::vector<Crypto::PublicKey>& publicKeys) const;
+
+private:
+  void checkRange(uint32_t startIndex, uint32_t count) const;
+  BlockchainReadResult readDatabase(BlockchainReadBatch& batch) const;
+
+  const Currency& currency;
+  std::shared_ptr<IDataBase> database;
+  const uint32_t topBlockIndex;
+  const Crypto::Hash topBlockHash;
+  const uint32_t databaseTopBlockIndex;
+  const bool hasRawBlocks;
+};
+
+}
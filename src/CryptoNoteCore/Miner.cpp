@@ -55,6 +55,7 @@ namespace CryptoNote
     m_starter_nonce(0),
     m_last_hr_merge_time(0),
     m_hashes(0),
+    m_hashes_by_ways(),
     m_do_print_hashrate(false),
     m_do_mining(false),
     m_current_hash_rate(0),
@@ -150,7 +151,8 @@ namespace CryptoNote
   void miner::merge_hr()
   {
     if(m_last_hr_merge_time && is_mining()) {
-      m_current_hash_rate = m_hashes * 1000 / (millisecondsSinceEpoch() - m_last_hr_merge_time + 1);
+      uint64_t elapsed = millisecondsSinceEpoch() - m_last_hr_merge_time + 1;
+      m_current_hash_rate = m_hashes * 1000 / elapsed;
       std::lock_guard<std::mutex> lk(m_last_hash_rates_lock);
       m_last_hash_rates.push_back(m_current_hash_rate);
       if(m_last_hash_rates.size() > 19)
@@ -159,12 +161,21 @@ namespace CryptoNote
       if(m_do_print_hashrate) {
         uint64_t total_hr = std::accumulate(m_last_hash_rates.begin(), m_last_hash_rates.end(), static_cast<uint64_t>(0));
         float hr = static_cast<float>(total_hr)/static_cast<float>(m_last_hash_rates.size());
-        std::cout << "hashrate: " << std::setprecision(4) << std::fixed << hr << ENDL;
+        std::cout << "hashrate: " << std::setprecision(4) << std::fixed << hr;
+        for (size_t i = 0; i < Crypto::SLOW_HASH_MAX_WAYS; ++i) {
+          if (m_hashes_by_ways[i] != 0) {
+            std::cout << ", " << i + 1 << "-way: " << m_hashes_by_ways[i] * 1000 / elapsed;
+          }
+        }
+        std::cout << ENDL;
       }
     }
     
     m_last_hr_merge_time = millisecondsSinceEpoch();
     m_hashes = 0;
+    for (auto& hashes : m_hashes_by_ways) {
+      hashes = 0;
+    }
   }
 
   bool miner::init(const MinerConfig& config) {
@@ -376,7 +387,25 @@ namespace CryptoNote
     uint32_t nonce = m_starter_nonce + th_local_index;
     Difficulty local_diff = 0;
     uint32_t local_template_ver = 0;
-    Crypto::cn_context context;
+    std::vector<std::unique_ptr<Crypto::cn_context>> contexts;
+    try {
+      contexts = Crypto::make_cn_contexts(Crypto::SLOW_HASH_MAX_WAYS);
+    } catch (std::bad_alloc&) {
+      logger(ERROR) << "Failed to allocate hashing context";
+      return false;
+    }
+
+    size_t ways = contexts.size();
+    std::vector<Crypto::cn_context*> lane_contexts;
+    for (auto& context : contexts) {
+      lane_contexts.push_back(context.get());
+    }
+
+    logger(DEBUGGING) << "Miner thread [" << th_local_index << "] hashes " << ways << " nonces per call";
+    std::vector<BlockTemplate> blocks(ways);
+    std::vector<BinaryArray> hashing_blobs(ways);
+    std::vector<const void*> inputs(ways);
+    std::vector<Crypto::Hash> hashes(ways);
     BlockTemplate b;
 
     while(!m_stop)
@@ -395,6 +424,7 @@ namespace CryptoNote
 
         local_template_ver = m_template_no;
         nonce = m_starter_nonce + th_local_index;
+        std::fill(blocks.begin(), blocks.end(), b);
       }
 
       if(!local_template_ver)//no any set_block_template call
@@ -404,27 +434,36 @@ namespace CryptoNote
         continue;
       }
 
-      b.nonce = nonce;
-      Crypto::Hash h;
+      //lane i takes the nonce this thread would have reached after i single hashes
+      for (size_t i = 0; i < ways; ++i) {
+        blocks[i].nonce = nonce + static_cast<uint32_t>(i) * m_threads_total;
+      }
 
-      CachedBlock cb(b);
       if (!m_stop) {
         try {
-          h = cb.getBlockLongHash(context);
+          for (size_t i = 0; i < ways; ++i) {
+            hashing_blobs[i] = CachedBlock(blocks[i]).getBlockLongHashingBinaryArray();
+            inputs[i] = hashing_blobs[i].data();
+          }
+
+          Crypto::cn_slow_hash_multi(lane_contexts.data(), inputs.data(), hashing_blobs[0].size(), hashes.data(), ways);
         } catch (std::exception& e) {
           logger(ERROR) << "getBlockLongHash failed: " << e.what();
           m_stop = true;
         }
       }
 
-      if (!m_stop && check_hash(h, local_diff))
-      {
+      for (size_t i = 0; i < ways && !m_stop; ++i) {
+        if (!check_hash(hashes[i], local_diff)) {
+          continue;
+        }
+
         //we lucky!
         ++m_config.current_extra_message_index;
 
         logger(INFO, GREEN) << "Found block for difficulty: " << local_diff;
 
-        if(!m_handler.handle_block_found(b)) {
+        if(!m_handler.handle_block_found(blocks[i])) {
           --m_config.current_extra_message_index;
         } else {
           //success update, lets update config
@@ -432,8 +471,9 @@ namespace CryptoNote
         }
       }
 
-      nonce += m_threads_total;
-      ++m_hashes;
+      nonce += static_cast<uint32_t>(ways) * m_threads_total;
+      m_hashes += ways;
+      m_hashes_by_ways[ways - 1] += ways;
     }
     logger(INFO) << "Miner thread stopped ["<< th_local_index << "]";
     return true;
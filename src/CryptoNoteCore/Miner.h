@@ -28,6 +28,7 @@
 #include "CryptoNoteCore/IMinerHandler.h"
 #include "CryptoNoteCore/MinerConfig.h"
 #include "CryptoNoteCore/OnceInInterval.h"
+#include "crypto/hash.h"
 
 #include <Logging/LoggerRef.h>
 
@@ -94,6 +95,7 @@ namespace CryptoNote {
     std::string m_config_folder_path;
     std::atomic<uint64_t> m_last_hr_merge_time;
     std::atomic<uint64_t> m_hashes;
+    std::atomic<uint64_t> m_hashes_by_ways[Crypto::SLOW_HASH_MAX_WAYS];
     std::atomic<uint64_t> m_current_hash_rate;
     std::mutex m_last_hash_rates_lock;
     std::list<uint64_t> m_last_hash_rates;
@@ -0,0 +1,146 @@
+// Copyright (c) 2012-2017, The CryptoNote developers, The Bytecoin developers
+//
+// This file is part of Bytecoin.
+//
+// Bytecoin is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Bytecoin is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with Bytecoin.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "ProofOfWorkService.h"
+
+#include <atomic>
+#include <cassert>
+#include <exception>
+
+#include <System/InterruptedException.h>
+
+namespace CryptoNote {
+
+namespace {
+
+enum TaskState : int {
+  TASK_QUEUED,
+  TASK_RUNNING,
+  TASK_CANCELLED
+};
+
+}
+
+struct ProofOfWorkService::Task {
+  explicit Task(System::Dispatcher& dispatcher) : state(TASK_QUEUED), finished(dispatcher) {
+  }
+
+  std::atomic<int> state;
+  System::Event finished;
+};
+
+ProofOfWorkService::ProofOfWorkService(System::Dispatcher& dispatcher, Common::ThreadPool& threadPool) :
+  dispatcher(dispatcher), threadPool(threadPool), pendingCount(0), allTasksFinished(dispatcher) {
+  allTasksFinished.set();
+}
+
+ProofOfWorkService::~ProofOfWorkService() {
+  try {
+    cancel();
+  } catch (...) {
+  }
+}
+
+void ProofOfWorkService::push(const CachedBlock& cachedBlock) {
+  if (tasks.count(&cachedBlock) != 0) {
+    return;
+  }
+
+  // CachedBlock fills its caches lazily and without locking. Everything the worker reads is filled here,
+  // so the worker only writes the long hash, which the dispatcher doesn't read before waitBlockLongHash.
+  try {
+    cachedBlock.getBlockHash();
+    cachedBlock.getBlockLongHashingBinaryArray();
+  } catch (std::exception&) {
+    // the block is rejected when its hash is requested again on the dispatcher thread
+    return;
+  }
+
+  auto task = std::make_shared<Task>(dispatcher);
+  tasks.emplace(&cachedBlock, task);
+  ++pendingCount;
+  allTasksFinished.clear();
+
+  threadPool.post(std::bind([this, &cachedBlock] (std::shared_ptr<Task>& task) {
+    int expected = TASK_QUEUED;
+    if (task->state.compare_exchange_strong(expected, TASK_RUNNING)) {
+      try {
+        cachedBlock.getBlockLongHash(getThreadContext());
+      } catch (std::exception&) {
+        // the block is rejected when its hash is requested again on the dispatcher thread
+      }
+    }
+
+    // the task is released on the dispatcher thread, which owns its event
+    dispatcher.remoteSpawn(std::bind([this] (std::shared_ptr<Task>& task) {
+      task->finished.set();
+      assert(pendingCount > 0);
+      if (--pendingCount == 0) {
+        allTasksFinished.set();
+      }
+    }, std::move(task)));
+  }, std::move(task)));
+}
+
+void ProofOfWorkService::waitBlockLongHash(const CachedBlock& cachedBlock) {
+  auto it = tasks.find(&cachedBlock);
+  if (it != tasks.end()) {
+    auto task = it->second;
+    tasks.erase(it);
+
+    int expected = TASK_QUEUED;
+    if (!task->state.compare_exchange_strong(expected, TASK_CANCELLED)) {
+      waitEvent(task->finished);
+    }
+  }
+}
+
+void ProofOfWorkService::cancel() {
+  for (auto& kv : tasks) {
+    int expected = TASK_QUEUED;
+    kv.second->state.compare_exchange_strong(expected, TASK_CANCELLED);
+  }
+
+  tasks.clear();
+  waitEvent(allTasksFinished);
+}
+
+size_t ProofOfWorkService::getPendingCount() const {
+  return pendingCount;
+}
+
+Crypto::cn_context& ProofOfWorkService::getThreadContext() {
+  static thread_local Crypto::cn_context context;
+  return context;
+}
+
+void ProofOfWorkService::waitEvent(System::Event& event) {
+  bool interrupted = false;
+  while (!event.get()) {
+    try {
+      event.wait();
+    } catch (System::InterruptedException&) {
+      interrupted = true;
+    }
+  }
+
+  if (interrupted) {
+    dispatcher.interrupt();
+  }
+}
+
+}
@@ -0,0 +1,72 @@
+// Copyright (c) 2012-2017, The CryptoNote developers, The Bytecoin developers
+//
+// This file is part of Bytecoin.
+//
+// Bytecoin is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Bytecoin is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with Bytecoin.  If not, see <http://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <unordered_map>
+
+#include <Common/ThreadPool.h>
+#include <System/Dispatcher.h>
+#include <System/Event.h>
+
+#include "CachedBlock.h"
+#include "crypto/hash.h"
+
+namespace CryptoNote {
+
+// Calculates block long hashes on a thread pool ahead of block validation. Results are cached inside CachedBlock,
+// so the proof of work check of a pushed block doesn't hash on the dispatcher thread.
+// All methods must be called from the dispatcher thread.
+class ProofOfWorkService {
+public:
+  ProofOfWorkService(System::Dispatcher& dispatcher, Common::ThreadPool& threadPool);
+  ~ProofOfWorkService();
+
+  ProofOfWorkService(const ProofOfWorkService&) = delete;
+  ProofOfWorkService& operator=(const ProofOfWorkService&) = delete;
+
+  // Queue long hash calculation. The block must stay alive until cancel() is called or the service is destroyed.
+  // The block hashing blobs are serialized here, a block that can't be serialized isn't queued.
+  void push(const CachedBlock& cachedBlock);
+
+  // Wait for the worker calculating the block long hash. If no worker has started it yet, the block is dropped
+  // from the queue and the hash is left to the caller.
+  void waitBlockLongHash(const CachedBlock& cachedBlock);
+
+  // Drop all queued blocks and wait for the calculations in progress.
+  void cancel();
+
+  size_t getPendingCount() const;
+
+  // Scratchpad owned by the calling thread, allocated on first use.
+  static Crypto::cn_context& getThreadContext();
+
+private:
+  struct Task;
+
+  void waitEvent(System::Event& event);
+
+  System::Dispatcher& dispatcher;
+  Common::ThreadPool& threadPool;
+  std::unordered_map<const CachedBlock*, std::shared_ptr<Task>> tasks;
+  size_t pendingCount;
+  System::Event allTasksFinished;
+};
+
+}
@@ -0,0 +1,84 @@
+// Copyright (c) 2012-2017, The CryptoNote developers, The Bytecoin developers
+//
+// This file is part of Bytecoin.
+//
+// Bytecoin is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Bytecoin is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with Bytecoin.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "RingSignatureBatch.h"
+
+#include <atomic>
+
+#include "Common/ThreadPool.h"
+
+namespace CryptoNote {
+
+const size_t RingSignatureBatch::NO_FAILURE;
+
+void RingSignatureBatch::addCheck(size_t transactionIndex, const Crypto::Hash& prefixHash, const Crypto::KeyImage& keyImage,
+                                  std::vector<Crypto::PublicKey>&& outputKeys, const Crypto::Signature* signatures, bool checkKeyImage) {
+  checks.push_back({transactionIndex, &prefixHash, keyImage, std::move(outputKeys), signatures, checkKeyImage});
+}
+
+bool RingSignatureBatch::empty() const {
+  return checks.empty();
+}
+
+size_t RingSignatureBatch::size() const {
+  return checks.size();
+}
+
+void RingSignatureBatch::clear() {
+  checks.clear();
+}
+
+size_t RingSignatureBatch::verify() const {
+  for (const auto& check : checks) {
+    if (!verifyCheck(check)) {
+      return check.transactionIndex;
+    }
+  }
+
+  return NO_FAILURE;
+}
+
+size_t RingSignatureBatch::verify(Common::ThreadPool& threadPool) const {
+  std::atomic<size_t> failedCheck(checks.size());
+
+  threadPool.parallelFor(checks.size(), [&] (size_t index) {
+    if (index > failedCheck.load(std::memory_order_relaxed)) {
+      return;
+    }
+
+    if (!verifyCheck(checks[index])) {
+      size_t current = failedCheck.load();
+      while (index < current && !failedCheck.compare_exchange_weak(current, index)) {
+      }
+    }
+  });
+
+  return failedCheck == checks.size() ? NO_FAILURE : checks[failedCheck].transactionIndex;
+}
+
+bool RingSignatureBatch::verifyCheck(const Check& check) {
+  std::vector<const Crypto::PublicKey*> outputKeyPointers;
+  outputKeyPointers.reserve(check.outputKeys.size());
+  for (const auto& key : check.outputKeys) {
+    outputKeyPointers.push_back(&key);
+  }
+
+  return Crypto::check_ring_signature(*check.prefixHash, check.keyImage, outputKeyPointers.data(), outputKeyPointers.size(),
+                                      check.signatures, check.checkKeyImage);
+}
+
+}
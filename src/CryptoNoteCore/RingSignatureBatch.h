@@ -0,0 +1,64 @@
+// Copyright (c) 2012-2017, The CryptoNote developers, The Bytecoin developers
+//
+// This file is part of Bytecoin.
+//
+// Bytecoin is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Bytecoin is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with Bytecoin.  If not, see <http://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <cstddef>
+#include <limits>
+#include <vector>
+
+#include "crypto/crypto.h"
+
+namespace Common {
+class ThreadPool;
+}
+
+namespace CryptoNote {
+
+// Ring signature checks collected while validating block transactions, verified at once.
+// Transaction prefix hashes and signatures are referenced, so the transactions must outlive the batch.
+class RingSignatureBatch {
+public:
+  static const size_t NO_FAILURE = std::numeric_limits<size_t>::max();
+
+  void addCheck(size_t transactionIndex, const Crypto::Hash& prefixHash, const Crypto::KeyImage& keyImage,
+                std::vector<Crypto::PublicKey>&& outputKeys, const Crypto::Signature* signatures, bool checkKeyImage);
+
+  bool empty() const;
+  size_t size() const;
+  void clear();
+
+  // Returns index of the transaction with the first invalid signature, or NO_FAILURE.
+  size_t verify() const;
+  size_t verify(Common::ThreadPool& threadPool) const;
+
+private:
+  struct Check {
+    size_t transactionIndex;
+    const Crypto::Hash* prefixHash;
+    Crypto::KeyImage keyImage;
+    std::vector<Crypto::PublicKey> outputKeys;
+    const Crypto::Signature* signatures;
+    bool checkKeyImage;
+  };
+
+  static bool verifyCheck(const Check& check);
+
+  std::vector<Check> checks;
+};
+
+}
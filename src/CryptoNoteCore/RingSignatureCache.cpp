@@ -0,0 +1,93 @@
+// Copyright (c) 2012-2017, The CryptoNote developers, The Bytecoin developers
+//
+// This file is part of Bytecoin.
+//
+// Bytecoin is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Bytecoin is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with Bytecoin.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "RingSignatureCache.h"
+
+#include "crypto/hash.h"
+
+namespace CryptoNote {
+
+RingSignatureCache::RingSignatureCache(size_t capacity) : capacity(capacity), hits(0), misses(0) {
+}
+
+Crypto::Hash RingSignatureCache::getKey(const Crypto::Hash& prefixHash, size_t inputIndex, const std::vector<Crypto::PublicKey>& outputKeys,
+                                        const std::vector<Crypto::Signature>& signatures, bool checkKeyImage) {
+  std::vector<uint8_t> data;
+  data.reserve(sizeof(prefixHash) + sizeof(uint64_t) + outputKeys.size() * sizeof(Crypto::PublicKey) +
+               signatures.size() * sizeof(Crypto::Signature) + 1);
+
+  auto append = [&data] (const void* bytes, size_t size) {
+    data.insert(data.end(), static_cast<const uint8_t*>(bytes), static_cast<const uint8_t*>(bytes) + size);
+  };
+
+  uint64_t index = inputIndex;
+  append(&prefixHash, sizeof(prefixHash));
+  append(&index, sizeof(index));
+  append(outputKeys.data(), outputKeys.size() * sizeof(Crypto::PublicKey));
+  append(signatures.data(), signatures.size() * sizeof(Crypto::Signature));
+  data.push_back(checkKeyImage ? 1 : 0);
+
+  return Crypto::cn_fast_hash(data.data(), data.size());
+}
+
+bool RingSignatureCache::contains(const Crypto::Hash& key) {
+  bool found;
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    found = entries.count(key) != 0;
+  }
+
+  if (found) {
+    ++hits;
+  } else {
+    ++misses;
+  }
+
+  return found;
+}
+
+void RingSignatureCache::insert(const Crypto::Hash& key) {
+  if (capacity == 0) {
+    return;
+  }
+
+  std::lock_guard<std::mutex> lock(mutex);
+  if (!entries.insert(key).second) {
+    return;
+  }
+
+  insertionOrder.push_back(key);
+  if (insertionOrder.size() > capacity) {
+    entries.erase(insertionOrder.front());
+    insertionOrder.pop_front();
+  }
+}
+
+size_t RingSignatureCache::size() const {
+  std::lock_guard<std::mutex> lock(mutex);
+  return entries.size();
+}
+
+uint64_t RingSignatureCache::getHits() const {
+  return hits;
+}
+
+uint64_t RingSignatureCache::getMisses() const {
+  return misses;
+}
+
+}
@@ -0,0 +1,57 @@
+// Copyright (c) 2012-2017, The CryptoNote developers, The Bytecoin developers
+//
+// This file is part of Bytecoin.
+//
+// Bytecoin is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Bytecoin is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with Bytecoin.  If not, see <http://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <deque>
+#include <mutex>
+#include <unordered_set>
+#include <vector>
+
+#include "crypto/crypto.h"
+
+namespace CryptoNote {
+
+// Bounded set of ring signatures already verified as valid, shared between pool admission and block validation.
+// The oldest entries are dropped first when the cache is full.
+class RingSignatureCache {
+public:
+  explicit RingSignatureCache(size_t capacity);
+
+  // Identifies a single ring signature check. Signatures are hashed too, since they are not covered by the prefix hash.
+  static Crypto::Hash getKey(const Crypto::Hash& prefixHash, size_t inputIndex, const std::vector<Crypto::PublicKey>& outputKeys,
+                             const std::vector<Crypto::Signature>& signatures, bool checkKeyImage);
+
+  bool contains(const Crypto::Hash& key);
+  void insert(const Crypto::Hash& key);
+
+  size_t size() const;
+  uint64_t getHits() const;
+  uint64_t getMisses() const;
+
+private:
+  const size_t capacity;
+  mutable std::mutex mutex;
+  std::unordered_set<Crypto::Hash> entries;
+  std::deque<Crypto::Hash> insertionOrder;
+  std::atomic<uint64_t> hits;
+  std::atomic<uint64_t> misses;
+};
+
+}
@@ -17,12 +17,19 @@
 
 #include "RocksDBWrapper.h"
 
+#include <algorithm>
+#include <numeric>
+
 #include "rocksdb/cache.h"
+#include "rocksdb/filter_policy.h"
+#include "rocksdb/slice_transform.h"
+#include "rocksdb/statistics.h"
 #include "rocksdb/table.h"
 #include "rocksdb/db.h"
 #include "rocksdb/utilities/backupable_db.h"
 
 #include "DataBaseErrors.h"
+#include "DBUtils.h"
 
 using namespace CryptoNote;
 using namespace Logging;
@@ -30,6 +37,63 @@ using namespace Logging;
 namespace {
   const std::string DB_NAME = "DB";
   const std::string TESTNET_DB_NAME = "testnet_DB";
+
+  const size_t RECORDS_TO_MOVE_PER_BATCH = 10000;
+
+  const size_t RAW_BLOCKS_BLOCK_SIZE = 64 * 1024;
+  const int BLOOM_FILTER_BITS_PER_KEY = 10;
+  const double MEMTABLE_BLOOM_SIZE_RATIO = 0.1;
+  // key prefix and the high 6 bytes of a big endian timestamp, i.e. ~18 hours per bucket
+  const size_t TIMESTAMP_KEY_PREFIX_LENGTH = 1 + 6;
+
+  // levels below this one hold recent data that is read and rewritten most often, they stay uncompressed
+  const int FIRST_COMPRESSED_LEVEL = 2;
+
+  enum class ColumnFamilyKind {
+    GENERIC,
+    LARGE_VALUES,
+    POINT_LOOKUP,
+    TIME_ORDERED
+  };
+
+  struct ColumnFamilyLayout {
+    std::string name;
+    ColumnFamilyKind kind;
+    std::vector<std::string> keyPrefixes;
+  };
+
+  // Keys keep their prefix, records are routed to a column family by the first byte of the key.
+  // Keys with unlisted prefixes (scheme version, counters) stay in the default column family.
+  std::vector<ColumnFamilyLayout> getColumnFamilyLayouts() {
+    return {
+      { rocksdb::kDefaultColumnFamilyName, ColumnFamilyKind::GENERIC, {} },
+      { "raw_blocks", ColumnFamilyKind::LARGE_VALUES, { DB::BLOCK_INDEX_TO_RAW_BLOCK_PREFIX } },
+      { "blocks", ColumnFamilyKind::GENERIC, { DB::BLOCK_INDEX_TO_KEY_IMAGE_PREFIX, DB::BLOCK_INDEX_TO_TX_HASHES_PREFIX,
+        DB::BLOCK_INDEX_TO_TRANSACTION_INFO_PREFIX, DB::BLOCK_HASH_TO_BLOCK_INDEX_PREFIX, DB::BLOCK_INDEX_TO_BLOCK_INFO_PREFIX,
+        DB::BLOCK_INDEX_TO_BLOCK_HASH_PREFIX } },
+      { "transactions", ColumnFamilyKind::POINT_LOOKUP, { DB::TRANSACTION_HASH_TO_TRANSACTION_INFO_PREFIX, DB::PAYMENT_ID_TO_TX_HASH_PREFIX } },
+      { "key_images", ColumnFamilyKind::POINT_LOOKUP, { DB::KEY_IMAGE_TO_BLOCK_INDEX_PREFIX } },
+      { "key_outputs", ColumnFamilyKind::POINT_LOOKUP, { DB::KEY_OUTPUT_KEY_PREFIX, DB::INPUT_KEYS_BY_OUTPUT_KEY } },
+      { "key_output_amounts", ColumnFamilyKind::GENERIC, { DB::KEY_OUTPUT_AMOUNT_PREFIX, DB::KEY_OUTPUT_AMOUNTS_COUNT_PREFIX } },
+      { "timestamps", ColumnFamilyKind::TIME_ORDERED, { DB::CLOSEST_TIMESTAMP_BLOCK_INDEX_PREFIX, DB::TIMESTAMP_TO_BLOCKHASHES_PREFIX } }
+    };
+  }
+
+  rocksdb::CompressionType getCompressionType(const std::string& name) {
+    if (name == "lz4") {
+      return rocksdb::kLZ4Compression;
+    } else if (name == "zstd") {
+      return rocksdb::kZSTDNotFinalCompression;
+    } else if (name == "none") {
+      return rocksdb::kNoCompression;
+    }
+
+    throw std::system_error(make_error_code(CryptoNote::error::DataBaseErrorCodes::INTERNAL_ERROR), "Unknown DB compression: " + name);
+  }
+
+  bool isUnsupportedCompression(const rocksdb::Status& status) {
+    return status.IsInvalidArgument() && status.ToString().find("is not linked with the binary") != std::string::npos;
+  }
 }
 
 RocksDBWrapper::RocksDBWrapper(Logging::ILogger& logger) : logger(logger, "RocksDBWrapper"), state(NOT_INITIALIZED){
@@ -49,16 +113,15 @@ void RocksDBWrapper::init(const DataBaseConfig& config) {
 
   logger(INFO) << "Opening DB in " << dataDir;
 
-  rocksdb::DB* dbPtr;
+  blockCache = rocksdb::NewLRUCache(config.getReadCacheSize());
+  statistics = rocksdb::CreateDBStatistics();
 
-  rocksdb::Options dbOptions = getDBOptions(config);
-  rocksdb::Status status = rocksdb::DB::Open(dbOptions, dataDir, &dbPtr);
+  rocksdb::Status status = open(config, false);
   if (status.ok()) {
     logger(INFO) << "DB opened in " << dataDir;
   } else if (!status.ok() && status.IsInvalidArgument()) {
     logger(INFO) << "DB not found in " << dataDir << ". Creating new DB...";
-    dbOptions.create_if_missing = true;
-    rocksdb::Status status = rocksdb::DB::Open(dbOptions, dataDir, &dbPtr);
+    rocksdb::Status status = open(config, true);
     if (!status.ok()) {
       logger(ERROR) << "DB Error. DB can't be created in " << dataDir << ". Error: " << status.ToString();
       throw std::system_error(make_error_code(CryptoNote::error::DataBaseErrorCodes::INTERNAL_ERROR));
@@ -71,18 +134,126 @@ void RocksDBWrapper::init(const DataBaseConfig& config) {
     throw std::system_error(make_error_code(CryptoNote::error::DataBaseErrorCodes::INTERNAL_ERROR));
   }
 
-  db.reset(dbPtr);
+  try {
+    moveRecordsToColumnFamilies();
+  } catch (std::exception&) {
+    closeColumnFamilies();
+    db.reset();
+    throw;
+  }
+
   state.store(INITIALIZED);
 }
 
+rocksdb::Status RocksDBWrapper::open(const DataBaseConfig& config, bool createIfMissing) {
+  std::string dataDir = getDataDir(config);
+
+  rocksdb::DBOptions dbOptions(getDBOptions(config));
+  dbOptions.create_if_missing = createIfMissing;
+  dbOptions.create_missing_column_families = true;
+  dbOptions.statistics = statistics;
+
+  rocksdb::CompressionType compression = getCompressionType(config.getCompression());
+
+  rocksdb::DB* dbPtr;
+  std::vector<rocksdb::ColumnFamilyHandle*> handles;
+  rocksdb::Status status = rocksdb::DB::Open(dbOptions, dataDir, getColumnFamilyDescriptors(config, compression), &handles, &dbPtr);
+  if (isUnsupportedCompression(status)) {
+    logger(WARNING) << "RocksDB is built without " << config.getCompression() << " compression, DB is not compressed";
+    status = rocksdb::DB::Open(dbOptions, dataDir, getColumnFamilyDescriptors(config, rocksdb::kNoCompression), &handles, &dbPtr);
+  }
+
+  if (status.ok()) {
+    db.reset(dbPtr);
+    columnFamilies = std::move(handles);
+  }
+
+  return status;
+}
+
+// Databases created before column families were introduced keep all records in the default column family.
+// Every batch moves records atomically, so an interrupted move is continued on the next start.
+void RocksDBWrapper::moveRecordsToColumnFamilies() {
+  rocksdb::ColumnFamilyHandle* defaultFamily = columnFamilies.front();
+
+  uint64_t movedCount = 0;
+  rocksdb::WriteBatch batch;
+  auto writeBatch = [this, &batch] {
+    rocksdb::Status status = db->Write(rocksdb::WriteOptions(), &batch);
+    if (!status.ok()) {
+      logger(ERROR) << "Can't move records to column families. " << status.ToString();
+      throw std::system_error(make_error_code(CryptoNote::error::DataBaseErrorCodes::INTERNAL_ERROR));
+    }
+
+    batch.Clear();
+  };
+
+  std::unique_ptr<rocksdb::Iterator> iterator(db->NewIterator(rocksdb::ReadOptions(), defaultFamily));
+  for (iterator->SeekToFirst(); iterator->Valid(); iterator->Next()) {
+    rocksdb::ColumnFamilyHandle* family = getColumnFamily(iterator->key().ToString());
+    if (family == defaultFamily) {
+      continue;
+    }
+
+    if (movedCount == 0) {
+      logger(INFO) << "Moving DB records to column families, it may take a while...";
+    }
+
+    batch.Put(family, iterator->key(), iterator->value());
+    batch.Delete(defaultFamily, iterator->key());
+    ++movedCount;
+
+    if (movedCount % RECORDS_TO_MOVE_PER_BATCH == 0) {
+      writeBatch();
+      logger(INFO) << movedCount << " records moved";
+    }
+  }
+
+  if (!iterator->status().ok()) {
+    logger(ERROR) << "Can't move records to column families. " << iterator->status().ToString();
+    throw std::system_error(make_error_code(CryptoNote::error::DataBaseErrorCodes::INTERNAL_ERROR));
+  }
+
+  if (movedCount == 0) {
+    return;
+  }
+
+  writeBatch();
+  iterator.reset();
+
+  // drop the tombstones left in the default column family
+  db->CompactRange(rocksdb::CompactRangeOptions(), defaultFamily, nullptr, nullptr);
+  logger(INFO) << "Moved " << movedCount << " records to column families";
+}
+
+rocksdb::ColumnFamilyHandle* RocksDBWrapper::getColumnFamily(const std::string& key) const {
+  if (key.empty()) {
+    return columnFamilies.front();
+  }
+
+  return columnFamilies[columnFamilyByPrefix[static_cast<uint8_t>(key[0])]];
+}
+
+void RocksDBWrapper::closeColumnFamilies() {
+  for (rocksdb::ColumnFamilyHandle* family : columnFamilies) {
+    db->DestroyColumnFamilyHandle(family);
+  }
+
+  columnFamilies.clear();
+}
+
 void RocksDBWrapper::shutdown() {
   if (state.load() != INITIALIZED) {
     throw std::system_error(make_error_code(CryptoNote::error::DataBaseErrorCodes::NOT_INITIALIZED));
   }
 
   logger(INFO) << "Closing DB.";
-  db->Flush(rocksdb::FlushOptions());
+  for (rocksdb::ColumnFamilyHandle* family : columnFamilies) {
+    db->Flush(rocksdb::FlushOptions(), family);
+  }
+
   db->SyncWAL();
+  closeColumnFamilies();
   db.reset();
   state.store(NOT_INITIALIZED);
 }
@@ -130,12 +301,12 @@ std::error_code RocksDBWrapper::write(IWriteBatch& batch, bool sync) {
   rocksdb::WriteBatch rocksdbBatch;
   std::vector<std::pair<std::string, std::string>> rawData(batch.extractRawDataToInsert());
   for (const std::pair<std::string, std::string>& kvPair : rawData) {
-    rocksdbBatch.Put(rocksdb::Slice(kvPair.first), rocksdb::Slice(kvPair.second));
+    rocksdbBatch.Put(getColumnFamily(kvPair.first), rocksdb::Slice(kvPair.first), rocksdb::Slice(kvPair.second));
   }
 
   std::vector<std::string> rawKeys(batch.extractRawKeysToRemove());
   for (const std::string& key : rawKeys) {
-    rocksdbBatch.Delete(rocksdb::Slice(key));
+    rocksdbBatch.Delete(getColumnFamily(key), rocksdb::Slice(key));
   }
 
   rocksdb::Status status = db->Write(writeOptions, &rocksdbBatch);
@@ -149,36 +320,166 @@ std::error_code RocksDBWrapper::write(IWriteBatch& batch, bool sync) {
 }
 
 std::error_code RocksDBWrapper::read(IReadBatch& batch) {
+  return read(batch, rocksdb::ReadOptions());
+}
+
+std::error_code RocksDBWrapper::read(IReadBatch& batch, const rocksdb::ReadOptions& readOptions) {
   if (state.load() != INITIALIZED) {
     throw std::runtime_error("Not initialized.");
   }
 
-  rocksdb::ReadOptions readOptions;
-
   std::vector<std::string> rawKeys(batch.getRawKeys());
+
+  // keys are looked up in sorted order so neighbouring keys share blocks, results are returned in batch order
+  std::vector<size_t> keyOrder(rawKeys.size());
+  std::iota(keyOrder.begin(), keyOrder.end(), 0);
+  std::sort(keyOrder.begin(), keyOrder.end(), [&rawKeys] (size_t left, size_t right) { return rawKeys[left] < rawKeys[right]; });
+
   std::vector<rocksdb::Slice> keySlices;
+  std::vector<rocksdb::ColumnFamilyHandle*> keyFamilies;
   keySlices.reserve(rawKeys.size());
-  for (const std::string& key : rawKeys) {
-    keySlices.emplace_back(rocksdb::Slice(key));
+  keyFamilies.reserve(rawKeys.size());
+  for (size_t keyIndex : keyOrder) {
+    keySlices.emplace_back(rocksdb::Slice(rawKeys[keyIndex]));
+    keyFamilies.push_back(getColumnFamily(rawKeys[keyIndex]));
   }
 
-  std::vector<std::string> values;
-  values.reserve(rawKeys.size());
-  std::vector<rocksdb::Status> statuses = db->MultiGet(readOptions, keySlices, &values);
+  std::vector<std::string> sortedValues;
+  sortedValues.reserve(rawKeys.size());
+  std::vector<rocksdb::Status> statuses = db->MultiGet(readOptions, keyFamilies, keySlices, &sortedValues);
 
-  std::error_code error;
-  std::vector<bool> resultStates;
-  for (const rocksdb::Status& status : statuses) {
+  std::vector<std::string> values(rawKeys.size());
+  std::vector<bool> resultStates(rawKeys.size());
+  for (size_t i = 0; i < statuses.size(); ++i) {
+    const rocksdb::Status& status = statuses[i];
     if (!status.ok() && !status.IsNotFound()) {
       return make_error_code(CryptoNote::error::DataBaseErrorCodes::INTERNAL_ERROR);
     }
-    resultStates.push_back(status.ok());
+
+    values[keyOrder[i]] = std::move(sortedValues[i]);
+    resultStates[keyOrder[i]] = status.ok();
   }
 
   batch.submitRawResult(values, resultStates);
   return std::error_code();
 }
 
+std::error_code RocksDBWrapper::iterate(const std::string& startKey, const std::function<bool(const std::string& key, const std::string& value)>& handler) {
+  return iterate(startKey, handler, rocksdb::ReadOptions());
+}
+
+std::error_code RocksDBWrapper::iterate(const std::string& startKey, const std::function<bool(const std::string& key, const std::string& value)>& handler,
+                                        rocksdb::ReadOptions readOptions) {
+  if (state.load() != INITIALIZED) {
+    throw std::runtime_error("Not initialized.");
+  }
+
+  // prefix extractors of some column families would otherwise limit iteration to the prefix of the start key
+  readOptions.total_order_seek = true;
+
+  std::vector<rocksdb::Iterator*> iteratorPtrs;
+  rocksdb::Status status = db->NewIterators(readOptions, columnFamilies, &iteratorPtrs);
+  if (!status.ok()) {
+    logger(ERROR) << "Can't iterate DB. " << status.ToString();
+    return make_error_code(CryptoNote::error::DataBaseErrorCodes::INTERNAL_ERROR);
+  }
+
+  std::vector<std::unique_ptr<rocksdb::Iterator>> iterators;
+  for (rocksdb::Iterator* iterator : iteratorPtrs) {
+    iterators.emplace_back(iterator);
+    iterator->Seek(rocksdb::Slice(startKey));
+  }
+
+  // column families hold disjoint key ranges, records are merged to keep the ascending key order
+  for (;;) {
+    rocksdb::Iterator* next = nullptr;
+    for (const std::unique_ptr<rocksdb::Iterator>& iterator : iterators) {
+      if (iterator->Valid() && (next == nullptr || iterator->key().compare(next->key()) < 0)) {
+        next = iterator.get();
+      }
+    }
+
+    if (next == nullptr || !handler(next->key().ToString(), next->value().ToString())) {
+      break;
+    }
+
+    next->Next();
+  }
+
+  for (const std::unique_ptr<rocksdb::Iterator>& iterator : iterators) {
+    if (!iterator->status().ok()) {
+      logger(ERROR) << "Can't iterate DB. " << iterator->status().ToString();
+      return make_error_code(CryptoNote::error::DataBaseErrorCodes::INTERNAL_ERROR);
+    }
+  }
+
+  return std::error_code();
+}
+
+class RocksDBWrapper::Snapshot : public IDataBase {
+public:
+  Snapshot(RocksDBWrapper& database) : database(database), snapshot(database.db->GetSnapshot()) {
+    readOptions.snapshot = snapshot;
+  }
+
+  ~Snapshot() {
+    if (database.state.load() == INITIALIZED) {
+      database.db->ReleaseSnapshot(snapshot);
+    }
+  }
+
+  std::error_code write(IWriteBatch& batch) override {
+    return make_error_code(CryptoNote::error::DataBaseErrorCodes::READ_ONLY);
+  }
+
+  std::error_code writeSync(IWriteBatch& batch) override {
+    return make_error_code(CryptoNote::error::DataBaseErrorCodes::READ_ONLY);
+  }
+
+  std::error_code read(IReadBatch& batch) override {
+    return database.read(batch, readOptions);
+  }
+
+  std::error_code iterate(const std::string& startKey, const std::function<bool(const std::string& key, const std::string& value)>& handler) override {
+    return database.iterate(startKey, handler, readOptions);
+  }
+
+private:
+  RocksDBWrapper& database;
+  const rocksdb::Snapshot* snapshot;
+  rocksdb::ReadOptions readOptions;
+};
+
+std::shared_ptr<IDataBase> RocksDBWrapper::createSnapshot() {
+  if (state.load() != INITIALIZED) {
+    throw std::system_error(make_error_code(CryptoNote::error::DataBaseErrorCodes::NOT_INITIALIZED));
+  }
+
+  return std::make_shared<Snapshot>(*this);
+}
+
+BlockCacheStatistics RocksDBWrapper::getBlockCacheStatistics() const {
+  if (state.load() != INITIALIZED) {
+    throw std::system_error(make_error_code(CryptoNote::error::DataBaseErrorCodes::NOT_INITIALIZED));
+  }
+
+  BlockCacheStatistics cacheStatistics;
+  cacheStatistics.capacity = blockCache->GetCapacity();
+  cacheStatistics.usage = blockCache->GetUsage();
+  cacheStatistics.pinnedUsage = blockCache->GetPinnedUsage();
+  cacheStatistics.hits = statistics->getTickerCount(rocksdb::BLOCK_CACHE_HIT);
+  cacheStatistics.misses = statistics->getTickerCount(rocksdb::BLOCK_CACHE_MISS);
+  cacheStatistics.indexHits = statistics->getTickerCount(rocksdb::BLOCK_CACHE_INDEX_HIT);
+  cacheStatistics.indexMisses = statistics->getTickerCount(rocksdb::BLOCK_CACHE_INDEX_MISS);
+  cacheStatistics.filterHits = statistics->getTickerCount(rocksdb::BLOCK_CACHE_FILTER_HIT);
+  cacheStatistics.filterMisses = statistics->getTickerCount(rocksdb::BLOCK_CACHE_FILTER_MISS);
+  cacheStatistics.dataHits = statistics->getTickerCount(rocksdb::BLOCK_CACHE_DATA_HIT);
+  cacheStatistics.dataMisses = statistics->getTickerCount(rocksdb::BLOCK_CACHE_DATA_MISS);
+  cacheStatistics.bloomFilterUseful = statistics->getTickerCount(rocksdb::BLOOM_FILTER_USEFUL);
+
+  return cacheStatistics;
+}
+
 rocksdb::Options RocksDBWrapper::getDBOptions(const DataBaseConfig& config) {
   rocksdb::DBOptions dbOptions;
   dbOptions.IncreaseParallelism(config.getBackgroundThreadsCount());
@@ -214,14 +515,58 @@ rocksdb::Options RocksDBWrapper::getDBOptions(const DataBaseConfig& config) {
     fOptions.compression_per_level[i] = rocksdb::kNoCompression;
   }
 
-  rocksdb::BlockBasedTableOptions tableOptions;
-  tableOptions.block_cache = rocksdb::NewLRUCache(config.getReadCacheSize());
-  std::shared_ptr<rocksdb::TableFactory> tfp(NewBlockBasedTableFactory(tableOptions));
-  fOptions.table_factory = tfp;
-
   return rocksdb::Options(dbOptions, fOptions);
 }
 
+std::vector<rocksdb::ColumnFamilyDescriptor> RocksDBWrapper::getColumnFamilyDescriptors(const DataBaseConfig& config, rocksdb::CompressionType compression) {
+  rocksdb::ColumnFamilyOptions baseOptions(getDBOptions(config));
+  for (int level = FIRST_COMPRESSED_LEVEL; level < baseOptions.num_levels; ++level) {
+    baseOptions.compression_per_level[level] = compression;
+  }
+
+  std::vector<ColumnFamilyLayout> layouts = getColumnFamilyLayouts();
+  std::vector<rocksdb::ColumnFamilyDescriptor> descriptors;
+  columnFamilyByPrefix.fill(0);
+
+  for (size_t i = 0; i < layouts.size(); ++i) {
+    const ColumnFamilyLayout& layout = layouts[i];
+    for (const std::string& prefix : layout.keyPrefixes) {
+      columnFamilyByPrefix[static_cast<uint8_t>(prefix[0])] = static_cast<uint8_t>(i);
+    }
+
+    rocksdb::ColumnFamilyOptions options(baseOptions);
+    // all column families share one read cache, index and filter blocks are charged to it as well
+    rocksdb::BlockBasedTableOptions tableOptions;
+    tableOptions.block_cache = blockCache;
+    tableOptions.cache_index_and_filter_blocks = true;
+    tableOptions.pin_l0_filter_and_index_blocks_in_cache = true;
+    tableOptions.filter_policy.reset(rocksdb::NewBloomFilterPolicy(BLOOM_FILTER_BITS_PER_KEY, false));
+
+    switch (layout.kind) {
+      case ColumnFamilyKind::GENERIC:
+        break;
+      case ColumnFamilyKind::LARGE_VALUES:
+        tableOptions.block_size = RAW_BLOCKS_BLOCK_SIZE;
+        std::fill(options.compression_per_level.begin(), options.compression_per_level.end(), compression);
+        break;
+      case ColumnFamilyKind::POINT_LOOKUP:
+        // whole key is the prefix: hashed index and memtable bloom filter for Get, ordered iteration still works
+        options.prefix_extractor.reset(rocksdb::NewNoopTransform());
+        options.memtable_prefix_bloom_size_ratio = MEMTABLE_BLOOM_SIZE_RATIO;
+        tableOptions.index_type = rocksdb::BlockBasedTableOptions::kHashSearch;
+        break;
+      case ColumnFamilyKind::TIME_ORDERED:
+        options.prefix_extractor.reset(rocksdb::NewFixedPrefixTransform(TIMESTAMP_KEY_PREFIX_LENGTH));
+        break;
+    }
+
+    options.table_factory.reset(rocksdb::NewBlockBasedTableFactory(tableOptions));
+    descriptors.emplace_back(layout.name, options);
+  }
+
+  return descriptors;
+}
+
 std::string RocksDBWrapper::getDataDir(const DataBaseConfig& config) {
   if (config.getTestnet()) {
     return config.getDataDir() + '/' + TESTNET_DB_NAME;
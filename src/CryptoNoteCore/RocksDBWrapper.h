@@ -17,9 +17,11 @@
 
 #pragma once
 
+#include <array>
 #include <atomic>
 #include <memory>
 #include <string>
+#include <vector>
 
 #include "rocksdb/db.h"
 
@@ -30,6 +32,21 @@
 
 namespace CryptoNote {
 
+struct BlockCacheStatistics {
+  uint64_t capacity;
+  uint64_t usage;
+  uint64_t pinnedUsage;
+  uint64_t hits;
+  uint64_t misses;
+  uint64_t indexHits;
+  uint64_t indexMisses;
+  uint64_t filterHits;
+  uint64_t filterMisses;
+  uint64_t dataHits;
+  uint64_t dataMisses;
+  uint64_t bloomFilterUseful;
+};
+
 class RocksDBWrapper : public IDataBase {
 public:
   RocksDBWrapper(Logging::ILogger& logger);
@@ -48,11 +65,26 @@ public:
   std::error_code write(IWriteBatch& batch) override;
   std::error_code writeSync(IWriteBatch& batch) override;
   std::error_code read(IReadBatch& batch) override;
+  std::error_code iterate(const std::string& startKey, const std::function<bool(const std::string& key, const std::string& value)>& handler) override;
+  std::shared_ptr<IDataBase> createSnapshot() override;
+
+  BlockCacheStatistics getBlockCacheStatistics() const;
 
 private:
+  class Snapshot;
+
   std::error_code write(IWriteBatch& batch, bool sync);
+  std::error_code read(IReadBatch& batch, const rocksdb::ReadOptions& readOptions);
+  std::error_code iterate(const std::string& startKey, const std::function<bool(const std::string& key, const std::string& value)>& handler,
+                          rocksdb::ReadOptions readOptions);
+
+  rocksdb::Status open(const DataBaseConfig& config, bool createIfMissing);
+  void moveRecordsToColumnFamilies();
+  rocksdb::ColumnFamilyHandle* getColumnFamily(const std::string& key) const;
+  void closeColumnFamilies();
 
   rocksdb::Options getDBOptions(const DataBaseConfig& config);
+  std::vector<rocksdb::ColumnFamilyDescriptor> getColumnFamilyDescriptors(const DataBaseConfig& config, rocksdb::CompressionType compression);
   std::string getDataDir(const DataBaseConfig& config);
 
   enum State {
@@ -62,6 +94,12 @@ private:
 
   Logging::LoggerRef logger;
   std::unique_ptr<rocksdb::DB> db;
+  // index 0 is the default column family
+  std::vector<rocksdb::ColumnFamilyHandle*> columnFamilies;
+  // column family index for every possible first byte of a key
+  std::array<uint8_t, 256> columnFamilyByPrefix;
+  std::shared_ptr<rocksdb::Cache> blockCache;
+  std::shared_ptr<rocksdb::Statistics> statistics;
   std::atomic<State> state;
 };
 }
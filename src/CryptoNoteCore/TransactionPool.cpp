@@ -49,6 +49,10 @@ const Crypto::Hash& TransactionPool::PendingTransactionInfo::getTransactionHash(
   return cachedTransaction.getTransactionHash();
 }
 
+size_t TransactionPool::PendingTransactionInfo::getTransactionSize() const {
+  return cachedTransaction.getTransactionBinaryArray().size();
+}
+
 size_t TransactionPool::PaymentIdHasher::operator() (const boost::optional<Crypto::Hash>& paymentId) const {
   if (!paymentId) {
     return std::numeric_limits<size_t>::max();
@@ -57,14 +61,18 @@ size_t TransactionPool::PaymentIdHasher::operator() (const boost::optional<Crypt
   return std::hash<Crypto::Hash>{}(*paymentId);
 }
 
-TransactionPool::TransactionPool(Logging::ILogger& logger) :
+TransactionPool::TransactionPool(Logging::ILogger& logger, uint64_t maxSize) :
+  poolSize(0),
+  maxPoolSize(maxSize),
+  statistics(TransactionPoolStatistics{0, maxSize, 0, 0, 0, 0, 0}),
   transactionHashIndex(transactions.get<TransactionHashTag>()),
   transactionCostIndex(transactions.get<TransactionCostTag>()),
   paymentIdIndex(transactions.get<PaymentIdTag>()),
   logger(logger, "TransactionPool") {
 }
 
-bool TransactionPool::pushTransaction(CachedTransaction&& transaction, TransactionValidatorState&& transactionState) {
+bool TransactionPool::pushTransaction(CachedTransaction&& transaction, TransactionValidatorState&& transactionState,
+                                      std::vector<Crypto::Hash>& evictedTransactions) {
   auto pendingTx = PendingTransactionInfo{static_cast<uint64_t>(time(nullptr)), std::move(transaction)};
 
   Crypto::Hash paymentId;
@@ -74,15 +82,22 @@ bool TransactionPool::pushTransaction(CachedTransaction&& transaction, Transacti
 
   if (transactionHashIndex.count(pendingTx.getTransactionHash()) > 0) {
     logger(Logging::DEBUGGING) << "pushTransaction: transaction hash already present in index";
+    ++statistics.rejectedDuplicates;
     return false;
   }
 
   if (hasIntersections(poolState, transactionState)) {
     logger(Logging::DEBUGGING) << "pushTransaction: failed to merge states, some keys already used";
+    ++statistics.rejectedConflicting;
+    return false;
+  }
+
+  if (!makeRoomFor(pendingTx, evictedTransactions)) {
     return false;
   }
 
   mergeStates(poolState, transactionState);
+  poolSize += pendingTx.getTransactionSize();
 
   logger(Logging::DEBUGGING) << "pushed transaction " << pendingTx.getTransactionHash() << " to pool";
   return transactionHashIndex.emplace(std::move(pendingTx)).second;
@@ -103,6 +118,7 @@ bool TransactionPool::removeTransaction(const Crypto::Hash& hash) {
   }
 
   excludeFromState(poolState, it->cachedTransaction);
+  poolSize -= it->getTransactionSize();
   transactionHashIndex.erase(it);
 
   logger(Logging::DEBUGGING) << "transaction " << hash << " removed from pool";
@@ -141,6 +157,23 @@ std::vector<CachedTransaction> TransactionPool::getPoolTransactions() const {
   return result;
 }
 
+std::vector<const CachedTransaction*> TransactionPool::getPoolTransactionsByPriority() const {
+  std::vector<const CachedTransaction*> result;
+  result.reserve(transactionCostIndex.size());
+
+  for (const auto& transactionItem: transactionCostIndex) {
+    result.push_back(&transactionItem.cachedTransaction);
+  }
+
+  return result;
+}
+
+TransactionPoolStatistics TransactionPool::getStatistics() const {
+  TransactionPoolStatistics result = statistics;
+  result.size = poolSize;
+  return result;
+}
+
 uint64_t TransactionPool::getTransactionReceiveTime(const Crypto::Hash& hash) const {
   auto it = transactionHashIndex.find(hash);
   assert(it != transactionHashIndex.end());
@@ -161,4 +194,45 @@ std::vector<Crypto::Hash> TransactionPool::getTransactionHashesByPaymentId(const
   return transactionHashes;
 }
 
+bool TransactionPool::makeRoomFor(const PendingTransactionInfo& pendingTx, std::vector<Crypto::Hash>& evictedTransactions) {
+  if (maxPoolSize == 0) {
+    return true;
+  }
+
+  size_t transactionSize = pendingTx.getTransactionSize();
+  if (transactionSize > maxPoolSize) {
+    logger(Logging::DEBUGGING) << "pushTransaction: transaction " << pendingTx.getTransactionHash() << " is larger than the pool";
+    ++statistics.rejectedTooLarge;
+    return false;
+  }
+
+  // Only transactions with a lower priority than the new one can be evicted, they are at the end of the cost index
+  TransactionPriorityComparator isPreferred;
+  uint64_t freedSize = 0;
+  auto firstEvicted = transactionCostIndex.end();
+  while (poolSize - freedSize + transactionSize > maxPoolSize) {
+    assert(firstEvicted != transactionCostIndex.begin());
+    --firstEvicted;
+
+    if (!isPreferred(pendingTx, *firstEvicted)) {
+      logger(Logging::DEBUGGING) << "pushTransaction: pool is full, transaction " << pendingTx.getTransactionHash() << " fee rate is too low";
+      ++statistics.rejectedLowFeeRate;
+      return false;
+    }
+
+    freedSize += firstEvicted->getTransactionSize();
+  }
+
+  while (firstEvicted != transactionCostIndex.end()) {
+    logger(Logging::DEBUGGING) << "transaction " << firstEvicted->getTransactionHash() << " evicted from full pool";
+    evictedTransactions.push_back(firstEvicted->getTransactionHash());
+    excludeFromState(poolState, firstEvicted->cachedTransaction);
+    poolSize -= firstEvicted->getTransactionSize();
+    firstEvicted = transactionCostIndex.erase(firstEvicted);
+    ++statistics.evictedTransactions;
+  }
+
+  return true;
+}
+
 }
@@ -36,9 +36,10 @@ namespace CryptoNote {
 
 class TransactionPool : public ITransactionPool {
 public:
-  TransactionPool(Logging::ILogger& logger);
+  // maxSize limits the summary size of pool transactions in bytes, 0 - no limit
+  TransactionPool(Logging::ILogger& logger, uint64_t maxSize = 0);
 
-  virtual bool pushTransaction(CachedTransaction&& transaction, TransactionValidatorState&& transactionState) override;
+  virtual bool pushTransaction(CachedTransaction&& transaction, TransactionValidatorState&& transactionState, std::vector<Crypto::Hash>& evictedTransactions) override;
   virtual const CachedTransaction& getTransaction(const Crypto::Hash& hash) const override;
   virtual bool removeTransaction(const Crypto::Hash& hash) override;
 
@@ -48,11 +49,16 @@ public:
 
   virtual const TransactionValidatorState& getPoolTransactionValidationState() const override;
   virtual std::vector<CachedTransaction> getPoolTransactions() const override;
+  virtual std::vector<const CachedTransaction*> getPoolTransactionsByPriority() const override;
+  virtual TransactionPoolStatistics getStatistics() const override;
 
   virtual uint64_t getTransactionReceiveTime(const Crypto::Hash& hash) const override;
   virtual std::vector<Crypto::Hash> getTransactionHashesByPaymentId(const Crypto::Hash& paymentId) const override;
 private:
   TransactionValidatorState poolState;
+  uint64_t poolSize;
+  uint64_t maxPoolSize;
+  TransactionPoolStatistics statistics;
 
   struct PendingTransactionInfo {
     uint64_t receiveTime;
@@ -60,6 +66,7 @@ private:
     boost::optional<Crypto::Hash> paymentId;
 
     const Crypto::Hash& getTransactionHash() const;
+    size_t getTransactionSize() const;
   };
 
   struct TransactionPriorityComparator {
@@ -111,6 +118,8 @@ private:
   TransactionsContainer::index<PaymentIdTag>::type& paymentIdIndex;
   
   Logging::LoggerRef logger;
+
+  bool makeRoomFor(const PendingTransactionInfo& pendingTx, std::vector<Crypto::Hash>& evictedTransactions);
 };
 
 }
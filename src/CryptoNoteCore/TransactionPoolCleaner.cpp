@@ -41,8 +41,10 @@ TransactionPoolCleanWrapper::TransactionPoolCleanWrapper(
 TransactionPoolCleanWrapper::~TransactionPoolCleanWrapper() {
 }
 
-bool TransactionPoolCleanWrapper::pushTransaction(CachedTransaction&& tx, TransactionValidatorState&& transactionState) {
-  return !isTransactionRecentlyDeleted(tx.getTransactionHash()) && transactionPool->pushTransaction(std::move(tx), std::move(transactionState));
+bool TransactionPoolCleanWrapper::pushTransaction(CachedTransaction&& tx, TransactionValidatorState&& transactionState,
+                                                  std::vector<Crypto::Hash>& evictedTransactions) {
+  return !isTransactionRecentlyDeleted(tx.getTransactionHash()) &&
+         transactionPool->pushTransaction(std::move(tx), std::move(transactionState), evictedTransactions);
 }
 
 const CachedTransaction& TransactionPoolCleanWrapper::getTransaction(const Crypto::Hash& hash) const {
@@ -73,6 +75,14 @@ std::vector<CachedTransaction> TransactionPoolCleanWrapper::getPoolTransactions(
   return transactionPool->getPoolTransactions();
 }
 
+std::vector<const CachedTransaction*> TransactionPoolCleanWrapper::getPoolTransactionsByPriority() const {
+  return transactionPool->getPoolTransactionsByPriority();
+}
+
+TransactionPoolStatistics TransactionPoolCleanWrapper::getStatistics() const {
+  return transactionPool->getStatistics();
+}
+
 uint64_t TransactionPoolCleanWrapper::getTransactionReceiveTime(const Crypto::Hash& hash) const {
   return transactionPool->getTransactionReceiveTime(hash);
 }
@@ -49,7 +49,7 @@ public:
 
   virtual ~TransactionPoolCleanWrapper();
 
-  virtual bool pushTransaction(CachedTransaction&& tx, TransactionValidatorState&& transactionState) override;
+  virtual bool pushTransaction(CachedTransaction&& tx, TransactionValidatorState&& transactionState, std::vector<Crypto::Hash>& evictedTransactions) override;
   virtual const CachedTransaction& getTransaction(const Crypto::Hash& hash) const override;
   virtual bool removeTransaction(const Crypto::Hash& hash) override;
 
@@ -59,6 +59,8 @@ public:
 
   virtual const TransactionValidatorState& getPoolTransactionValidationState() const override;
   virtual std::vector<CachedTransaction> getPoolTransactions() const override;
+  virtual std::vector<const CachedTransaction*> getPoolTransactionsByPriority() const override;
+  virtual TransactionPoolStatistics getStatistics() const override;
 
   virtual uint64_t getTransactionReceiveTime(const Crypto::Hash& hash) const override;
   virtual std::vector<Crypto::Hash> getTransactionHashesByPaymentId(const Crypto::Hash& paymentId) const override;
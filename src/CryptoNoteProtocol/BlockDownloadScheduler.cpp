@@ -0,0 +1,380 @@
+// Copyright (c) 2012-2017, The CryptoNote developers, The Bytecoin developers
+//
+// This file is part of Bytecoin.
+//
+// Bytecoin is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Bytecoin is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with Bytecoin.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "BlockDownloadScheduler.h"
+
+#include <algorithm>
+#include <cassert>
+
+#include "CryptoNoteConfig.h"
+#include "CryptoNoteCore/CryptoNoteBasic.h"
+#include "crypto/hash.h"
+
+namespace CryptoNote {
+
+namespace {
+
+// a span is sized to last at least this many round trips, so the latency doesn't dominate its download time
+const uint32_t ROUND_TRIPS_PER_SPAN = 4;
+const uint32_t SPAN_TIMEOUT_FACTOR = 4;
+
+uint64_t getBlocksSize(const std::vector<RawBlock>& blocks) {
+  uint64_t size = 0;
+  for (const auto& block : blocks) {
+    size += block.block.size();
+    for (const auto& transaction : block.transactions) {
+      size += transaction.size();
+    }
+  }
+
+  return size;
+}
+
+uint64_t toMilliseconds(BlockDownloadScheduler::Clock::duration duration) {
+  return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::milliseconds>(duration).count());
+}
+
+}
+
+BlockDownloadScheduler::Peer::Peer() :
+  statistics{0, Clock::duration::zero(), 0},
+  knowsChain(false),
+  chainEnd(0),
+  chainTop(NULL_HASH),
+  chainRequested(false),
+  requesting(false) {
+}
+
+BlockDownloadScheduler::BlockDownloadScheduler() : startIndex(0), spanPopped(false), bufferedBytes(0), averageBlockSize(0) {
+}
+
+bool BlockDownloadScheduler::addChain(const PeerId& peerId, uint32_t index, std::vector<Crypto::Hash>&& hashes) {
+  assert(!hashes.empty());
+
+  Peer& peer = peers[peerId];
+  peer.chainRequested = false;
+
+  uint32_t end = index + static_cast<uint32_t>(hashes.size());
+  if (empty()) {
+    // the queue is replaced, nobody knows the new chain but this peer
+    for (auto& item : peers) {
+      item.second.knowsChain = false;
+    }
+
+    startIndex = index;
+    unassignedHashes.assign(hashes.begin(), hashes.end());
+  } else {
+    uint32_t endIndex = getEndIndex();
+    if (index > endIndex) {
+      peer.knowsChain = false;
+      return false;
+    }
+
+    // hashes before startIndex belong to the blocks already handed out, they can't be checked
+    uint32_t hashIndex = startIndex;
+    auto matches = [&](const Crypto::Hash& hash) {
+      bool result = hashIndex < index || hashIndex >= end || hash == hashes[hashIndex - index];
+      ++hashIndex;
+      return result;
+    };
+
+    for (const auto& span : spans) {
+      if (!std::all_of(span.hashes.begin(), span.hashes.end(), matches)) {
+        peer.knowsChain = false;
+        return false;
+      }
+    }
+
+    if (!std::all_of(unassignedHashes.begin(), unassignedHashes.end(), matches)) {
+      peer.knowsChain = false;
+      return false;
+    }
+
+    for (uint32_t i = std::max(index, endIndex); i < end; ++i) {
+      unassignedHashes.push_back(hashes[i - index]);
+    }
+  }
+
+  if (!peer.knowsChain || peer.chainEnd < end) {
+    peer.chainEnd = end;
+    peer.chainTop = hashes.back();
+  }
+
+  peer.knowsChain = true;
+  return true;
+}
+
+bool BlockDownloadScheduler::knowsChain(const PeerId& peer) const {
+  auto it = peers.find(peer);
+  return it != peers.end() && it->second.knowsChain;
+}
+
+uint32_t BlockDownloadScheduler::getPeerChainEnd(const PeerId& peer) const {
+  auto it = peers.find(peer);
+  return it != peers.end() && it->second.knowsChain ? it->second.chainEnd : 0;
+}
+
+const Crypto::Hash& BlockDownloadScheduler::getPeerChainTop(const PeerId& peer) const {
+  auto it = peers.find(peer);
+  return it != peers.end() && it->second.knowsChain ? it->second.chainTop : NULL_HASH;
+}
+
+void BlockDownloadScheduler::setChainRequested(const PeerId& peer, bool requested) {
+  peers[peer].chainRequested = requested;
+}
+
+bool BlockDownloadScheduler::isChainRequested(const PeerId& peer) const {
+  auto it = peers.find(peer);
+  return it != peers.end() && it->second.chainRequested;
+}
+
+std::vector<Crypto::Hash> BlockDownloadScheduler::requestSpan(const PeerId& peerId, Clock::time_point now) {
+  Peer& peer = peers[peerId];
+  if (peer.requesting || !peer.knowsChain) {
+    return {};
+  }
+
+  for (auto& span : spans) {
+    if (span.startIndex + span.hashes.size() > peer.chainEnd) {
+      break;
+    }
+
+    if (span.received || (span.requested && now < span.deadline)) {
+      continue;
+    }
+
+    if (span.requested) {
+      // the previous requester still may answer, but it is assumed to be slower than measured
+      auto requester = peers.find(span.requester);
+      if (requester != peers.end()) {
+        requester->second.statistics.bytesPerSecond /= 2;
+      }
+    }
+
+    return startRequest(peer, peerId, span, now);
+  }
+
+  if (unassignedHashes.empty() || bufferedBytes >= BLOCKS_SYNCHRONIZING_MAX_BUFFERED_SIZE) {
+    return {};
+  }
+
+  uint32_t index = getEndIndex() - static_cast<uint32_t>(unassignedHashes.size());
+  if (index >= peer.chainEnd) {
+    return {};
+  }
+
+  size_t count = std::min({getSpanSize(peerId), static_cast<size_t>(peer.chainEnd - index), unassignedHashes.size()});
+
+  spans.emplace_back();
+  QueuedSpan& span = spans.back();
+  span.startIndex = index;
+  span.hashes.assign(unassignedHashes.begin(), unassignedHashes.begin() + count);
+  span.requested = false;
+  span.received = false;
+  span.size = 0;
+  unassignedHashes.erase(unassignedHashes.begin(), unassignedHashes.begin() + count);
+
+  return startRequest(peer, peerId, span, now);
+}
+
+bool BlockDownloadScheduler::isRequesting(const PeerId& peer) const {
+  auto it = peers.find(peer);
+  return it != peers.end() && it->second.requesting;
+}
+
+bool BlockDownloadScheduler::receiveSpan(const PeerId& peerId, const std::vector<Crypto::Hash>& hashes,
+  std::vector<RawBlock>&& blocks, std::vector<BlockTemplate>&& blockTemplates, Clock::time_point now) {
+  assert(blocks.size() == hashes.size() && blockTemplates.size() == hashes.size());
+
+  uint64_t size = getBlocksSize(blocks);
+
+  auto peer = peers.find(peerId);
+  if (peer != peers.end() && peer->second.requesting) {
+    updateStatistics(peer->second, size, blocks.size(), now);
+    peer->second.requesting = false;
+  }
+
+  for (auto& span : spans) {
+    if (!span.received && span.hashes == hashes) {
+      span.received = true;
+      span.sender = peerId;
+      span.size = size;
+      span.blocks = std::move(blocks);
+      span.blockTemplates = std::move(blockTemplates);
+      bufferedBytes += size;
+      return true;
+    }
+  }
+
+  return false;
+}
+
+std::vector<BlockDownloadScheduler::PeerId> BlockDownloadScheduler::releaseTimedOutSpans(Clock::time_point now) {
+  std::vector<PeerId> requesters;
+  for (auto& span : spans) {
+    if (!span.requested || span.received || now < span.deadline) {
+      continue;
+    }
+
+    // the requester still may answer, but it is assumed to be slower than measured
+    auto requester = peers.find(span.requester);
+    if (requester != peers.end()) {
+      requester->second.statistics.bytesPerSecond /= 2;
+    }
+
+    span.requested = false;
+    requesters.push_back(span.requester);
+  }
+
+  return requesters;
+}
+
+bool BlockDownloadScheduler::hasReadySpan() const {
+  return !spans.empty() && spans.front().received;
+}
+
+BlockDownloadScheduler::Span BlockDownloadScheduler::popReadySpan() {
+  assert(hasReadySpan());
+
+  QueuedSpan& queued = spans.front();
+  Span span{queued.startIndex, std::move(queued.hashes), std::move(queued.blocks), std::move(queued.blockTemplates),
+    queued.sender};
+
+  bufferedBytes -= queued.size;
+  startIndex += static_cast<uint32_t>(span.hashes.size());
+  spans.pop_front();
+  spanPopped = true;
+
+  return span;
+}
+
+void BlockDownloadScheduler::completeSpan() {
+  spanPopped = false;
+}
+
+void BlockDownloadScheduler::requeueSpan(Span&& span) {
+  if (!spanPopped) {
+    // the chain is requested again after the reset
+    return;
+  }
+
+  assert(span.startIndex + span.hashes.size() == startIndex);
+  spanPopped = false;
+
+  spans.emplace_front();
+  QueuedSpan& queued = spans.front();
+  queued.startIndex = span.startIndex;
+  queued.hashes = std::move(span.hashes);
+  queued.requested = false;
+  queued.received = false;
+  queued.size = 0;
+  startIndex = span.startIndex;
+}
+
+void BlockDownloadScheduler::removePeer(const PeerId& peer) {
+  peers.erase(peer);
+
+  for (auto& span : spans) {
+    if (span.requested && !span.received && span.requester == peer) {
+      span.requested = false;
+    }
+  }
+}
+
+void BlockDownloadScheduler::reset() {
+  spans.clear();
+  unassignedHashes.clear();
+  spanPopped = false;
+  bufferedBytes = 0;
+
+  for (auto& item : peers) {
+    item.second.knowsChain = false;
+    item.second.chainRequested = false;
+  }
+}
+
+bool BlockDownloadScheduler::empty() const {
+  return spans.empty() && unassignedHashes.empty() && !spanPopped;
+}
+
+uint32_t BlockDownloadScheduler::getStartIndex() const {
+  return startIndex;
+}
+
+uint32_t BlockDownloadScheduler::getEndIndex() const {
+  uint32_t spansEnd = spans.empty() ? startIndex :
+    spans.back().startIndex + static_cast<uint32_t>(spans.back().hashes.size());
+
+  return spansEnd + static_cast<uint32_t>(unassignedHashes.size());
+}
+
+BlockDownloadScheduler::PeerStatistics BlockDownloadScheduler::getPeerStatistics(const PeerId& peer) const {
+  auto it = peers.find(peer);
+  return it != peers.end() ? it->second.statistics : PeerStatistics{0, Clock::duration::zero(), 0};
+}
+
+size_t BlockDownloadScheduler::getSpanSize(const PeerId& peerId) const {
+  auto peer = peers.find(peerId);
+  if (peer == peers.end() || peer->second.statistics.bytesPerSecond == 0 || averageBlockSize == 0) {
+    return BLOCKS_SYNCHRONIZING_INITIAL_COUNT;
+  }
+
+  const PeerStatistics& statistics = peer->second.statistics;
+  uint64_t duration = std::max<uint64_t>(BLOCKS_SYNCHRONIZING_SPAN_DURATION,
+    ROUND_TRIPS_PER_SPAN * toMilliseconds(statistics.roundTrip));
+  uint64_t count = statistics.bytesPerSecond * duration / 1000 / averageBlockSize;
+
+  return static_cast<size_t>(std::max<uint64_t>(BLOCKS_SYNCHRONIZING_MIN_COUNT,
+    std::min<uint64_t>(count, BLOCKS_SYNCHRONIZING_DEFAULT_COUNT)));
+}
+
+BlockDownloadScheduler::Clock::duration BlockDownloadScheduler::getSpanTimeout(const Peer& peer, size_t count) const {
+  if (peer.statistics.bytesPerSecond == 0 || averageBlockSize == 0) {
+    return std::chrono::milliseconds(BLOCKS_SYNCHRONIZING_INITIAL_TIMEOUT);
+  }
+
+  uint64_t expected = toMilliseconds(peer.statistics.roundTrip) + count * averageBlockSize * 1000 / peer.statistics.bytesPerSecond;
+  return std::chrono::milliseconds(std::max<uint64_t>(BLOCKS_SYNCHRONIZING_MIN_TIMEOUT, SPAN_TIMEOUT_FACTOR * expected));
+}
+
+std::vector<Crypto::Hash> BlockDownloadScheduler::startRequest(Peer& peer, const PeerId& peerId, QueuedSpan& span, Clock::time_point now) {
+  span.requested = true;
+  span.requester = peerId;
+  span.deadline = now + getSpanTimeout(peer, span.hashes.size());
+
+  peer.requesting = true;
+  peer.requestTime = now;
+
+  return span.hashes;
+}
+
+void BlockDownloadScheduler::updateStatistics(Peer& peer, uint64_t bytes, size_t count, Clock::time_point now) {
+  Clock::duration elapsed = std::max(now - peer.requestTime, Clock::duration(std::chrono::milliseconds(1)));
+  uint64_t bytesPerSecond = bytes * 1000 / std::max<uint64_t>(toMilliseconds(elapsed), 1);
+
+  PeerStatistics& statistics = peer.statistics;
+  statistics.bytesPerSecond = statistics.bytesPerSecond == 0 ? bytesPerSecond : (statistics.bytesPerSecond * 3 + bytesPerSecond) / 4;
+  // the quickest response is the closest one to the bare round trip
+  statistics.roundTrip = statistics.roundTrip == Clock::duration::zero() ? elapsed : std::min(statistics.roundTrip, elapsed);
+  statistics.receivedBytes += bytes;
+
+  if (count != 0) {
+    averageBlockSize = averageBlockSize == 0 ? bytes / count : (averageBlockSize * 7 + bytes / count) / 8;
+  }
+}
+
+}
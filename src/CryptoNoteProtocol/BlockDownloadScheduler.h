@@ -0,0 +1,140 @@
+// Copyright (c) 2012-2017, The CryptoNote developers, The Bytecoin developers
+//
+// This file is part of Bytecoin.
+//
+// Bytecoin is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Bytecoin is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with Bytecoin.  If not, see <http://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <chrono>
+#include <deque>
+#include <map>
+#include <vector>
+
+#include <boost/uuid/uuid.hpp>
+
+#include "CryptoNote.h"
+
+namespace CryptoNote {
+
+// Splits the block hashes received from synchronizing peers into spans, hands them out to the peers proportionally
+// to their measured throughput and returns the downloaded blocks in chain order
+class BlockDownloadScheduler {
+public:
+  using Clock = std::chrono::steady_clock;
+  using PeerId = boost::uuids::uuid;
+
+  struct PeerStatistics {
+    uint64_t bytesPerSecond;
+    Clock::duration roundTrip;
+    uint64_t receivedBytes;
+  };
+
+  struct Span {
+    uint32_t startIndex;
+    std::vector<Crypto::Hash> hashes;
+    std::vector<RawBlock> blocks;
+    std::vector<BlockTemplate> blockTemplates;
+    PeerId sender;
+  };
+
+  BlockDownloadScheduler();
+
+  // startIndex is the index of hashes.front(), all hashes must be unknown to the local chain. Returns false if the
+  // hashes contradict the queued ones, the peer has to wait until the queue is downloaded then
+  bool addChain(const PeerId& peer, uint32_t startIndex, std::vector<Crypto::Hash>&& hashes);
+  bool knowsChain(const PeerId& peer) const;
+  // index after the last queued hash known by the peer
+  uint32_t getPeerChainEnd(const PeerId& peer) const;
+  const Crypto::Hash& getPeerChainTop(const PeerId& peer) const;
+
+  void setChainRequested(const PeerId& peer, bool requested);
+  bool isChainRequested(const PeerId& peer) const;
+
+  // Returns the hashes of the blocks to request from the peer: a span timed out at another peer first, a new one
+  // sized by the peer throughput otherwise. Returns nothing if the peer has a request in flight or knows no
+  // blocks left to request
+  std::vector<Crypto::Hash> requestSpan(const PeerId& peer, Clock::time_point now);
+  bool isRequesting(const PeerId& peer) const;
+
+  // Completes the request of the peer. Returns false if the blocks are dropped because the span was received from
+  // another peer before
+  bool receiveSpan(const PeerId& peer, const std::vector<Crypto::Hash>& hashes, std::vector<RawBlock>&& blocks,
+    std::vector<BlockTemplate>&& blockTemplates, Clock::time_point now);
+
+  // Makes the spans not received by their deadline available to the other peers and returns their requesters.
+  // A late answer is still accepted if the span wasn't received from another peer meanwhile
+  std::vector<PeerId> releaseTimedOutSpans(Clock::time_point now);
+
+  bool hasReadySpan() const;
+  // The popped span stays in the queue until it is completed or requeued: adding its blocks yields, and a chain
+  // received meanwhile must extend the queue rather than replace it
+  Span popReadySpan();
+  // Ends the addition of the last popped span
+  void completeSpan();
+  // Puts the last popped span back to be downloaded again, e.g. after its sender sent an invalid block.
+  // Does nothing if the queue was reset meanwhile
+  void requeueSpan(Span&& span);
+
+  void removePeer(const PeerId& peer);
+  // Forgets the queued chain, e.g. after one of its blocks failed validation
+  void reset();
+
+  bool empty() const;
+  uint32_t getStartIndex() const;
+  uint32_t getEndIndex() const;
+
+  PeerStatistics getPeerStatistics(const PeerId& peer) const;
+  size_t getSpanSize(const PeerId& peer) const;
+
+private:
+  struct QueuedSpan {
+    uint32_t startIndex;
+    std::vector<Crypto::Hash> hashes;
+    bool requested;
+    PeerId requester;
+    Clock::time_point deadline;
+    bool received;
+    PeerId sender;
+    uint64_t size;
+    std::vector<RawBlock> blocks;
+    std::vector<BlockTemplate> blockTemplates;
+  };
+
+  struct Peer {
+    Peer();
+
+    PeerStatistics statistics;
+    bool knowsChain;
+    uint32_t chainEnd;
+    Crypto::Hash chainTop;
+    bool chainRequested;
+    bool requesting;
+    Clock::time_point requestTime;
+  };
+
+  Clock::duration getSpanTimeout(const Peer& peer, size_t count) const;
+  std::vector<Crypto::Hash> startRequest(Peer& peer, const PeerId& peerId, QueuedSpan& span, Clock::time_point now);
+  void updateStatistics(Peer& peer, uint64_t bytes, size_t count, Clock::time_point now);
+
+  std::deque<QueuedSpan> spans;
+  std::deque<Crypto::Hash> unassignedHashes;
+  uint32_t startIndex;
+  bool spanPopped;
+  uint64_t bufferedBytes;
+  uint64_t averageBlockSize;
+  std::map<PeerId, Peer> peers;
+};
+
+}
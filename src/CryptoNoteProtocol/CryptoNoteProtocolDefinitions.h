@@ -149,4 +149,81 @@ namespace CryptoNote
     const static int ID = BC_COMMANDS_POOL_BASE + 8;
     typedef NOTIFY_REQUEST_TX_POOL_request request;
   };
+
+  /************************************************************************/
+  /*                                                                      */
+  /************************************************************************/
+  // block without transactions, the receiver takes them from its pool and requests the missing ones
+  struct NOTIFY_NEW_COMPACT_BLOCK_request {
+    BinaryArray block; //BlockTemplate
+    uint32_t current_blockchain_height;
+    uint32_t hop;
+
+    void serialize(ISerializer& s) {
+      serializeAsBinary(block, "block", s);
+      KV_MEMBER(current_blockchain_height)
+      KV_MEMBER(hop)
+    }
+  };
+
+  struct NOTIFY_NEW_COMPACT_BLOCK {
+    const static int ID = BC_COMMANDS_POOL_BASE + 9;
+    typedef NOTIFY_NEW_COMPACT_BLOCK_request request;
+  };
+
+  struct NOTIFY_REQUEST_BLOCK_TRANSACTIONS_request {
+    Crypto::Hash block_hash;
+    std::vector<Crypto::Hash> txs;
+
+    void serialize(ISerializer& s) {
+      KV_MEMBER(block_hash)
+      serializeAsBinary(txs, "txs", s);
+    }
+  };
+
+  struct NOTIFY_REQUEST_BLOCK_TRANSACTIONS {
+    const static int ID = BC_COMMANDS_POOL_BASE + 10;
+    typedef NOTIFY_REQUEST_BLOCK_TRANSACTIONS_request request;
+  };
+
+  struct NOTIFY_RESPONSE_BLOCK_TRANSACTIONS_request {
+    Crypto::Hash block_hash;
+    std::vector<BinaryArray> txs;
+  };
+
+  struct NOTIFY_RESPONSE_BLOCK_TRANSACTIONS {
+    const static int ID = BC_COMMANDS_POOL_BASE + 11;
+    typedef NOTIFY_RESPONSE_BLOCK_TRANSACTIONS_request request;
+  };
+
+  /************************************************************************/
+  /*                                                                      */
+  /************************************************************************/
+  // hashes of new transactions, the receiver requests the unknown ones with NOTIFY_REQUEST_TXS
+  struct NOTIFY_TX_INVENTORY_request {
+    std::vector<Crypto::Hash> txs;
+
+    void serialize(ISerializer& s) {
+      serializeAsBinary(txs, "txs", s);
+    }
+  };
+
+  struct NOTIFY_TX_INVENTORY {
+    const static int ID = BC_COMMANDS_POOL_BASE + 12;
+    typedef NOTIFY_TX_INVENTORY_request request;
+  };
+
+  // answered with NOTIFY_NEW_TRANSACTIONS holding the requested transactions still in the pool
+  struct NOTIFY_REQUEST_TXS_request {
+    std::vector<Crypto::Hash> txs;
+
+    void serialize(ISerializer& s) {
+      serializeAsBinary(txs, "txs", s);
+    }
+  };
+
+  struct NOTIFY_REQUEST_TXS {
+    const static int ID = BC_COMMANDS_POOL_BASE + 13;
+    typedef NOTIFY_REQUEST_TXS_request request;
+  };
 }
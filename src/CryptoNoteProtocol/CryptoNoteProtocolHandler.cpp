@@ -18,6 +18,8 @@
 #include "CryptoNoteProtocolHandler.h"
 
 #include <future>
+#include <limits>
+#include <unordered_set>
 #include <boost/scope_exit.hpp>
 #include <boost/uuid/uuid_io.hpp>
 #include <System/Dispatcher.h>
@@ -41,11 +43,6 @@ bool post_notify(IP2pEndpoint& p2p, typename t_parametr::request& arg, const Cry
   return p2p.invoke_notify_to_peer(t_parametr::ID, LevinProtocol::encode(arg), context);
 }
 
-template<class t_parametr>
-void relay_post_notify(IP2pEndpoint& p2p, typename t_parametr::request& arg, const net_connection_id* excludeConnection = nullptr) {
-  p2p.relay_notify_to_all(t_parametr::ID, LevinProtocol::encode(arg), excludeConnection);
-}
-
 std::vector<RawBlockLegacy> convertRawBlocksToRawBlocksLegacy(const std::vector<RawBlock>& rawBlocks) {
   std::vector<RawBlockLegacy> legacy;
   legacy.reserve(rawBlocks.size());
@@ -119,6 +116,25 @@ static inline void serialize(NOTIFY_NEW_TRANSACTIONS_request& request, ISerializ
   }
 }
 
+// transactions are packed as strings like in NOTIFY_NEW_TRANSACTIONS
+static inline void serialize(NOTIFY_RESPONSE_BLOCK_TRANSACTIONS_request& request, ISerializer& s) {
+  s(request.block_hash, "block_hash");
+  std::vector<std::string> transactions;
+  if (s.type() == ISerializer::INPUT) {
+    s(transactions, "txs");
+    request.txs.reserve(transactions.size());
+    std::transform(transactions.begin(), transactions.end(), std::back_inserter(request.txs), [] (const std::string& s) {
+      return BinaryArray(s.begin(), s.end());
+    });
+  } else {
+    transactions.reserve(request.txs.size());
+    std::transform(request.txs.begin(), request.txs.end(), std::back_inserter(transactions), [] (const BinaryArray& s) {
+      return std::string(s.begin(), s.end());
+    });
+    s(transactions, "txs");
+  }
+}
+
 static inline void serialize(NOTIFY_RESPONSE_GET_OBJECTS_request& request, ISerializer& s) {
   s(request.txs, "txs");
   s(request.blocks, "blocks");
@@ -134,6 +150,14 @@ CryptoNoteProtocolHandler::CryptoNoteProtocolHandler(const Currency& currency, S
   m_synchronized(false),
   m_stop(false),
   m_observedHeight(0),
+  m_addingDownloadedBlocks(false),
+  m_receivedTransactions(0),
+  m_receivedTransactionBytes(0),
+  m_duplicateTransactions(0),
+  m_duplicateTransactionBytes(0),
+  m_announcedTransactionHashes(0),
+  m_receivedTransactionHashes(0),
+  m_requestedTransactionsCount(0),
   m_peersCount(0),
   logger(log, "protocol") {
   
@@ -176,6 +200,20 @@ void CryptoNoteProtocolHandler::onConnectionClosed(CryptoNoteConnectionContext&
     m_peersCount--;
     m_observerManager.notify(&ICryptoNoteProtocolObserver::peerCountUpdated, m_peersCount.load());
   }
+
+  m_pendingBlocks.erase(context.m_connection_id);
+  m_peerInventories.erase(context.m_connection_id);
+  for (auto& requested : m_requestedTransactions) {
+    auto& announcers = requested.second.announcers;
+    announcers.erase(std::remove(announcers.begin(), announcers.end(), context.m_connection_id), announcers.end());
+    if (requested.second.requestedFrom == context.m_connection_id) {
+      // the next announcer is asked with the next announcement
+      requested.second.deadline = std::chrono::steady_clock::time_point::min();
+    }
+  }
+
+  m_downloadScheduler.removePeer(context.m_connection_id);
+  requestBlocksFromPeers();
 }
 
 void CryptoNoteProtocolHandler::stop() {
@@ -186,13 +224,8 @@ bool CryptoNoteProtocolHandler::start_sync(CryptoNoteConnectionContext& context)
   logger(Logging::TRACE) << context << "Starting synchronization";
 
   if (context.m_state == CryptoNoteConnectionContext::state_synchronizing) {
-    assert(context.m_needed_objects.empty());
     assert(context.m_requested_objects.empty());
-
-    NOTIFY_REQUEST_CHAIN::request r = boost::value_initialized<NOTIFY_REQUEST_CHAIN::request>();
-    r.block_ids = m_core.buildSparseChain();
-    logger(Logging::TRACE) << context << "-->>NOTIFY_REQUEST_CHAIN: m_block_ids.size()=" << r.block_ids.size();
-    post_notify<NOTIFY_REQUEST_CHAIN>(*m_p2p, r, context);
+    requestChain(context);
   }
 
   return true;
@@ -209,7 +242,8 @@ void CryptoNoteProtocolHandler::log_connections() {
     << std::setw(20) << "Peer id"
     << std::setw(25) << "Recv/Sent (inactive,sec)"
     << std::setw(25) << "State"
-    << std::setw(20) << "Lifetime(seconds)" << ENDL;
+    << std::setw(20) << "Lifetime(seconds)"
+    << std::setw(20) << "Download(KiB/s)" << ENDL;
 
   m_p2p->for_each_connection([&](const CryptoNoteConnectionContext& cntxt, PeerIdType peer_id) {
     ss << std::setw(25) << std::left << std::string(cntxt.m_is_income ? "[INC]" : "[OUT]") +
@@ -217,7 +251,8 @@ void CryptoNoteProtocolHandler::log_connections() {
       << std::setw(20) << std::hex << peer_id
       // << std::setw(25) << std::to_string(cntxt.m_recv_cnt) + "(" + std::to_string(time(NULL) - cntxt.m_last_recv) + ")" + "/" + std::to_string(cntxt.m_send_cnt) + "(" + std::to_string(time(NULL) - cntxt.m_last_send) + ")"
       << std::setw(25) << get_protocol_state_string(cntxt.m_state)
-      << std::setw(20) << std::to_string(time(NULL) - cntxt.m_started) << ENDL;
+      << std::setw(20) << std::to_string(time(NULL) - cntxt.m_started)
+      << std::setw(20) << std::to_string(m_downloadScheduler.getPeerStatistics(cntxt.m_connection_id).bytesPerSecond / 1024) << ENDL;
   });
   logger(INFO) << "Connections: " << ENDL << ss.str();
 }
@@ -231,6 +266,8 @@ bool CryptoNoteProtocolHandler::process_payload_sync_data(const CORE_SYNC_DATA&
     return true;
 
   if (context.m_state == CryptoNoteConnectionContext::state_synchronizing) {
+    // timed out spans are only checked on events, the periodic sync makes one even if the peers are silent
+    requestBlocks(context);
   } else if (m_core.hasBlock(hshd.top_id)) {
     if (is_inital) {
       on_connection_synchronized();
@@ -298,6 +335,11 @@ int CryptoNoteProtocolHandler::handleCommand(bool is_notify, int command, const
     HANDLE_NOTIFY(NOTIFY_REQUEST_CHAIN, handle_request_chain)
     HANDLE_NOTIFY(NOTIFY_RESPONSE_CHAIN_ENTRY, handle_response_chain_entry)
     HANDLE_NOTIFY(NOTIFY_REQUEST_TX_POOL, handleRequestTxPool)
+    HANDLE_NOTIFY(NOTIFY_NEW_COMPACT_BLOCK, handleNotifyNewCompactBlock)
+    HANDLE_NOTIFY(NOTIFY_REQUEST_BLOCK_TRANSACTIONS, handleRequestBlockTransactions)
+    HANDLE_NOTIFY(NOTIFY_RESPONSE_BLOCK_TRANSACTIONS, handleResponseBlockTransactions)
+    HANDLE_NOTIFY(NOTIFY_TX_INVENTORY, handleTxInventory)
+    HANDLE_NOTIFY(NOTIFY_REQUEST_TXS, handleRequestTxs)
 
   default:
     handled = false;
@@ -316,19 +358,20 @@ int CryptoNoteProtocolHandler::handle_notify_new_block(int command, NOTIFY_NEW_B
     return 1;
   }
 
+  addNewBlock(context, arg);
+  return 1;
+}
+
+void CryptoNoteProtocolHandler::addNewBlock(CryptoNoteConnectionContext& context, NOTIFY_NEW_BLOCK::request& arg) {
   auto result = m_core.addBlock(RawBlock{ arg.b.block, arg.b.transactions });
   if (result == error::AddBlockErrorCondition::BLOCK_ADDED) {
     if (result == error::AddBlockErrorCode::ADDED_TO_ALTERNATIVE_AND_SWITCHED) {
       ++arg.hop;
-      //TODO: Add here announce protocol usage
-      relay_post_notify<NOTIFY_NEW_BLOCK>(*m_p2p, arg, &context.m_connection_id);
-      // relay_block(arg, context);
+      relayNewBlock(arg, &context.m_connection_id);
       requestMissingPoolTransactions(context);
     } else if (result == error::AddBlockErrorCode::ADDED_TO_MAIN) {
       ++arg.hop;
-      //TODO: Add here announce protocol usage
-      relay_post_notify<NOTIFY_NEW_BLOCK>(*m_p2p, arg, &context.m_connection_id);
-      // relay_block(arg, context);
+      relayNewBlock(arg, &context.m_connection_id);
     } else if (result == error::AddBlockErrorCode::ADDED_TO_ALTERNATIVE) {
       logger(Logging::TRACE) << context << "Block added as alternative";
     } else {
@@ -337,16 +380,18 @@ int CryptoNoteProtocolHandler::handle_notify_new_block(int command, NOTIFY_NEW_B
   } else if (result == error::AddBlockErrorCondition::BLOCK_REJECTED) {
     m_p2p->drop_connection(context, true);
     context.m_state = CryptoNoteConnectionContext::state_synchronizing;
-    NOTIFY_REQUEST_CHAIN::request r = boost::value_initialized<NOTIFY_REQUEST_CHAIN::request>();
-    r.block_ids = m_core.buildSparseChain();
-    logger(Logging::TRACE) << context << "-->>NOTIFY_REQUEST_CHAIN: m_block_ids.size()=" << r.block_ids.size();
-    post_notify<NOTIFY_REQUEST_CHAIN>(*m_p2p, r, context);
+    requestChain(context);
   } else {
     logger(Logging::DEBUGGING) << context << "Block verification failed, dropping connection: " << result.message();
     context.m_state = CryptoNoteConnectionContext::state_shutdown;
   }
+}
 
-  return 1;
+// the block is downloaded with the chain of the peer, which brings the transactions and any block it depends on
+void CryptoNoteProtocolHandler::requestChainOfMissedBlock(CryptoNoteConnectionContext& context) {
+  m_pendingBlocks.erase(context.m_connection_id);
+  context.m_state = CryptoNoteConnectionContext::state_synchronizing;
+  requestChain(context);
 }
 
 int CryptoNoteProtocolHandler::handle_notify_new_transactions(int command, NOTIFY_NEW_TRANSACTIONS::request& arg, CryptoNoteConnectionContext& context) {
@@ -355,8 +400,26 @@ int CryptoNoteProtocolHandler::handle_notify_new_transactions(int command, NOTIF
   if (context.m_state != CryptoNoteConnectionContext::state_normal)
     return 1;
 
+  InventoryFilter* knownTransactions = nullptr;
+  if (context.version >= P2PProtocolVersion::V3) {
+    knownTransactions = &m_peerInventories[context.m_connection_id].knownTransactions;
+  }
+
   for (auto tx_blob_it = arg.txs.begin(); tx_blob_it != arg.txs.end();) {
-    if (!m_core.addTransactionToPool(*tx_blob_it)) {
+    auto transactionHash = getBinaryArrayHash(*tx_blob_it);
+    if (knownTransactions != nullptr) {
+      knownTransactions->insert(transactionHash);
+    }
+
+    eraseRequestedTransaction(transactionHash);
+    m_receivedTransactions++;
+    m_receivedTransactionBytes += tx_blob_it->size();
+
+    if (m_core.hasTransaction(transactionHash)) {
+      m_duplicateTransactions++;
+      m_duplicateTransactionBytes += tx_blob_it->size();
+      tx_blob_it = arg.txs.erase(tx_blob_it);
+    } else if (!m_core.addTransactionToPool(*tx_blob_it)) {
       logger(Logging::INFO) << context << "Tx verification failed";
       tx_blob_it = arg.txs.erase(tx_blob_it);
     } else {
@@ -365,8 +428,7 @@ int CryptoNoteProtocolHandler::handle_notify_new_transactions(int command, NOTIF
   }
 
   if (arg.txs.size()) {
-    //TODO: add announce usage here
-    relay_post_notify<NOTIFY_NEW_TRANSACTIONS>(*m_p2p, arg, &context.m_connection_id);
+    relayNewTransactions(arg.txs, &context.m_connection_id);
   }
 
   return true;
@@ -408,9 +470,9 @@ int CryptoNoteProtocolHandler::handle_response_get_objects(int command, NOTIFY_R
   updateObservedHeight(arg.current_blockchain_height, context);
   context.m_remote_blockchain_height = arg.current_blockchain_height;
   std::vector<BlockTemplate> blockTemplates;
-  std::vector<CachedBlock> cachedBlocks;
+  std::vector<Crypto::Hash> blockHashes;
   blockTemplates.resize(arg.blocks.size());
-  cachedBlocks.reserve(arg.blocks.size());
+  blockHashes.reserve(arg.blocks.size());
 
   std::vector<RawBlock> rawBlocks = convertRawBlocksLegacyToRawBlocks(arg.blocks);
 
@@ -422,29 +484,19 @@ int CryptoNoteProtocolHandler::handle_response_get_objects(int command, NOTIFY_R
       return 1;
     }
 
-    cachedBlocks.emplace_back(blockTemplates[index]);
-    if (index == 1) {
-      if (m_core.hasBlock(cachedBlocks.back().getBlockHash())) { //TODO
-        context.m_state = CryptoNoteConnectionContext::state_idle;
-        context.m_needed_objects.clear();
-        context.m_requested_objects.clear();
-        logger(Logging::DEBUGGING) << context << "Connection set to idle state.";
-        return 1;
-      }
-    }
-
-    auto req_it = context.m_requested_objects.find(cachedBlocks.back().getBlockHash());
+    CachedBlock cachedBlock(blockTemplates[index]);
+    auto req_it = context.m_requested_objects.find(cachedBlock.getBlockHash());
     if (req_it == context.m_requested_objects.end()) {
-      logger(Logging::ERROR) << context << "sent wrong NOTIFY_RESPONSE_GET_OBJECTS: block with id=" << Common::podToHex(cachedBlocks.back().getBlockHash())
+      logger(Logging::ERROR) << context << "sent wrong NOTIFY_RESPONSE_GET_OBJECTS: block with id=" << Common::podToHex(cachedBlock.getBlockHash())
         << " wasn't requested, dropping connection";
       context.m_state = CryptoNoteConnectionContext::state_shutdown;
       return 1;
     }
 
-    if (cachedBlocks.back().getBlock().transactionHashes.size() != rawBlocks[index].transactions.size()) {
+    if (cachedBlock.getBlock().transactionHashes.size() != rawBlocks[index].transactions.size()) {
       logger(Logging::ERROR) << context
-        << "sent wrong NOTIFY_RESPONSE_GET_OBJECTS: block with id=" << Common::podToHex(cachedBlocks.back().getBlockHash())
-        << ", transactionHashes.size()=" << cachedBlocks.back().getBlock().transactionHashes.size()
+        << "sent wrong NOTIFY_RESPONSE_GET_OBJECTS: block with id=" << Common::podToHex(cachedBlock.getBlockHash())
+        << ", transactionHashes.size()=" << cachedBlock.getBlock().transactionHashes.size()
         << " mismatch with block_complete_entry.m_txs.size()=" << rawBlocks[index].transactions.size()
         << ", dropping connection";
       context.m_state = CryptoNoteConnectionContext::state_shutdown;
@@ -452,6 +504,7 @@ int CryptoNoteProtocolHandler::handle_response_get_objects(int command, NOTIFY_R
     }
 
     context.m_requested_objects.erase(req_it);
+    blockHashes.push_back(cachedBlock.getBlockHash());
   }
 
   if (context.m_requested_objects.size()) {
@@ -462,51 +515,83 @@ int CryptoNoteProtocolHandler::handle_response_get_objects(int command, NOTIFY_R
     return 1;
   }
 
-  {
-    int result = processObjects(context, std::move(rawBlocks), cachedBlocks);
-    if (result != 0) {
-      return result;
-    }
-  }
-
-  logger(DEBUGGING, BRIGHT_GREEN) << "Local blockchain updated, new index = " << m_core.getTopBlockIndex();
-  if (!m_stop && context.m_state == CryptoNoteConnectionContext::state_synchronizing) {
-    request_missing_objects(context, true);
+  if (!m_downloadScheduler.receiveSpan(context.m_connection_id, blockHashes, std::move(rawBlocks), std::move(blockTemplates),
+      BlockDownloadScheduler::Clock::now())) {
+    logger(Logging::DEBUGGING) << context << "Blocks were received from another peer already";
   }
 
+  addDownloadedBlocks();
+  requestBlocksFromPeers();
   return 1;
 }
 
-int CryptoNoteProtocolHandler::processObjects(CryptoNoteConnectionContext& context, std::vector<RawBlock>&& rawBlocks, const std::vector<CachedBlock>& cachedBlocks) {
-  assert(rawBlocks.size() == cachedBlocks.size());
-  for (size_t index = 0; index < rawBlocks.size(); ++index) {
-    if (m_stop) {
-      break;
+void CryptoNoteProtocolHandler::addDownloadedBlocks() {
+  // adding blocks yields, meanwhile the other connections only queue the blocks they receive
+  if (m_addingDownloadedBlocks) {
+    return;
+  }
+
+  m_addingDownloadedBlocks = true;
+  BOOST_SCOPE_EXIT_ALL(this) {
+    m_addingDownloadedBlocks = false;
+  };
+
+  auto dropSender = [this](const BlockDownloadScheduler::Span& span, Logging::Level level, const std::string& message) {
+    m_p2p->for_each_connection([&](CryptoNoteConnectionContext& context, PeerIdType) {
+      if (context.m_connection_id == span.sender) {
+        logger(level) << context << message;
+        context.m_state = CryptoNoteConnectionContext::state_shutdown;
+      }
+    });
+  };
+
+  while (!m_stop && m_downloadScheduler.hasReadySpan()) {
+    BlockDownloadScheduler::Span span = m_downloadScheduler.popReadySpan();
+
+    std::vector<CachedBlock> cachedBlocks;
+    std::vector<RawBlock> rawBlocks;
+    for (size_t index = 0; index < span.hashes.size(); ++index) {
+      // the block could be relayed to us while it was downloaded
+      if (!m_core.hasBlock(span.hashes[index])) {
+        cachedBlocks.emplace_back(span.blockTemplates[index]);
+        rawBlocks.emplace_back(std::move(span.blocks[index]));
+      }
+    }
+
+    if (cachedBlocks.empty()) {
+      m_downloadScheduler.completeSpan();
+      continue;
     }
 
-    auto addResult = m_core.addBlock(cachedBlocks[index], std::move(rawBlocks[index]));
+    auto addResults = m_core.addBlocks(cachedBlocks, std::move(rawBlocks));
+    if (addResults.empty()) {
+      m_downloadScheduler.completeSpan();
+      continue;
+    }
+
+    // only the last block may have failed, all blocks before it were added
+    const auto& addResult = addResults.back();
     if (addResult == error::AddBlockErrorCondition::BLOCK_VALIDATION_FAILED ||
         addResult == error::AddBlockErrorCondition::TRANSACTION_VALIDATION_FAILED ||
         addResult == error::AddBlockErrorCondition::DESERIALIZATION_FAILED) {
-      logger(Logging::DEBUGGING) << context << "Block verification failed, dropping connection: " << addResult.message();
-      context.m_state = CryptoNoteConnectionContext::state_shutdown;
-      return 1;
+      // the span is downloaded from another peer, the added blocks of it are skipped then
+      dropSender(span, Logging::DEBUGGING, "Block verification failed, dropping connection: " + addResult.message());
+      m_downloadScheduler.removePeer(span.sender);
+      m_downloadScheduler.requeueSpan(std::move(span));
+      break;
     } else if (addResult == error::AddBlockErrorCondition::BLOCK_REJECTED) {
-      logger(Logging::INFO) << context << "Block received at sync phase was marked as orphaned, dropping connection: " << addResult.message();
-      context.m_state = CryptoNoteConnectionContext::state_shutdown;
-      return 1;
+      dropSender(span, Logging::INFO, "Block received at sync phase was marked as orphaned, dropping connection: " + addResult.message());
+      m_downloadScheduler.reset();
+      break;
     } else if (addResult == error::AddBlockErrorCode::ALREADY_EXISTS) {
-      logger(Logging::DEBUGGING) << context << "Block already exists, switching to idle state: " << addResult.message();
-      context.m_state = CryptoNoteConnectionContext::state_idle;
-      context.m_needed_objects.clear();
-      context.m_requested_objects.clear();
-      return 1;
+      logger(Logging::DEBUGGING) << "Block already exists, requesting the chain again: " << addResult.message();
+      m_downloadScheduler.reset();
+      break;
     }
 
-    m_dispatcher.yield();
+    m_downloadScheduler.completeSpan();
+    logger(DEBUGGING, BRIGHT_GREEN) << "Local blockchain updated, new index = " << m_core.getTopBlockIndex();
   }
-
-  return 0;
 }
 
 int CryptoNoteProtocolHandler::handle_request_chain(int command, NOTIFY_REQUEST_CHAIN::request& arg, CryptoNoteConnectionContext& context) {
@@ -532,51 +617,82 @@ int CryptoNoteProtocolHandler::handle_request_chain(int command, NOTIFY_REQUEST_
   return 1;
 }
 
-bool CryptoNoteProtocolHandler::request_missing_objects(CryptoNoteConnectionContext& context, bool check_having_blocks) {
-  if (context.m_needed_objects.size()) {
-    //we know objects that we need, request this objects
-    NOTIFY_REQUEST_GET_OBJECTS::request req;
-    size_t count = 0;
-    auto it = context.m_needed_objects.begin();
+void CryptoNoteProtocolHandler::requestChain(CryptoNoteConnectionContext& context) {
+  NOTIFY_REQUEST_CHAIN::request r = boost::value_initialized<NOTIFY_REQUEST_CHAIN::request>();
+  r.block_ids = m_core.buildSparseChain();
+  logger(Logging::TRACE) << context << "-->>NOTIFY_REQUEST_CHAIN: m_block_ids.size()=" << r.block_ids.size();
+  post_notify<NOTIFY_REQUEST_CHAIN>(*m_p2p, r, context);
+  m_downloadScheduler.setChainRequested(context.m_connection_id, true);
+}
 
-    while (it != context.m_needed_objects.end() && count < BLOCKS_SYNCHRONIZING_DEFAULT_COUNT) {
-      if (!(check_having_blocks && m_core.hasBlock(*it))) {
-        req.blocks.push_back(*it);
-        ++count;
-        context.m_requested_objects.insert(*it);
-      }
-      it = context.m_needed_objects.erase(it);
-    }
+void CryptoNoteProtocolHandler::requestBlocks(CryptoNoteConnectionContext& context) {
+  const auto& peer = context.m_connection_id;
+  if (m_stop || context.m_state != CryptoNoteConnectionContext::state_synchronizing ||
+      m_downloadScheduler.isRequesting(peer) || m_downloadScheduler.isChainRequested(peer)) {
+    return;
+  }
+
+  NOTIFY_REQUEST_GET_OBJECTS::request req;
+  req.blocks = m_downloadScheduler.requestSpan(peer, BlockDownloadScheduler::Clock::now());
+  if (!req.blocks.empty()) {
+    context.m_requested_objects.clear();
+    context.m_requested_objects.insert(req.blocks.begin(), req.blocks.end());
     logger(Logging::TRACE) << context << "-->>NOTIFY_REQUEST_GET_OBJECTS: blocks.size()=" << req.blocks.size() << ", txs.size()=" << req.txs.size();
     post_notify<NOTIFY_REQUEST_GET_OBJECTS>(*m_p2p, req, context);
-  } else if (context.m_last_response_height < context.m_remote_blockchain_height - 1) {//we have to fetch more objects ids, request blockchain entry
+    return;
+  }
 
-    NOTIFY_REQUEST_CHAIN::request r = boost::value_initialized<NOTIFY_REQUEST_CHAIN::request>();
-    r.block_ids = m_core.buildSparseChain();
-    logger(Logging::TRACE) << context << "-->>NOTIFY_REQUEST_CHAIN: m_block_ids.size()=" << r.block_ids.size();
-    post_notify<NOTIFY_REQUEST_CHAIN>(*m_p2p, r, context);
-  } else {
-    if (!(context.m_last_response_height ==
-      context.m_remote_blockchain_height - 1 &&
-      !context.m_needed_objects.size() &&
-      !context.m_requested_objects.size())) {
-      logger(Logging::ERROR, Logging::BRIGHT_RED)
-        << "request_missing_blocks final condition failed!"
-        << "\r\nm_last_response_height=" << context.m_last_response_height
-        << "\r\nm_remote_blockchain_height=" << context.m_remote_blockchain_height
-        << "\r\nm_needed_objects.size()=" << context.m_needed_objects.size()
-        << "\r\nm_requested_objects.size()=" << context.m_requested_objects.size() 
-        << "\r\non connection [" << context << "]";
-      return false;
-    }
-
-    requestMissingPoolTransactions(context);
-
-    context.m_state = CryptoNoteConnectionContext::state_normal;
-    logger(Logging::INFO, Logging::BRIGHT_GREEN) << context << "SYNCHRONIZED OK";
-    on_connection_synchronized();
+  if (!m_downloadScheduler.knowsChain(peer)) {
+    // a peer on another chain waits until the queued one is downloaded
+    if (m_downloadScheduler.empty()) {
+      requestChain(context);
+    }
+
+    return;
   }
-  return true;
+
+  uint32_t chainEnd = m_downloadScheduler.getPeerChainEnd(peer);
+  if (chainEnd < context.m_remote_blockchain_height) {
+    // a chain entry starts at the local top, it extends the queue only when the queue isn't far ahead of it
+    if (chainEnd < get_current_blockchain_height() + BLOCKS_IDS_SYNCHRONIZING_DEFAULT_COUNT / 2) {
+      requestChain(context);
+    }
+
+    return;
+  }
+
+  if (m_core.hasBlock(m_downloadScheduler.getPeerChainTop(peer))) {
+    setConnectionSynchronized(context);
+  }
+}
+
+void CryptoNoteProtocolHandler::releaseTimedOutBlockRequests(std::chrono::steady_clock::time_point now) {
+  auto requesters = m_downloadScheduler.releaseTimedOutSpans(now);
+  if (requesters.empty()) {
+    return;
+  }
+
+  m_p2p->for_each_connection([&](CryptoNoteConnectionContext& context, PeerIdType) {
+    if (std::find(requesters.begin(), requesters.end(), context.m_connection_id) != requesters.end()) {
+      logger(Logging::DEBUGGING) << context << "Didn't send the requested blocks in time, requesting them from other peers";
+    }
+  });
+
+  requestBlocksFromPeers();
+}
+
+void CryptoNoteProtocolHandler::requestBlocksFromPeers() {
+  m_p2p->for_each_connection([this](CryptoNoteConnectionContext& context, PeerIdType) {
+    requestBlocks(context);
+  });
+}
+
+void CryptoNoteProtocolHandler::setConnectionSynchronized(CryptoNoteConnectionContext& context) {
+  requestMissingPoolTransactions(context);
+
+  context.m_state = CryptoNoteConnectionContext::state_normal;
+  logger(Logging::INFO, Logging::BRIGHT_GREEN) << context << "SYNCHRONIZED OK";
+  on_connection_synchronized();
 }
 
 bool CryptoNoteProtocolHandler::on_connection_synchronized() {
@@ -627,19 +743,28 @@ int CryptoNoteProtocolHandler::handle_response_chain_entry(int command, NOTIFY_R
     context.m_state = CryptoNoteConnectionContext::state_shutdown;
   }
 
-  bool allBlocksKnown = true;
-  for (auto& bl_id : arg.m_block_ids) {
-    if (allBlocksKnown) {
-      if (!m_core.hasBlock(bl_id)) {
-        context.m_needed_objects.push_back(bl_id);
-        allBlocksKnown = false;
-      }
-    } else {
-      context.m_needed_objects.push_back(bl_id);
+  m_downloadScheduler.setChainRequested(context.m_connection_id, false);
+
+  auto firstUnknown = std::find_if(arg.m_block_ids.begin(), arg.m_block_ids.end(), [this](const Crypto::Hash& hash) {
+    return !m_core.hasBlock(hash);
+  });
+
+  if (firstUnknown == arg.m_block_ids.end()) {
+    if (context.m_last_response_height + 1 < context.m_remote_blockchain_height) {
+      requestChain(context);
+    } else if (context.m_state == CryptoNoteConnectionContext::state_synchronizing) {
+      setConnectionSynchronized(context);
     }
+
+    return 1;
+  }
+
+  uint32_t startIndex = arg.start_height + static_cast<uint32_t>(std::distance(arg.m_block_ids.begin(), firstUnknown));
+  if (!m_downloadScheduler.addChain(context.m_connection_id, startIndex, std::vector<Crypto::Hash>(firstUnknown, arg.m_block_ids.end()))) {
+    logger(Logging::DEBUGGING) << context << "Chain entry contradicts the queued blocks, waiting until they are downloaded";
   }
 
-  request_missing_objects(context, false);
+  requestBlocksFromPeers();
   return 1;
 }
 
@@ -660,14 +785,364 @@ int CryptoNoteProtocolHandler::handleRequestTxPool(int command, NOTIFY_REQUEST_T
 }
 
 
+int CryptoNoteProtocolHandler::handleTxInventory(int command, NOTIFY_TX_INVENTORY::request& arg,
+                                                   CryptoNoteConnectionContext& context) {
+  logger(Logging::TRACE) << context << "NOTIFY_TX_INVENTORY: txs.size()=" << arg.txs.size();
+  m_receivedTransactionHashes += arg.txs.size();
+  if (context.m_state != CryptoNoteConnectionContext::state_normal) {
+    return 1;
+  }
+
+  auto now = std::chrono::steady_clock::now();
+  auto& inventory = m_peerInventories[context.m_connection_id];
+  NOTIFY_REQUEST_TXS::request request;
+  size_t skippedCount = 0;
+  for (const auto& transactionHash : arg.txs) {
+    inventory.knownTransactions.insert(transactionHash);
+    if (m_core.hasTransaction(transactionHash)) {
+      continue;
+    }
+
+    auto requested = m_requestedTransactions.find(transactionHash);
+    if (requested != m_requestedTransactions.end()) {
+      auto& announcers = requested->second.announcers;
+      if (requested->second.requestedFrom != context.m_connection_id &&
+          std::find(announcers.begin(), announcers.end(), context.m_connection_id) == announcers.end()) {
+        announcers.push_back(context.m_connection_id);
+      }
+
+      continue;
+    }
+
+    // the transaction reaches us with another announcement or the pool synchronization
+    if (inventory.requestedTransactions >= P2P_REQUESTED_TRANSACTIONS_PER_CONNECTION_LIMIT ||
+        m_requestedTransactions.size() >= P2P_REQUESTED_TRANSACTIONS_LIMIT) {
+      ++skippedCount;
+      continue;
+    }
+
+    auto& transaction = m_requestedTransactions[transactionHash];
+    transaction.deadline = now + std::chrono::milliseconds(P2P_TRANSACTIONS_REQUEST_TIMEOUT);
+    transaction.requestedFrom = context.m_connection_id;
+    ++inventory.requestedTransactions;
+    request.txs.push_back(transactionHash);
+  }
+
+  if (skippedCount != 0) {
+    logger(Logging::DEBUGGING) << context << "Too many transactions are requested, " << skippedCount << " announced ones skipped";
+  }
+
+  if (!request.txs.empty()) {
+    logger(Logging::TRACE) << context << "-->>NOTIFY_REQUEST_TXS: txs.size()=" << request.txs.size();
+    m_requestedTransactionsCount += request.txs.size();
+    post_notify<NOTIFY_REQUEST_TXS>(*m_p2p, request, context);
+  }
+
+  return 1;
+}
+
+int CryptoNoteProtocolHandler::handleRequestTxs(int command, NOTIFY_REQUEST_TXS::request& arg,
+                                                  CryptoNoteConnectionContext& context) {
+  logger(Logging::TRACE) << context << "NOTIFY_REQUEST_TXS: txs.size()=" << arg.txs.size();
+
+  // transactions which left the pool meanwhile are skipped, the peer requests them from another announcer
+  NOTIFY_NEW_TRANSACTIONS::request response;
+  std::vector<Crypto::Hash> missedHashes;
+  m_core.getPoolTransactions(arg.txs, response.txs, missedHashes);
+  if (!response.txs.empty()) {
+    post_notify<NOTIFY_NEW_TRANSACTIONS>(*m_p2p, response, context);
+  }
+
+  return 1;
+}
+
+int CryptoNoteProtocolHandler::handleNotifyNewCompactBlock(int command, NOTIFY_NEW_COMPACT_BLOCK::request& arg,
+                                                             CryptoNoteConnectionContext& context) {
+  logger(Logging::TRACE) << context << "NOTIFY_NEW_COMPACT_BLOCK (hop " << arg.hop << ")";
+  updateObservedHeight(arg.current_blockchain_height, context);
+  context.m_remote_blockchain_height = arg.current_blockchain_height;
+  if (context.m_state != CryptoNoteConnectionContext::state_normal) {
+    return 1;
+  }
+
+  BlockTemplate blockTemplate;
+  if (!fromBinaryArray(blockTemplate, arg.block)) {
+    logger(Logging::DEBUGGING) << context << "sent wrong compact block: failed to parse block, dropping connection";
+    context.m_state = CryptoNoteConnectionContext::state_shutdown;
+    return 1;
+  }
+
+  CachedBlock cachedBlock(blockTemplate);
+  if (m_core.hasBlock(cachedBlock.getBlockHash())) {
+    logger(Logging::TRACE) << context << "Block already exists";
+    return 1;
+  }
+
+  std::vector<BinaryArray> transactions;
+  std::vector<Crypto::Hash> missedHashes;
+  m_core.getPoolTransactions(blockTemplate.transactionHashes, transactions, missedHashes);
+
+  if (missedHashes.empty()) {
+    NOTIFY_NEW_BLOCK::request block{RawBlockLegacy{std::move(arg.block), std::move(transactions)}, arg.current_blockchain_height, arg.hop};
+    addNewBlock(context, block);
+    return 1;
+  }
+
+  auto pendingBlocks = m_pendingBlocks.find(context.m_connection_id);
+  if (pendingBlocks != m_pendingBlocks.end()) {
+    if (pendingBlocks->second.count(cachedBlock.getBlockHash()) != 0) {
+      logger(Logging::TRACE) << context << "Block transactions are requested already";
+      return 1;
+    }
+
+    if (pendingBlocks->second.size() >= P2P_PENDING_BLOCKS_LIMIT) {
+      logger(Logging::DEBUGGING) << context << "sent too many compact blocks, requesting its chain";
+      requestChainOfMissedBlock(context);
+      return 1;
+    }
+  }
+
+  if (missedHashes.size() > P2P_BLOCK_TRANSACTIONS_REQUEST_MAX_COUNT) {
+    logger(Logging::DEBUGGING) << context << "Too many transactions of the compact block are missing, requesting its chain";
+    requestChainOfMissedBlock(context);
+    return 1;
+  }
+
+  PendingBlock pending;
+  pending.hash = cachedBlock.getBlockHash();
+  pending.transactionHashes = std::move(blockTemplate.transactionHashes);
+
+  std::unordered_set<Crypto::Hash> missedSet(missedHashes.begin(), missedHashes.end());
+  auto transaction = transactions.begin();
+  for (const auto& transactionHash : pending.transactionHashes) {
+    if (missedSet.count(transactionHash) == 0) {
+      assert(transaction != transactions.end());
+      pending.transactions.emplace(transactionHash, std::move(*transaction));
+      ++transaction;
+    }
+  }
+
+  pending.block = std::move(arg);
+
+  NOTIFY_REQUEST_BLOCK_TRANSACTIONS::request request;
+  request.block_hash = pending.hash;
+  request.txs = std::move(missedHashes);
+  m_pendingBlocks[context.m_connection_id].emplace(pending.hash, std::move(pending));
+
+  logger(Logging::TRACE) << context << "-->>NOTIFY_REQUEST_BLOCK_TRANSACTIONS: txs.size()=" << request.txs.size();
+  post_notify<NOTIFY_REQUEST_BLOCK_TRANSACTIONS>(*m_p2p, request, context);
+  return 1;
+}
+
+int CryptoNoteProtocolHandler::handleRequestBlockTransactions(int command, NOTIFY_REQUEST_BLOCK_TRANSACTIONS::request& arg,
+                                                                CryptoNoteConnectionContext& context) {
+  logger(Logging::TRACE) << context << "NOTIFY_REQUEST_BLOCK_TRANSACTIONS: txs.size()=" << arg.txs.size();
+  if (arg.txs.size() > P2P_BLOCK_TRANSACTIONS_REQUEST_MAX_COUNT) {
+    logger(Logging::DEBUGGING) << context << "requested too many block transactions: " << arg.txs.size() << ", dropping connection";
+    context.m_state = CryptoNoteConnectionContext::state_shutdown;
+    return 1;
+  }
+
+  // the block is added before it is relayed, but it may be switched out meanwhile returning its transactions to the pool
+  NOTIFY_RESPONSE_BLOCK_TRANSACTIONS::request response;
+  response.block_hash = arg.block_hash;
+  std::vector<Crypto::Hash> missedHashes;
+  m_core.getTransactions(arg.txs, response.txs, missedHashes);
+
+  std::vector<Crypto::Hash> poolMissedHashes;
+  m_core.getPoolTransactions(missedHashes, response.txs, poolMissedHashes);
+
+  logger(Logging::TRACE) << context << "-->>NOTIFY_RESPONSE_BLOCK_TRANSACTIONS: txs.size()=" << response.txs.size();
+  post_notify<NOTIFY_RESPONSE_BLOCK_TRANSACTIONS>(*m_p2p, response, context);
+  return 1;
+}
+
+int CryptoNoteProtocolHandler::handleResponseBlockTransactions(int command, NOTIFY_RESPONSE_BLOCK_TRANSACTIONS::request& arg,
+                                                                 CryptoNoteConnectionContext& context) {
+  logger(Logging::TRACE) << context << "NOTIFY_RESPONSE_BLOCK_TRANSACTIONS: txs.size()=" << arg.txs.size();
+
+  auto pendingBlocks = m_pendingBlocks.find(context.m_connection_id);
+  if (pendingBlocks == m_pendingBlocks.end() || pendingBlocks->second.count(arg.block_hash) == 0) {
+    logger(Logging::DEBUGGING) << context << "sent transactions of a block which wasn't requested";
+    return 1;
+  }
+
+  auto it = pendingBlocks->second.find(arg.block_hash);
+  PendingBlock pending = std::move(it->second);
+  pendingBlocks->second.erase(it);
+  if (pendingBlocks->second.empty()) {
+    m_pendingBlocks.erase(pendingBlocks);
+  }
+
+  if (context.m_state != CryptoNoteConnectionContext::state_normal) {
+    return 1;
+  }
+
+  for (auto& transaction : arg.txs) {
+    auto transactionHash = getBinaryArrayHash(transaction);
+    pending.transactions.emplace(transactionHash, std::move(transaction));
+  }
+
+  NOTIFY_NEW_BLOCK::request block;
+  block.b.block = std::move(pending.block.block);
+  block.current_blockchain_height = pending.block.current_blockchain_height;
+  block.hop = pending.block.hop;
+  block.b.transactions.reserve(pending.transactionHashes.size());
+
+  for (const auto& transactionHash : pending.transactionHashes) {
+    auto transaction = pending.transactions.find(transactionHash);
+    if (transaction == pending.transactions.end()) {
+      logger(Logging::DEBUGGING) << context << "didn't send transaction " << Common::podToHex(transactionHash) << " of block "
+        << Common::podToHex(pending.hash) << ", requesting its chain";
+      requestChainOfMissedBlock(context);
+      return 1;
+    }
+
+    block.b.transactions.push_back(std::move(transaction->second));
+  }
+
+  addNewBlock(context, block);
+  return 1;
+}
+
+void CryptoNoteProtocolHandler::relayNewBlock(const NOTIFY_NEW_BLOCK::request& arg, const net_connection_id* excludeConnection) {
+  NOTIFY_NEW_COMPACT_BLOCK::request compactBlock{arg.b.block, arg.current_blockchain_height, arg.hop};
+  m_p2p->relayNotifyToVersions(NOTIFY_NEW_COMPACT_BLOCK::ID, LevinProtocol::encode(compactBlock), excludeConnection,
+    P2PProtocolVersion::V2, std::numeric_limits<uint8_t>::max());
+  m_p2p->relayNotifyToVersions(NOTIFY_NEW_BLOCK::ID, LevinProtocol::encode(arg), excludeConnection,
+    P2PProtocolVersion::V0, P2PProtocolVersion::V1);
+}
+
 void CryptoNoteProtocolHandler::relayBlock(NOTIFY_NEW_BLOCK::request& arg) {
-  auto buf = LevinProtocol::encode(arg);
-  m_p2p->externalRelayNotifyToAll(NOTIFY_NEW_BLOCK::ID, buf);
+  m_dispatcher.remoteSpawn([this, arg] {
+    relayNewBlock(arg, nullptr);
+  });
 }
 
 void CryptoNoteProtocolHandler::relayTransactions(const std::vector<BinaryArray>& transactions) {
-  auto buf = LevinProtocol::encode(NOTIFY_NEW_TRANSACTIONS::request{transactions});
-  m_p2p->externalRelayNotifyToAll(NOTIFY_NEW_TRANSACTIONS::ID, buf);
+  m_dispatcher.remoteSpawn([this, transactions] {
+    relayNewTransactions(transactions, nullptr);
+  });
+}
+
+void CryptoNoteProtocolHandler::relayNewTransactions(const std::vector<BinaryArray>& transactions, const net_connection_id* excludeConnection) {
+  m_p2p->relayNotifyToVersions(NOTIFY_NEW_TRANSACTIONS::ID, LevinProtocol::encode(NOTIFY_NEW_TRANSACTIONS::request{transactions}),
+    excludeConnection, P2PProtocolVersion::V0, P2PProtocolVersion::V2);
+
+  std::vector<Crypto::Hash> transactionHashes;
+  transactionHashes.reserve(transactions.size());
+  for (const auto& transaction : transactions) {
+    transactionHashes.push_back(getBinaryArrayHash(transaction));
+  }
+
+  // upgraded peers get the hashes with the next announcement
+  m_p2p->for_each_connection([&](CryptoNoteConnectionContext& context, PeerIdType peerId) {
+    if (context.version < P2PProtocolVersion::V3 ||
+        (excludeConnection != nullptr && context.m_connection_id == *excludeConnection) ||
+        (context.m_state != CryptoNoteConnectionContext::state_normal &&
+         context.m_state != CryptoNoteConnectionContext::state_synchronizing)) {
+      return;
+    }
+
+    auto& inventory = m_peerInventories[context.m_connection_id];
+    for (const auto& transactionHash : transactionHashes) {
+      if (!inventory.knownTransactions.contains(transactionHash)) {
+        inventory.announcements.push_back(transactionHash);
+      }
+    }
+  });
+}
+
+void CryptoNoteProtocolHandler::announceTransactions(std::chrono::steady_clock::time_point now) {
+  // transactions the asked peer didn't send in time are requested from the next announcer
+  std::map<net_connection_id, NOTIFY_REQUEST_TXS::request> requests;
+  for (auto it = m_requestedTransactions.begin(); it != m_requestedTransactions.end();) {
+    auto& requested = it->second;
+    if (now < requested.deadline) {
+      ++it;
+      continue;
+    }
+
+    auto inventory = m_peerInventories.find(requested.requestedFrom);
+    if (inventory != m_peerInventories.end()) {
+      --inventory->second.requestedTransactions;
+    }
+
+    inventory = m_peerInventories.end();
+    while (inventory == m_peerInventories.end() && !requested.announcers.empty()) {
+      requested.requestedFrom = requested.announcers.front();
+      requested.announcers.erase(requested.announcers.begin());
+      inventory = m_peerInventories.find(requested.requestedFrom);
+      if (inventory != m_peerInventories.end() &&
+          inventory->second.requestedTransactions >= P2P_REQUESTED_TRANSACTIONS_PER_CONNECTION_LIMIT) {
+        // a busy announcer isn't asked
+        inventory = m_peerInventories.end();
+      }
+    }
+
+    if (inventory == m_peerInventories.end() || m_core.hasTransaction(it->first)) {
+      it = m_requestedTransactions.erase(it);
+      continue;
+    }
+
+    ++inventory->second.requestedTransactions;
+    requested.deadline = now + std::chrono::milliseconds(P2P_TRANSACTIONS_REQUEST_TIMEOUT);
+    requests[requested.requestedFrom].txs.push_back(it->first);
+    ++it;
+  }
+
+  m_p2p->for_each_connection([&](CryptoNoteConnectionContext& context, PeerIdType peerId) {
+    auto request = requests.find(context.m_connection_id);
+    if (request != requests.end()) {
+      m_requestedTransactionsCount += request->second.txs.size();
+      post_notify<NOTIFY_REQUEST_TXS>(*m_p2p, request->second, context);
+    }
+
+    auto inventory = m_peerInventories.find(context.m_connection_id);
+    if (inventory == m_peerInventories.end() || inventory->second.announcements.empty()) {
+      return;
+    }
+
+    NOTIFY_TX_INVENTORY::request notification;
+    for (const auto& transactionHash : inventory->second.announcements) {
+      if (!inventory->second.knownTransactions.contains(transactionHash)) {
+        inventory->second.knownTransactions.insert(transactionHash);
+        notification.txs.push_back(transactionHash);
+      }
+    }
+
+    inventory->second.announcements.clear();
+    if (!notification.txs.empty()) {
+      m_announcedTransactionHashes += notification.txs.size();
+      post_notify<NOTIFY_TX_INVENTORY>(*m_p2p, notification, context);
+    }
+  });
+}
+
+void CryptoNoteProtocolHandler::eraseRequestedTransaction(const Crypto::Hash& transactionHash) {
+  auto requested = m_requestedTransactions.find(transactionHash);
+  if (requested == m_requestedTransactions.end()) {
+    return;
+  }
+
+  auto inventory = m_peerInventories.find(requested->second.requestedFrom);
+  if (inventory != m_peerInventories.end()) {
+    --inventory->second.requestedTransactions;
+  }
+
+  m_requestedTransactions.erase(requested);
+}
+
+TransactionRelayStatistics CryptoNoteProtocolHandler::getTransactionRelayStatistics() const {
+  TransactionRelayStatistics statistics;
+  statistics.received = m_receivedTransactions;
+  statistics.receivedBytes = m_receivedTransactionBytes;
+  statistics.duplicates = m_duplicateTransactions;
+  statistics.duplicateBytes = m_duplicateTransactionBytes;
+  statistics.hashesAnnounced = m_announcedTransactionHashes;
+  statistics.hashesReceived = m_receivedTransactionHashes;
+  statistics.requested = m_requestedTransactionsCount;
+  return statistics;
 }
 
 void CryptoNoteProtocolHandler::requestMissingPoolTransactions(const CryptoNoteConnectionContext& context) {
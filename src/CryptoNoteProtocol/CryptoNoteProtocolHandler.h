@@ -18,15 +18,21 @@
 #pragma once
 
 #include <atomic>
+#include <chrono>
+#include <map>
+#include <unordered_map>
 
 #include <Common/ObserverManager.h>
 
+#include "CryptoNoteConfig.h"
 #include "CryptoNoteCore/ICore.h"
 
+#include "CryptoNoteProtocol/BlockDownloadScheduler.h"
 #include "CryptoNoteProtocol/CryptoNoteProtocolDefinitions.h"
 #include "CryptoNoteProtocol/CryptoNoteProtocolHandlerCommon.h"
 #include "CryptoNoteProtocol/ICryptoNoteProtocolObserver.h"
 #include "CryptoNoteProtocol/ICryptoNoteProtocolQuery.h"
+#include "CryptoNoteProtocol/InventoryFilter.h"
 
 #include "P2p/P2pProtocolDefinitions.h"
 #include "P2p/NetNodeCommon.h"
@@ -42,6 +48,16 @@ namespace CryptoNote
 {
   class Currency;
 
+  struct TransactionRelayStatistics {
+    uint64_t received;
+    uint64_t receivedBytes;
+    uint64_t duplicates;
+    uint64_t duplicateBytes;
+    uint64_t hashesAnnounced;
+    uint64_t hashesReceived;
+    uint64_t requested;
+  };
+
   class CryptoNoteProtocolHandler : public ICryptoNoteProtocolHandler
   {
   public:
@@ -68,6 +84,12 @@ namespace CryptoNote
     virtual size_t getPeerCount() const override;
     virtual uint32_t getObservedHeight() const override;
     void requestMissingPoolTransactions(const CryptoNoteConnectionContext& context);
+    // sends the transaction hashes batched since the previous call to the peers supporting inventory relay
+    // and requests the transactions not received by now from their next announcers
+    void announceTransactions(std::chrono::steady_clock::time_point now);
+    TransactionRelayStatistics getTransactionRelayStatistics() const;
+    // hands the block spans a peer didn't send in time to the other peers
+    void releaseTimedOutBlockRequests(std::chrono::steady_clock::time_point now);
 
   private:
     //----------------- commands handlers ----------------------------------------------
@@ -78,6 +100,11 @@ namespace CryptoNote
     int handle_request_chain(int command, NOTIFY_REQUEST_CHAIN::request& arg, CryptoNoteConnectionContext& context);
     int handle_response_chain_entry(int command, NOTIFY_RESPONSE_CHAIN_ENTRY::request& arg, CryptoNoteConnectionContext& context);
     int handleRequestTxPool(int command, NOTIFY_REQUEST_TX_POOL::request& arg, CryptoNoteConnectionContext& context);
+    int handleNotifyNewCompactBlock(int command, NOTIFY_NEW_COMPACT_BLOCK::request& arg, CryptoNoteConnectionContext& context);
+    int handleRequestBlockTransactions(int command, NOTIFY_REQUEST_BLOCK_TRANSACTIONS::request& arg, CryptoNoteConnectionContext& context);
+    int handleResponseBlockTransactions(int command, NOTIFY_RESPONSE_BLOCK_TRANSACTIONS::request& arg, CryptoNoteConnectionContext& context);
+    int handleTxInventory(int command, NOTIFY_TX_INVENTORY::request& arg, CryptoNoteConnectionContext& context);
+    int handleRequestTxs(int command, NOTIFY_REQUEST_TXS::request& arg, CryptoNoteConnectionContext& context);
 
     //----------------- i_cryptonote_protocol ----------------------------------
     virtual void relayBlock(NOTIFY_NEW_BLOCK::request& arg) override;
@@ -85,14 +112,46 @@ namespace CryptoNote
 
     //----------------------------------------------------------------------------------
     uint32_t get_current_blockchain_height();
-    bool request_missing_objects(CryptoNoteConnectionContext& context, bool check_having_blocks);
+    void requestChain(CryptoNoteConnectionContext& context);
+    void requestBlocks(CryptoNoteConnectionContext& context);
+    void requestBlocksFromPeers();
+    void addDownloadedBlocks();
+    void setConnectionSynchronized(CryptoNoteConnectionContext& context);
+    void addNewBlock(CryptoNoteConnectionContext& context, NOTIFY_NEW_BLOCK::request& arg);
+    void requestChainOfMissedBlock(CryptoNoteConnectionContext& context);
+    void relayNewBlock(const NOTIFY_NEW_BLOCK::request& arg, const net_connection_id* excludeConnection);
+    void relayNewTransactions(const std::vector<BinaryArray>& transactions, const net_connection_id* excludeConnection);
     bool on_connection_synchronized();
     void updateObservedHeight(uint32_t peerHeight, const CryptoNoteConnectionContext& context);
     void recalculateMaxObservedHeight(const CryptoNoteConnectionContext& context);
-    int processObjects(CryptoNoteConnectionContext& context, std::vector<RawBlock>&& rawBlocks, const std::vector<CachedBlock>& cachedBlocks);
+    void eraseRequestedTransaction(const Crypto::Hash& transactionHash);
     Logging::LoggerRef logger;
 
   private:
+    // compact block waiting for the transactions requested from its sender
+    struct PendingBlock {
+      NOTIFY_NEW_COMPACT_BLOCK::request block;
+      Crypto::Hash hash;
+      std::vector<Crypto::Hash> transactionHashes;
+      std::unordered_map<Crypto::Hash, BinaryArray> transactions;
+    };
+
+    struct PeerInventory {
+      PeerInventory() : knownTransactions(P2P_KNOWN_TRANSACTIONS_LIMIT), requestedTransactions(0) {}
+
+      // transactions the peer has or was told about, they aren't announced to it
+      InventoryFilter knownTransactions;
+      std::vector<Crypto::Hash> announcements;
+      size_t requestedTransactions;
+    };
+
+    // announced transaction requested from one of its announcers, the next one is asked after the deadline
+    struct RequestedTransaction {
+      std::chrono::steady_clock::time_point deadline;
+      net_connection_id requestedFrom;
+      // announcers which weren't asked yet
+      std::vector<net_connection_id> announcers;
+    };
 
     System::Dispatcher& m_dispatcher;
     ICore& m_core;
@@ -106,6 +165,20 @@ namespace CryptoNote
     mutable std::mutex m_observedHeightMutex;
     uint32_t m_observedHeight;
 
+    BlockDownloadScheduler m_downloadScheduler;
+    bool m_addingDownloadedBlocks;
+    std::map<net_connection_id, std::unordered_map<Crypto::Hash, PendingBlock>> m_pendingBlocks;
+    std::map<net_connection_id, PeerInventory> m_peerInventories;
+    std::unordered_map<Crypto::Hash, RequestedTransaction> m_requestedTransactions;
+
+    std::atomic<uint64_t> m_receivedTransactions;
+    std::atomic<uint64_t> m_receivedTransactionBytes;
+    std::atomic<uint64_t> m_duplicateTransactions;
+    std::atomic<uint64_t> m_duplicateTransactionBytes;
+    std::atomic<uint64_t> m_announcedTransactionHashes;
+    std::atomic<uint64_t> m_receivedTransactionHashes;
+    std::atomic<uint64_t> m_requestedTransactionsCount;
+
     std::atomic<size_t> m_peersCount;
     Tools::ObserverManager<ICryptoNoteProtocolObserver> m_observerManager;
   };
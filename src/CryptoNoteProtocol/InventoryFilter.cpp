@@ -0,0 +1,52 @@
+// Copyright (c) 2012-2017, The CryptoNote developers, The Bytecoin developers
+//
+// This file is part of Bytecoin.
+//
+// Bytecoin is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Bytecoin is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with Bytecoin.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "InventoryFilter.h"
+
+#include <algorithm>
+
+namespace CryptoNote {
+
+InventoryFilter::InventoryFilter(size_t capacity) : generationCapacity(std::max<size_t>(capacity / 2, 1)) {
+}
+
+void InventoryFilter::insert(const Crypto::Hash& hash) {
+  if (contains(hash)) {
+    return;
+  }
+
+  if (current.size() >= generationCapacity) {
+    previous.clear();
+    std::swap(previous, current);
+  }
+
+  current.insert(hash);
+}
+
+bool InventoryFilter::contains(const Crypto::Hash& hash) const {
+  return current.count(hash) != 0 || previous.count(hash) != 0;
+}
+
+size_t InventoryFilter::size() const {
+  return current.size() + previous.size();
+}
+
+size_t InventoryFilter::capacity() const {
+  return generationCapacity * 2;
+}
+
+}
@@ -0,0 +1,45 @@
+// Copyright (c) 2012-2017, The CryptoNote developers, The Bytecoin developers
+//
+// This file is part of Bytecoin.
+//
+// Bytecoin is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Bytecoin is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with Bytecoin.  If not, see <http://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <cstddef>
+#include <unordered_set>
+
+#include "crypto/hash.h"
+
+namespace CryptoNote {
+
+// Bounded set of recently seen hashes. Hashes are kept in two generations, when the current one
+// fills up the previous one is dropped, so the filter remembers at least the last capacity / 2 hashes.
+class InventoryFilter {
+public:
+  explicit InventoryFilter(size_t capacity);
+
+  void insert(const Crypto::Hash& hash);
+  bool contains(const Crypto::Hash& hash) const;
+
+  size_t size() const;
+  size_t capacity() const;
+
+private:
+  std::unordered_set<Crypto::Hash> current;
+  std::unordered_set<Crypto::Hash> previous;
+  size_t generationCapacity;
+};
+
+}
@@ -32,10 +32,11 @@
 #include "crypto/hash.h"
 #include "CryptoNoteCore/CryptoNoteTools.h"
 #include "CryptoNoteCore/Core.h"
+#include "CryptoNoteCore/CoreConfig.h"
 #include "CryptoNoteCore/Currency.h"
 #include "CryptoNoteCore/DatabaseBlockchainCache.h"
 #include "CryptoNoteCore/DatabaseBlockchainCacheFactory.h"
-#include "CryptoNoteCore/MainChainStorage.h"
+#include "CryptoNoteCore/FlatMainChainStorage.h"
 #include "CryptoNoteCore/MinerConfig.h"
 #include "CryptoNoteCore/RocksDBWrapper.h"
 #include "CryptoNoteProtocol/CryptoNoteProtocolHandler.h"
@@ -363,6 +364,7 @@ int main(int argc, char* argv[])
     RpcServerConfig::initOptions(desc_cmd_sett);
     NetNodeConfig::initOptions(desc_cmd_sett);
     DataBaseConfig::initOptions(desc_cmd_sett);
+    CoreConfig::initOptions(desc_cmd_sett);
 
     po::options_description desc_options("Allowed options");
     desc_options.add(desc_cmd_only).add(desc_cmd_sett);
@@ -386,6 +388,7 @@ int main(int argc, char* argv[])
     RpcServerConfig::initOptions(help_options);
     NetNodeConfig::initOptionsForHelp(help_options);
     DataBaseConfig::initOptions(help_options);
+    CoreConfig::initOptions(help_options);
 
     po::variables_map vm;
     boost::filesystem::path data_dir_path;
@@ -604,6 +607,9 @@ for (const auto& cp : checkpoint_input) {
     DataBaseConfig dbConfig;
     dbConfig.init(vm);
 
+    CoreConfig coreConfig;
+    coreConfig.init(vm);
+
     dbConfig.setDataDir(data_dir_path.string());
     if (dbConfig.isConfigFolderDefaulted()) {
       if (!Tools::create_directories_if_necessary(dbConfig.getDataDir())) {
@@ -619,7 +625,9 @@ for (const auto& cp : checkpoint_input) {
     database.init(dbConfig);
     Tools::ScopeExit dbShutdownOnExit([&database] () { database.shutdown(); });
 
-    if (!DatabaseBlockchainCache::checkDBSchemeVersion(database, logManager))
+    if ((!DatabaseBlockchainCache::checkDBSchemeVersion(database, logManager) &&
+         !DatabaseBlockchainCache::migrateDBScheme(database, logManager)) ||
+        !DatabaseBlockchainCache::checkRawBlocksLocation(database, logManager, dbConfig.getRawBlocksInMainChainStorage()))
     {
       dbShutdownOnExit.cancel();
       database.shutdown();
@@ -632,13 +640,17 @@ for (const auto& cp : checkpoint_input) {
 
     System::Dispatcher dispatcher;
     logger(INFO) << "Initializing core...";
+    auto mainChainStorage = createFlatMainChainStorage(data_dir_path.string(), currency, logManager);
+    auto rawBlocksStorage = dbConfig.getRawBlocksInMainChainStorage() ? mainChainStorage.get() : nullptr;
     CryptoNote::Core ccore(
       currency,
       logManager,
       std::move(checkpoints),
       dispatcher,
-      std::unique_ptr<IBlockchainCacheFactory>(new DatabaseBlockchainCacheFactory(database, logger.getLogger())),
-      createSwappedMainChainStorage(data_dir_path.string(), currency));
+      std::unique_ptr<IBlockchainCacheFactory>(new DatabaseBlockchainCacheFactory(database, logger.getLogger(),
+        (data_dir_path / currency.keyOutputsIndexFileName()).string(), dbConfig.getKeyOutputsCacheSize(), rawBlocksStorage)),
+      std::move(mainChainStorage),
+      coreConfig);
 
     ccore.load();
     logger(INFO) << "Core initialized OK";
@@ -648,7 +660,7 @@ for (const auto& cp : checkpoint_input) {
     CryptoNote::RpcServer rpcServer(dispatcher, logManager, ccore, p2psrv, cprotocol);
 
     cprotocol.set_p2p_endpoint(&p2psrv);
-    DaemonCommandsHandler dch(ccore, p2psrv, logManager);
+    DaemonCommandsHandler dch(ccore, p2psrv, database, rpcServer, logManager);
     logger(INFO) << "Initializing p2p server...";
     if (!p2psrv.init(netNodeConfig)) {
       logger(ERROR, BRIGHT_RED) << "Failed to initialize p2p server.";
@@ -662,6 +674,7 @@ for (const auto& cp : checkpoint_input) {
     }
 
     logger(INFO) << "Starting core rpc server on address " << rpcConfig.getBindAddress();
+    rpcServer.setWorkerThreadsCount(rpcConfig.threadsCount);
     rpcServer.start(rpcConfig.bindIp, rpcConfig.bindPort);
   rpcServer.setFeeAddress(command_line::get_arg(vm, arg_set_fee_address));
 rpcServer.enableCors(command_line::get_arg(vm, arg_enable_cors));
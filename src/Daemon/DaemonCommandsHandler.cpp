@@ -17,10 +17,14 @@
 
 #include "DaemonCommandsHandler.h"
 
+#include <iomanip>
+
 #include "P2p/NetNode.h"
 #include "CryptoNoteCore/Miner.h"
 #include "CryptoNoteCore/Core.h"
+#include "CryptoNoteCore/RocksDBWrapper.h"
 #include "CryptoNoteProtocol/CryptoNoteProtocolHandler.h"
+#include "Rpc/RpcServer.h"
 #include "Serialization/SerializationTools.h"
 #include "version.h"
 
@@ -41,6 +45,29 @@ std::string printTransactionShortInfo(const CryptoNote::CachedTransaction& trans
   return ss.str();
 }
 
+std::string printHitRate(uint64_t hits, uint64_t misses) {
+  std::stringstream ss;
+  ss << hits << " hits, " << misses << " misses";
+  if (hits + misses != 0) {
+    ss << ", " << std::fixed << std::setprecision(2) << 100.0 * hits / (hits + misses) << "% hit rate";
+  }
+
+  return ss.str();
+}
+
+// Upper bound of the latency bucket that completes the given share of requests
+uint64_t latencyPercentile(const CryptoNote::RpcEndpointStatistics& statistics, double share) {
+  uint64_t counted = 0;
+  for (size_t i = 0; i + 1 < statistics.latencyBuckets.size(); ++i) {
+    counted += statistics.latencyBuckets[i];
+    if (counted >= statistics.requests * share) {
+      return uint64_t(1) << i;
+    }
+  }
+
+  return statistics.maxMicroseconds;
+}
+
 std::string printTransactionFullInfo(const CryptoNote::CachedTransaction& transaction) {
   std::stringstream ss;
   ss << printTransactionShortInfo(transaction);
@@ -51,8 +78,9 @@ std::string printTransactionFullInfo(const CryptoNote::CachedTransaction& transa
 
 }
 
-DaemonCommandsHandler::DaemonCommandsHandler(CryptoNote::Core& core, CryptoNote::NodeServer& srv, Logging::LoggerManager& log) :
-  m_core(core), m_srv(srv), logger(log, "daemon"), m_logManager(log) {
+DaemonCommandsHandler::DaemonCommandsHandler(CryptoNote::Core& core, CryptoNote::NodeServer& srv, CryptoNote::RocksDBWrapper& database, CryptoNote::RpcServer& rpcServer,
+                                             Logging::LoggerManager& log) :
+  m_core(core), m_srv(srv), m_database(database), m_rpcServer(rpcServer), logger(log, "daemon"), m_logManager(log) {
   m_consoleHandler.setHandler("exit", boost::bind(&DaemonCommandsHandler::exit, this, _1), "Shutdown the daemon");
   m_consoleHandler.setHandler("help", boost::bind(&DaemonCommandsHandler::help, this, _1), "Show this help");
   m_consoleHandler.setHandler("print_pl", boost::bind(&DaemonCommandsHandler::print_pl, this, _1), "Print peer list");
@@ -64,6 +92,11 @@ DaemonCommandsHandler::DaemonCommandsHandler(CryptoNote::Core& core, CryptoNote:
   m_consoleHandler.setHandler("print_tx", boost::bind(&DaemonCommandsHandler::print_tx, this, _1), "Print transaction, print_tx <transaction_hash>");
   m_consoleHandler.setHandler("print_pool", boost::bind(&DaemonCommandsHandler::print_pool, this, _1), "Print transaction pool (long format)");
   m_consoleHandler.setHandler("print_pool_sh", boost::bind(&DaemonCommandsHandler::print_pool_sh, this, _1), "Print transaction pool (short format)");
+  m_consoleHandler.setHandler("print_pool_stat", boost::bind(&DaemonCommandsHandler::print_pool_stat, this, _1), "Print transaction pool size and rejection statistics");
+  m_consoleHandler.setHandler("print_db_cache", boost::bind(&DaemonCommandsHandler::print_db_cache, this, _1), "Print DB block cache usage and hit rates");
+  m_consoleHandler.setHandler("print_bt_cache", boost::bind(&DaemonCommandsHandler::print_bt_cache, this, _1), "Print block template rebuilds and cache hits");
+  m_consoleHandler.setHandler("print_relay_stat", boost::bind(&DaemonCommandsHandler::print_relay_stat, this, _1), "Print transaction relay and duplicate receive statistics");
+  m_consoleHandler.setHandler("print_rpc_stat", boost::bind(&DaemonCommandsHandler::print_rpc_stat, this, _1), "Print RPC request counts and latencies per endpoint");
   m_consoleHandler.setHandler("set_log", boost::bind(&DaemonCommandsHandler::set_log, this, _1), "set_log <level> - Change current log level, <level> is a number 0-4");
 }
 
@@ -288,3 +321,71 @@ bool DaemonCommandsHandler::print_pool_sh(const std::vector<std::string>& args)
 
   return true;
 }
+//--------------------------------------------------------------------------------
+bool DaemonCommandsHandler::print_pool_stat(const std::vector<std::string>& args)
+{
+  CryptoNote::TransactionPoolStatistics statistics = m_core.getTransactionPoolStatistics();
+
+  std::cout << "Pool: " << m_core.getPoolTransactionCount() << " transactions, " << statistics.size << " bytes";
+  if (statistics.maxSize != 0) {
+    std::cout << " of " << statistics.maxSize << " bytes";
+  }
+
+  std::cout << ENDL;
+  std::cout << "evicted with low fee rate: " << statistics.evictedTransactions << ENDL;
+  std::cout << "rejected with low fee rate: " << statistics.rejectedLowFeeRate << ENDL;
+  std::cout << "rejected as larger than pool: " << statistics.rejectedTooLarge << ENDL;
+  std::cout << "rejected as duplicates: " << statistics.rejectedDuplicates << ENDL;
+  std::cout << "rejected with conflicting key images: " << statistics.rejectedConflicting << ENDL;
+
+  return true;
+}
+//--------------------------------------------------------------------------------
+bool DaemonCommandsHandler::print_db_cache(const std::vector<std::string>& args)
+{
+  CryptoNote::BlockCacheStatistics statistics = m_database.getBlockCacheStatistics();
+
+  std::cout << "DB block cache: " << statistics.usage / 1024 << " KiB used of " << statistics.capacity / 1024 << " KiB, "
+    << statistics.pinnedUsage / 1024 << " KiB pinned" << ENDL;
+  std::cout << "total:   " << printHitRate(statistics.hits, statistics.misses) << ENDL;
+  std::cout << "data:    " << printHitRate(statistics.dataHits, statistics.dataMisses) << ENDL;
+  std::cout << "index:   " << printHitRate(statistics.indexHits, statistics.indexMisses) << ENDL;
+  std::cout << "filter:  " << printHitRate(statistics.filterHits, statistics.filterMisses) << ENDL;
+  std::cout << "lookups skipped by bloom filters: " << statistics.bloomFilterUseful << ENDL;
+
+  return true;
+}
+//--------------------------------------------------------------------------------
+bool DaemonCommandsHandler::print_bt_cache(const std::vector<std::string>& args)
+{
+  CryptoNote::BlockTemplateCacheStatistics statistics = m_core.getBlockTemplateCacheStatistics();
+
+  std::cout << "block template cache (misses are rebuilds): " << printHitRate(statistics.cacheHits, statistics.rebuilds) << ENDL;
+  std::cout << "pool changes applied without rebuild: " << statistics.incrementalUpdates << ENDL;
+
+  return true;
+}
+//--------------------------------------------------------------------------------
+bool DaemonCommandsHandler::print_relay_stat(const std::vector<std::string>& args)
+{
+  CryptoNote::TransactionRelayStatistics statistics = m_srv.get_payload_object().getTransactionRelayStatistics();
+
+  std::cout << "transactions received: " << statistics.received << ", " << statistics.receivedBytes << " bytes" << ENDL;
+  std::cout << "duplicates received: " << statistics.duplicates << ", " << statistics.duplicateBytes << " bytes" << ENDL;
+  std::cout << "hashes announced to peers: " << statistics.hashesAnnounced << ENDL;
+  std::cout << "hashes announced by peers: " << statistics.hashesReceived << ", transactions requested: " << statistics.requested << ENDL;
+
+  return true;
+}
+//--------------------------------------------------------------------------------
+bool DaemonCommandsHandler::print_rpc_stat(const std::vector<std::string>& args)
+{
+  for (const auto& kv : m_rpcServer.getEndpointStatistics()) {
+    const CryptoNote::RpcEndpointStatistics& statistics = kv.second;
+    std::cout << kv.first << ": " << statistics.requests << " requests, " << statistics.snapshotRequests << " from snapshot, avg " <<
+      statistics.totalMicroseconds / statistics.requests << " us, max " << statistics.maxMicroseconds << " us, 50% under " <<
+      latencyPercentile(statistics, 0.5) << " us, 99% under " << latencyPercentile(statistics, 0.99) << " us" << ENDL;
+  }
+
+  return true;
+}
@@ -25,12 +25,15 @@
 namespace CryptoNote {
 class Core;
 class NodeServer;
+class RocksDBWrapper;
+class RpcServer;
 }
 
 class DaemonCommandsHandler
 {
 public:
-  DaemonCommandsHandler(CryptoNote::Core& core, CryptoNote::NodeServer& srv, Logging::LoggerManager& log);
+  DaemonCommandsHandler(CryptoNote::Core& core, CryptoNote::NodeServer& srv, CryptoNote::RocksDBWrapper& database, CryptoNote::RpcServer& rpcServer,
+                        Logging::LoggerManager& log);
 
   bool start_handling() {
     m_consoleHandler.start();
@@ -46,6 +49,8 @@ private:
   Common::ConsoleHandler m_consoleHandler;
   CryptoNote::Core& m_core;
   CryptoNote::NodeServer& m_srv;
+  CryptoNote::RocksDBWrapper& m_database;
+  CryptoNote::RpcServer& m_rpcServer;
   Logging::LoggerRef logger;
   Logging::LoggerManager& m_logManager;
 
@@ -67,6 +72,11 @@ private:
   bool print_tx(const std::vector<std::string>& args);
   bool print_pool(const std::vector<std::string>& args);
   bool print_pool_sh(const std::vector<std::string>& args);
+  bool print_pool_stat(const std::vector<std::string>& args);
+  bool print_db_cache(const std::vector<std::string>& args);
+  bool print_bt_cache(const std::vector<std::string>& args);
+  bool print_relay_stat(const std::vector<std::string>& args);
+  bool print_rpc_stat(const std::vector<std::string>& args);
   bool start_mining(const std::vector<std::string>& args);
   bool stop_mining(const std::vector<std::string>& args);
 };
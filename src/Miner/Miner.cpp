@@ -17,6 +17,7 @@
 
 #include "Miner.h"
 
+#include <chrono>
 #include <functional>
 
 #include "crypto/crypto.h"
@@ -76,6 +77,12 @@ void Miner::runWorkers(BlockMiningParameters blockMiningParameters, size_t threa
 
   m_logger(Logging::INFO) << "Starting mining for difficulty " << blockMiningParameters.difficulty;
 
+  for (auto& hashCount : m_hashCounts) {
+    hashCount = 0;
+  }
+
+  auto miningStart = std::chrono::steady_clock::now();
+
   try {
     blockMiningParameters.blockTemplate.nonce = Crypto::rand<uint32_t>();
 
@@ -94,30 +101,60 @@ void Miner::runWorkers(BlockMiningParameters blockMiningParameters, size_t threa
     m_state = MiningState::MINING_STOPPED;
   }
 
+  auto miningTime = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - miningStart).count() + 1;
+  for (size_t i = 0; i < Crypto::SLOW_HASH_MAX_WAYS; ++i) {
+    if (m_hashCounts[i] != 0) {
+      m_logger(Logging::INFO) << i + 1 << "-way hashrate: " << m_hashCounts[i] * 1000 / miningTime << " H/s";
+    }
+  }
+
   m_miningStopped.set();
 }
 
 void Miner::workerFunc(const BlockTemplate& blockTemplate, Difficulty difficulty, uint32_t nonceStep) {
   try {
-    BlockTemplate block = blockTemplate;
-    Crypto::cn_context cryptoContext;
+    auto cryptoContexts = Crypto::make_cn_contexts(Crypto::SLOW_HASH_MAX_WAYS);
+    size_t ways = cryptoContexts.size();
+    std::vector<Crypto::cn_context*> contexts;
+    for (auto& context : cryptoContexts) {
+      contexts.push_back(context.get());
+    }
+
+    // lane i hashes the nonce a single-way worker would have reached after i steps
+    std::vector<BlockTemplate> blocks(ways, blockTemplate);
+    std::vector<BinaryArray> hashingBlobs(ways);
+    std::vector<const void*> inputs(ways);
+    std::vector<Crypto::Hash> hashes(ways);
+    for (size_t i = 1; i < ways; ++i) {
+      blocks[i].nonce = blocks[i - 1].nonce + nonceStep;
+    }
 
     while (m_state == MiningState::MINING_IN_PROGRESS) {
-      CachedBlock cachedBlock(block);
-      Crypto::Hash hash = cachedBlock.getBlockLongHash(cryptoContext);
-      if (check_hash(hash, difficulty)) {
-        m_logger(Logging::INFO) << "Found block for difficulty " << difficulty;
+      for (size_t i = 0; i < ways; ++i) {
+        hashingBlobs[i] = CachedBlock(blocks[i]).getBlockLongHashingBinaryArray();
+        inputs[i] = hashingBlobs[i].data();
+      }
+
+      Crypto::cn_slow_hash_multi(contexts.data(), inputs.data(), hashingBlobs[0].size(), hashes.data(), ways);
+      m_hashCounts[ways - 1] += ways;
+
+      for (size_t i = 0; i < ways; ++i) {
+        if (check_hash(hashes[i], difficulty)) {
+          m_logger(Logging::INFO) << "Found block for difficulty " << difficulty;
 
-        if (!setStateBlockFound()) {
-          m_logger(Logging::DEBUGGING) << "block is already found or mining stopped";
+          if (!setStateBlockFound()) {
+            m_logger(Logging::DEBUGGING) << "block is already found or mining stopped";
+            return;
+          }
+
+          m_block = blocks[i];
           return;
         }
-
-        m_block = block;
-        return;
       }
 
-      block.nonce += nonceStep;
+      for (auto& block : blocks) {
+        block.nonce += static_cast<uint32_t>(nonceStep * ways);
+      }
     }
   } catch (std::exception& e) {
     m_logger(Logging::ERROR) << "Miner got error: " << e.what();
@@ -25,6 +25,7 @@
 #include <System/RemoteContext.h>
 
 #include "CryptoNote.h"
+#include "crypto/hash.h"
 #include "CryptoNoteCore/Difficulty.h"
 
 #include "Logging/LoggerRef.h"
@@ -57,6 +58,9 @@ private:
 
   BlockTemplate m_block;
 
+  // hashes computed by workers hashing 1..SLOW_HASH_MAX_WAYS nonces per call
+  std::atomic<uint64_t> m_hashCounts[Crypto::SLOW_HASH_MAX_WAYS];
+
   Logging::LoggerRef m_logger;
 
   void runWorkers(BlockMiningParameters blockMiningParameters, size_t threadCount);
@@ -42,6 +42,17 @@ struct bucket_head2
 };
 #pragma pack(pop)
 
+BinaryArray makePacket(const bucket_head2& head, const BinaryArray& out) {
+  BinaryArray packet;
+  packet.reserve(sizeof(head) + out.size());
+
+  Common::VectorOutputStream stream(packet);
+  stream.writeSome(&head, sizeof(head));
+  stream.writeSome(out.data(), out.size());
+
+  return packet;
+}
+
 }
 
 bool LevinProtocol::Command::needReply() const {
@@ -52,23 +63,7 @@ LevinProtocol::LevinProtocol(System::TcpConnection& connection)
   : m_conn(connection) {}
 
 void LevinProtocol::sendMessage(uint32_t command, const BinaryArray& out, bool needResponse) {
-  bucket_head2 head = { 0 };
-  head.m_signature = LEVIN_SIGNATURE;
-  head.m_cb = out.size();
-  head.m_have_to_return_data = needResponse;
-  head.m_command = command;
-  head.m_protocol_version = LEVIN_PROTOCOL_VER_1;
-  head.m_flags = LEVIN_PACKET_REQUEST;
-
-  // write header and body in one operation
-  BinaryArray writeBuffer;
-  writeBuffer.reserve(sizeof(head) + out.size());
-
-  Common::VectorOutputStream stream(writeBuffer);
-  stream.writeSome(&head, sizeof(head));
-  stream.writeSome(out.data(), out.size());
-
-  writeStrict(writeBuffer.data(), writeBuffer.size());
+  sendPacket(encodeMessage(command, out, needResponse));
 }
 
 bool LevinProtocol::readCommand(Command& cmd) {
@@ -104,6 +99,27 @@ bool LevinProtocol::readCommand(Command& cmd) {
 }
 
 void LevinProtocol::sendReply(uint32_t command, const BinaryArray& out, int32_t returnCode) {
+  sendPacket(encodeReply(command, out, returnCode));
+}
+
+void LevinProtocol::sendPacket(const BinaryArray& packet) {
+  // header and body are written in one operation
+  writeStrict(packet.data(), packet.size());
+}
+
+BinaryArray LevinProtocol::encodeMessage(uint32_t command, const BinaryArray& out, bool needResponse) {
+  bucket_head2 head = { 0 };
+  head.m_signature = LEVIN_SIGNATURE;
+  head.m_cb = out.size();
+  head.m_have_to_return_data = needResponse;
+  head.m_command = command;
+  head.m_protocol_version = LEVIN_PROTOCOL_VER_1;
+  head.m_flags = LEVIN_PACKET_REQUEST;
+
+  return makePacket(head, out);
+}
+
+BinaryArray LevinProtocol::encodeReply(uint32_t command, const BinaryArray& out, int32_t returnCode) {
   bucket_head2 head = { 0 };
   head.m_signature = LEVIN_SIGNATURE;
   head.m_cb = out.size();
@@ -113,14 +129,7 @@ void LevinProtocol::sendReply(uint32_t command, const BinaryArray& out, int32_t
   head.m_flags = LEVIN_PACKET_RESPONSE;
   head.m_return_code = returnCode;
 
-  BinaryArray writeBuffer;
-  writeBuffer.reserve(sizeof(head) + out.size());
-
-  Common::VectorOutputStream stream(writeBuffer);
-  stream.writeSome(&head, sizeof(head));
-  stream.writeSome(out.data(), out.size());
-
-  writeStrict(writeBuffer.data(), writeBuffer.size());
+  return makePacket(head, out);
 }
 
 void LevinProtocol::writeStrict(const uint8_t* ptr, size_t size) {
@@ -79,6 +79,12 @@ public:
 
   void sendMessage(uint32_t command, const BinaryArray& out, bool needResponse);
   void sendReply(uint32_t command, const BinaryArray& out, int32_t returnCode);
+  // sends a packet built by encodeMessage or encodeReply
+  void sendPacket(const BinaryArray& packet);
+
+  // header and body of a packet, built once it can be sent to any number of connections
+  static BinaryArray encodeMessage(uint32_t command, const BinaryArray& out, bool needResponse);
+  static BinaryArray encodeReply(uint32_t command, const BinaryArray& out, int32_t returnCode);
 
   template <typename T>
   static bool decode(const BinaryArray& buf, T& value) {
@@ -19,6 +19,7 @@
 
 #include <algorithm>
 #include <fstream>
+#include <limits>
 
 #include <boost/foreach.hpp>
 #include <boost/uuid/random_generator.hpp>
@@ -211,6 +212,7 @@ std::string print_peerlist_to_string(const std::list<PeerlistEntry>& pl) {
     m_idleTimer(m_dispatcher),
     m_timedSyncTimer(m_dispatcher),
     m_timeoutTimer(m_dispatcher),
+    m_relayTimer(m_dispatcher),
     m_stop(false),
     // intervals
     // m_peer_handshake_idle_maker_interval(CryptoNote::P2P_DEFAULT_HANDSHAKE_INTERVAL),
@@ -569,6 +571,7 @@ void  NodeServer::drop_connection(CryptoNoteConnectionContext& context, bool add
     m_workingContextGroup.spawn(std::bind(&NodeServer::onIdle, this));
     m_workingContextGroup.spawn(std::bind(&NodeServer::timedSyncLoop, this));
     m_workingContextGroup.spawn(std::bind(&NodeServer::timeoutLoop, this));
+    m_workingContextGroup.spawn(std::bind(&NodeServer::relayLoop, this));
 
     m_stopEvent.wait();
 
@@ -1117,16 +1120,34 @@ void  NodeServer::drop_connection(CryptoNoteConnectionContext& context, bool add
   
   //-----------------------------------------------------------------------------------
   
-  void NodeServer::relay_notify_to_all(int command, const BinaryArray& data_buff, const net_connection_id* excludeConnection) {
+  void relayNotifyToConnections(ConnectionContainer& connections, int command, const BinaryArray& data_buff,
+    const net_connection_id* excludeConnection, uint8_t minVersion, uint8_t maxVersion) {
     net_connection_id excludeId = excludeConnection ? *excludeConnection : boost::value_initialized<net_connection_id>();
+    std::shared_ptr<const BinaryArray> packet;
 
-    forEachConnection([&](P2pConnectionContext& conn) {
-      if (conn.peerId && conn.m_connection_id != excludeId &&
+    for (auto& kv : connections) {
+      auto& conn = kv.second;
+      if (conn.peerId && conn.m_connection_id != excludeId && conn.version >= minVersion && conn.version <= maxVersion &&
           (conn.m_state == CryptoNoteConnectionContext::state_normal ||
            conn.m_state == CryptoNoteConnectionContext::state_synchronizing)) {
-        conn.pushMessage(P2pMessage(P2pMessage::NOTIFY, command, data_buff));
+        if (!packet) {
+          packet = std::make_shared<const BinaryArray>(LevinProtocol::encodeMessage(command, data_buff, false));
+        }
+
+        conn.pushMessage(P2pMessage(P2pMessage::NOTIFY, command, packet));
       }
-    });
+    }
+  }
+
+  //-----------------------------------------------------------------------------------
+  void NodeServer::relay_notify_to_all(int command, const BinaryArray& data_buff, const net_connection_id* excludeConnection) {
+    relayNotifyToVersions(command, data_buff, excludeConnection, 0, std::numeric_limits<uint8_t>::max());
+  }
+
+  //-----------------------------------------------------------------------------------
+  void NodeServer::relayNotifyToVersions(int command, const BinaryArray& data_buff, const net_connection_id* excludeConnection,
+    uint8_t minVersion, uint8_t maxVersion) {
+    relayNotifyToConnections(m_connections, command, data_buff, excludeConnection, minVersion, maxVersion);
   }
  
   //-----------------------------------------------------------------------------------
@@ -1435,6 +1456,23 @@ void  NodeServer::drop_connection(CryptoNoteConnectionContext& context, bool add
     logger(DEBUGGING) << "timedSyncLoop finished";
   }
 
+  void NodeServer::relayLoop() {
+    try {
+      for (;;) {
+        m_relayTimer.sleep(std::chrono::milliseconds(P2P_TRANSACTIONS_ANNOUNCE_INTERVAL));
+        auto now = std::chrono::steady_clock::now();
+        m_payload_handler.announceTransactions(now);
+        m_payload_handler.releaseTimedOutBlockRequests(now);
+      }
+    } catch (System::InterruptedException&) {
+      logger(DEBUGGING) << "relayLoop() is interrupted";
+    } catch (std::exception& e) {
+      logger(WARNING) << "Exception in relayLoop: " << e.what();
+    }
+
+    logger(DEBUGGING) << "relayLoop finished";
+  }
+
   void NodeServer::connectionHandler(const boost::uuids::uuid& connectionId, P2pConnectionContext& ctx) {
     // This inner context is necessary in order to stop connection handler at any moment
     System::Context<> context(m_dispatcher, [this, &connectionId, &ctx] {
@@ -1518,19 +1556,7 @@ void  NodeServer::drop_connection(CryptoNoteConnectionContext& context, bool add
 
         for (const auto& msg : msgs) {
           logger(DEBUGGING) << ctx << "msg " << msg.type << ':' << msg.command;
-          switch (msg.type) {
-          case P2pMessage::COMMAND:
-            proto.sendMessage(msg.command, msg.buffer, true);
-            break;
-          case P2pMessage::NOTIFY:
-            proto.sendMessage(msg.command, msg.buffer, false);
-            break;
-          case P2pMessage::REPLY:
-            proto.sendReply(msg.command, msg.buffer, msg.returnCode);
-            break;
-          default:
-            assert(false);
-          }
+          proto.sendPacket(*msg.packet);
         }
       }
     } catch (System::InterruptedException&) {
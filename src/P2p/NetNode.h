@@ -18,6 +18,7 @@
 #pragma once
 
 #include <functional>
+#include <memory>
 #include <unordered_map>
 
 #include <boost/functional/hash.hpp>
@@ -60,21 +61,22 @@ namespace CryptoNote
     };
 
     P2pMessage(Type type, uint32_t command, const BinaryArray& buffer, int32_t returnCode = 0) :
-      type(type), command(command), buffer(buffer), returnCode(returnCode) {
+      type(type), command(command), packet(std::make_shared<const BinaryArray>(type == REPLY ?
+        LevinProtocol::encodeReply(command, buffer, returnCode) : LevinProtocol::encodeMessage(command, buffer, type == COMMAND))) {
     }
 
-    P2pMessage(P2pMessage&& msg) :
-      type(msg.type), command(msg.command), buffer(std::move(msg.buffer)), returnCode(msg.returnCode) {
+    // the packet is shared by all connections a message is relayed to
+    P2pMessage(Type type, uint32_t command, std::shared_ptr<const BinaryArray> packet) :
+      type(type), command(command), packet(std::move(packet)) {
     }
 
     size_t size() {
-      return buffer.size();
+      return packet->size();
     }
 
     Type type;
     uint32_t command;
-    const BinaryArray buffer;
-    int32_t returnCode;
+    std::shared_ptr<const BinaryArray> packet;
   };
 
   struct P2pConnectionContext : public CryptoNoteConnectionContext {
@@ -120,6 +122,13 @@ namespace CryptoNote
     bool stopped;
   };
 
+  typedef std::unordered_map<boost::uuids::uuid, P2pConnectionContext, boost::hash<boost::uuids::uuid>> ConnectionContainer;
+
+  // queues a notification to every handshaked connection in the version range that is synchronizing or synchronized,
+  // the packet is encoded once and shared between them
+  void relayNotifyToConnections(ConnectionContainer& connections, int command, const BinaryArray& data_buff,
+    const net_connection_id* excludeConnection, uint8_t minVersion, uint8_t maxVersion);
+
   class NodeServer :  public IP2pEndpoint
   {
   public:
@@ -177,6 +186,8 @@ namespace CryptoNote
 
     //----------------- i_p2p_endpoint -------------------------------------------------------------
     virtual void relay_notify_to_all(int command, const BinaryArray& data_buff, const net_connection_id* excludeConnection) override;
+    virtual void relayNotifyToVersions(int command, const BinaryArray& data_buff, const net_connection_id* excludeConnection,
+      uint8_t minVersion, uint8_t maxVersion) override;
     virtual bool invoke_notify_to_peer(int command, const BinaryArray& req_buff, const CryptoNoteConnectionContext& context) override;
     virtual void drop_connection(CryptoNoteConnectionContext& context, bool add_fail) override;
     virtual void for_each_connection(std::function<void(CryptoNote::CryptoNoteConnectionContext&, PeerIdType)> f) override;
@@ -213,7 +224,6 @@ bool add_host_fail(const uint32_t address_ip);
     //debug functions
     std::string print_connections_container();
 
-    typedef std::unordered_map<boost::uuids::uuid, P2pConnectionContext, boost::hash<boost::uuids::uuid>> ConnectionContainer;
     typedef ConnectionContainer::iterator ConnectionIterator;
     ConnectionContainer m_connections;
 
@@ -223,6 +233,7 @@ bool add_host_fail(const uint32_t address_ip);
     void onIdle();
     void timedSyncLoop();
     void timeoutLoop();
+    void relayLoop();
     
     template<typename T>
     void safeInterrupt(T& obj);
@@ -266,6 +277,7 @@ bool add_host_fail(const uint32_t address_ip);
     OnceInInterval m_connections_maker_interval;
     OnceInInterval m_peerlist_store_interval;
     System::Timer m_timedSyncTimer;
+    System::Timer m_relayTimer;
 
     std::string m_bind_ip;
     std::string m_port;
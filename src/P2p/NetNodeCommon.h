@@ -26,6 +26,9 @@ namespace CryptoNote {
 
   struct IP2pEndpoint {
     virtual void relay_notify_to_all(int command, const BinaryArray& data_buff, const net_connection_id* excludeConnection) = 0;
+    // relays to the peers which protocol version is within [minVersion, maxVersion]
+    virtual void relayNotifyToVersions(int command, const BinaryArray& data_buff, const net_connection_id* excludeConnection,
+      uint8_t minVersion, uint8_t maxVersion) = 0;
     virtual bool invoke_notify_to_peer(int command, const BinaryArray& req_buff, const CryptoNote::CryptoNoteConnectionContext& context) = 0;
     virtual uint64_t get_connections_count()=0;
     virtual void drop_connection(CryptoNoteConnectionContext& context, bool add_fail) = 0;
@@ -36,6 +39,8 @@ namespace CryptoNote {
 
   struct p2p_endpoint_stub: public IP2pEndpoint {
     virtual void relay_notify_to_all(int command, const BinaryArray& data_buff, const net_connection_id* excludeConnection) override {}
+    virtual void relayNotifyToVersions(int command, const BinaryArray& data_buff, const net_connection_id* excludeConnection,
+      uint8_t minVersion, uint8_t maxVersion) override {}
     virtual bool invoke_notify_to_peer(int command, const BinaryArray& req_buff, const CryptoNote::CryptoNoteConnectionContext& context) override { return true; }
     virtual void drop_connection(CryptoNoteConnectionContext& context, bool add_fail) override {}
     virtual void for_each_connection(std::function<void(CryptoNote::CryptoNoteConnectionContext&, PeerIdType)> f) override {}
@@ -30,7 +30,7 @@
 #include "CryptoNoteCore/DatabaseBlockchainCache.h"
 #include "CryptoNoteCore/DatabaseBlockchainCacheFactory.h"
 #include "CryptoNoteCore/DataBaseConfig.h"
-#include "CryptoNoteCore/MainChainStorage.h"
+#include "CryptoNoteCore/FlatMainChainStorage.h"
 #include "CryptoNoteCore/RocksDBWrapper.h"
 #include "CryptoNoteProtocol/CryptoNoteProtocolHandler.h"
 #include "P2p/NetNode.h"
@@ -274,7 +274,9 @@ dbConfig.setDataDir(data_dir);
   database.init(dbConfig);
   Tools::ScopeExit dbShutdownOnExit([&database] () { database.shutdown(); });
 
-  if (!CryptoNote::DatabaseBlockchainCache::checkDBSchemeVersion(database, logger))
+  if ((!CryptoNote::DatabaseBlockchainCache::checkDBSchemeVersion(database, logger) &&
+       !CryptoNote::DatabaseBlockchainCache::migrateDBScheme(database, logger)) ||
+      !CryptoNote::DatabaseBlockchainCache::checkRawBlocksLocation(database, logger, dbConfig.getRawBlocksInMainChainStorage()))
   {
     dbShutdownOnExit.cancel();
     database.shutdown();
@@ -295,7 +297,7 @@ dbConfig.setDataDir(data_dir);
     CryptoNote::Checkpoints(logger),
     *dispatcher,
     std::unique_ptr<CryptoNote::IBlockchainCacheFactory>(new CryptoNote::DatabaseBlockchainCacheFactory(database, log.getLogger())),
-    CryptoNote::createSwappedMainChainStorage(dbConfig.getDataDir(), currency));
+    CryptoNote::createFlatMainChainStorage(dbConfig.getDataDir(), currency, logger));
 
   core.load();
 
@@ -20,10 +20,14 @@
 #include <future>
 #include <unordered_map>
 
+#include <System/Event.h>
+#include <System/InterruptedException.h>
+
 // CryptoNote
 #include "Common/StringTools.h"
 #include "CryptoNoteCore/CryptoNoteTools.h"
 #include "CryptoNoteCore/Core.h"
+#include "CryptoNoteCore/MainChainSnapshot.h"
 #include "CryptoNoteCore/Miner.h"
 #include "CryptoNoteCore/TransactionExtra.h"
 
@@ -102,17 +106,61 @@ RpcServer::HandlerFunction jsonMethod(bool (RpcServer::*handler)(typename Comman
   };
 }
 
+template <typename Command>
+RpcServer::SnapshotHandlerFunction binSnapshotMethod(bool (RpcServer::*handler)(const MainChainSnapshot&, typename Command::request const&, typename Command::response&)) {
+  return [handler](RpcServer* obj, const MainChainSnapshot& snapshot, const HttpRequest& request, HttpResponse& response) {
+
+    boost::value_initialized<typename Command::request> req;
+    boost::value_initialized<typename Command::response> res;
+
+    if (!loadFromBinaryKeyValue(static_cast<typename Command::request&>(req), request.getBody())) {
+      return false;
+    }
+
+    bool result = (obj->*handler)(snapshot, req, res);
+    response.setBody(storeToBinaryKeyValue(res.data()));
+    return result;
+  };
+}
+
+template <typename Command>
+RpcServer::SnapshotHandlerFunction jsonSnapshotMethod(bool (RpcServer::*handler)(const MainChainSnapshot&, typename Command::request const&, typename Command::response&)) {
+  return [handler](RpcServer* obj, const MainChainSnapshot& snapshot, const HttpRequest& request, HttpResponse& response) {
+
+    boost::value_initialized<typename Command::request> req;
+    boost::value_initialized<typename Command::response> res;
+
+    if (!loadFromJson(static_cast<typename Command::request&>(req), request.getBody())) {
+      return false;
+    }
+
+    bool result = (obj->*handler)(snapshot, req, res);
+    response.setBody(storeToJson(res.data()));
+    return result;
+  };
+}
+
+typedef std::function<bool(RpcServer*, const MainChainSnapshot&, const JsonRpc::JsonRpcRequest& req, JsonRpc::JsonRpcResponse& res)> JsonSnapshotMethod;
+
+template <typename Params, typename Result>
+JsonSnapshotMethod makeSnapshotMethod(bool (RpcServer::*handler)(const MainChainSnapshot&, const Params&, Result&)) {
+  return [handler](RpcServer* obj, const MainChainSnapshot& snapshot, const JsonRpc::JsonRpcRequest& req, JsonRpc::JsonRpcResponse& res) {
+    return JsonRpc::invokeMethod<Params, Result>(
+      req, res, std::bind(handler, obj, std::cref(snapshot), std::placeholders::_1, std::placeholders::_2));
+  };
+}
 
 }
   
-std::unordered_map<std::string, RpcServer::RpcHandler<RpcServer::HandlerFunction>> RpcServer::s_handlers = {
+std::unordered_map<std::string, RpcServer::RpcHandler<RpcServer::HandlerFunction, RpcServer::SnapshotHandlerFunction>> RpcServer::s_handlers = {
   
   // binary handlers
   { "/getblocks.bin", { binMethod<COMMAND_RPC_GET_BLOCKS_FAST>(&RpcServer::on_get_blocks), false } },
   { "/queryblocks.bin", { binMethod<COMMAND_RPC_QUERY_BLOCKS>(&RpcServer::on_query_blocks), false } },
   { "/queryblockslite.bin", { binMethod<COMMAND_RPC_QUERY_BLOCKS_LITE>(&RpcServer::on_query_blocks_lite), false } },
   { "/get_o_indexes.bin", { binMethod<COMMAND_RPC_GET_TX_GLOBAL_OUTPUTS_INDEXES>(&RpcServer::on_get_indexes), false } },
-  { "/getrandom_outs.bin", { binMethod<COMMAND_RPC_GET_RANDOM_OUTPUTS_FOR_AMOUNTS>(&RpcServer::on_get_random_outs), false } },
+  { "/getrandom_outs.bin", { binMethod<COMMAND_RPC_GET_RANDOM_OUTPUTS_FOR_AMOUNTS>(&RpcServer::on_get_random_outs), false,
+    binSnapshotMethod<COMMAND_RPC_GET_RANDOM_OUTPUTS_FOR_AMOUNTS>(&RpcServer::on_get_random_outs) } },
   { "/get_pool_changes.bin", { binMethod<COMMAND_RPC_GET_POOL_CHANGES>(&RpcServer::onGetPoolChanges), false } },
   { "/get_pool_changes_lite.bin", { binMethod<COMMAND_RPC_GET_POOL_CHANGES_LITE>(&RpcServer::onGetPoolChangesLite), false } },
   { "/get_blocks_details_by_hashes.bin", { binMethod<COMMAND_RPC_GET_BLOCKS_DETAILS_BY_HASHES>(&RpcServer::onGetBlocksDetailsByHashes), false } },
@@ -122,7 +170,8 @@ std::unordered_map<std::string, RpcServer::RpcHandler<RpcServer::HandlerFunction
   { "/get_transaction_hashes_by_payment_id.bin", { binMethod<COMMAND_RPC_GET_TRANSACTION_HASHES_BY_PAYMENT_ID>(&RpcServer::onGetTransactionHashesByPaymentId), false } },
 
   // json handlers
-{ "/getrandom_outs", { jsonMethod<COMMAND_RPC_GET_RANDOM_OUTPUTS_FOR_AMOUNTS_JSON>(&RpcServer::on_get_random_outs_json), false } },
+{ "/getrandom_outs", { jsonMethod<COMMAND_RPC_GET_RANDOM_OUTPUTS_FOR_AMOUNTS_JSON>(&RpcServer::on_get_random_outs_json), false,
+    jsonSnapshotMethod<COMMAND_RPC_GET_RANDOM_OUTPUTS_FOR_AMOUNTS_JSON>(&RpcServer::on_get_random_outs_json) } },
   { "/getinfo", { jsonMethod<COMMAND_RPC_GET_INFO>(&RpcServer::on_get_info), true } },
   { "/getheight", { jsonMethod<COMMAND_RPC_GET_HEIGHT>(&RpcServer::on_get_height), true } },
   { "/gettransactions", { jsonMethod<COMMAND_RPC_GET_TRANSACTIONS>(&RpcServer::on_get_transactions), false } },
@@ -139,6 +188,7 @@ RpcServer::RpcServer(System::Dispatcher& dispatcher, Logging::ILogger& log, Core
 }
 
 void RpcServer::processRequest(const HttpRequest& request, HttpResponse& response) {
+  auto startTime = std::chrono::steady_clock::now();
   auto url = request.getUrl();
   if (url.find(".bin") == std::string::npos) {
       logger(TRACE) << "RPC request came: \n" << request << std::endl;
@@ -158,7 +208,16 @@ void RpcServer::processRequest(const HttpRequest& request, HttpResponse& respons
     return;
   }
 
-  it->second.handler(this, request, response);
+  const auto& handler = it->second;
+  bool fromSnapshot = handler.snapshotHandler && serveFromSnapshot([this, &handler, &request, &response] (const MainChainSnapshot& snapshot) {
+    handler.snapshotHandler(this, snapshot, request, response);
+  });
+
+  if (!fromSnapshot) {
+    handler.handler(this, request, response);
+  }
+
+  updateStatistics(url, startTime, fromSnapshot);
 }
 
 bool RpcServer::processJsonRpcRequest(const HttpRequest& request, HttpResponse& response) {
@@ -170,6 +229,7 @@ bool RpcServer::processJsonRpcRequest(const HttpRequest& request, HttpResponse&
   }
   response.addHeader("Content-Type", "application/json");
 
+  auto startTime = std::chrono::steady_clock::now();
   JsonRpcRequest jsonRequest;
   JsonRpcResponse jsonResponse;
 
@@ -178,8 +238,8 @@ bool RpcServer::processJsonRpcRequest(const HttpRequest& request, HttpResponse&
     jsonRequest.parseRequest(request.getBody());
     jsonResponse.setId(jsonRequest.getId()); // copy id
 
-    static std::unordered_map<std::string, RpcServer::RpcHandler<JsonMemberMethod>> jsonRpcHandlers = {
-      { "f_blocks_list_json", { makeMemberMethod(&RpcServer::f_on_blocks_list_json), false } },
+    static std::unordered_map<std::string, RpcServer::RpcHandler<JsonMemberMethod, JsonSnapshotMethod>> jsonRpcHandlers = {
+      { "f_blocks_list_json", { makeMemberMethod(&RpcServer::f_on_blocks_list_json), false, makeSnapshotMethod(&RpcServer::f_on_blocks_list_json) } },
       { "f_block_json", { makeMemberMethod(&RpcServer::f_on_block_json), false } },
       { "f_transaction_json", { makeMemberMethod(&RpcServer::f_on_transaction_json), false } },
       { "f_on_transactions_pool_json", { makeMemberMethod(&RpcServer::f_on_transactions_pool_json), false } },
@@ -190,9 +250,9 @@ bool RpcServer::processJsonRpcRequest(const HttpRequest& request, HttpResponse&
       { "getblocktemplate", { makeMemberMethod(&RpcServer::on_getblocktemplate), false } },
       { "getcurrencyid", { makeMemberMethod(&RpcServer::on_get_currency_id), true } },
       { "submitblock", { makeMemberMethod(&RpcServer::on_submitblock), false } },
-      { "getlastblockheader", { makeMemberMethod(&RpcServer::on_get_last_block_header), false } },
+      { "getlastblockheader", { makeMemberMethod(&RpcServer::on_get_last_block_header), false, makeSnapshotMethod(&RpcServer::on_get_last_block_header) } },
       { "getblockheaderbyhash", { makeMemberMethod(&RpcServer::on_get_block_header_by_hash), false } },
-      { "getblockheaderbyheight", { makeMemberMethod(&RpcServer::on_get_block_header_by_height), false } }
+      { "getblockheaderbyheight", { makeMemberMethod(&RpcServer::on_get_block_header_by_height), false, makeSnapshotMethod(&RpcServer::on_get_block_header_by_height) } }
     };
 
     auto it = jsonRpcHandlers.find(jsonRequest.getMethod());
@@ -204,7 +264,16 @@ bool RpcServer::processJsonRpcRequest(const HttpRequest& request, HttpResponse&
       throw JsonRpcError(CORE_RPC_ERROR_CODE_CORE_BUSY, "Core is busy");
     }
 
-    it->second.handler(this, jsonRequest, jsonResponse);
+    const auto& handler = it->second;
+    bool fromSnapshot = handler.snapshotHandler && serveFromSnapshot([this, &handler, &jsonRequest, &jsonResponse] (const MainChainSnapshot& snapshot) {
+      handler.snapshotHandler(this, snapshot, jsonRequest, jsonResponse);
+    });
+
+    if (!fromSnapshot) {
+      handler.handler(this, jsonRequest, jsonResponse);
+    }
+
+    updateStatistics("/json_rpc/" + jsonRequest.getMethod(), startTime, fromSnapshot);
 
   } catch (const JsonRpcError& err) {
     jsonResponse.setError(err);
@@ -227,10 +296,99 @@ bool RpcServer::setFeeAddress(const std::string fee_address) {
   return true;
 }
 
+void RpcServer::setWorkerThreadsCount(size_t threadsCount) {
+  m_workers.reset(threadsCount == 0 ? nullptr : new Common::ThreadPool(threadsCount));
+}
+
+std::map<std::string, RpcEndpointStatistics> RpcServer::getEndpointStatistics() const {
+  std::lock_guard<std::mutex> lock(m_statisticsMutex);
+  return m_statistics;
+}
+
 bool RpcServer::isCoreReady() {
   return m_core.getCurrency().isTestnet() || m_p2p.get_payload_object().isSynchronized();
 }
 
+bool RpcServer::serveFromSnapshot(const std::function<void(const MainChainSnapshot& snapshot)>& handler) {
+  if (m_workers == nullptr) {
+    return false;
+  }
+
+  struct Task {
+    Task(System::Dispatcher& dispatcher, std::shared_ptr<const MainChainSnapshot>&& snapshot) :
+      snapshot(std::move(snapshot)), finished(dispatcher) {
+    }
+
+    std::shared_ptr<const MainChainSnapshot> snapshot;
+    System::Event finished;
+    std::exception_ptr error;
+  };
+
+  auto snapshot = m_core.getMainChainSnapshot();
+  if (snapshot == nullptr) {
+    return false;
+  }
+
+  auto task = std::make_shared<Task>(m_dispatcher, std::move(snapshot));
+  m_workers->post(std::bind([this, &handler] (std::shared_ptr<Task>& task) {
+    try {
+      handler(*task->snapshot);
+    } catch (...) {
+      task->error = std::current_exception();
+    }
+
+    // the task is released on the dispatcher thread, which owns its event
+    m_dispatcher.remoteSpawn(std::bind([] (std::shared_ptr<Task>& task) {
+      task->finished.set();
+    }, std::move(task)));
+  }, task));
+
+  // the handler works with the caller's request and response, so an interrupt is delivered once it finishes
+  bool interrupted = false;
+  while (!task->finished.get()) {
+    try {
+      task->finished.wait();
+    } catch (System::InterruptedException&) {
+      interrupted = true;
+    }
+  }
+
+  if (interrupted) {
+    m_dispatcher.interrupt();
+  }
+
+  if (task->error) {
+    try {
+      std::rethrow_exception(task->error);
+    } catch (const OutOfSnapshotError& e) {
+      logger(TRACE) << "Request is served by the core: " << e.what();
+      return false;
+    }
+  }
+
+  return true;
+}
+
+void RpcServer::updateStatistics(const std::string& endpoint, std::chrono::steady_clock::time_point startTime, bool fromSnapshot) {
+  uint64_t microseconds = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - startTime).count();
+
+  size_t bucket = 0;
+  while (bucket + 1 < RpcEndpointStatistics::LATENCY_BUCKETS_COUNT && (microseconds >> bucket) != 0) {
+    ++bucket;
+  }
+
+  std::lock_guard<std::mutex> lock(m_statisticsMutex);
+  RpcEndpointStatistics& statistics = m_statistics[endpoint];
+  ++statistics.requests;
+  if (fromSnapshot) {
+    ++statistics.snapshotRequests;
+  }
+
+  statistics.totalMicroseconds += microseconds;
+  statistics.maxMicroseconds = std::max(statistics.maxMicroseconds, microseconds);
+  ++statistics.latencyBuckets[bucket];
+}
+
 //
 // Binary handlers
 //
@@ -309,13 +467,14 @@ bool RpcServer::on_get_indexes(const COMMAND_RPC_GET_TX_GLOBAL_OUTPUTS_INDEXES::
   return true;
 }
 
-bool RpcServer::on_get_random_outs_json(const COMMAND_RPC_GET_RANDOM_OUTPUTS_FOR_AMOUNTS_JSON::request& req, COMMAND_RPC_GET_RANDOM_OUTPUTS_FOR_AMOUNTS_JSON::response& res) {
+template <class MainChain>
+bool RpcServer::get_random_outs_json(const MainChain& mainChain, const COMMAND_RPC_GET_RANDOM_OUTPUTS_FOR_AMOUNTS_JSON::request& req, COMMAND_RPC_GET_RANDOM_OUTPUTS_FOR_AMOUNTS_JSON::response& res) {
   res.status = "Failed";
 
   for (uint64_t amount : req.amounts) {
     std::vector<uint32_t> globalIndexes;
     std::vector<Crypto::PublicKey> publicKeys;
-    if (!m_core.getRandomOutputs(amount, static_cast<uint16_t>(req.outs_count), globalIndexes, publicKeys)) {
+    if (!mainChain.getRandomOutputs(amount, static_cast<uint16_t>(req.outs_count), globalIndexes, publicKeys)) {
       return true;
     }
 
@@ -334,13 +493,22 @@ bool RpcServer::on_get_random_outs_json(const COMMAND_RPC_GET_RANDOM_OUTPUTS_FOR
   return true;
 }
 
-bool RpcServer::on_get_random_outs(const COMMAND_RPC_GET_RANDOM_OUTPUTS_FOR_AMOUNTS::request& req, COMMAND_RPC_GET_RANDOM_OUTPUTS_FOR_AMOUNTS::response& res) {
+bool RpcServer::on_get_random_outs_json(const COMMAND_RPC_GET_RANDOM_OUTPUTS_FOR_AMOUNTS_JSON::request& req, COMMAND_RPC_GET_RANDOM_OUTPUTS_FOR_AMOUNTS_JSON::response& res) {
+  return get_random_outs_json(m_core, req, res);
+}
+
+bool RpcServer::on_get_random_outs_json(const MainChainSnapshot& snapshot, const COMMAND_RPC_GET_RANDOM_OUTPUTS_FOR_AMOUNTS_JSON::request& req, COMMAND_RPC_GET_RANDOM_OUTPUTS_FOR_AMOUNTS_JSON::response& res) {
+  return get_random_outs_json(snapshot, req, res);
+}
+
+template <class MainChain>
+bool RpcServer::get_random_outs(const MainChain& mainChain, const COMMAND_RPC_GET_RANDOM_OUTPUTS_FOR_AMOUNTS::request& req, COMMAND_RPC_GET_RANDOM_OUTPUTS_FOR_AMOUNTS::response& res) {
   res.status = "Failed";
 
   for (uint64_t amount : req.amounts) {
     std::vector<uint32_t> globalIndexes;
     std::vector<Crypto::PublicKey> publicKeys;
-    if (!m_core.getRandomOutputs(amount, static_cast<uint16_t>(req.outs_count), globalIndexes, publicKeys)) {
+    if (!mainChain.getRandomOutputs(amount, static_cast<uint16_t>(req.outs_count), globalIndexes, publicKeys)) {
       return true;
     }
 
@@ -374,6 +542,14 @@ bool RpcServer::on_get_random_outs(const COMMAND_RPC_GET_RANDOM_OUTPUTS_FOR_AMOU
   return true;
 }
 
+bool RpcServer::on_get_random_outs(const COMMAND_RPC_GET_RANDOM_OUTPUTS_FOR_AMOUNTS::request& req, COMMAND_RPC_GET_RANDOM_OUTPUTS_FOR_AMOUNTS::response& res) {
+  return get_random_outs(m_core, req, res);
+}
+
+bool RpcServer::on_get_random_outs(const MainChainSnapshot& snapshot, const COMMAND_RPC_GET_RANDOM_OUTPUTS_FOR_AMOUNTS::request& req, COMMAND_RPC_GET_RANDOM_OUTPUTS_FOR_AMOUNTS::response& res) {
+  return get_random_outs(snapshot, req, res);
+}
+
 bool RpcServer::onGetPoolChanges(const COMMAND_RPC_GET_POOL_CHANGES::request& req, COMMAND_RPC_GET_POOL_CHANGES::response& rsp) {
   rsp.status = CORE_RPC_STATUS_OK;
   rsp.isTailBlockActual = m_core.getPoolChanges(req.tailBlockId, req.knownTxsIds, rsp.addedTxs, rsp.deletedTxsIds);
@@ -588,43 +764,54 @@ bool RpcServer::on_stop_daemon(const COMMAND_RPC_STOP_DAEMON::request& req, COMM
 //------------------------------------------------------------------------------------------------------------------------------
 // JSON RPC methods
 //------------------------------------------------------------------------------------------------------------------------------
-bool RpcServer::f_on_blocks_list_json(const F_COMMAND_RPC_GET_BLOCKS_LIST::request& req, F_COMMAND_RPC_GET_BLOCKS_LIST::response& res) {
+template <class MainChain>
+bool RpcServer::get_blocks_list_json(const MainChain& mainChain, const F_COMMAND_RPC_GET_BLOCKS_LIST::request& req, F_COMMAND_RPC_GET_BLOCKS_LIST::response& res) {
   // check if blockchain explorer RPC is enabled
   if (m_core.getCurrency().isBlockexplorer() == false) {
     return false;
   }
 
-  if (m_core.getTopBlockIndex() + 1 <= req.height) {
+  if (mainChain.getTopBlockIndex() + 1 <= req.height) {
     throw JsonRpc::JsonRpcError{ CORE_RPC_ERROR_CODE_TOO_BIG_HEIGHT,
-      std::string("To big height: ") + std::to_string(req.height) + ", current blockchain height = " + std::to_string(m_core.getTopBlockIndex() + 1) };
+      std::string("To big height: ") + std::to_string(req.height) + ", current blockchain height = " + std::to_string(mainChain.getTopBlockIndex() + 1) };
   }
 
   uint32_t print_blocks_count = 30;
-  uint32_t last_height = req.height - print_blocks_count;
-  if (req.height <= print_blocks_count)  {
-    last_height = 0;
-  } 
-
-  for (uint32_t i = req.height; i >= last_height; i--) {
-    Hash block_hash = m_core.getBlockHashByIndex(static_cast<uint32_t>(i));
-    if (!m_core.hasBlock(block_hash)) {
+  uint32_t height = static_cast<uint32_t>(req.height);
+  uint32_t last_height = height <= print_blocks_count ? 0 : height - print_blocks_count;
+
+  // the whole list is read at once
+  std::vector<RawBlock> rawBlocks = mainChain.getBlocks(last_height, height - last_height + 1);
+  if (rawBlocks.size() != height - last_height + 1) {
+    throw JsonRpc::JsonRpcError{
+      CORE_RPC_ERROR_CODE_INTERNAL_ERROR,
+      "Internal error: can't get blocks by height. Height = " + std::to_string(height) + '.' };
+  }
+
+  for (uint32_t i = height; ; i--) {
+    const RawBlock& rawBlock = rawBlocks[i - last_height];
+    BlockTemplate blk;
+    if (!fromBinaryArray(blk, rawBlock.block)) {
       throw JsonRpc::JsonRpcError{
         CORE_RPC_ERROR_CODE_INTERNAL_ERROR,
         "Internal error: can't get block by height. Height = " + std::to_string(i) + '.' };
     }
-    BlockTemplate blk = m_core.getBlockByHash(block_hash);
-    BlockDetails blkDetails = m_core.getBlockDetails(block_hash);
 
     f_block_short_response block_short;
-    block_short.cumul_size = blkDetails.blockSize;
+    // the same as BlockDetails::blockSize, raw transactions don't include the base transaction
+    block_short.cumul_size = rawBlock.block.size();
+    for (const BinaryArray& transaction : rawBlock.transactions) {
+      block_short.cumul_size += transaction.size();
+    }
+
     block_short.timestamp = blk.timestamp;
     block_short.height = i;
-    block_short.hash = Common::podToHex(block_hash);
+    block_short.hash = Common::podToHex(CachedBlock(blk).getBlockHash());
     block_short.tx_count = blk.transactionHashes.size() + 1;
 
     res.blocks.push_back(block_short);
 
-    if (i == 0)
+    if (i == last_height)
       break;
   }
 
@@ -632,6 +819,14 @@ bool RpcServer::f_on_blocks_list_json(const F_COMMAND_RPC_GET_BLOCKS_LIST::reque
   return true;
 }
 
+bool RpcServer::f_on_blocks_list_json(const F_COMMAND_RPC_GET_BLOCKS_LIST::request& req, F_COMMAND_RPC_GET_BLOCKS_LIST::response& res) {
+  return get_blocks_list_json(m_core, req, res);
+}
+
+bool RpcServer::f_on_blocks_list_json(const MainChainSnapshot& snapshot, const F_COMMAND_RPC_GET_BLOCKS_LIST::request& req, F_COMMAND_RPC_GET_BLOCKS_LIST::response& res) {
+  return get_blocks_list_json(snapshot, req, res);
+}
+
 bool RpcServer::f_on_block_json(const F_COMMAND_RPC_GET_BLOCK_DETAILS::request& req, F_COMMAND_RPC_GET_BLOCK_DETAILS::response& res) {
   // check if blockchain explorer RPC is enabled
   if (m_core.getCurrency().isBlockexplorer() == false) {
@@ -1142,7 +1337,8 @@ uint64_t get_block_reward(const BlockTemplate& blk) {
 
 }
 
-void RpcServer::fill_block_header_response(const BlockTemplate& blk, bool orphan_status, uint32_t index, const Hash& hash, block_header_response& response) {
+template <class MainChain>
+void RpcServer::fill_block_header_response(const MainChain& mainChain, const BlockTemplate& blk, bool orphan_status, uint32_t index, const Hash& hash, block_header_response& response) {
   response.major_version = blk.majorVersion;
   response.minor_version = blk.minorVersion;
   response.timestamp = blk.timestamp;
@@ -1150,19 +1346,32 @@ void RpcServer::fill_block_header_response(const BlockTemplate& blk, bool orphan
   response.nonce = blk.nonce;
   response.orphan_status = orphan_status;
   response.height = index;
-  response.depth = m_core.getTopBlockIndex() - index;
+  response.depth = mainChain.getTopBlockIndex() - index;
   response.hash = Common::podToHex(hash);
-  response.difficulty = m_core.getBlockDifficulty(index);
+  response.difficulty = mainChain.getBlockDifficulty(index);
   response.reward = get_block_reward(blk);
 }
 
-bool RpcServer::on_get_last_block_header(const COMMAND_RPC_GET_LAST_BLOCK_HEADER::request& req, COMMAND_RPC_GET_LAST_BLOCK_HEADER::response& res) {
-  auto topBlock = m_core.getBlockByHash(m_core.getTopBlockHash());  
-  fill_block_header_response(topBlock, false, m_core.getTopBlockIndex(), m_core.getTopBlockHash(), res.block_header);
+void RpcServer::fill_block_header_response(const BlockTemplate& blk, bool orphan_status, uint32_t index, const Hash& hash, block_header_response& response) {
+  fill_block_header_response(m_core, blk, orphan_status, index, hash, response);
+}
+
+template <class MainChain>
+bool RpcServer::get_last_block_header(const MainChain& mainChain, const COMMAND_RPC_GET_LAST_BLOCK_HEADER::request& req, COMMAND_RPC_GET_LAST_BLOCK_HEADER::response& res) {
+  auto topBlock = mainChain.getBlockByHash(mainChain.getTopBlockHash());  
+  fill_block_header_response(mainChain, topBlock, false, mainChain.getTopBlockIndex(), mainChain.getTopBlockHash(), res.block_header);
   res.status = CORE_RPC_STATUS_OK;
   return true;
 }
 
+bool RpcServer::on_get_last_block_header(const COMMAND_RPC_GET_LAST_BLOCK_HEADER::request& req, COMMAND_RPC_GET_LAST_BLOCK_HEADER::response& res) {
+  return get_last_block_header(m_core, req, res);
+}
+
+bool RpcServer::on_get_last_block_header(const MainChainSnapshot& snapshot, const COMMAND_RPC_GET_LAST_BLOCK_HEADER::request& req, COMMAND_RPC_GET_LAST_BLOCK_HEADER::response& res) {
+  return get_last_block_header(snapshot, req, res);
+}
+
 bool RpcServer::on_get_block_header_by_hash(const COMMAND_RPC_GET_BLOCK_HEADER_BY_HASH::request& req, COMMAND_RPC_GET_BLOCK_HEADER_BY_HASH::response& res) {
   Hash blockHash;
   if (!parse_hash256(req.hash, blockHash)) {
@@ -1186,20 +1395,29 @@ bool RpcServer::on_get_block_header_by_hash(const COMMAND_RPC_GET_BLOCK_HEADER_B
   return true;
 }
 
-bool RpcServer::on_get_block_header_by_height(const COMMAND_RPC_GET_BLOCK_HEADER_BY_HEIGHT::request& req, COMMAND_RPC_GET_BLOCK_HEADER_BY_HEIGHT::response& res) {
-  if (m_core.getTopBlockIndex() + 1 < req.height) {
+template <class MainChain>
+bool RpcServer::get_block_header_by_height(const MainChain& mainChain, const COMMAND_RPC_GET_BLOCK_HEADER_BY_HEIGHT::request& req, COMMAND_RPC_GET_BLOCK_HEADER_BY_HEIGHT::response& res) {
+  if (mainChain.getTopBlockIndex() + 1 < req.height) {
     throw JsonRpc::JsonRpcError{ CORE_RPC_ERROR_CODE_TOO_BIG_HEIGHT,
-      std::string("To big height: ") + std::to_string(req.height) + ", current blockchain height = " + std::to_string(m_core.getTopBlockIndex() + 1) };
+      std::string("To big height: ") + std::to_string(req.height) + ", current blockchain height = " + std::to_string(mainChain.getTopBlockIndex() + 1) };
   }
 
   uint32_t index = static_cast<uint32_t>(req.height) - 1;
-  auto block = m_core.getBlockByIndex(index);
+  auto block = mainChain.getBlockByIndex(index);
   CachedBlock cachedBlock(block);
   assert(cachedBlock.getBlockIndex() == req.height - 1);
-  fill_block_header_response(block, false, index, cachedBlock.getBlockHash(), res.block_header);
+  fill_block_header_response(mainChain, block, false, index, cachedBlock.getBlockHash(), res.block_header);
   res.status = CORE_RPC_STATUS_OK;
   return true;
 }
 
+bool RpcServer::on_get_block_header_by_height(const COMMAND_RPC_GET_BLOCK_HEADER_BY_HEIGHT::request& req, COMMAND_RPC_GET_BLOCK_HEADER_BY_HEIGHT::response& res) {
+  return get_block_header_by_height(m_core, req, res);
+}
+
+bool RpcServer::on_get_block_header_by_height(const MainChainSnapshot& snapshot, const COMMAND_RPC_GET_BLOCK_HEADER_BY_HEIGHT::request& req, COMMAND_RPC_GET_BLOCK_HEADER_BY_HEIGHT::response& res) {
+  return get_block_header_by_height(snapshot, req, res);
+}
+
 
 }
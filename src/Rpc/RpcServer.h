@@ -17,41 +17,73 @@
 
 #include "HttpServer.h"
 
+#include <array>
+#include <chrono>
 #include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
 #include <unordered_map>
 
 #include <Logging/LoggerRef.h>
 #include "Common/Math.h"
+#include "Common/ThreadPool.h"
 #include "CoreRpcServerCommandsDefinitions.h"
 
 namespace CryptoNote {
 
 class Core;
+class MainChainSnapshot;
 class NodeServer;
 struct ICryptoNoteProtocolHandler;
 
+struct RpcEndpointStatistics {
+  static const size_t LATENCY_BUCKETS_COUNT = 24;
+
+  uint64_t requests;
+  // served on worker threads from a main chain snapshot
+  uint64_t snapshotRequests;
+  uint64_t totalMicroseconds;
+  uint64_t maxMicroseconds;
+  // bucket i counts requests served in [2^(i-1), 2^i) microseconds, the last one counts all slower requests
+  std::array<uint64_t, LATENCY_BUCKETS_COUNT> latencyBuckets;
+};
+
 class RpcServer : public HttpServer {
 public:
   RpcServer(System::Dispatcher& dispatcher, Logging::ILogger& log, Core& c, NodeServer& p2p, ICryptoNoteProtocolHandler& protocol);
 
   typedef std::function<bool(RpcServer*, const HttpRequest& request, HttpResponse& response)> HandlerFunction;
+  typedef std::function<bool(RpcServer*, const MainChainSnapshot& snapshot, const HttpRequest& request, HttpResponse& response)> SnapshotHandlerFunction;
   bool setFeeAddress(const std::string fee_address);
   bool enableCors(const std::vector<std::string>  domains);
+  // Read-only requests that have a snapshot handler are served on this many threads, 0 serves all requests on the dispatcher
+  void setWorkerThreadsCount(size_t threadsCount);
+
+  // Keyed by URL, JSON RPC methods are keyed by "/json_rpc/<method>"
+  std::map<std::string, RpcEndpointStatistics> getEndpointStatistics() const;
 
 private:
 
-  template <class Handler>
+  // The snapshot handler, if any, serves the request on a worker thread, the handler serves it on the dispatcher
+  // when there are no workers or the snapshot doesn't have the requested data
+  template <class Handler, class SnapshotHandler>
   struct RpcHandler {
     const Handler handler;
     const bool allowBusyCore;
+    const SnapshotHandler snapshotHandler;
   };
 
   typedef void (RpcServer::*HandlerPtr)(const HttpRequest& request, HttpResponse& response);
-  static std::unordered_map<std::string, RpcHandler<HandlerFunction>> s_handlers;
+  static std::unordered_map<std::string, RpcHandler<HandlerFunction, SnapshotHandlerFunction>> s_handlers;
 
   virtual void processRequest(const HttpRequest& request, HttpResponse& response) override;
   bool processJsonRpcRequest(const HttpRequest& request, HttpResponse& response);
   bool isCoreReady();
+  // Runs the handler against a main chain snapshot on a worker thread, the calling context waits for it.
+  // Returns false if the request has to be served by the core.
+  bool serveFromSnapshot(const std::function<void(const MainChainSnapshot& snapshot)>& handler);
+  void updateStatistics(const std::string& endpoint, std::chrono::steady_clock::time_point startTime, bool fromSnapshot);
 
   // binary handlers
   bool on_get_blocks(const COMMAND_RPC_GET_BLOCKS_FAST::request& req, COMMAND_RPC_GET_BLOCKS_FAST::response& res);
@@ -59,6 +91,7 @@ private:
   bool on_query_blocks_lite(const COMMAND_RPC_QUERY_BLOCKS_LITE::request& req, COMMAND_RPC_QUERY_BLOCKS_LITE::response& res);
   bool on_get_indexes(const COMMAND_RPC_GET_TX_GLOBAL_OUTPUTS_INDEXES::request& req, COMMAND_RPC_GET_TX_GLOBAL_OUTPUTS_INDEXES::response& res);
   bool on_get_random_outs(const COMMAND_RPC_GET_RANDOM_OUTPUTS_FOR_AMOUNTS::request& req, COMMAND_RPC_GET_RANDOM_OUTPUTS_FOR_AMOUNTS::response& res);
+  bool on_get_random_outs(const MainChainSnapshot& snapshot, const COMMAND_RPC_GET_RANDOM_OUTPUTS_FOR_AMOUNTS::request& req, COMMAND_RPC_GET_RANDOM_OUTPUTS_FOR_AMOUNTS::response& res);
   bool onGetPoolChanges(const COMMAND_RPC_GET_POOL_CHANGES::request& req, COMMAND_RPC_GET_POOL_CHANGES::response& rsp);
   bool onGetPoolChangesLite(const COMMAND_RPC_GET_POOL_CHANGES_LITE::request& req, COMMAND_RPC_GET_POOL_CHANGES_LITE::response& rsp);
   bool onGetBlocksDetailsByHashes(const COMMAND_RPC_GET_BLOCKS_DETAILS_BY_HASHES::request& req, COMMAND_RPC_GET_BLOCKS_DETAILS_BY_HASHES::response& rsp);
@@ -69,6 +102,7 @@ private:
 
   // json handlers
 bool on_get_random_outs_json(const COMMAND_RPC_GET_RANDOM_OUTPUTS_FOR_AMOUNTS_JSON::request& req, COMMAND_RPC_GET_RANDOM_OUTPUTS_FOR_AMOUNTS_JSON::response& res);
+  bool on_get_random_outs_json(const MainChainSnapshot& snapshot, const COMMAND_RPC_GET_RANDOM_OUTPUTS_FOR_AMOUNTS_JSON::request& req, COMMAND_RPC_GET_RANDOM_OUTPUTS_FOR_AMOUNTS_JSON::response& res);
   bool on_get_info(const COMMAND_RPC_GET_INFO::request& req, COMMAND_RPC_GET_INFO::response& res);
   bool on_get_height(const COMMAND_RPC_GET_HEIGHT::request& req, COMMAND_RPC_GET_HEIGHT::response& res);
   bool on_get_transactions(const COMMAND_RPC_GET_TRANSACTIONS::request& req, COMMAND_RPC_GET_TRANSACTIONS::response& res);
@@ -82,15 +116,32 @@ bool on_get_random_outs_json(const COMMAND_RPC_GET_RANDOM_OUTPUTS_FOR_AMOUNTS_JS
   bool on_get_currency_id(const COMMAND_RPC_GET_CURRENCY_ID::request& req, COMMAND_RPC_GET_CURRENCY_ID::response& res);
   bool on_submitblock(const COMMAND_RPC_SUBMITBLOCK::request& req, COMMAND_RPC_SUBMITBLOCK::response& res);
   bool on_get_last_block_header(const COMMAND_RPC_GET_LAST_BLOCK_HEADER::request& req, COMMAND_RPC_GET_LAST_BLOCK_HEADER::response& res);
+  bool on_get_last_block_header(const MainChainSnapshot& snapshot, const COMMAND_RPC_GET_LAST_BLOCK_HEADER::request& req, COMMAND_RPC_GET_LAST_BLOCK_HEADER::response& res);
   bool on_get_block_header_by_hash(const COMMAND_RPC_GET_BLOCK_HEADER_BY_HASH::request& req, COMMAND_RPC_GET_BLOCK_HEADER_BY_HASH::response& res);
   bool on_get_block_header_by_height(const COMMAND_RPC_GET_BLOCK_HEADER_BY_HEIGHT::request& req, COMMAND_RPC_GET_BLOCK_HEADER_BY_HEIGHT::response& res);
+  bool on_get_block_header_by_height(const MainChainSnapshot& snapshot, const COMMAND_RPC_GET_BLOCK_HEADER_BY_HEIGHT::request& req, COMMAND_RPC_GET_BLOCK_HEADER_BY_HEIGHT::response& res);
 
   void fill_block_header_response(const BlockTemplate& blk, bool orphan_status, uint32_t index, const Crypto::Hash& hash, block_header_response& responce);
+
+  // Shared by the core and the snapshot handlers, MainChain is Core or MainChainSnapshot
+  template <class MainChain>
+  bool get_random_outs(const MainChain& mainChain, const COMMAND_RPC_GET_RANDOM_OUTPUTS_FOR_AMOUNTS::request& req, COMMAND_RPC_GET_RANDOM_OUTPUTS_FOR_AMOUNTS::response& res);
+  template <class MainChain>
+  bool get_random_outs_json(const MainChain& mainChain, const COMMAND_RPC_GET_RANDOM_OUTPUTS_FOR_AMOUNTS_JSON::request& req, COMMAND_RPC_GET_RANDOM_OUTPUTS_FOR_AMOUNTS_JSON::response& res);
+  template <class MainChain>
+  bool get_last_block_header(const MainChain& mainChain, const COMMAND_RPC_GET_LAST_BLOCK_HEADER::request& req, COMMAND_RPC_GET_LAST_BLOCK_HEADER::response& res);
+  template <class MainChain>
+  bool get_block_header_by_height(const MainChain& mainChain, const COMMAND_RPC_GET_BLOCK_HEADER_BY_HEIGHT::request& req, COMMAND_RPC_GET_BLOCK_HEADER_BY_HEIGHT::response& res);
+  template <class MainChain>
+  bool get_blocks_list_json(const MainChain& mainChain, const F_COMMAND_RPC_GET_BLOCKS_LIST::request& req, F_COMMAND_RPC_GET_BLOCKS_LIST::response& res);
+  template <class MainChain>
+  void fill_block_header_response(const MainChain& mainChain, const BlockTemplate& blk, bool orphan_status, uint32_t index, const Crypto::Hash& hash, block_header_response& responce);
   RawBlockLegacy prepareRawBlockLegacy(BinaryArray&& blockBlob);
 
   bool on_get_fee_address(const COMMAND_RPC_GET_FEE_ADDRESS::request& req, COMMAND_RPC_GET_FEE_ADDRESS::response& res);
 
   bool f_on_blocks_list_json(const F_COMMAND_RPC_GET_BLOCKS_LIST::request& req, F_COMMAND_RPC_GET_BLOCKS_LIST::response& res);
+  bool f_on_blocks_list_json(const MainChainSnapshot& snapshot, const F_COMMAND_RPC_GET_BLOCKS_LIST::request& req, F_COMMAND_RPC_GET_BLOCKS_LIST::response& res);
   bool f_on_block_json(const F_COMMAND_RPC_GET_BLOCK_DETAILS::request& req, F_COMMAND_RPC_GET_BLOCK_DETAILS::response& res);
   bool f_on_transaction_json(const F_COMMAND_RPC_GET_TRANSACTION_DETAILS::request& req, F_COMMAND_RPC_GET_TRANSACTION_DETAILS::response& res);
   bool f_on_transactions_pool_json(const F_COMMAND_RPC_GET_POOL::request& req, F_COMMAND_RPC_GET_POOL::response& res);
@@ -103,6 +154,9 @@ bool on_get_random_outs_json(const COMMAND_RPC_GET_RANDOM_OUTPUTS_FOR_AMOUNTS_JS
   ICryptoNoteProtocolHandler& m_protocol;
   std::string m_fee_address;
 std::vector<std::string> m_cors_domains;
+  std::unique_ptr<Common::ThreadPool> m_workers;
+  mutable std::mutex m_statisticsMutex;
+  std::map<std::string, RpcEndpointStatistics> m_statistics;
 };
 
 }
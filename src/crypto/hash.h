@@ -18,6 +18,8 @@
 #pragma once
 
 #include <stddef.h>
+#include <memory>
+#include <vector>
 
 #include <CryptoTypes.h>
 #include "generic-ops.h"
@@ -42,26 +44,90 @@ namespace Crypto {
     return h;
   }
 
+  /*
+    Memory backing the slow hash scratchpad, from the most to the least preferred.
+    Huge pages are tried first and each failure falls back to the next backing.
+  */
+  enum class cn_page_backing {
+    huge_pages,
+    transparent_huge_pages,
+    normal_pages
+  };
+
+  struct cn_context_stats {
+    size_t huge_pages;
+    size_t transparent_huge_pages;
+    size_t normal_pages;
+  };
+
   class cn_context {
   public:
 
-    cn_context();
+    explicit cn_context(cn_page_backing preferred_backing = cn_page_backing::huge_pages);
     ~cn_context();
 #if !defined(_MSC_VER) || _MSC_VER >= 1800
     cn_context(const cn_context &) = delete;
     void operator=(const cn_context &) = delete;
 #endif
 
+    cn_page_backing backing() const {
+      return page_backing;
+    }
+
   private:
 
+    bool map_huge_pages();
+    bool map_transparent_huge_pages();
+    void map_normal_pages();
+
+    // the scratchpad is mapped on its own so that it fits a single huge page,
+    // data points to the 16 byte aligned hashing state inside state_buffer
+    unsigned char state_buffer[SLOW_HASH_CONTEXT_SIZE + 15];
     void *data;
+    void *mapping;
+    size_t mapping_size;
+    cn_page_backing page_backing;
     friend inline void cn_slow_hash(cn_context &, const void *, size_t, Hash &);
+    friend inline void cn_slow_hash_multi(cn_context *const *, const void *const *, size_t, Hash *, size_t);
   };
 
+  /*
+    Number of live contexts by the backing they were allocated with.
+  */
+  cn_context_stats get_cn_context_stats();
+
+  /*
+    Allocates up to max_count contexts, stopping early when memory runs out.
+    Throws if not even one context can be allocated.
+  */
+  std::vector<std::unique_ptr<cn_context>> make_cn_contexts(size_t max_count);
+
   inline void cn_slow_hash(cn_context &context, const void *data, size_t length, Hash &hash) {
     (*cn_slow_hash_f)(context.data, data, length, reinterpret_cast<void *>(&hash));
   }
 
+  /*
+    Hashes count inputs of the same length at once, each with its own context.
+    Up to SLOW_HASH_MAX_WAYS lanes are interleaved in the memory-hard loop.
+  */
+  inline void cn_slow_hash_multi(cn_context *const *contexts, const void *const *data, size_t length, Hash *hashes, size_t count) {
+    void *scratchpads[SLOW_HASH_MAX_WAYS];
+    void *outputs[SLOW_HASH_MAX_WAYS];
+    while (count > 0) {
+      size_t ways = count < static_cast<size_t>(SLOW_HASH_MAX_WAYS) ? count : static_cast<size_t>(SLOW_HASH_MAX_WAYS);
+      for (size_t i = 0; i < ways; ++i) {
+        scratchpads[i] = contexts[i]->data;
+        outputs[i] = reinterpret_cast<void *>(&hashes[i]);
+      }
+
+      (*cn_slow_hash_multi_f)(scratchpads, data, length, outputs, ways);
+      contexts += ways;
+      data += ways;
+      hashes += ways;
+      count -= ways;
+    }
+  }
+
   inline void tree_hash(const Hash *hashes, size_t count, Hash &root_hash) {
     tree_hash(reinterpret_cast<const char (*)[HASH_SIZE]>(hashes), count, reinterpret_cast<char *>(&root_hash));
   }
@@ -35,18 +35,25 @@
 #include "oaes_lib.h"
 
 void (*cn_slow_hash_fp)(void *, const void *, size_t, void *);
+void (*cn_slow_hash_multi_fp)(void *const *, const void *const *, size_t, void *const *, size_t);
 
 void cn_slow_hash_f(void * a, const void * b, size_t c, void * d){
 (*cn_slow_hash_fp)(a, b, c, d);
 }
 
+void cn_slow_hash_multi_f(void *const *contexts, const void *const *data, size_t length, void *const *hashes, size_t count) {
+  (*cn_slow_hash_multi_fp)(contexts, data, length, hashes, count);
+}
+
 #if defined(__GNUC__)
 #define likely(x) (__builtin_expect(!!(x), 1))
 #define unlikely(x) (__builtin_expect(!!(x), 0))
+#define force_inline inline __attribute__((always_inline))
 #else
 #define likely(x) (x)
 #define unlikely(x) (x)
 #define __attribute__(x)
+#define force_inline __forceinline
 #endif
 
 #if defined(_MSC_VER)
@@ -79,7 +86,7 @@ union cn_slow_hash_state {
 #endif
 
 struct cn_ctx {
-  ALIGNED_DECL(uint8_t long_state[MEMORY], 16);
+  uint8_t *long_state;
   ALIGNED_DECL(union cn_slow_hash_state state, 16);
   ALIGNED_DECL(uint8_t text[INIT_SIZE_BYTE], 16);
   ALIGNED_DECL(uint64_t a[AES_BLOCK_SIZE >> 3], 16);
@@ -89,6 +96,11 @@ struct cn_ctx {
 };
 
 static_assert(sizeof(struct cn_ctx) == SLOW_HASH_CONTEXT_SIZE, "Invalid structure size");
+static_assert(MEMORY == SLOW_HASH_SCRATCHPAD_SIZE, "Invalid scratchpad size");
+
+void cn_slow_hash_set_scratchpad(void *context, void *scratchpad) {
+  ((struct cn_ctx *) context)->long_state = (uint8_t *) scratchpad;
+}
 
 static inline void ExpandAESKey256_sub1(__m128i *tmp1, __m128i *tmp2)
 {
@@ -178,6 +190,215 @@ static void (*const extra_hashes[4])(const void *, size_t, char *) =
 #include "slow-hash.inl"
 #define AESNI
 #include "slow-hash.inl"
+#undef ctx
+
+/*
+ * Several independent hashes per call. Scratchpad filling and finalization are done lane by lane,
+ * the memory-hard loop runs all lanes together, so their AES and MUL latencies overlap.
+ */
+static inline void cn_explode_scratchpad_aesni(struct cn_ctx *ctx, const void *data, size_t length)
+{
+  ALIGNED_DECL(uint8_t ExpandedKey[256], 16);
+  __m128i *longoutput, *expkey, *xmminput;
+  size_t i, j, k;
+
+  hash_process(&ctx->state.hs, (const uint8_t*) data, length);
+  memcpy(ctx->text, ctx->state.init, INIT_SIZE_BYTE);
+  memcpy(ExpandedKey, ctx->state.hs.b, AES_KEY_SIZE);
+  ExpandAESKey256(ExpandedKey);
+
+  longoutput = (__m128i *) ctx->long_state;
+  expkey = (__m128i *) ExpandedKey;
+  xmminput = (__m128i *) ctx->text;
+
+  for (i = 0; likely(i < MEMORY); i += INIT_SIZE_BYTE)
+  {
+    for (j = 0; j < 10; j++)
+    {
+      for (k = 0; k < 8; k++)
+      {
+        xmminput[k] = _mm_aesenc_si128(xmminput[k], expkey[j]);
+      }
+    }
+
+    for (k = 0; k < 8; k++)
+    {
+      _mm_store_si128(&(longoutput[(i >> 4) + k]), xmminput[k]);
+    }
+  }
+
+  for (i = 0; i < 2; i++)
+  {
+    ctx->a[i] = ((uint64_t *)ctx->state.k)[i] ^  ((uint64_t *)ctx->state.k)[i+4];
+    ctx->b[i] = ((uint64_t *)ctx->state.k)[i+2] ^  ((uint64_t *)ctx->state.k)[i+6];
+  }
+}
+
+static force_inline void cn_main_loop_step_aesni(uint8_t *long_state, uint64_t *a, __m128i *b_x)
+{
+  __m128i c_x = _mm_load_si128((__m128i *)&long_state[a[0] & 0x1FFFF0]);
+  __m128i a_x = _mm_set_epi64x((int64_t) a[1], (int64_t) a[0]);
+  uint64_t c[2];
+  uint64_t b[2];
+  uint64_t *nextblock;
+  uint64_t hi, lo;
+
+  c_x = _mm_aesenc_si128(c_x, a_x);
+  c[0] = (uint64_t) _mm_cvtsi128_si64(c_x);
+
+  *b_x = _mm_xor_si128(*b_x, c_x);
+  _mm_store_si128((__m128i *)&long_state[a[0] & 0x1FFFF0], *b_x);
+
+  nextblock = (uint64_t *)&long_state[c[0] & 0x1FFFF0];
+  b[0] = nextblock[0];
+  b[1] = nextblock[1];
+
+#if defined(__GNUC__) && defined(__x86_64__)
+  __asm__("mulq %3\n\t"
+    : "=d" (hi),
+    "=a" (lo)
+    : "%a" (c[0]),
+    "rm" (b[0])
+    : "cc" );
+#else
+  lo = mul128(c[0], b[0], &hi);
+#endif
+
+  a[0] += hi;
+  a[1] += lo;
+  nextblock[0] = a[0];
+  nextblock[1] = a[1];
+
+  a[0] ^= b[0];
+  a[1] ^= b[1];
+  *b_x = c_x;
+}
+
+// The lanes are spelled out so each one keeps its state in registers
+static void cn_main_loop_aesni_2(struct cn_ctx **ctx)
+{
+  uint8_t *long_state0 = ctx[0]->long_state, *long_state1 = ctx[1]->long_state;
+  uint64_t a0[2] = { ctx[0]->a[0], ctx[0]->a[1] };
+  uint64_t a1[2] = { ctx[1]->a[0], ctx[1]->a[1] };
+  __m128i b_x0 = _mm_load_si128((__m128i *)ctx[0]->b);
+  __m128i b_x1 = _mm_load_si128((__m128i *)ctx[1]->b);
+  size_t i;
+
+  for (i = 0; likely(i < 0x80000); i++)
+  {
+    cn_main_loop_step_aesni(long_state0, a0, &b_x0);
+    cn_main_loop_step_aesni(long_state1, a1, &b_x1);
+  }
+}
+
+static void cn_main_loop_aesni_4(struct cn_ctx **ctx)
+{
+  uint8_t *long_state0 = ctx[0]->long_state, *long_state1 = ctx[1]->long_state;
+  uint8_t *long_state2 = ctx[2]->long_state, *long_state3 = ctx[3]->long_state;
+  uint64_t a0[2] = { ctx[0]->a[0], ctx[0]->a[1] };
+  uint64_t a1[2] = { ctx[1]->a[0], ctx[1]->a[1] };
+  uint64_t a2[2] = { ctx[2]->a[0], ctx[2]->a[1] };
+  uint64_t a3[2] = { ctx[3]->a[0], ctx[3]->a[1] };
+  __m128i b_x0 = _mm_load_si128((__m128i *)ctx[0]->b);
+  __m128i b_x1 = _mm_load_si128((__m128i *)ctx[1]->b);
+  __m128i b_x2 = _mm_load_si128((__m128i *)ctx[2]->b);
+  __m128i b_x3 = _mm_load_si128((__m128i *)ctx[3]->b);
+  size_t i;
+
+  for (i = 0; likely(i < 0x80000); i++)
+  {
+    cn_main_loop_step_aesni(long_state0, a0, &b_x0);
+    cn_main_loop_step_aesni(long_state1, a1, &b_x1);
+    cn_main_loop_step_aesni(long_state2, a2, &b_x2);
+    cn_main_loop_step_aesni(long_state3, a3, &b_x3);
+  }
+}
+
+static inline void cn_implode_scratchpad_aesni(struct cn_ctx *ctx, void *hash)
+{
+  ALIGNED_DECL(uint8_t ExpandedKey[256], 16);
+  __m128i *longoutput, *expkey, *xmminput;
+  size_t i, j, k;
+
+  memcpy(ctx->text, ctx->state.init, INIT_SIZE_BYTE);
+  memcpy(ExpandedKey, &ctx->state.hs.b[32], AES_KEY_SIZE);
+  ExpandAESKey256(ExpandedKey);
+
+  longoutput = (__m128i *) ctx->long_state;
+  expkey = (__m128i *) ExpandedKey;
+  xmminput = (__m128i *) ctx->text;
+
+  for (i = 0; likely(i < MEMORY); i += INIT_SIZE_BYTE)
+  {
+    for (k = 0; k < 8; k++)
+    {
+      xmminput[k] = _mm_xor_si128(longoutput[(i >> 4) + k], xmminput[k]);
+    }
+
+    for (j = 0; j < 10; j++)
+    {
+      for (k = 0; k < 8; k++)
+      {
+        xmminput[k] = _mm_aesenc_si128(xmminput[k], expkey[j]);
+      }
+    }
+  }
+
+  memcpy(ctx->state.init, ctx->text, INIT_SIZE_BYTE);
+  hash_permutation(&ctx->state.hs);
+  extra_hashes[ctx->state.hs.b[0] & 3](&ctx->state, 200, hash);
+}
+
+static void cn_slow_hash_multi_aesni(void *const *contexts, const void *const *data, size_t length, void *const *hashes, size_t count)
+{
+  struct cn_ctx *ctx[SLOW_HASH_MAX_WAYS];
+  size_t ways, w;
+
+  while (count > 0)
+  {
+    if (count == 1)
+    {
+      cn_slow_hash_aesni(contexts[0], data[0], length, hashes[0]);
+      return;
+    }
+
+    ways = count >= 4 ? 4 : 2;
+    for (w = 0; w < ways; w++)
+    {
+      ctx[w] = (struct cn_ctx *) contexts[w];
+      cn_explode_scratchpad_aesni(ctx[w], data[w], length);
+    }
+
+    if (ways == 4)
+    {
+      cn_main_loop_aesni_4(ctx);
+    }
+    else
+    {
+      cn_main_loop_aesni_2(ctx);
+    }
+
+    for (w = 0; w < ways; w++)
+    {
+      cn_implode_scratchpad_aesni(ctx[w], hashes[w]);
+    }
+
+    contexts += ways;
+    data += ways;
+    hashes += ways;
+    count -= ways;
+  }
+}
+
+static void cn_slow_hash_multi_noaesni(void *const *contexts, const void *const *data, size_t length, void *const *hashes, size_t count)
+{
+  size_t i;
+
+  for (i = 0; i < count; i++)
+  {
+    cn_slow_hash_noaesni(contexts[i], data[i], length, hashes[i]);
+  }
+}
 
 INITIALIZER(detect_aes) {
   int ecx;
@@ -190,4 +411,5 @@ INITIALIZER(detect_aes) {
   __cpuid(1, a, b, ecx, d);
 #endif
   cn_slow_hash_fp = (ecx & (1 << 25)) ? &cn_slow_hash_aesni : &cn_slow_hash_noaesni;
+  cn_slow_hash_multi_fp = (ecx & (1 << 25)) ? &cn_slow_hash_multi_aesni : &cn_slow_hash_multi_noaesni;
 }
@@ -15,6 +15,7 @@
 // You should have received a copy of the GNU Lesser General Public License
 // along with Bytecoin.  If not, see <http://www.gnu.org/licenses/>.
 
+#include <atomic>
 #include <new>
 
 #include "hash.h"
@@ -25,6 +26,8 @@
 #endif
 #include <Windows.h>
 #else
+#include <fstream>
+#include <string>
 #include <sys/mman.h>
 #endif
 
@@ -33,40 +36,186 @@ using std::bad_alloc;
 namespace Crypto {
 
   enum {
-    MAP_SIZE = SLOW_HASH_CONTEXT_SIZE + ((-SLOW_HASH_CONTEXT_SIZE) & 0xfff)
+    MAP_SIZE = SLOW_HASH_SCRATCHPAD_SIZE,
+    HUGE_PAGE_SIZE = 2 * 1024 * 1024
   };
 
+  namespace {
+
+    std::atomic<size_t> backing_counts[3];
+
+    inline size_t round_up(size_t size, size_t alignment) {
+      return (size + alignment - 1) / alignment * alignment;
+    }
+
+#if defined(MADV_HUGEPAGE)
+    // madvise only gets huge pages when "always" or "madvise" is selected, e.g. "always [madvise] never"
+    bool transparent_huge_pages_enabled() {
+      std::ifstream file("/sys/kernel/mm/transparent_hugepage/enabled");
+      std::string setting;
+      std::getline(file, setting);
+      return setting.find("[always]") != std::string::npos || setting.find("[madvise]") != std::string::npos;
+    }
+#endif
+
+  }
+
+  cn_context_stats get_cn_context_stats() {
+    cn_context_stats stats;
+    stats.huge_pages = backing_counts[static_cast<int>(cn_page_backing::huge_pages)];
+    stats.transparent_huge_pages = backing_counts[static_cast<int>(cn_page_backing::transparent_huge_pages)];
+    stats.normal_pages = backing_counts[static_cast<int>(cn_page_backing::normal_pages)];
+    return stats;
+  }
+
+  std::vector<std::unique_ptr<cn_context>> make_cn_contexts(size_t max_count) {
+    std::vector<std::unique_ptr<cn_context>> contexts;
+    contexts.reserve(max_count);
+    for (size_t i = 0; i < max_count; ++i) {
+      try {
+        contexts.emplace_back(new cn_context());
+      } catch (bad_alloc&) {
+        if (contexts.empty()) {
+          throw;
+        }
+
+        break;
+      }
+    }
+
+    return contexts;
+  }
+
+  cn_context::cn_context(cn_page_backing preferred_backing) : mapping(nullptr), mapping_size(0) {
+    data = reinterpret_cast<void *>(round_up(reinterpret_cast<size_t>(state_buffer), 16));
+    if (preferred_backing == cn_page_backing::huge_pages && map_huge_pages()) {
+      page_backing = cn_page_backing::huge_pages;
+    } else if (preferred_backing != cn_page_backing::normal_pages && map_transparent_huge_pages()) {
+      page_backing = cn_page_backing::transparent_huge_pages;
+    } else {
+      map_normal_pages();
+      page_backing = cn_page_backing::normal_pages;
+    }
+
+    cn_slow_hash_set_scratchpad(data, mapping);
+    ++backing_counts[static_cast<int>(page_backing)];
+  }
+
 #if defined(WIN32)
 
-  cn_context::cn_context() {
-    data = VirtualAlloc(nullptr, MAP_SIZE, MEM_COMMIT, PAGE_READWRITE);
-    if (data == nullptr) {
+  bool cn_context::map_huge_pages() {
+    // large pages need SeLockMemoryPrivilege, without it the allocation fails
+    size_t large_page_size = GetLargePageMinimum();
+    if (large_page_size == 0) {
+      return false;
+    }
+
+    size_t size = round_up(MAP_SIZE, large_page_size);
+    mapping = VirtualAlloc(nullptr, size, MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE);
+    if (mapping == nullptr) {
+      return false;
+    }
+
+    mapping_size = size;
+    return true;
+  }
+
+  bool cn_context::map_transparent_huge_pages() {
+    return false;
+  }
+
+  void cn_context::map_normal_pages() {
+    mapping = VirtualAlloc(nullptr, MAP_SIZE, MEM_COMMIT, PAGE_READWRITE);
+    if (mapping == nullptr) {
       throw bad_alloc();
     }
+
+    mapping_size = MAP_SIZE;
   }
 
   cn_context::~cn_context() {
-    if (!VirtualFree(data, 0, MEM_RELEASE)) {
+    --backing_counts[static_cast<int>(page_backing)];
+    if (!VirtualFree(mapping, 0, MEM_RELEASE)) {
       throw bad_alloc();
     }
   }
 
 #else
 
-  cn_context::cn_context() {
+  bool cn_context::map_huge_pages() {
+#if defined(MAP_HUGETLB)
+    // fails unless huge pages are reserved, see /proc/sys/vm/nr_hugepages;
+    // the scratchpad takes exactly one huge page
+    size_t size = round_up(MAP_SIZE, HUGE_PAGE_SIZE);
+    mapping = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB | MAP_POPULATE, -1, 0);
+    if (mapping == MAP_FAILED) {
+      mapping = nullptr;
+      return false;
+    }
+
+    mapping_size = size;
+    return true;
+#else
+    return false;
+#endif
+  }
+
+  bool cn_context::map_transparent_huge_pages() {
+#if defined(MADV_HUGEPAGE)
+    static const bool enabled = transparent_huge_pages_enabled();
+    if (!enabled) {
+      return false;
+    }
+
+    // reserve a huge page more than needed and keep only the huge page aligned scratchpad,
+    // so it can be backed by a single huge page
+    size_t size = MAP_SIZE + HUGE_PAGE_SIZE;
+    char *reserved = static_cast<char *>(mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0));
+    if (reserved == MAP_FAILED) {
+      return false;
+    }
+
+    char *aligned = reinterpret_cast<char *>(round_up(reinterpret_cast<size_t>(reserved), HUGE_PAGE_SIZE));
+    if (aligned != reserved) {
+      munmap(reserved, aligned - reserved);
+    }
+
+    if (aligned + MAP_SIZE != reserved + size) {
+      munmap(aligned + MAP_SIZE, reserved + size - (aligned + MAP_SIZE));
+    }
+
+    if (madvise(aligned, MAP_SIZE, MADV_HUGEPAGE) != 0) {
+      munmap(aligned, MAP_SIZE);
+      return false;
+    }
+
+    mapping = aligned;
+    mapping_size = MAP_SIZE;
+    // pages are populated after madvise, so the kernel can allocate huge ones
+    mlock(mapping, MAP_SIZE);
+    return true;
+#else
+    return false;
+#endif
+  }
+
+  void cn_context::map_normal_pages() {
 #if !defined(__APPLE__)
-    data = mmap(nullptr, MAP_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_POPULATE, -1, 0);
+    mapping = mmap(nullptr, MAP_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_POPULATE, -1, 0);
 #else
-    data = mmap(nullptr, MAP_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANON, -1, 0);
+    mapping = mmap(nullptr, MAP_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANON, -1, 0);
 #endif
-    if (data == MAP_FAILED) {
+    if (mapping == MAP_FAILED) {
       throw bad_alloc();
     }
-    mlock(data, MAP_SIZE);
+
+    mapping_size = MAP_SIZE;
+    mlock(mapping, MAP_SIZE);
   }
 
   cn_context::~cn_context() {
-    if (munmap(data, MAP_SIZE) != 0) {
+    --backing_counts[static_cast<int>(page_backing)];
+    if (munmap(mapping, mapping_size) != 0) {
       throw bad_alloc();
     }
   }
@@ -20,6 +20,7 @@
 #include <iomanip>
 #include <ios>
 #include <string>
+#include <vector>
 
 #include "crypto/hash.h"
 #include "../Io.h"
@@ -28,6 +29,7 @@ using namespace std;
 typedef Crypto::Hash chash;
 
 Crypto::cn_context *context;
+Crypto::cn_context *multi_contexts[Crypto::SLOW_HASH_MAX_WAYS + 1];
 
 extern "C" {
 #ifdef _MSC_VER
@@ -44,13 +46,42 @@ extern "C" {
   static void slow_hash(const void *data, size_t length, char *hash) {
     cn_slow_hash(*context, data, length, *reinterpret_cast<chash *>(hash));
   }
+
+  // Hashes the input alongside altered copies of it with every lane count up to one more than the kernel
+  // interleaves, so the remainder paths are covered too. Every lane must match the single-way hash.
+  static void slow_hash_multi(const void *data, size_t length, char *hash) {
+    const size_t MAX_LANES = Crypto::SLOW_HASH_MAX_WAYS + 1;
+    vector<vector<char>> lanes(MAX_LANES, vector<char>(static_cast<const char *>(data), static_cast<const char *>(data) + length));
+    const void *inputs[MAX_LANES];
+    chash singles[MAX_LANES];
+    for (size_t i = 0; i < lanes.size(); ++i) {
+      for (char &c : lanes[i]) {
+        c ^= static_cast<char>(i);
+      }
+      inputs[i] = lanes[i].data();
+      cn_slow_hash(*context, inputs[i], length, singles[i]);
+    }
+
+    chash result = singles[0];
+    for (size_t count = 1; count <= MAX_LANES; ++count) {
+      chash outputs[MAX_LANES];
+      Crypto::cn_slow_hash_multi(multi_contexts, inputs, length, outputs, count);
+      for (size_t i = 0; i < count; ++i) {
+        if (outputs[i] != singles[i]) {
+          result = chash();
+        }
+      }
+    }
+
+    *reinterpret_cast<chash *>(hash) = result;
+  }
 }
 
 extern "C" typedef void hash_f(const void *, size_t, char *);
 struct hash_func {
   const string name;
   hash_f &f;
-} hashes[] = {{"fast", Crypto::cn_fast_hash}, {"slow", slow_hash}, {"tree", hash_tree},
+} hashes[] = {{"fast", Crypto::cn_fast_hash}, {"slow", slow_hash}, {"slow-multi", slow_hash_multi}, {"tree", hash_tree},
   {"extra-blake", Crypto::hash_extra_blake}, {"extra-groestl", Crypto::hash_extra_groestl},
   {"extra-jh", Crypto::hash_extra_jh}, {"extra-skein", Crypto::hash_extra_skein}};
 
@@ -76,9 +107,14 @@ int main(int argc, char *argv[]) {
       break;
     }
   }
-  if (f == slow_hash) {
+  if (f == slow_hash || f == slow_hash_multi) {
     context = new Crypto::cn_context();
   }
+  if (f == slow_hash_multi) {
+    for (auto &multi_context : multi_contexts) {
+      multi_context = new Crypto::cn_context();
+    }
+  }
   input.open(argv[2], ios_base::in);
   for (;;) {
     ++test;
@@ -0,0 +1,96 @@
+// Copyright (c) 2012-2017, The CryptoNote developers, The Bytecoin developers
+//
+// This file is part of Bytecoin.
+//
+// Bytecoin is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Bytecoin is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with Bytecoin.  If not, see <http://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <memory>
+#include <vector>
+
+#include "Common/ThreadPool.h"
+#include "CryptoNoteCore/Account.h"
+#include "CryptoNoteCore/CryptoNoteBasic.h"
+#include "CryptoNoteCore/CryptoNoteFormatUtils.h"
+#include "CryptoNoteCore/CryptoNoteTools.h"
+#include "CryptoNoteCore/RingSignatureBatch.h"
+#include "crypto/crypto.h"
+
+#include "MultiTransactionTestBase.h"
+#include "PerformanceUtils.h"
+
+/**
+ * Verifies ring signatures of a block with a_input_count inputs, as Core::addBlock does.
+ * a_threads_count == 1 checks signatures on the calling thread, otherwise a thread pool of this size is used.
+ */
+template<size_t a_threads_count, size_t a_input_count = 64, size_t a_ring_size = 10>
+class test_check_ring_signature_batch : private multi_tx_test_base<a_ring_size>
+{
+  static_assert(0 < a_threads_count, "threads_count must be greater than 0");
+  static_assert(0 < a_input_count, "input_count must be greater than 0");
+
+public:
+  static const size_t loop_count = 10;
+  static const size_t ring_size = a_ring_size;
+
+  typedef multi_tx_test_base<a_ring_size> base_class;
+
+  bool init()
+  {
+    using namespace CryptoNote;
+
+    if (!base_class::init())
+      return false;
+
+    m_alice.generate();
+
+    std::vector<TransactionDestinationEntry> destinations;
+    destinations.push_back(TransactionDestinationEntry(this->m_source_amount, m_alice.getAccountKeys().address));
+
+    if (!constructTransaction(this->m_miners[this->real_source_idx].getAccountKeys(), this->m_sources, destinations, std::vector<uint8_t>(), m_tx, 0, this->m_logger))
+      return false;
+
+    getObjectHash(*static_cast<TransactionPrefix*>(&m_tx), m_tx_prefix_hash);
+
+    if (a_threads_count > 1)
+    {
+      unrestricted_thread_affinity affinity;
+      m_thread_pool.reset(new Common::ThreadPool(a_threads_count));
+    }
+
+    return true;
+  }
+
+  bool test()
+  {
+    const CryptoNote::KeyInput& txin = boost::get<CryptoNote::KeyInput>(m_tx.inputs[0]);
+
+    CryptoNote::RingSignatureBatch batch;
+    for (size_t i = 0; i < a_input_count; ++i)
+    {
+      std::vector<Crypto::PublicKey> output_keys(this->m_public_keys, this->m_public_keys + ring_size);
+      batch.addCheck(i, m_tx_prefix_hash, txin.keyImage, std::move(output_keys), m_tx.signatures[0].data(), true);
+    }
+
+    size_t failed = m_thread_pool ? batch.verify(*m_thread_pool) : batch.verify();
+    return failed == CryptoNote::RingSignatureBatch::NO_FAILURE;
+  }
+
+private:
+  CryptoNote::AccountBase m_alice;
+  CryptoNote::Transaction m_tx;
+  Crypto::Hash m_tx_prefix_hash;
+  std::unique_ptr<Common::ThreadPool> m_thread_pool;
+};
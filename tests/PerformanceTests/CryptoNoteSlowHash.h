@@ -17,6 +17,10 @@
 
 #pragma once
 
+#include <iostream>
+#include <memory>
+#include <vector>
+
 #include "Common/StringTools.h"
 #include "crypto/crypto.h"
 #include "CryptoNoteCore/CryptoNoteBasic.h"
@@ -33,6 +37,9 @@ public:
 
   static_assert(13 == sizeof(data_t), "Invalid structure size");
 
+  explicit test_cn_slow_hash(Crypto::cn_page_backing backing = Crypto::cn_page_backing::huge_pages) : m_context(backing) {
+  }
+
   bool init() {
     size_t size;
     if (!Common::fromHex("63617665617420656d70746f72", &m_data, sizeof(m_data), size) || size != sizeof(m_data)) {
@@ -52,8 +59,65 @@ public:
     return hash == m_expected_hash;
   }
 
-private:
+protected:
+  Crypto::cn_context m_context;
   data_t m_data;
   Crypto::Hash m_expected_hash;
-  Crypto::cn_context m_context;
+};
+
+// Fails if the requested scratchpad backing isn't available on this system
+template<Crypto::cn_page_backing backing>
+class test_cn_slow_hash_backing : public test_cn_slow_hash {
+public:
+  test_cn_slow_hash_backing() : test_cn_slow_hash(backing) {
+  }
+
+  bool init() {
+    if (m_context.backing() != backing) {
+      std::cout << "Scratchpad backing is not available" << std::endl;
+      return false;
+    }
+
+    return test_cn_slow_hash::init();
+  }
+};
+
+// Each call hashes the same input in all lanes, so the time is per ways hashes
+template<size_t ways>
+class test_cn_slow_hash_multi : public test_cn_slow_hash {
+public:
+  bool init() {
+    m_contexts = Crypto::make_cn_contexts(ways);
+    if (m_contexts.size() != ways) {
+      std::cout << "Not enough memory for " << ways << " contexts" << std::endl;
+      return false;
+    }
+
+    for (size_t i = 0; i < ways; ++i) {
+      m_lane_contexts[i] = m_contexts[i].get();
+    }
+
+    return test_cn_slow_hash::init();
+  }
+
+  bool test() {
+    const void* inputs[ways];
+    Crypto::Hash hashes[ways];
+    for (size_t i = 0; i < ways; ++i) {
+      inputs[i] = &m_data;
+    }
+
+    Crypto::cn_slow_hash_multi(m_lane_contexts, inputs, sizeof(m_data), hashes, ways);
+    for (size_t i = 0; i < ways; ++i) {
+      if (hashes[i] != m_expected_hash) {
+        return false;
+      }
+    }
+
+    return true;
+  }
+
+private:
+  std::vector<std::unique_ptr<Crypto::cn_context>> m_contexts;
+  Crypto::cn_context* m_lane_contexts[ways];
 };
@@ -50,6 +50,41 @@ void set_process_affinity(int core)
 #endif
 }
 
+/**
+ * Threads started while the object is alive may run on every core, the calling thread keeps its affinity afterwards.
+ */
+class unrestricted_thread_affinity
+{
+public:
+  unrestricted_thread_affinity()
+  {
+#if defined(BOOST_HAS_PTHREADS) && !defined(__APPLE__)
+    ::pthread_getaffinity_np(::pthread_self(), sizeof(m_saved), &m_saved);
+
+    cpu_set_t cpuset;
+    CPU_ZERO(&cpuset);
+    for (int i = 0; i < CPU_SETSIZE; ++i)
+    {
+      CPU_SET(i, &cpuset);
+    }
+
+    ::pthread_setaffinity_np(::pthread_self(), sizeof(cpuset), &cpuset);
+#endif
+  }
+
+  ~unrestricted_thread_affinity()
+  {
+#if defined(BOOST_HAS_PTHREADS) && !defined(__APPLE__)
+    ::pthread_setaffinity_np(::pthread_self(), sizeof(m_saved), &m_saved);
+#endif
+  }
+
+private:
+#if defined(BOOST_HAS_PTHREADS) && !defined(__APPLE__)
+  cpu_set_t m_saved;
+#endif
+};
+
 void set_thread_high_priority()
 {
 #if defined(__APPLE__)
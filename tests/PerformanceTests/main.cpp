@@ -21,6 +21,7 @@
 // tests
 #include "ConstructTransaction.h"
 #include "CheckRingSignature.h"
+#include "CheckRingSignatureBatch.h"
 #include "CryptoNoteSlowHash.h"
 #include "DerivePublicKey.h"
 #include "DeriveSecretKey.h"
@@ -63,6 +64,11 @@ int main(int argc, char** argv)
   TEST_PERFORMANCE1(test_check_ring_signature, 10);
   TEST_PERFORMANCE1(test_check_ring_signature, 100);
 
+  TEST_PERFORMANCE1(test_check_ring_signature_batch, 1);
+  TEST_PERFORMANCE1(test_check_ring_signature_batch, 2);
+  TEST_PERFORMANCE1(test_check_ring_signature_batch, 4);
+  TEST_PERFORMANCE1(test_check_ring_signature_batch, 8);
+
   TEST_PERFORMANCE0(test_is_out_to_acc);
   TEST_PERFORMANCE0(test_generate_key_image_helper);
   TEST_PERFORMANCE0(test_generate_key_derivation);
@@ -71,6 +77,12 @@ int main(int argc, char** argv)
   TEST_PERFORMANCE0(test_derive_secret_key);
 
   TEST_PERFORMANCE0(test_cn_slow_hash);
+  TEST_PERFORMANCE1(test_cn_slow_hash_backing, Crypto::cn_page_backing::huge_pages);
+  TEST_PERFORMANCE1(test_cn_slow_hash_backing, Crypto::cn_page_backing::transparent_huge_pages);
+  TEST_PERFORMANCE1(test_cn_slow_hash_backing, Crypto::cn_page_backing::normal_pages);
+  TEST_PERFORMANCE1(test_cn_slow_hash_multi, 1);
+  TEST_PERFORMANCE1(test_cn_slow_hash_multi, 2);
+  TEST_PERFORMANCE1(test_cn_slow_hash_multi, 4);
 
   std::cout << "Tests finished. Elapsed time: " << timer.elapsed_ms() / 1000 << " sec" << std::endl;
 
@@ -0,0 +1,331 @@
+// Copyright (c) 2012-2017, The CryptoNote developers, The Bytecoin developers
+//
+// This file is part of Bytecoin.
+//
+// Bytecoin is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Bytecoin is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with Bytecoin.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <gtest/gtest.h>
+
+#include <vector>
+
+#include "CryptoNoteConfig.h"
+#include "CryptoNoteProtocol/BlockDownloadScheduler.h"
+#include "crypto/crypto.h"
+#include "crypto/hash.h"
+
+using namespace CryptoNote;
+
+namespace {
+
+using Clock = BlockDownloadScheduler::Clock;
+
+const uint32_t START_INDEX = 100;
+const size_t BLOCK_SIZE = 1000;
+
+BlockDownloadScheduler::PeerId makePeer(uint8_t id) {
+  BlockDownloadScheduler::PeerId peer = {};
+  peer.data[0] = id;
+  return peer;
+}
+
+std::vector<Crypto::Hash> makeChain(size_t count) {
+  std::vector<Crypto::Hash> hashes;
+  for (size_t i = 0; i < count; ++i) {
+    hashes.push_back(Crypto::rand<Crypto::Hash>());
+  }
+
+  return hashes;
+}
+
+std::vector<RawBlock> makeBlocks(size_t count) {
+  return std::vector<RawBlock>(count, RawBlock{BinaryArray(BLOCK_SIZE), {}});
+}
+
+bool receive(BlockDownloadScheduler& scheduler, const BlockDownloadScheduler::PeerId& peer,
+  const std::vector<Crypto::Hash>& hashes, Clock::time_point now) {
+  return scheduler.receiveSpan(peer, hashes, makeBlocks(hashes.size()), std::vector<BlockTemplate>(hashes.size()), now);
+}
+
+}
+
+TEST(BlockDownloadScheduler, spansOfPeersDontOverlap) {
+  BlockDownloadScheduler scheduler;
+  auto chain = makeChain(100);
+  auto now = Clock::now();
+
+  ASSERT_TRUE(scheduler.addChain(makePeer(1), START_INDEX, std::vector<Crypto::Hash>(chain)));
+  ASSERT_TRUE(scheduler.addChain(makePeer(2), START_INDEX, std::vector<Crypto::Hash>(chain)));
+
+  auto first = scheduler.requestSpan(makePeer(1), now);
+  auto second = scheduler.requestSpan(makePeer(2), now);
+  ASSERT_FALSE(first.empty());
+  ASSERT_FALSE(second.empty());
+  ASSERT_EQ(chain.front(), first.front());
+  ASSERT_EQ(chain[first.size()], second.front());
+}
+
+TEST(BlockDownloadScheduler, peerHasOneRequestInFlight) {
+  BlockDownloadScheduler scheduler;
+  auto now = Clock::now();
+
+  ASSERT_TRUE(scheduler.addChain(makePeer(1), START_INDEX, makeChain(100)));
+  auto span = scheduler.requestSpan(makePeer(1), now);
+  ASSERT_FALSE(span.empty());
+  ASSERT_TRUE(scheduler.isRequesting(makePeer(1)));
+  ASSERT_TRUE(scheduler.requestSpan(makePeer(1), now).empty());
+
+  ASSERT_TRUE(receive(scheduler, makePeer(1), span, now + std::chrono::milliseconds(100)));
+  ASSERT_FALSE(scheduler.isRequesting(makePeer(1)));
+  ASSERT_FALSE(scheduler.requestSpan(makePeer(1), now).empty());
+}
+
+TEST(BlockDownloadScheduler, spansAreReadyInChainOrder) {
+  BlockDownloadScheduler scheduler;
+  auto chain = makeChain(100);
+  auto now = Clock::now();
+
+  ASSERT_TRUE(scheduler.addChain(makePeer(1), START_INDEX, std::vector<Crypto::Hash>(chain)));
+  ASSERT_TRUE(scheduler.addChain(makePeer(2), START_INDEX, std::vector<Crypto::Hash>(chain)));
+  auto first = scheduler.requestSpan(makePeer(1), now);
+  auto second = scheduler.requestSpan(makePeer(2), now);
+
+  ASSERT_TRUE(receive(scheduler, makePeer(2), second, now));
+  ASSERT_FALSE(scheduler.hasReadySpan());
+
+  ASSERT_TRUE(receive(scheduler, makePeer(1), first, now));
+  ASSERT_TRUE(scheduler.hasReadySpan());
+  auto span = scheduler.popReadySpan();
+  ASSERT_EQ(START_INDEX, span.startIndex);
+  ASSERT_EQ(first, span.hashes);
+  ASSERT_EQ(makePeer(1), span.sender);
+
+  ASSERT_TRUE(scheduler.hasReadySpan());
+  span = scheduler.popReadySpan();
+  ASSERT_EQ(START_INDEX + first.size(), span.startIndex);
+  ASSERT_EQ(second, span.hashes);
+  ASSERT_EQ(makePeer(2), span.sender);
+  ASSERT_FALSE(scheduler.hasReadySpan());
+  ASSERT_EQ(START_INDEX + first.size() + second.size(), scheduler.getStartIndex());
+}
+
+TEST(BlockDownloadScheduler, timedOutSpanIsRequestedFromAnotherPeer) {
+  BlockDownloadScheduler scheduler;
+  auto chain = makeChain(100);
+  auto now = Clock::now();
+
+  ASSERT_TRUE(scheduler.addChain(makePeer(1), START_INDEX, std::vector<Crypto::Hash>(chain)));
+  ASSERT_TRUE(scheduler.addChain(makePeer(2), START_INDEX, std::vector<Crypto::Hash>(chain)));
+  auto first = scheduler.requestSpan(makePeer(1), now);
+  auto second = scheduler.requestSpan(makePeer(2), now);
+  ASSERT_TRUE(receive(scheduler, makePeer(2), second, now + std::chrono::seconds(1)));
+  ASSERT_NE(first, scheduler.requestSpan(makePeer(2), now + std::chrono::seconds(1)));
+
+  auto late = now + std::chrono::milliseconds(BLOCKS_SYNCHRONIZING_INITIAL_TIMEOUT + 1);
+  ASSERT_TRUE(scheduler.addChain(makePeer(3), START_INDEX, std::vector<Crypto::Hash>(chain)));
+  ASSERT_EQ(first, scheduler.requestSpan(makePeer(3), late));
+
+  // the first response wins, the late one is dropped
+  ASSERT_TRUE(receive(scheduler, makePeer(3), first, late));
+  ASSERT_FALSE(receive(scheduler, makePeer(1), first, late));
+  ASSERT_FALSE(scheduler.isRequesting(makePeer(1)));
+  ASSERT_TRUE(scheduler.hasReadySpan());
+  ASSERT_EQ(makePeer(3), scheduler.popReadySpan().sender);
+}
+
+TEST(BlockDownloadScheduler, timedOutSpanIsReleasedToOtherPeers) {
+  BlockDownloadScheduler scheduler;
+  auto chain = makeChain(100);
+  auto now = Clock::now();
+
+  ASSERT_TRUE(scheduler.addChain(makePeer(1), START_INDEX, std::vector<Crypto::Hash>(chain)));
+  ASSERT_TRUE(scheduler.addChain(makePeer(2), START_INDEX, std::vector<Crypto::Hash>(chain)));
+  auto first = scheduler.requestSpan(makePeer(1), now);
+  ASSERT_TRUE(scheduler.releaseTimedOutSpans(now + std::chrono::seconds(1)).empty());
+
+  auto late = now + std::chrono::milliseconds(BLOCKS_SYNCHRONIZING_INITIAL_TIMEOUT + 1);
+  ASSERT_EQ(std::vector<BlockDownloadScheduler::PeerId>({makePeer(1)}), scheduler.releaseTimedOutSpans(late));
+  ASSERT_TRUE(scheduler.releaseTimedOutSpans(late).empty());
+  ASSERT_TRUE(scheduler.isRequesting(makePeer(1)));
+
+  ASSERT_EQ(first, scheduler.requestSpan(makePeer(2), late));
+
+  // the late answer is still taken when it comes first
+  ASSERT_TRUE(receive(scheduler, makePeer(1), first, late));
+  ASSERT_FALSE(scheduler.isRequesting(makePeer(1)));
+  ASSERT_FALSE(receive(scheduler, makePeer(2), first, late));
+  ASSERT_EQ(makePeer(1), scheduler.popReadySpan().sender);
+}
+
+TEST(BlockDownloadScheduler, requeuedSpanIsDownloadedAgainAndOtherSpansAreKept) {
+  BlockDownloadScheduler scheduler;
+  auto chain = makeChain(100);
+  auto now = Clock::now();
+
+  ASSERT_TRUE(scheduler.addChain(makePeer(1), START_INDEX, std::vector<Crypto::Hash>(chain)));
+  ASSERT_TRUE(scheduler.addChain(makePeer(2), START_INDEX, std::vector<Crypto::Hash>(chain)));
+  auto first = scheduler.requestSpan(makePeer(1), now);
+  auto second = scheduler.requestSpan(makePeer(2), now);
+  ASSERT_TRUE(receive(scheduler, makePeer(1), first, now));
+  ASSERT_TRUE(receive(scheduler, makePeer(2), second, now));
+
+  auto span = scheduler.popReadySpan();
+  scheduler.removePeer(span.sender);
+  scheduler.requeueSpan(std::move(span));
+  ASSERT_EQ(START_INDEX, scheduler.getStartIndex());
+  ASSERT_FALSE(scheduler.hasReadySpan());
+
+  ASSERT_EQ(first, scheduler.requestSpan(makePeer(2), now));
+  ASSERT_TRUE(receive(scheduler, makePeer(2), first, now));
+  ASSERT_EQ(first, scheduler.popReadySpan().hashes);
+  ASSERT_TRUE(scheduler.hasReadySpan());
+  ASSERT_EQ(second, scheduler.popReadySpan().hashes);
+}
+
+TEST(BlockDownloadScheduler, chainAddedWhileLastSpanIsAddedExtendsQueue) {
+  BlockDownloadScheduler scheduler;
+  auto chain = makeChain(20);
+  auto now = Clock::now();
+
+  ASSERT_TRUE(scheduler.addChain(makePeer(1), START_INDEX, std::vector<Crypto::Hash>(chain.begin(), chain.begin() + 10)));
+  auto first = scheduler.requestSpan(makePeer(1), now);
+  ASSERT_EQ(10, first.size());
+  ASSERT_TRUE(receive(scheduler, makePeer(1), first, now));
+
+  auto span = scheduler.popReadySpan();
+  ASSERT_FALSE(scheduler.empty());
+
+  // another peer's chain entry is handled while the blocks of the span are added
+  ASSERT_TRUE(scheduler.addChain(makePeer(2), START_INDEX, std::vector<Crypto::Hash>(chain)));
+  ASSERT_EQ(START_INDEX + 10, scheduler.getStartIndex());
+  ASSERT_EQ(START_INDEX + 20, scheduler.getEndIndex());
+
+  scheduler.removePeer(span.sender);
+  scheduler.requeueSpan(std::move(span));
+  ASSERT_EQ(START_INDEX, scheduler.getStartIndex());
+  ASSERT_EQ(START_INDEX + 20, scheduler.getEndIndex());
+
+  ASSERT_EQ(first, scheduler.requestSpan(makePeer(2), now));
+  ASSERT_TRUE(receive(scheduler, makePeer(2), first, now));
+  ASSERT_EQ(std::vector<Crypto::Hash>(chain.begin() + 10, chain.end()), scheduler.requestSpan(makePeer(2), now));
+}
+
+TEST(BlockDownloadScheduler, completedSpanLetsChainReplaceEmptyQueue) {
+  BlockDownloadScheduler scheduler;
+  auto now = Clock::now();
+
+  ASSERT_TRUE(scheduler.addChain(makePeer(1), START_INDEX, makeChain(10)));
+  auto first = scheduler.requestSpan(makePeer(1), now);
+  ASSERT_TRUE(receive(scheduler, makePeer(1), first, now));
+  scheduler.popReadySpan();
+  scheduler.completeSpan();
+  ASSERT_TRUE(scheduler.empty());
+
+  auto chain = makeChain(10);
+  ASSERT_TRUE(scheduler.addChain(makePeer(2), START_INDEX + 50, std::vector<Crypto::Hash>(chain)));
+  ASSERT_EQ(START_INDEX + 50, scheduler.getStartIndex());
+  ASSERT_FALSE(scheduler.knowsChain(makePeer(1)));
+  ASSERT_EQ(chain, scheduler.requestSpan(makePeer(2), now));
+}
+
+TEST(BlockDownloadScheduler, spanRequeuedAfterResetIsDropped) {
+  BlockDownloadScheduler scheduler;
+  auto now = Clock::now();
+
+  ASSERT_TRUE(scheduler.addChain(makePeer(1), START_INDEX, makeChain(10)));
+  auto first = scheduler.requestSpan(makePeer(1), now);
+  ASSERT_TRUE(receive(scheduler, makePeer(1), first, now));
+  auto span = scheduler.popReadySpan();
+
+  // the queue is reset and replaced while the blocks of the span are added
+  scheduler.reset();
+  auto chain = makeChain(10);
+  ASSERT_TRUE(scheduler.addChain(makePeer(2), START_INDEX, std::vector<Crypto::Hash>(chain)));
+
+  scheduler.requeueSpan(std::move(span));
+  ASSERT_EQ(START_INDEX, scheduler.getStartIndex());
+  ASSERT_EQ(START_INDEX + 10, scheduler.getEndIndex());
+  ASSERT_EQ(chain, scheduler.requestSpan(makePeer(2), now));
+}
+
+TEST(BlockDownloadScheduler, spanOfRemovedPeerIsRequestedAgain) {
+  BlockDownloadScheduler scheduler;
+  auto chain = makeChain(100);
+  auto now = Clock::now();
+
+  ASSERT_TRUE(scheduler.addChain(makePeer(1), START_INDEX, std::vector<Crypto::Hash>(chain)));
+  ASSERT_TRUE(scheduler.addChain(makePeer(2), START_INDEX, std::vector<Crypto::Hash>(chain)));
+  auto first = scheduler.requestSpan(makePeer(1), now);
+
+  scheduler.removePeer(makePeer(1));
+  ASSERT_EQ(first, scheduler.requestSpan(makePeer(2), now));
+}
+
+TEST(BlockDownloadScheduler, contradictingChainIsRejected) {
+  BlockDownloadScheduler scheduler;
+  auto chain = makeChain(100);
+
+  ASSERT_TRUE(scheduler.addChain(makePeer(1), START_INDEX, std::vector<Crypto::Hash>(chain)));
+  ASSERT_FALSE(scheduler.addChain(makePeer(2), START_INDEX, makeChain(100)));
+  ASSERT_FALSE(scheduler.knowsChain(makePeer(2)));
+  ASSERT_TRUE(scheduler.requestSpan(makePeer(2), Clock::now()).empty());
+}
+
+TEST(BlockDownloadScheduler, overlappingChainExtendsQueue) {
+  BlockDownloadScheduler scheduler;
+  auto chain = makeChain(200);
+
+  ASSERT_TRUE(scheduler.addChain(makePeer(1), START_INDEX, std::vector<Crypto::Hash>(chain.begin(), chain.begin() + 100)));
+  ASSERT_TRUE(scheduler.addChain(makePeer(2), START_INDEX + 50, std::vector<Crypto::Hash>(chain.begin() + 50, chain.end())));
+  ASSERT_EQ(START_INDEX + 200, scheduler.getEndIndex());
+  ASSERT_EQ(START_INDEX + 100, scheduler.getPeerChainEnd(makePeer(1)));
+  ASSERT_EQ(START_INDEX + 200, scheduler.getPeerChainEnd(makePeer(2)));
+  ASSERT_EQ(chain.back(), scheduler.getPeerChainTop(makePeer(2)));
+}
+
+TEST(BlockDownloadScheduler, peerIsOnlyAskedForBlocksItKnows) {
+  BlockDownloadScheduler scheduler;
+  auto chain = makeChain(10);
+  auto now = Clock::now();
+
+  ASSERT_TRUE(scheduler.addChain(makePeer(1), START_INDEX, std::vector<Crypto::Hash>(chain.begin(), chain.begin() + 5)));
+  ASSERT_TRUE(scheduler.addChain(makePeer(2), START_INDEX, std::vector<Crypto::Hash>(chain)));
+
+  auto span = scheduler.requestSpan(makePeer(1), now);
+  ASSERT_EQ(std::vector<Crypto::Hash>(chain.begin(), chain.begin() + 5), span);
+  ASSERT_EQ(std::vector<Crypto::Hash>(chain.begin() + 5, chain.end()), scheduler.requestSpan(makePeer(2), now));
+}
+
+TEST(BlockDownloadScheduler, spanSizeFollowsPeerThroughput) {
+  BlockDownloadScheduler scheduler;
+  auto chain = makeChain(1000);
+  auto now = Clock::now();
+
+  ASSERT_TRUE(scheduler.addChain(makePeer(1), START_INDEX, std::vector<Crypto::Hash>(chain)));
+  ASSERT_TRUE(scheduler.addChain(makePeer(2), START_INDEX, std::vector<Crypto::Hash>(chain)));
+  ASSERT_EQ(BLOCKS_SYNCHRONIZING_INITIAL_COUNT, scheduler.getSpanSize(makePeer(1)));
+
+  auto fastSpan = scheduler.requestSpan(makePeer(1), now);
+  auto slowSpan = scheduler.requestSpan(makePeer(2), now);
+  ASSERT_TRUE(receive(scheduler, makePeer(1), fastSpan, now + std::chrono::milliseconds(100)));
+  ASSERT_TRUE(receive(scheduler, makePeer(2), slowSpan, now + std::chrono::seconds(10)));
+
+  auto statistics = scheduler.getPeerStatistics(makePeer(1));
+  ASSERT_EQ(fastSpan.size() * BLOCK_SIZE * 10, statistics.bytesPerSecond);
+  ASSERT_EQ(fastSpan.size() * BLOCK_SIZE, statistics.receivedBytes);
+  ASSERT_TRUE(statistics.roundTrip == std::chrono::milliseconds(100));
+
+  ASSERT_EQ(BLOCKS_SYNCHRONIZING_DEFAULT_COUNT, scheduler.getSpanSize(makePeer(1)));
+  ASSERT_LT(scheduler.getSpanSize(makePeer(2)), scheduler.getSpanSize(makePeer(1)));
+  ASSERT_EQ(BLOCKS_SYNCHRONIZING_DEFAULT_COUNT, scheduler.requestSpan(makePeer(1), now).size());
+}
@@ -0,0 +1,177 @@
+// Copyright (c) 2012-2017, The CryptoNote developers, The Bytecoin developers
+//
+// This file is part of Bytecoin.
+//
+// Bytecoin is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Bytecoin is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with Bytecoin.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <gtest/gtest.h>
+
+#include "CryptoNoteCore/BufferedDataBase.h"
+#include "DataBaseMock.h"
+
+using namespace CryptoNote;
+
+namespace {
+
+class RawWriteBatch: public IWriteBatch {
+public:
+  RawWriteBatch(std::vector<std::pair<std::string, std::string>>&& rawData, std::vector<std::string>&& rawKeys = {})
+    : rawData(std::move(rawData)), rawKeys(std::move(rawKeys)) {
+  }
+
+  virtual std::vector<std::pair<std::string, std::string>> extractRawDataToInsert() override {
+    return std::move(rawData);
+  }
+
+  virtual std::vector<std::string> extractRawKeysToRemove() override {
+    return std::move(rawKeys);
+  }
+
+private:
+  std::vector<std::pair<std::string, std::string>> rawData;
+  std::vector<std::string> rawKeys;
+};
+
+class RawReadBatch: public IReadBatch {
+public:
+  explicit RawReadBatch(std::vector<std::string>&& rawKeys) : rawKeys(std::move(rawKeys)) {
+  }
+
+  virtual std::vector<std::string> getRawKeys() const override {
+    return rawKeys;
+  }
+
+  virtual void submitRawResult(const std::vector<std::string>& values, const std::vector<bool>& resultStates) override {
+    this->values = values;
+    this->resultStates = resultStates;
+  }
+
+  std::vector<std::string> rawKeys;
+  std::vector<std::string> values;
+  std::vector<bool> resultStates;
+};
+
+class BufferedDataBaseTests: public ::testing::Test {
+public:
+  BufferedDataBaseTests() : bufferedDatabase(database) {
+  }
+
+  void write(IDataBase& target, std::vector<std::pair<std::string, std::string>>&& rawData, std::vector<std::string>&& rawKeys = {}) {
+    RawWriteBatch batch(std::move(rawData), std::move(rawKeys));
+    ASSERT_FALSE(target.write(batch));
+  }
+
+  RawReadBatch read(IDataBase& target, std::vector<std::string>&& rawKeys) {
+    RawReadBatch batch(std::move(rawKeys));
+    EXPECT_FALSE(target.read(batch));
+    return batch;
+  }
+
+  DataBaseMock database;
+  BufferedDataBase bufferedDatabase;
+};
+
+}
+
+TEST_F(BufferedDataBaseTests, writesThroughWithoutBuffering) {
+  write(bufferedDatabase, {{"a", "1"}});
+
+  ASSERT_FALSE(bufferedDatabase.isBuffering());
+  ASSERT_EQ(1, database.baseState.count("a"));
+}
+
+TEST_F(BufferedDataBaseTests, keepsWritesUntilFlush) {
+  write(database, {{"a", "1"}, {"b", "2"}});
+
+  bufferedDatabase.startBuffering();
+  write(bufferedDatabase, {{"c", "3"}, {"a", "4"}}, {"b"});
+  ASSERT_EQ("1", database.baseState.at("a"));
+  ASSERT_EQ(0, database.baseState.count("c"));
+  ASSERT_LT(0, bufferedDatabase.getBufferedSize());
+
+  ASSERT_FALSE(bufferedDatabase.flush());
+  ASSERT_FALSE(bufferedDatabase.isBuffering());
+  ASSERT_EQ(0, bufferedDatabase.getBufferedSize());
+  ASSERT_EQ("4", database.baseState.at("a"));
+  ASSERT_EQ(0, database.baseState.count("b"));
+  ASSERT_EQ("3", database.baseState.at("c"));
+}
+
+TEST_F(BufferedDataBaseTests, readsSeeBufferedWrites) {
+  write(database, {{"a", "1"}, {"b", "2"}});
+
+  bufferedDatabase.startBuffering();
+  write(bufferedDatabase, {{"c", "3"}, {"a", "4"}}, {"b"});
+
+  auto batch = read(bufferedDatabase, {"a", "b", "c", "d"});
+  ASSERT_EQ(std::vector<bool>({true, false, true, false}), batch.resultStates);
+  ASSERT_EQ("4", batch.values[0]);
+  ASSERT_EQ("3", batch.values[2]);
+
+  write(bufferedDatabase, {{"b", "5"}});
+  batch = read(bufferedDatabase, {"b"});
+  ASSERT_TRUE(batch.resultStates[0]);
+  ASSERT_EQ("5", batch.values[0]);
+}
+
+TEST_F(BufferedDataBaseTests, writeSyncWritesBufferedRecords) {
+  bufferedDatabase.startBuffering();
+  write(bufferedDatabase, {{"a", "1"}});
+
+  RawWriteBatch batch(std::vector<std::pair<std::string, std::string>>{{"b", "2"}});
+  ASSERT_FALSE(bufferedDatabase.writeSync(batch));
+  ASSERT_TRUE(bufferedDatabase.isBuffering());
+  ASSERT_EQ(1, database.baseState.count("a"));
+  ASSERT_EQ(1, database.baseState.count("b"));
+}
+
+TEST_F(BufferedDataBaseTests, snapshotIsntAffectedByLaterWrites) {
+  write(bufferedDatabase, {{"a", "1"}});
+
+  auto snapshot = bufferedDatabase.createSnapshot();
+  ASSERT_NE(nullptr, snapshot);
+  write(bufferedDatabase, {{"a", "2"}, {"b", "3"}});
+
+  auto batch = read(*snapshot, {"a", "b"});
+  ASSERT_EQ(std::vector<bool>({true, false}), batch.resultStates);
+  ASSERT_EQ("1", batch.values[0]);
+}
+
+TEST_F(BufferedDataBaseTests, hasNoSnapshotWhileBuffering) {
+  bufferedDatabase.startBuffering();
+  ASSERT_EQ(nullptr, bufferedDatabase.createSnapshot());
+
+  ASSERT_FALSE(bufferedDatabase.flush());
+  ASSERT_NE(nullptr, bufferedDatabase.createSnapshot());
+}
+
+TEST_F(BufferedDataBaseTests, iterateWritesBufferedRecordsFirst) {
+  write(database, {{"a", "1"}});
+
+  bufferedDatabase.startBuffering();
+  write(bufferedDatabase, {{"b", "2"}}, {"a"});
+
+  std::vector<std::string> keys;
+  ASSERT_FALSE(bufferedDatabase.iterate("", [&keys] (const std::string& key, const std::string& value) {
+    keys.push_back(key);
+    return true;
+  }));
+
+  ASSERT_EQ(std::vector<std::string>({"b"}), keys);
+  ASSERT_TRUE(bufferedDatabase.isBuffering());
+  ASSERT_EQ(0, bufferedDatabase.getBufferedSize());
+
+  write(bufferedDatabase, {{"c", "3"}});
+  ASSERT_EQ(0, database.baseState.count("c"));
+}
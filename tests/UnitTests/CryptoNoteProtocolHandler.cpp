@@ -0,0 +1,430 @@
+// Copyright (c) 2012-2017, The CryptoNote developers, The Bytecoin developers
+//
+// This file is part of Bytecoin.
+//
+// Bytecoin is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Bytecoin is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with Bytecoin.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <chrono>
+#include <limits>
+#include <vector>
+
+#include <System/Dispatcher.h>
+
+#include "CryptoNoteCore/AddBlockErrors.h"
+#include "CryptoNoteCore/CryptoNoteTools.h"
+#include "CryptoNoteCore/Currency.h"
+#include "CryptoNoteProtocol/CryptoNoteProtocolHandler.h"
+#include "Logging/LoggerGroup.h"
+#include "P2p/LevinProtocol.h"
+
+#include "ICoreStub.h"
+
+using namespace CryptoNote;
+
+namespace CryptoNote {
+
+// the handler packs transactions as strings
+static void serializeTransactions(std::vector<BinaryArray>& txs, ISerializer& s) {
+  std::vector<std::string> transactions;
+  if (s.type() == ISerializer::INPUT) {
+    s(transactions, "txs");
+    for (const auto& transaction : transactions) {
+      txs.emplace_back(transaction.begin(), transaction.end());
+    }
+  } else {
+    for (const auto& transaction : txs) {
+      transactions.emplace_back(transaction.begin(), transaction.end());
+    }
+
+    s(transactions, "txs");
+  }
+}
+
+static void serialize(NOTIFY_NEW_TRANSACTIONS_request& request, ISerializer& s) {
+  serializeTransactions(request.txs, s);
+}
+
+static void serialize(NOTIFY_RESPONSE_BLOCK_TRANSACTIONS_request& request, ISerializer& s) {
+  s(request.block_hash, "block_hash");
+  serializeTransactions(request.txs, s);
+}
+
+}
+
+namespace {
+
+class BlockCoreStub : public ICoreStub {
+public:
+  using ICoreStub::addBlock;
+
+  virtual std::error_code addBlock(RawBlock&& rawBlock) override {
+    addedBlocks.push_back(std::move(rawBlock));
+    return error::AddBlockErrorCode::ADDED_TO_MAIN;
+  }
+
+  std::vector<RawBlock> addedBlocks;
+};
+
+class P2pEndpointRecorder : public p2p_endpoint_stub {
+public:
+  struct Notification {
+    int command;
+    BinaryArray data;
+    net_connection_id connection;
+  };
+
+  struct Relay {
+    int command;
+    BinaryArray data;
+    uint8_t minVersion;
+    uint8_t maxVersion;
+  };
+
+  virtual void relayNotifyToVersions(int command, const BinaryArray& data, const net_connection_id* excludeConnection,
+    uint8_t minVersion, uint8_t maxVersion) override {
+    relays.push_back({command, data, minVersion, maxVersion});
+  }
+
+  virtual bool invoke_notify_to_peer(int command, const BinaryArray& data, const CryptoNoteConnectionContext& context) override {
+    notifications.push_back({command, data, context.m_connection_id});
+    return true;
+  }
+
+  virtual void for_each_connection(std::function<void(CryptoNoteConnectionContext&, PeerIdType)> f) override {
+    for (auto connection : connections) {
+      f(*connection, 0);
+    }
+  }
+
+  std::vector<Notification> notifications;
+  std::vector<Relay> relays;
+  std::vector<CryptoNoteConnectionContext*> connections;
+};
+
+using Clock = std::chrono::steady_clock;
+
+const auto REQUEST_TIMEOUT = std::chrono::milliseconds(P2P_TRANSACTIONS_REQUEST_TIMEOUT);
+
+BinaryArray makeTransaction(uint64_t unlockTime) {
+  Transaction transaction;
+  transaction.version = 1;
+  transaction.unlockTime = unlockTime;
+  return toBinaryArray(transaction);
+}
+
+NOTIFY_NEW_COMPACT_BLOCK::request makeCompactBlock(uint32_t index, const std::vector<BinaryArray>& transactions) {
+  BlockTemplate block;
+  block.majorVersion = BLOCK_MAJOR_VERSION_1;
+  block.minorVersion = BLOCK_MINOR_VERSION_0;
+  block.timestamp = index;
+  block.nonce = 0;
+  block.baseTransaction.version = 1;
+  block.baseTransaction.unlockTime = 0;
+  block.baseTransaction.inputs.push_back(BaseInput{index});
+  for (const auto& transaction : transactions) {
+    block.transactionHashes.push_back(getBinaryArrayHash(transaction));
+  }
+
+  return {toBinaryArray(block), index + 1, 0};
+}
+
+Crypto::Hash getCompactBlockHash(const NOTIFY_NEW_COMPACT_BLOCK::request& compactBlock) {
+  BlockTemplate block;
+  fromBinaryArray(block, compactBlock.block);
+  return CachedBlock(block).getBlockHash();
+}
+
+class CryptoNoteProtocolHandlerTest : public ::testing::Test {
+public:
+  CryptoNoteProtocolHandlerTest() :
+    currency(CurrencyBuilder(logger).currency()),
+    handler(currency, dispatcher, core, &p2p, logger) {
+  }
+
+  CryptoNoteConnectionContext makeConnection(uint8_t id, uint8_t version) {
+    CryptoNoteConnectionContext context;
+    context.version = version;
+    context.m_connection_id = boost::uuids::uuid();
+    context.m_connection_id.data[0] = id;
+    context.m_state = CryptoNoteConnectionContext::state_normal;
+    return context;
+  }
+
+  template <class Command>
+  void notify(typename Command::request request, CryptoNoteConnectionContext& context) {
+    BinaryArray response;
+    bool handled = false;
+    handler.handleCommand(true, Command::ID, LevinProtocol::encode(request), response, context, handled);
+    ASSERT_TRUE(handled);
+  }
+
+  template <class Command>
+  std::vector<typename Command::request> sentTo(const CryptoNoteConnectionContext& context) {
+    std::vector<typename Command::request> requests;
+    for (const auto& notification : p2p.notifications) {
+      if (notification.command == Command::ID && notification.connection == context.m_connection_id) {
+        typename Command::request request;
+        EXPECT_TRUE(LevinProtocol::decode(notification.data, request));
+        requests.push_back(std::move(request));
+      }
+    }
+
+    return requests;
+  }
+
+protected:
+  Logging::LoggerGroup logger;
+  Currency currency;
+  System::Dispatcher dispatcher;
+  BlockCoreStub core;
+  P2pEndpointRecorder p2p;
+  CryptoNoteProtocolHandler handler;
+};
+
+}
+
+TEST_F(CryptoNoteProtocolHandlerTest, compactBlockIsRebuiltFromPoolTransactions) {
+  auto peer = makeConnection(1, P2PProtocolVersion::V2);
+  std::vector<BinaryArray> transactions = {makeTransaction(1), makeTransaction(2), makeTransaction(3)};
+  for (auto it = transactions.rbegin(); it != transactions.rend(); ++it) {
+    core.addTransactionToPool(*it);
+  }
+
+  auto compactBlock = makeCompactBlock(1, transactions);
+  notify<NOTIFY_NEW_COMPACT_BLOCK>(compactBlock, peer);
+
+  ASSERT_EQ(1, core.addedBlocks.size());
+  ASSERT_EQ(compactBlock.block, core.addedBlocks[0].block);
+  ASSERT_EQ(transactions, core.addedBlocks[0].transactions);
+  ASSERT_TRUE(p2p.notifications.empty());
+}
+
+TEST_F(CryptoNoteProtocolHandlerTest, missingTransactionsAreRequestedFromSender) {
+  auto peer = makeConnection(1, P2PProtocolVersion::V2);
+  std::vector<BinaryArray> transactions = {makeTransaction(1), makeTransaction(2), makeTransaction(3)};
+  core.addTransactionToPool(transactions[1]);
+
+  auto compactBlock = makeCompactBlock(1, transactions);
+  notify<NOTIFY_NEW_COMPACT_BLOCK>(compactBlock, peer);
+  ASSERT_TRUE(core.addedBlocks.empty());
+
+  auto requests = sentTo<NOTIFY_REQUEST_BLOCK_TRANSACTIONS>(peer);
+  ASSERT_EQ(1, requests.size());
+  ASSERT_EQ(getCompactBlockHash(compactBlock), requests[0].block_hash);
+  ASSERT_EQ(std::vector<Crypto::Hash>({getBinaryArrayHash(transactions[0]), getBinaryArrayHash(transactions[2])}), requests[0].txs);
+
+  notify<NOTIFY_RESPONSE_BLOCK_TRANSACTIONS>({requests[0].block_hash, {transactions[2], transactions[0]}}, peer);
+  ASSERT_EQ(1, core.addedBlocks.size());
+  ASSERT_EQ(compactBlock.block, core.addedBlocks[0].block);
+  ASSERT_EQ(transactions, core.addedBlocks[0].transactions);
+}
+
+TEST_F(CryptoNoteProtocolHandlerTest, chainIsRequestedWhenSenderOmitsTransaction) {
+  auto peer = makeConnection(1, P2PProtocolVersion::V2);
+  std::vector<BinaryArray> transactions = {makeTransaction(1), makeTransaction(2)};
+
+  auto compactBlock = makeCompactBlock(1, transactions);
+  notify<NOTIFY_NEW_COMPACT_BLOCK>(compactBlock, peer);
+  notify<NOTIFY_RESPONSE_BLOCK_TRANSACTIONS>({getCompactBlockHash(compactBlock), {transactions[0]}}, peer);
+
+  ASSERT_TRUE(core.addedBlocks.empty());
+  ASSERT_EQ(CryptoNoteConnectionContext::state_synchronizing, peer.m_state);
+  ASSERT_EQ(1, sentTo<NOTIFY_REQUEST_CHAIN>(peer).size());
+}
+
+TEST_F(CryptoNoteProtocolHandlerTest, pendingBlocksOfPeerDontReplaceEachOther) {
+  auto peer = makeConnection(1, P2PProtocolVersion::V2);
+  auto firstTransaction = makeTransaction(1);
+  auto secondTransaction = makeTransaction(2);
+  auto firstBlock = makeCompactBlock(1, {firstTransaction});
+  auto secondBlock = makeCompactBlock(2, {secondTransaction});
+
+  notify<NOTIFY_NEW_COMPACT_BLOCK>(firstBlock, peer);
+  notify<NOTIFY_NEW_COMPACT_BLOCK>(secondBlock, peer);
+  ASSERT_EQ(2, sentTo<NOTIFY_REQUEST_BLOCK_TRANSACTIONS>(peer).size());
+
+  notify<NOTIFY_RESPONSE_BLOCK_TRANSACTIONS>({getCompactBlockHash(secondBlock), {secondTransaction}}, peer);
+  notify<NOTIFY_RESPONSE_BLOCK_TRANSACTIONS>({getCompactBlockHash(firstBlock), {firstTransaction}}, peer);
+
+  ASSERT_EQ(2, core.addedBlocks.size());
+  ASSERT_EQ(secondBlock.block, core.addedBlocks[0].block);
+  ASSERT_EQ(firstBlock.block, core.addedBlocks[1].block);
+}
+
+TEST_F(CryptoNoteProtocolHandlerTest, blockTransactionsAreServedFromChainAndPool) {
+  auto peer = makeConnection(1, P2PProtocolVersion::V2);
+  Transaction chainTransaction;
+  chainTransaction.version = 1;
+  chainTransaction.unlockTime = 1;
+  core.addTransaction(chainTransaction);
+  auto poolTransaction = makeTransaction(2);
+  core.addTransactionToPool(poolTransaction);
+
+  NOTIFY_REQUEST_BLOCK_TRANSACTIONS::request request;
+  request.block_hash = Crypto::rand<Crypto::Hash>();
+  request.txs = {getObjectHash(chainTransaction), getBinaryArrayHash(poolTransaction), Crypto::rand<Crypto::Hash>()};
+  notify<NOTIFY_REQUEST_BLOCK_TRANSACTIONS>(request, peer);
+
+  auto responses = sentTo<NOTIFY_RESPONSE_BLOCK_TRANSACTIONS>(peer);
+  ASSERT_EQ(1, responses.size());
+  ASSERT_EQ(request.block_hash, responses[0].block_hash);
+  ASSERT_EQ(std::vector<BinaryArray>({toBinaryArray(chainTransaction), poolTransaction}), responses[0].txs);
+}
+
+TEST_F(CryptoNoteProtocolHandlerTest, requestOfTooManyBlockTransactionsDropsConnection) {
+  auto peer = makeConnection(1, P2PProtocolVersion::V2);
+
+  NOTIFY_REQUEST_BLOCK_TRANSACTIONS::request request;
+  request.txs.resize(P2P_BLOCK_TRANSACTIONS_REQUEST_MAX_COUNT + 1);
+  notify<NOTIFY_REQUEST_BLOCK_TRANSACTIONS>(request, peer);
+
+  ASSERT_EQ(CryptoNoteConnectionContext::state_shutdown, peer.m_state);
+  ASSERT_TRUE(p2p.notifications.empty());
+}
+
+TEST_F(CryptoNoteProtocolHandlerTest, addedBlockIsRelayedByProtocolVersion) {
+  auto peer = makeConnection(1, P2PProtocolVersion::V2);
+  auto compactBlock = makeCompactBlock(1, {});
+  notify<NOTIFY_NEW_COMPACT_BLOCK>(compactBlock, peer);
+
+  ASSERT_EQ(2, p2p.relays.size());
+  auto compactRelay = std::find_if(p2p.relays.begin(), p2p.relays.end(), [](const P2pEndpointRecorder::Relay& relay) {
+    return relay.command == NOTIFY_NEW_COMPACT_BLOCK::ID;
+  });
+  auto fullRelay = std::find_if(p2p.relays.begin(), p2p.relays.end(), [](const P2pEndpointRecorder::Relay& relay) {
+    return relay.command == NOTIFY_NEW_BLOCK::ID;
+  });
+  ASSERT_NE(p2p.relays.end(), compactRelay);
+  ASSERT_NE(p2p.relays.end(), fullRelay);
+
+  ASSERT_EQ(P2PProtocolVersion::V2, compactRelay->minVersion);
+  ASSERT_EQ(std::numeric_limits<uint8_t>::max(), compactRelay->maxVersion);
+  ASSERT_EQ(P2PProtocolVersion::V0, fullRelay->minVersion);
+  ASSERT_EQ(P2PProtocolVersion::V1, fullRelay->maxVersion);
+
+  NOTIFY_NEW_COMPACT_BLOCK::request relayedCompactBlock;
+  ASSERT_TRUE(LevinProtocol::decode(compactRelay->data, relayedCompactBlock));
+  ASSERT_EQ(compactBlock.block, relayedCompactBlock.block);
+  ASSERT_EQ(1, relayedCompactBlock.hop);
+}
+
+TEST_F(CryptoNoteProtocolHandlerTest, announcedTransactionIsRequestedAndReceived) {
+  auto peer = makeConnection(1, P2PProtocolVersion::V3);
+  auto transaction = makeTransaction(1);
+  auto transactionHash = getBinaryArrayHash(transaction);
+
+  notify<NOTIFY_TX_INVENTORY>({{transactionHash}}, peer);
+  auto requests = sentTo<NOTIFY_REQUEST_TXS>(peer);
+  ASSERT_EQ(1, requests.size());
+  ASSERT_EQ(std::vector<Crypto::Hash>({transactionHash}), requests[0].txs);
+
+  notify<NOTIFY_NEW_TRANSACTIONS>({{transaction}}, peer);
+  ASSERT_TRUE(core.hasTransaction(transactionHash));
+
+  // the received transaction isn't requested again
+  handler.announceTransactions(Clock::now() + 2 * REQUEST_TIMEOUT);
+  ASSERT_EQ(1, sentTo<NOTIFY_REQUEST_TXS>(peer).size());
+
+  auto statistics = handler.getTransactionRelayStatistics();
+  ASSERT_EQ(1, statistics.hashesReceived);
+  ASSERT_EQ(1, statistics.requested);
+  ASSERT_EQ(1, statistics.received);
+  ASSERT_EQ(0, statistics.duplicates);
+}
+
+TEST_F(CryptoNoteProtocolHandlerTest, transactionIsRequestedOnceFromEachAnnouncer) {
+  auto firstPeer = makeConnection(1, P2PProtocolVersion::V3);
+  auto secondPeer = makeConnection(2, P2PProtocolVersion::V3);
+  p2p.connections = {&firstPeer, &secondPeer};
+  auto transactionHash = getBinaryArrayHash(makeTransaction(1));
+
+  notify<NOTIFY_TX_INVENTORY>({{transactionHash}}, firstPeer);
+  notify<NOTIFY_TX_INVENTORY>({{transactionHash}}, firstPeer);
+  notify<NOTIFY_TX_INVENTORY>({{transactionHash}}, secondPeer);
+  notify<NOTIFY_TX_INVENTORY>({{transactionHash}}, secondPeer);
+  ASSERT_EQ(1, sentTo<NOTIFY_REQUEST_TXS>(firstPeer).size());
+  ASSERT_TRUE(sentTo<NOTIFY_REQUEST_TXS>(secondPeer).empty());
+
+  auto now = Clock::now();
+  handler.announceTransactions(now);
+  ASSERT_TRUE(sentTo<NOTIFY_REQUEST_TXS>(secondPeer).empty());
+
+  handler.announceTransactions(now + 2 * REQUEST_TIMEOUT);
+  auto requests = sentTo<NOTIFY_REQUEST_TXS>(secondPeer);
+  ASSERT_EQ(1, requests.size());
+  ASSERT_EQ(std::vector<Crypto::Hash>({transactionHash}), requests[0].txs);
+
+  // every announcer was asked once
+  handler.announceTransactions(now + 4 * REQUEST_TIMEOUT);
+  ASSERT_EQ(1, sentTo<NOTIFY_REQUEST_TXS>(firstPeer).size());
+  ASSERT_EQ(1, sentTo<NOTIFY_REQUEST_TXS>(secondPeer).size());
+  ASSERT_EQ(2, handler.getTransactionRelayStatistics().requested);
+}
+
+TEST_F(CryptoNoteProtocolHandlerTest, transactionIsRequestedFromNextAnnouncerWhenAskedOneDisconnects) {
+  auto firstPeer = makeConnection(1, P2PProtocolVersion::V3);
+  auto secondPeer = makeConnection(2, P2PProtocolVersion::V3);
+  auto thirdPeer = makeConnection(3, P2PProtocolVersion::V3);
+  p2p.connections = {&firstPeer, &secondPeer, &thirdPeer};
+  auto transactionHash = getBinaryArrayHash(makeTransaction(1));
+
+  notify<NOTIFY_TX_INVENTORY>({{transactionHash}}, firstPeer);
+  notify<NOTIFY_TX_INVENTORY>({{transactionHash}}, secondPeer);
+  notify<NOTIFY_TX_INVENTORY>({{transactionHash}}, thirdPeer);
+
+  p2p.connections = {&firstPeer, &thirdPeer};
+  handler.onConnectionClosed(secondPeer);
+  p2p.connections = {&thirdPeer};
+  handler.onConnectionClosed(firstPeer);
+
+  handler.announceTransactions(Clock::now());
+  auto requests = sentTo<NOTIFY_REQUEST_TXS>(thirdPeer);
+  ASSERT_EQ(1, requests.size());
+  ASSERT_EQ(std::vector<Crypto::Hash>({transactionHash}), requests[0].txs);
+  ASSERT_TRUE(sentTo<NOTIFY_REQUEST_TXS>(secondPeer).empty());
+}
+
+TEST_F(CryptoNoteProtocolHandlerTest, requestsOfPeerAreLimited) {
+  auto peer = makeConnection(1, P2PProtocolVersion::V3);
+
+  NOTIFY_TX_INVENTORY::request inventory;
+  for (size_t i = 0; i < P2P_REQUESTED_TRANSACTIONS_PER_CONNECTION_LIMIT + 1; ++i) {
+    inventory.txs.push_back(Crypto::rand<Crypto::Hash>());
+  }
+
+  notify<NOTIFY_TX_INVENTORY>(inventory, peer);
+  auto requests = sentTo<NOTIFY_REQUEST_TXS>(peer);
+  ASSERT_EQ(1, requests.size());
+  ASSERT_EQ(P2P_REQUESTED_TRANSACTIONS_PER_CONNECTION_LIMIT, requests[0].txs.size());
+
+  notify<NOTIFY_TX_INVENTORY>({{Crypto::rand<Crypto::Hash>()}}, peer);
+  ASSERT_EQ(1, sentTo<NOTIFY_REQUEST_TXS>(peer).size());
+}
+
+TEST_F(CryptoNoteProtocolHandlerTest, duplicateTransactionsAreCounted) {
+  auto peer = makeConnection(1, P2PProtocolVersion::V3);
+  auto transaction = makeTransaction(1);
+
+  notify<NOTIFY_NEW_TRANSACTIONS>({{transaction}}, peer);
+  notify<NOTIFY_NEW_TRANSACTIONS>({{transaction}}, peer);
+
+  auto statistics = handler.getTransactionRelayStatistics();
+  ASSERT_EQ(2, statistics.received);
+  ASSERT_EQ(2 * transaction.size(), statistics.receivedBytes);
+  ASSERT_EQ(1, statistics.duplicates);
+  ASSERT_EQ(transaction.size(), statistics.duplicateBytes);
+}
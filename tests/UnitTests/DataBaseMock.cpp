@@ -58,6 +58,22 @@ std::error_code DataBaseMock::read(IReadBatch& batch) {
   return{};
 }
 
+std::error_code DataBaseMock::iterate(const std::string& startKey, const std::function<bool(const std::string& key, const std::string& value)>& handler) {
+  for (auto it = baseState.lower_bound(startKey); it != baseState.end(); ++it) {
+    if (!handler(it->first, it->second)) {
+      break;
+    }
+  }
+
+  return{};
+}
+
+std::shared_ptr<IDataBase> DataBaseMock::createSnapshot() {
+  auto snapshot = std::make_shared<DataBaseMock>();
+  snapshot->baseState = baseState;
+  return snapshot;
+}
+
 std::unordered_map<uint32_t, RawBlock> DataBaseMock::blocks() {
   BlockchainReadBatch req;
   for (int i = 0; i < 30; ++i) {
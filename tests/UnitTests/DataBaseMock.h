@@ -34,6 +34,8 @@ public:
   std::error_code write(IWriteBatch& batch) override;
   std::error_code writeSync(IWriteBatch& batch) override;
   std::error_code read(IReadBatch& batch) override;
+  std::error_code iterate(const std::string& startKey, const std::function<bool(const std::string& key, const std::string& value)>& handler) override;
+  std::shared_ptr<IDataBase> createSnapshot() override;
   std::unordered_map<uint32_t, RawBlock> blocks();
 
   std::map<std::string, std::string> baseState;
@@ -288,6 +288,18 @@ bool ICoreStub::getRandomOutputs(uint64_t amount, uint16_t count, std::vector<ui
   return randomOutsResult;
 }
 
+void ICoreStub::getPoolTransactions(const std::vector<Crypto::Hash>& txs_ids, std::vector<CryptoNote::BinaryArray>& txs,
+                                    std::vector<Crypto::Hash>& missed_txs) const {
+  for (const Crypto::Hash& hash : txs_ids) {
+    auto iter = transactionPool.find(hash);
+    if (iter != transactionPool.end()) {
+      txs.push_back(iter->second);
+    } else {
+      missed_txs.push_back(hash);
+    }
+  }
+}
+
 bool ICoreStub::addTransactionToPool(const CryptoNote::BinaryArray& transactionBinaryArray) {
   transactionPool.emplace(CryptoNote::getBinaryArrayHash(transactionBinaryArray), transactionBinaryArray);
   return true;
@@ -331,6 +343,16 @@ std::error_code ICoreStub::addBlock(CryptoNote::RawBlock&& rawBlock) {
   return {};
 }
 
+std::vector<std::error_code> ICoreStub::addBlocks(const std::vector<CryptoNote::CachedBlock>& cachedBlocks, std::vector<CryptoNote::RawBlock>&& rawBlocks) {
+  assert(false);
+  return {};
+}
+
+std::vector<std::error_code> ICoreStub::addBlocks(std::vector<CryptoNote::RawBlock>&& rawBlocks) {
+  assert(false);
+  return {};
+}
+
 bool ICoreStub::hasBlock(const Crypto::Hash& id) const {
   return blocks.count(id) > 0;
 }
@@ -51,6 +51,8 @@ public:
   virtual CryptoNote::Difficulty getDifficultyForNextBlock() const override;
   virtual std::error_code addBlock(const CryptoNote::CachedBlock& cachedBlock, CryptoNote::RawBlock&& rawBlock) override;
   virtual std::error_code addBlock(CryptoNote::RawBlock&& rawBlock) override;
+  virtual std::vector<std::error_code> addBlocks(const std::vector<CryptoNote::CachedBlock>& cachedBlocks, std::vector<CryptoNote::RawBlock>&& rawBlocks) override;
+  virtual std::vector<std::error_code> addBlocks(std::vector<CryptoNote::RawBlock>&& rawBlocks) override;
   virtual std::error_code submitBlock(CryptoNote::BinaryArray&& rawBlockTemplate) override;
   
   virtual std::vector<CryptoNote::RawBlock> getBlocks(uint32_t startIndex, uint32_t count) const override;
@@ -83,6 +85,7 @@ public:
   virtual CryptoNote::BlockTemplate getBlockByHash(const Crypto::Hash &h) const override;
   virtual void extractKeyOutputKeys(const uint64_t amount, const std::vector<uint32_t>& absolute_offsets, std::vector<Crypto::PublicKey>& mixin_outputs) const override;
   virtual void getTransactions(const std::vector<Crypto::Hash>& txs_ids, std::vector<CryptoNote::BinaryArray>& txs, std::vector<Crypto::Hash>& missed_txs) const override;
+  virtual void getPoolTransactions(const std::vector<Crypto::Hash>& txs_ids, std::vector<CryptoNote::BinaryArray>& txs, std::vector<Crypto::Hash>& missed_txs) const override;
   virtual CryptoNote::Difficulty getBlockDifficulty(uint32_t index) const override;
 
 
@@ -0,0 +1,84 @@
+// Copyright (c) 2012-2017, The CryptoNote developers, The Bytecoin developers
+//
+// This file is part of Bytecoin.
+//
+// Bytecoin is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Bytecoin is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with Bytecoin.  If not, see <http://www.gnu.org/licenses/>.
+#include <gtest/gtest.h>
+
+#include <vector>
+
+#include "CryptoNoteProtocol/InventoryFilter.h"
+#include "crypto/crypto.h"
+#include "crypto/hash.h"
+
+using namespace CryptoNote;
+
+namespace {
+
+std::vector<Crypto::Hash> makeHashes(size_t count) {
+  std::vector<Crypto::Hash> hashes;
+  for (size_t i = 0; i < count; ++i) {
+    hashes.push_back(Crypto::rand<Crypto::Hash>());
+  }
+
+  return hashes;
+}
+
+}
+
+TEST(InventoryFilter, containsInsertedHashes) {
+  InventoryFilter filter(100);
+  auto hashes = makeHashes(10);
+  for (const auto& hash : hashes) {
+    filter.insert(hash);
+  }
+
+  for (const auto& hash : hashes) {
+    ASSERT_TRUE(filter.contains(hash));
+  }
+
+  ASSERT_FALSE(filter.contains(Crypto::rand<Crypto::Hash>()));
+  ASSERT_EQ(10, filter.size());
+}
+
+TEST(InventoryFilter, duplicateInsertionDoesntGrowFilter) {
+  InventoryFilter filter(100);
+  auto hash = Crypto::rand<Crypto::Hash>();
+  filter.insert(hash);
+  filter.insert(hash);
+
+  ASSERT_EQ(1, filter.size());
+}
+
+TEST(InventoryFilter, sizeIsBoundedByCapacity) {
+  InventoryFilter filter(100);
+  for (const auto& hash : makeHashes(1000)) {
+    filter.insert(hash);
+    ASSERT_LE(filter.size(), filter.capacity());
+  }
+}
+
+TEST(InventoryFilter, remembersLastHalfOfCapacity) {
+  InventoryFilter filter(100);
+  auto hashes = makeHashes(1000);
+  for (const auto& hash : hashes) {
+    filter.insert(hash);
+  }
+
+  for (size_t i = hashes.size() - filter.capacity() / 2; i < hashes.size(); ++i) {
+    ASSERT_TRUE(filter.contains(hashes[i]));
+  }
+
+  ASSERT_FALSE(filter.contains(hashes.front()));
+}
@@ -0,0 +1,69 @@
+// Copyright (c) 2012-2017, The CryptoNote developers, The Bytecoin developers
+//
+// This file is part of Bytecoin.
+//
+// Bytecoin is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Bytecoin is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with Bytecoin.  If not, see <http://www.gnu.org/licenses/>.
+#include <gtest/gtest.h>
+
+#include <vector>
+
+#include "CryptoNoteCore/KeyImageFilter.h"
+
+using namespace CryptoNote;
+
+TEST(KeyImageFilter, emptyFilterContainsNothing) {
+  KeyImageFilter filter(100);
+  ASSERT_FALSE(filter.mayContain(Crypto::rand<Crypto::KeyImage>()));
+  ASSERT_EQ(0, filter.size());
+}
+
+TEST(KeyImageFilter, insertedKeyImagesAreFound) {
+  const size_t COUNT = 10000;
+  KeyImageFilter filter(COUNT);
+
+  std::vector<Crypto::KeyImage> keyImages;
+  for (size_t i = 0; i < COUNT; ++i) {
+    keyImages.push_back(Crypto::rand<Crypto::KeyImage>());
+    filter.insert(keyImages.back());
+  }
+
+  for (const auto& keyImage : keyImages) {
+    ASSERT_TRUE(filter.mayContain(keyImage));
+  }
+
+  ASSERT_EQ(COUNT, filter.size());
+}
+
+TEST(KeyImageFilter, falsePositiveRateIsLowAtCapacity) {
+  const size_t COUNT = 10000;
+  KeyImageFilter filter(COUNT);
+  for (size_t i = 0; i < COUNT; ++i) {
+    filter.insert(Crypto::rand<Crypto::KeyImage>());
+  }
+
+  size_t falsePositives = 0;
+  for (size_t i = 0; i < COUNT; ++i) {
+    if (filter.mayContain(Crypto::rand<Crypto::KeyImage>())) {
+      ++falsePositives;
+    }
+  }
+
+  ASSERT_LT(falsePositives, COUNT / 50);
+}
+
+TEST(KeyImageFilter, capacityIsNotLessThanRequested) {
+  KeyImageFilter filter(100000);
+  ASSERT_LE(100000, filter.capacity());
+  ASSERT_LE(100000 * 12 / 8, filter.memoryUsage());
+}
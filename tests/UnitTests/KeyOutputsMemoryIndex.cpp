@@ -0,0 +1,155 @@
+// Copyright (c) 2012-2017, The CryptoNote developers, The Bytecoin developers
+//
+// This file is part of Bytecoin.
+//
+// Bytecoin is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Bytecoin is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with Bytecoin.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <gtest/gtest.h>
+
+#include <boost/filesystem/operations.hpp>
+
+#include "CryptoNoteCore/KeyOutputsMemoryIndex.h"
+
+using namespace CryptoNote;
+
+namespace {
+
+PackedOutIndex makePackedOut(uint32_t blockIndex, uint16_t transactionIndex, uint16_t outputIndex) {
+  PackedOutIndex packedOut;
+  packedOut.blockIndex = blockIndex;
+  packedOut.transactionIndex = transactionIndex;
+  packedOut.outputIndex = outputIndex;
+  return packedOut;
+}
+
+void pushOutputs(KeyOutputsMemoryIndex& index, uint64_t amount, uint32_t count) {
+  for (uint32_t i = 0; i < count; ++i) {
+    index.push(amount, makePackedOut(i, 0, 0), Crypto::rand<Crypto::PublicKey>(), i);
+  }
+}
+
+class KeyOutputsMemoryIndexFile : public ::testing::Test {
+public:
+  void SetUp() override {
+    path = (boost::filesystem::temp_directory_path() / boost::filesystem::unique_path("keyoutputs_%%%%%%%%%%%%.bin")).string();
+  }
+
+  void TearDown() override {
+    boost::system::error_code ignoredErrorCode;
+    boost::filesystem::remove(path, ignoredErrorCode);
+  }
+
+  std::string path;
+};
+
+}
+
+TEST(KeyOutputsMemoryIndex, outputsOfUnknownAmountsAreIgnored) {
+  KeyOutputsMemoryIndex index(1024 * 1024);
+  pushOutputs(index, 10, 5);
+
+  ASSERT_EQ(nullptr, index.getColumn(10));
+  ASSERT_EQ(0, index.memoryUsage());
+}
+
+TEST(KeyOutputsMemoryIndex, pushedOutputsAreStoredInGlobalIndexOrder) {
+  KeyOutputsMemoryIndex index(1024 * 1024);
+  index.addAmount(10);
+
+  auto key = Crypto::rand<Crypto::PublicKey>();
+  index.push(10, makePackedOut(1, 2, 3), key, 100);
+  pushOutputs(index, 10, 4);
+
+  auto column = index.getColumn(10);
+  ASSERT_NE(nullptr, column);
+  ASSERT_EQ(5, column->size());
+  ASSERT_EQ(makePackedOut(1, 2, 3).packedValue, column->packedOuts[0].packedValue);
+  ASSERT_EQ(key, column->publicKeys[0]);
+  ASSERT_EQ(100, column->unlockTimes[0]);
+  ASSERT_EQ(5 * KeyOutputsMemoryIndex::outputMemoryUsage(), index.memoryUsage());
+}
+
+TEST(KeyOutputsMemoryIndex, truncateRemovesTailOutputs) {
+  KeyOutputsMemoryIndex index(1024 * 1024);
+  index.addAmount(10);
+  pushOutputs(index, 10, 5);
+
+  index.truncate(10, 2);
+  ASSERT_EQ(2, index.getColumn(10)->size());
+  ASSERT_EQ(2 * KeyOutputsMemoryIndex::outputMemoryUsage(), index.memoryUsage());
+
+  index.truncate(10, 3);
+  ASSERT_EQ(2, index.getColumn(10)->size());
+}
+
+TEST(KeyOutputsMemoryIndex, smallestAmountIsDroppedWhenLimitIsExceeded) {
+  KeyOutputsMemoryIndex index(10 * KeyOutputsMemoryIndex::outputMemoryUsage());
+  ASSERT_TRUE(index.canAdd(10));
+  ASSERT_FALSE(index.canAdd(11));
+
+  index.addAmount(10);
+  index.addAmount(20);
+  pushOutputs(index, 10, 6);
+  pushOutputs(index, 20, 4);
+  ASSERT_NE(nullptr, index.getColumn(20));
+
+  pushOutputs(index, 10, 1);
+  ASSERT_NE(nullptr, index.getColumn(10));
+  ASSERT_EQ(nullptr, index.getColumn(20));
+  ASSERT_EQ(7 * KeyOutputsMemoryIndex::outputMemoryUsage(), index.memoryUsage());
+}
+
+TEST_F(KeyOutputsMemoryIndexFile, loadRestoresSavedColumns) {
+  auto topBlockHash = Crypto::rand<Crypto::Hash>();
+  KeyOutputsMemoryIndex index(1024 * 1024);
+  index.addAmount(10);
+  index.addAmount(20);
+  index.addAmount(30);
+  pushOutputs(index, 10, 5);
+  pushOutputs(index, 20, 3);
+  ASSERT_TRUE(index.save(path, 7, topBlockHash));
+
+  KeyOutputsMemoryIndex loaded(1024 * 1024);
+  ASSERT_TRUE(loaded.load(path, 7, topBlockHash));
+  ASSERT_EQ(index.getAmounts(), loaded.getAmounts());
+  ASSERT_EQ(index.memoryUsage(), loaded.memoryUsage());
+  for (auto amount : index.getAmounts()) {
+    auto expected = index.getColumn(amount);
+    auto actual = loaded.getColumn(amount);
+    ASSERT_EQ(expected->size(), actual->size());
+    for (size_t i = 0; i < expected->size(); ++i) {
+      ASSERT_EQ(expected->packedOuts[i].packedValue, actual->packedOuts[i].packedValue);
+      ASSERT_EQ(expected->publicKeys[i], actual->publicKeys[i]);
+      ASSERT_EQ(expected->unlockTimes[i], actual->unlockTimes[i]);
+    }
+  }
+}
+
+TEST_F(KeyOutputsMemoryIndexFile, loadRejectsFileSavedAtAnotherTopBlock) {
+  auto topBlockHash = Crypto::rand<Crypto::Hash>();
+  KeyOutputsMemoryIndex index(1024 * 1024);
+  index.addAmount(10);
+  pushOutputs(index, 10, 5);
+  ASSERT_TRUE(index.save(path, 7, topBlockHash));
+
+  KeyOutputsMemoryIndex loaded(1024 * 1024);
+  ASSERT_FALSE(loaded.load(path, 8, topBlockHash));
+  ASSERT_FALSE(loaded.load(path, 7, Crypto::rand<Crypto::Hash>()));
+  ASSERT_EQ(nullptr, loaded.getColumn(10));
+}
+
+TEST_F(KeyOutputsMemoryIndexFile, loadFailsWithoutFile) {
+  KeyOutputsMemoryIndex index(1024 * 1024);
+  ASSERT_FALSE(index.load(path, 0, Crypto::Hash()));
+}
@@ -0,0 +1,81 @@
+// Copyright (c) 2012-2017, The CryptoNote developers, The Bytecoin developers
+//
+// This file is part of Bytecoin.
+//
+// Bytecoin is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Bytecoin is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with Bytecoin.  If not, see <http://www.gnu.org/licenses/>.
+#include <gtest/gtest.h>
+#include "CryptoNoteCore/ProofOfWorkService.h"
+#include "CryptoNoteCore/Currency.h"
+#include "Logging/LoggerGroup.h"
+
+#include <System/Dispatcher.h>
+
+using namespace CryptoNote;
+
+class ProofOfWorkServiceTest : public ::testing::Test {
+public:
+  ProofOfWorkServiceTest() : currency(CurrencyBuilder(logger).currency()), pool(2) {
+  }
+
+protected:
+  Logging::LoggerGroup logger;
+  Currency currency;
+  System::Dispatcher dispatcher;
+  Common::ThreadPool pool;
+};
+
+TEST_F(ProofOfWorkServiceTest, pushedBlockHashIsCalculatedByPool) {
+  Crypto::cn_context context;
+  Crypto::Hash expectedHash = CachedBlock(currency.genesisBlock()).getBlockLongHash(context);
+
+  CachedBlock block(currency.genesisBlock());
+  ProofOfWorkService service(dispatcher, pool);
+  service.push(block);
+  service.waitBlockLongHash(block);
+
+  ASSERT_EQ(0, service.getPendingCount());
+  ASSERT_EQ(expectedHash, block.getBlockLongHash(context));
+}
+
+TEST_F(ProofOfWorkServiceTest, waitForUnknownBlockReturnsImmediately) {
+  CachedBlock block(currency.genesisBlock());
+  ProofOfWorkService service(dispatcher, pool);
+  service.waitBlockLongHash(block);
+  ASSERT_EQ(0, service.getPendingCount());
+}
+
+TEST_F(ProofOfWorkServiceTest, cancelWaitsForAllTasks) {
+  std::vector<CachedBlock> blocks;
+  for (size_t i = 0; i < 8; ++i) {
+    blocks.emplace_back(currency.genesisBlock());
+  }
+
+  ProofOfWorkService service(dispatcher, pool);
+  for (const auto& block : blocks) {
+    service.push(block);
+  }
+
+  service.cancel();
+  ASSERT_EQ(0, service.getPendingCount());
+}
+
+TEST_F(ProofOfWorkServiceTest, blockOfUnknownVersionIsntQueued) {
+  auto blockTemplate = currency.genesisBlock();
+  blockTemplate.majorVersion = 0;
+  CachedBlock block(blockTemplate);
+
+  ProofOfWorkService service(dispatcher, pool);
+  service.push(block);
+  ASSERT_EQ(0, service.getPendingCount());
+}
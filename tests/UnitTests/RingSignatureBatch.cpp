@@ -0,0 +1,133 @@
+// Copyright (c) 2012-2017, The CryptoNote developers, The Bytecoin developers
+//
+// This file is part of Bytecoin.
+//
+// Bytecoin is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Bytecoin is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with Bytecoin.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "gtest/gtest.h"
+
+#include <array>
+
+#include "Common/ThreadPool.h"
+#include "CryptoNoteCore/RingSignatureBatch.h"
+
+using namespace CryptoNote;
+
+namespace {
+
+const size_t TRANSACTION_COUNT = 8;
+const size_t INPUTS_PER_TRANSACTION = 2;
+const size_t CHECK_COUNT = TRANSACTION_COUNT * INPUTS_PER_TRANSACTION;
+const size_t RING_SIZE = 3;
+const size_t REAL_OUTPUT = 1;
+
+class RingSignatureBatchTests : public ::testing::Test {
+public:
+  RingSignatureBatchTests() : threadPool(4) {
+    for (size_t i = 0; i < CHECK_COUNT; ++i) {
+      prefixHashes[i] = Crypto::rand<Crypto::Hash>();
+
+      std::vector<const Crypto::PublicKey*> keyPointers;
+      Crypto::SecretKey realSecretKey;
+      for (size_t j = 0; j < RING_SIZE; ++j) {
+        Crypto::SecretKey secretKey;
+        Crypto::generate_keys(outputKeys[i][j], secretKey);
+        keyPointers.push_back(&outputKeys[i][j]);
+        if (j == REAL_OUTPUT) {
+          realSecretKey = secretKey;
+        }
+      }
+
+      Crypto::generate_key_image(outputKeys[i][REAL_OUTPUT], realSecretKey, keyImages[i]);
+      signatures[i].resize(RING_SIZE);
+      Crypto::generate_ring_signature(prefixHashes[i], keyImages[i], keyPointers.data(), RING_SIZE, realSecretKey, REAL_OUTPUT,
+        signatures[i].data());
+    }
+  }
+
+  // checks of consecutive inputs belong to one transaction
+  RingSignatureBatch makeBatch() {
+    RingSignatureBatch batch;
+    for (size_t i = 0; i < CHECK_COUNT; ++i) {
+      batch.addCheck(i / INPUTS_PER_TRANSACTION, prefixHashes[i], keyImages[i],
+        std::vector<Crypto::PublicKey>(outputKeys[i].begin(), outputKeys[i].end()), signatures[i].data(), true);
+    }
+
+    return batch;
+  }
+
+  void breakSignature(size_t check) {
+    signatures[check][REAL_OUTPUT].data[0] ^= 1;
+  }
+
+protected:
+  Common::ThreadPool threadPool;
+  std::array<Crypto::Hash, CHECK_COUNT> prefixHashes;
+  std::array<Crypto::KeyImage, CHECK_COUNT> keyImages;
+  std::array<std::array<Crypto::PublicKey, RING_SIZE>, CHECK_COUNT> outputKeys;
+  std::array<std::vector<Crypto::Signature>, CHECK_COUNT> signatures;
+};
+
+}
+
+TEST_F(RingSignatureBatchTests, validSignaturesPass) {
+  auto batch = makeBatch();
+  ASSERT_EQ(CHECK_COUNT, batch.size());
+  ASSERT_EQ(RingSignatureBatch::NO_FAILURE, batch.verify());
+  ASSERT_EQ(RingSignatureBatch::NO_FAILURE, batch.verify(threadPool));
+}
+
+TEST_F(RingSignatureBatchTests, emptyBatchPasses) {
+  RingSignatureBatch batch;
+  ASSERT_TRUE(batch.empty());
+  ASSERT_EQ(RingSignatureBatch::NO_FAILURE, batch.verify());
+  ASSERT_EQ(RingSignatureBatch::NO_FAILURE, batch.verify(threadPool));
+}
+
+TEST_F(RingSignatureBatchTests, invalidSignatureOfFirstCheckReturnsItsTransaction) {
+  breakSignature(0);
+  auto batch = makeBatch();
+  ASSERT_EQ(0, batch.verify());
+  ASSERT_EQ(0, batch.verify(threadPool));
+}
+
+TEST_F(RingSignatureBatchTests, invalidSignatureOfMiddleCheckReturnsItsTransaction) {
+  breakSignature(CHECK_COUNT / 2 + 1);
+  auto batch = makeBatch();
+  ASSERT_EQ((CHECK_COUNT / 2 + 1) / INPUTS_PER_TRANSACTION, batch.verify());
+  ASSERT_EQ((CHECK_COUNT / 2 + 1) / INPUTS_PER_TRANSACTION, batch.verify(threadPool));
+}
+
+TEST_F(RingSignatureBatchTests, invalidSignatureOfLastCheckReturnsItsTransaction) {
+  breakSignature(CHECK_COUNT - 1);
+  auto batch = makeBatch();
+  ASSERT_EQ(TRANSACTION_COUNT - 1, batch.verify());
+  ASSERT_EQ(TRANSACTION_COUNT - 1, batch.verify(threadPool));
+}
+
+TEST_F(RingSignatureBatchTests, firstOfSeveralInvalidSignaturesIsReturned) {
+  breakSignature(CHECK_COUNT - 1);
+  breakSignature(5);
+  breakSignature(CHECK_COUNT / 2);
+  auto batch = makeBatch();
+  ASSERT_EQ(5 / INPUTS_PER_TRANSACTION, batch.verify());
+  ASSERT_EQ(5 / INPUTS_PER_TRANSACTION, batch.verify(threadPool));
+}
+
+TEST_F(RingSignatureBatchTests, signatureOfAnotherKeyImageFails) {
+  keyImages[3] = keyImages[4];
+  auto batch = makeBatch();
+  ASSERT_EQ(3 / INPUTS_PER_TRANSACTION, batch.verify());
+  ASSERT_EQ(3 / INPUTS_PER_TRANSACTION, batch.verify(threadPool));
+}
@@ -0,0 +1,101 @@
+// Copyright (c) 2012-2017, The CryptoNote developers, The Bytecoin developers
+//
+// This file is part of Bytecoin.
+//
+// Bytecoin is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Bytecoin is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with Bytecoin.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "gtest/gtest.h"
+
+#include "CryptoNoteCore/RingSignatureCache.h"
+
+using namespace CryptoNote;
+
+namespace {
+
+Crypto::Hash makeKey(uint8_t seed) {
+  Crypto::Hash prefixHash = Crypto::rand<Crypto::Hash>();
+  std::vector<Crypto::PublicKey> outputKeys(2, Crypto::rand<Crypto::PublicKey>());
+  std::vector<Crypto::Signature> signatures(2, Crypto::Signature());
+  return RingSignatureCache::getKey(prefixHash, seed, outputKeys, signatures, true);
+}
+
+TEST(RingSignatureCache, keyDependsOnEveryPart) {
+  Crypto::Hash prefixHash = Crypto::rand<Crypto::Hash>();
+  std::vector<Crypto::PublicKey> outputKeys{Crypto::rand<Crypto::PublicKey>(), Crypto::rand<Crypto::PublicKey>()};
+  std::vector<Crypto::Signature> signatures(2, Crypto::Signature());
+
+  auto key = RingSignatureCache::getKey(prefixHash, 0, outputKeys, signatures, true);
+  ASSERT_EQ(key, RingSignatureCache::getKey(prefixHash, 0, outputKeys, signatures, true));
+  ASSERT_NE(key, RingSignatureCache::getKey(Crypto::rand<Crypto::Hash>(), 0, outputKeys, signatures, true));
+  ASSERT_NE(key, RingSignatureCache::getKey(prefixHash, 1, outputKeys, signatures, true));
+  ASSERT_NE(key, RingSignatureCache::getKey(prefixHash, 0, outputKeys, signatures, false));
+
+  auto otherKeys = outputKeys;
+  std::swap(otherKeys[0], otherKeys[1]);
+  ASSERT_NE(key, RingSignatureCache::getKey(prefixHash, 0, otherKeys, signatures, true));
+
+  auto otherSignatures = signatures;
+  otherSignatures[1].data[0] = 1;
+  ASSERT_NE(key, RingSignatureCache::getKey(prefixHash, 0, outputKeys, otherSignatures, true));
+}
+
+TEST(RingSignatureCache, countsHitsAndMisses) {
+  RingSignatureCache cache(10);
+  auto key = makeKey(0);
+
+  ASSERT_FALSE(cache.contains(key));
+  cache.insert(key);
+  ASSERT_TRUE(cache.contains(key));
+  ASSERT_TRUE(cache.contains(key));
+
+  ASSERT_EQ(2, cache.getHits());
+  ASSERT_EQ(1, cache.getMisses());
+}
+
+TEST(RingSignatureCache, oldestEntriesAreDroppedWhenFull) {
+  RingSignatureCache cache(3);
+  std::vector<Crypto::Hash> keys;
+  for (uint8_t i = 0; i < 5; ++i) {
+    keys.push_back(makeKey(i));
+    cache.insert(keys.back());
+  }
+
+  ASSERT_EQ(3, cache.size());
+  ASSERT_FALSE(cache.contains(keys[0]));
+  ASSERT_FALSE(cache.contains(keys[1]));
+  ASSERT_TRUE(cache.contains(keys[2]));
+  ASSERT_TRUE(cache.contains(keys[4]));
+}
+
+TEST(RingSignatureCache, repeatedInsertKeepsSingleEntry) {
+  RingSignatureCache cache(2);
+  auto key = makeKey(0);
+  cache.insert(key);
+  cache.insert(key);
+  cache.insert(makeKey(1));
+
+  ASSERT_EQ(2, cache.size());
+  ASSERT_TRUE(cache.contains(key));
+}
+
+TEST(RingSignatureCache, zeroCapacityCacheKeepsNothing) {
+  RingSignatureCache cache(0);
+  auto key = makeKey(0);
+  cache.insert(key);
+
+  ASSERT_EQ(0, cache.size());
+  ASSERT_FALSE(cache.contains(key));
+}
+
+}
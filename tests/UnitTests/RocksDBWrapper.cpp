@@ -0,0 +1,288 @@
+// Copyright (c) 2012-2017, The CryptoNote developers, The Bytecoin developers
+//
+// This file is part of Bytecoin.
+//
+// Bytecoin is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Bytecoin is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with Bytecoin.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <limits>
+
+#include <boost/filesystem/operations.hpp>
+
+#include "rocksdb/db.h"
+
+#include "Common/CommandLine.h"
+#include "CryptoNoteCore/DBUtils.h"
+#include "CryptoNoteCore/RocksDBWrapper.h"
+#include "Logging/ConsoleLogger.h"
+
+using namespace CryptoNote;
+
+namespace {
+
+class RawWriteBatch: public IWriteBatch {
+public:
+  explicit RawWriteBatch(std::vector<std::pair<std::string, std::string>>&& rawData) : rawData(std::move(rawData)) {
+  }
+
+  virtual std::vector<std::pair<std::string, std::string>> extractRawDataToInsert() override {
+    return std::move(rawData);
+  }
+
+  virtual std::vector<std::string> extractRawKeysToRemove() override {
+    return {};
+  }
+
+private:
+  std::vector<std::pair<std::string, std::string>> rawData;
+};
+
+class RawReadBatch: public IReadBatch {
+public:
+  explicit RawReadBatch(std::vector<std::string>&& rawKeys) : rawKeys(std::move(rawKeys)) {
+  }
+
+  virtual std::vector<std::string> getRawKeys() const override {
+    return rawKeys;
+  }
+
+  virtual void submitRawResult(const std::vector<std::string>& values, const std::vector<bool>& resultStates) override {
+    this->values = values;
+    this->resultStates = resultStates;
+  }
+
+  std::vector<std::string> rawKeys;
+  std::vector<std::string> values;
+  std::vector<bool> resultStates;
+};
+
+// Opens the DB directory without the wrapper to see which column family keeps a record
+class RawDataBase {
+public:
+  explicit RawDataBase(const std::string& path) {
+    std::vector<std::string> names;
+    EXPECT_TRUE(rocksdb::DB::ListColumnFamilies(rocksdb::DBOptions(), path, &names).ok());
+
+    std::vector<rocksdb::ColumnFamilyDescriptor> descriptors;
+    for (const auto& name : names) {
+      descriptors.emplace_back(name, rocksdb::ColumnFamilyOptions());
+    }
+
+    rocksdb::DB* dbPtr;
+    EXPECT_TRUE(rocksdb::DB::Open(rocksdb::Options(), path, descriptors, &handles, &dbPtr).ok());
+    db.reset(dbPtr);
+  }
+
+  ~RawDataBase() {
+    for (auto handle : handles) {
+      db->DestroyColumnFamilyHandle(handle);
+    }
+  }
+
+  bool contains(const std::string& familyName, const std::string& key) {
+    auto it = std::find_if(handles.begin(), handles.end(), [&familyName](rocksdb::ColumnFamilyHandle* handle) {
+      return handle->GetName() == familyName;
+    });
+
+    std::string value;
+    return it != handles.end() && db->Get(rocksdb::ReadOptions(), *it, key, &value).ok();
+  }
+
+  size_t count(const std::string& familyName) {
+    auto it = std::find_if(handles.begin(), handles.end(), [&familyName](rocksdb::ColumnFamilyHandle* handle) {
+      return handle->GetName() == familyName;
+    });
+
+    size_t result = 0;
+    std::unique_ptr<rocksdb::Iterator> iterator(db->NewIterator(rocksdb::ReadOptions(), *it));
+    for (iterator->SeekToFirst(); iterator->Valid(); iterator->Next()) {
+      ++result;
+    }
+
+    return result;
+  }
+
+private:
+  std::unique_ptr<rocksdb::DB> db;
+  std::vector<rocksdb::ColumnFamilyHandle*> handles;
+};
+
+class RocksDBWrapperTests : public ::testing::Test {
+public:
+  RocksDBWrapperTests() : database(logger) {
+  }
+
+  void SetUp() override {
+    dir = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path("test_data_dir_%%%%%%%%%%%%");
+    boost::system::error_code ignoredErrorCode;
+    boost::filesystem::create_directory(dir, ignoredErrorCode);
+
+    config.setDataDir(dir.string());
+    config.setCompression("none");
+    config.setWriteBufferSize(4 * 1024 * 1024);
+    config.setReadCacheSize(1024 * 1024);
+  }
+
+  void TearDown() override {
+    try {
+      database.shutdown();
+    } catch (std::system_error&) {
+      // the test has already closed it
+    }
+
+    boost::system::error_code ignoredErrorCode;
+    boost::filesystem::remove_all(dir, ignoredErrorCode);
+  }
+
+  std::string getDataBasePath() const {
+    return (dir / "DB").string();
+  }
+
+  void write(std::vector<std::pair<std::string, std::string>>&& rawData) {
+    RawWriteBatch batch(std::move(rawData));
+    ASSERT_FALSE(database.write(batch));
+  }
+
+  std::vector<std::string> iterate(const std::string& startKey, size_t limit = std::numeric_limits<size_t>::max()) {
+    std::vector<std::string> keys;
+    EXPECT_FALSE(database.iterate(startKey, [&keys, limit](const std::string& key, const std::string&) {
+      keys.push_back(key);
+      return keys.size() < limit;
+    }));
+
+    return keys;
+  }
+
+  Logging::ConsoleLogger logger;
+  boost::filesystem::path dir;
+  DataBaseConfig config;
+  RocksDBWrapper database;
+};
+
+void initConfig(DataBaseConfig& config, const std::vector<std::string>& args) {
+  boost::program_options::options_description desc;
+  DataBaseConfig::initOptions(desc);
+  command_line::add_arg(desc, command_line::arg_data_dir);
+
+  boost::program_options::variables_map vm;
+  boost::program_options::store(boost::program_options::command_line_parser(args).options(desc).run(), vm);
+  boost::program_options::notify(vm);
+  config.init(vm);
+}
+
+}
+
+TEST(DataBaseConfig, acceptsKnownCompression) {
+  DataBaseConfig config;
+  initConfig(config, {"--db-compression", "zstd"});
+  ASSERT_EQ("zstd", config.getCompression());
+}
+
+TEST(DataBaseConfig, rejectsUnknownCompression) {
+  DataBaseConfig config;
+  ASSERT_THROW(initConfig(config, {"--db-compression", "brotli"}), boost::program_options::validation_error);
+}
+
+TEST_F(RocksDBWrapperTests, recordsAreStoredInColumnFamilyOfTheirPrefix) {
+  database.init(config);
+  write({
+    {DB::BLOCK_INDEX_TO_KEY_IMAGE_PREFIX + "1", "a"},
+    {DB::BLOCK_INDEX_TO_RAW_BLOCK_PREFIX + "2", "b"},
+    {DB::KEY_IMAGE_TO_BLOCK_INDEX_PREFIX + "3", "c"},
+    {DB::TIMESTAMP_TO_BLOCKHASHES_PREFIX + "4", "d"},
+    {"version", "e"}
+  });
+
+  RawReadBatch batch({DB::BLOCK_INDEX_TO_KEY_IMAGE_PREFIX + "1", DB::BLOCK_INDEX_TO_RAW_BLOCK_PREFIX + "2", DB::KEY_IMAGE_TO_BLOCK_INDEX_PREFIX + "3",
+    DB::TIMESTAMP_TO_BLOCKHASHES_PREFIX + "4", "version", DB::KEY_OUTPUT_KEY_PREFIX + "5"});
+  ASSERT_FALSE(database.read(batch));
+  ASSERT_EQ(std::vector<bool>({true, true, true, true, true, false}), batch.resultStates);
+  ASSERT_EQ(std::vector<std::string>({"a", "b", "c", "d", "e", ""}), batch.values);
+  database.shutdown();
+
+  RawDataBase raw(getDataBasePath());
+  ASSERT_TRUE(raw.contains("blocks", DB::BLOCK_INDEX_TO_KEY_IMAGE_PREFIX + "1"));
+  ASSERT_TRUE(raw.contains("raw_blocks", DB::BLOCK_INDEX_TO_RAW_BLOCK_PREFIX + "2"));
+  ASSERT_TRUE(raw.contains("key_images", DB::KEY_IMAGE_TO_BLOCK_INDEX_PREFIX + "3"));
+  ASSERT_TRUE(raw.contains("timestamps", DB::TIMESTAMP_TO_BLOCKHASHES_PREFIX + "4"));
+  // keys with unlisted prefixes stay in the default column family
+  ASSERT_TRUE(raw.contains(rocksdb::kDefaultColumnFamilyName, "version"));
+  ASSERT_FALSE(raw.contains(rocksdb::kDefaultColumnFamilyName, DB::BLOCK_INDEX_TO_KEY_IMAGE_PREFIX + "1"));
+}
+
+TEST_F(RocksDBWrapperTests, iterateMergesColumnFamiliesInKeyOrder) {
+  database.init(config);
+  std::vector<std::string> keys = {
+    DB::TIMESTAMP_TO_BLOCKHASHES_PREFIX + "1", DB::BLOCK_INDEX_TO_KEY_IMAGE_PREFIX + "2", DB::KEY_OUTPUT_KEY_PREFIX + "1",
+    DB::BLOCK_INDEX_TO_RAW_BLOCK_PREFIX + "1", DB::BLOCK_INDEX_TO_KEY_IMAGE_PREFIX + "1", "version",
+    DB::TRANSACTION_HASH_TO_TRANSACTION_INFO_PREFIX + "1", DB::KEY_IMAGE_TO_BLOCK_INDEX_PREFIX + "1"
+  };
+
+  std::vector<std::pair<std::string, std::string>> records;
+  for (const auto& key : keys) {
+    records.emplace_back(key, "value");
+  }
+
+  write(std::move(records));
+  std::sort(keys.begin(), keys.end());
+
+  ASSERT_EQ(keys, iterate(""));
+
+  auto start = std::lower_bound(keys.begin(), keys.end(), DB::BLOCK_INDEX_TO_BLOCK_HASH_PREFIX);
+  ASSERT_EQ(std::vector<std::string>(start, keys.end()), iterate(DB::BLOCK_INDEX_TO_BLOCK_HASH_PREFIX));
+
+  ASSERT_EQ(std::vector<std::string>(keys.begin(), keys.begin() + 3), iterate("", 3));
+}
+
+TEST_F(RocksDBWrapperTests, legacyRecordsAreMovedToColumnFamilies) {
+  // more records than one move batch holds
+  const size_t RECORDS_COUNT = 25000;
+
+  {
+    rocksdb::Options options;
+    options.create_if_missing = true;
+    rocksdb::DB* dbPtr;
+    ASSERT_TRUE(rocksdb::DB::Open(options, getDataBasePath(), &dbPtr).ok());
+    std::unique_ptr<rocksdb::DB> legacy(dbPtr);
+
+    rocksdb::WriteBatch batch;
+    for (size_t i = 0; i < RECORDS_COUNT; ++i) {
+      batch.Put(DB::BLOCK_INDEX_TO_KEY_IMAGE_PREFIX + std::to_string(i), std::to_string(i));
+    }
+
+    batch.Put("version", "1");
+    ASSERT_TRUE(legacy->Write(rocksdb::WriteOptions(), &batch).ok());
+  }
+
+  database.init(config);
+
+  std::vector<std::string> rawKeys;
+  for (size_t i = 0; i < RECORDS_COUNT; i += 997) {
+    rawKeys.push_back(DB::BLOCK_INDEX_TO_KEY_IMAGE_PREFIX + std::to_string(i));
+  }
+
+  rawKeys.push_back("version");
+  RawReadBatch batch(std::move(rawKeys));
+  ASSERT_FALSE(database.read(batch));
+  ASSERT_TRUE(std::all_of(batch.resultStates.begin(), batch.resultStates.end(), [](bool found) { return found; }));
+  ASSERT_EQ("1", batch.values.back());
+  ASSERT_EQ(RECORDS_COUNT + 1, iterate("").size());
+  database.shutdown();
+
+  RawDataBase raw(getDataBasePath());
+  ASSERT_EQ(RECORDS_COUNT, raw.count("blocks"));
+  ASSERT_EQ(1, raw.count(rocksdb::kDefaultColumnFamilyName));
+}
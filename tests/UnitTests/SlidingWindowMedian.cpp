@@ -0,0 +1,94 @@
+// Copyright (c) 2012-2017, The CryptoNote developers, The Bytecoin developers
+//
+// This file is part of Bytecoin.
+//
+// Bytecoin is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Bytecoin is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with Bytecoin.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <deque>
+#include <limits>
+#include <random>
+
+#include "gtest/gtest.h"
+
+#include "Common/Math.h"
+#include "Common/SlidingWindowMedian.h"
+
+using namespace Common;
+
+namespace {
+
+void checkAgainstMedianValue(size_t windowSize, size_t valuesCount, uint64_t maxValue) {
+  std::mt19937_64 generator(windowSize * 31 + valuesCount);
+  std::uniform_int_distribution<uint64_t> distribution(0, maxValue);
+
+  SlidingWindowMedian<uint64_t> median(windowSize);
+  std::deque<uint64_t> window;
+  for (size_t i = 0; i < valuesCount; ++i) {
+    uint64_t value = distribution(generator);
+    median.push(value);
+    window.push_back(value);
+    if (window.size() > windowSize) {
+      window.pop_front();
+    }
+
+    std::vector<uint64_t> values(window.begin(), window.end());
+    ASSERT_EQ(window.size(), median.size());
+    ASSERT_EQ(medianValue(values), median.median()) << "after " << i + 1 << " values";
+  }
+}
+
+}
+
+TEST(SlidingWindowMedian, emptyWindowHasZeroMedian) {
+  SlidingWindowMedian<uint64_t> median(10);
+  ASSERT_EQ(0, median.median());
+}
+
+TEST(SlidingWindowMedian, evenCountAveragesMiddleValues) {
+  SlidingWindowMedian<uint64_t> median(4);
+  median.push(1);
+  median.push(10);
+  ASSERT_EQ(5, median.median());
+  median.push(3);
+  ASSERT_EQ(3, median.median());
+}
+
+TEST(SlidingWindowMedian, oldValuesLeaveWindow) {
+  SlidingWindowMedian<uint64_t> median(3);
+  median.push(100);
+  median.push(100);
+  median.push(1);
+  median.push(1);
+  ASSERT_EQ(3, median.size());
+  ASSERT_EQ(1, median.median());
+}
+
+TEST(SlidingWindowMedian, clearEmptiesWindow) {
+  SlidingWindowMedian<uint64_t> median(3);
+  median.push(5);
+  median.clear();
+  ASSERT_EQ(0, median.size());
+  median.push(7);
+  ASSERT_EQ(7, median.median());
+}
+
+TEST(SlidingWindowMedian, matchesMedianValueWithDistinctValues) {
+  checkAgainstMedianValue(100, 1000, std::numeric_limits<uint32_t>::max());
+}
+
+TEST(SlidingWindowMedian, matchesMedianValueWithRepeatedValues) {
+  checkAgainstMedianValue(60, 1000, 5);
+  checkAgainstMedianValue(1, 10, 5);
+  checkAgainstMedianValue(2, 100, 3);
+}
@@ -19,6 +19,8 @@
 
 #include "crypto/crypto.h"
 
+#include "Common/Math.h"
+
 #include "CryptoNoteCore/BlockchainCache.h"
 #include "CryptoNoteCore/CryptoNoteTools.h"
 #include "CryptoNoteCore/TransactionValidatiorState.h"
@@ -328,3 +330,101 @@ TEST_F(BlockchainCacheTests, checkIfSpentChain1) {
   BlockchainCache otherCache("cache", currency, logger, &blockCache);
   ASSERT_TRUE(otherCache.checkIfSpent(keyImage, 1));
 }
+
+TEST_F(BlockchainCacheTests, extractKeyOutputKeysBatchMatchesSingleRequests) {
+  const uint32_t SPLIT_HEIGHT = 4;
+  const size_t BLOCK_COUNT = 10;
+  std::vector<CachedTransaction> transactions;
+  TransactionValidatorState validatorState;
+  generator.generateEmptyBlocks(BLOCK_COUNT);
+  auto bcCopy = generator.getBlockchainCopy();
+  for (size_t i = 1; i < bcCopy.size(); ++i) { //Skip genesis block
+    const CachedBlock block(bcCopy.at(i));
+    ASSERT_NO_FATAL_FAILURE(blockCache.pushBlock(block, transactions, validatorState, 1, 1, 1, RawBlock()));
+  }
+
+  std::unique_ptr<IBlockchainCache> otherCache = blockCache.split(SPLIT_HEIGHT);
+
+  std::map<uint64_t, uint32_t> outputsByAmount;
+  for (const auto& block : bcCopy) {
+    for (const auto& output : block.baseTransaction.outputs) {
+      ++outputsByAmount[output.amount];
+    }
+  }
+
+  std::vector<KeyOutputKeysRequest> requests;
+  for (const auto& amountOutputs : outputsByAmount) {
+    KeyOutputKeysRequest request;
+    request.amount = amountOutputs.first;
+    for (uint32_t i = 0; i < amountOutputs.second; ++i) {
+      request.globalIndexes.push_back(i);
+    }
+
+    requests.push_back(std::move(request));
+  }
+
+  KeyOutputKeysRequest invalidRequest;
+  invalidRequest.amount = outputsByAmount.begin()->first;
+  invalidRequest.globalIndexes.push_back(outputsByAmount.begin()->second);
+  requests.push_back(invalidRequest);
+
+  const uint32_t blockIndex = static_cast<uint32_t>(bcCopy.size() - 1);
+  auto results = otherCache->extractKeyOutputKeys(blockIndex, requests);
+  ASSERT_EQ(requests.size(), results.size());
+  for (size_t i = 0; i < requests.size(); ++i) {
+    std::vector<Crypto::PublicKey> publicKeys;
+    auto result = otherCache->extractKeyOutputKeys(requests[i].amount, blockIndex,
+      {requests[i].globalIndexes.data(), requests[i].globalIndexes.size()}, publicKeys);
+    ASSERT_EQ(result, results[i].result);
+    if (result == ExtractOutputKeysResult::SUCCESS) {
+      ASSERT_EQ(publicKeys, results[i].publicKeys);
+    }
+  }
+
+  ASSERT_EQ(ExtractOutputKeysResult::INVALID_GLOBAL_INDEX, results.back().result);
+}
+
+TEST_F(BlockchainCacheTests, consensusWindowsMatchBlocksAfterSplit) {
+  const size_t BLOCK_COUNT = 250;
+  const uint32_t SPLIT_INDEX = 200;
+  const size_t UPPER_BLOCK_COUNT = 20;
+  std::vector<CachedTransaction> transactions;
+  TransactionValidatorState validatorState;
+  generator.generateEmptyBlocks(BLOCK_COUNT + UPPER_BLOCK_COUNT);
+  auto bcCopy = generator.getBlockchainCopy();
+
+  std::vector<uint64_t> sizes = blockCache.getLastBlocksSizes(1, 0, UseGenesis(true));
+  std::vector<uint64_t> timestamps = { bcCopy[0].timestamp };
+  auto pushBlock = [&] (IBlockchainCache& cache, size_t index) {
+    sizes.push_back(index * 7919 % 1000 + 1);
+    timestamps.push_back(bcCopy[index].timestamp);
+    cache.pushBlock(CachedBlock(bcCopy[index]), transactions, validatorState, sizes.back(), 1, 1, RawBlock());
+  };
+
+  for (size_t i = 1; i <= BLOCK_COUNT; ++i) {
+    pushBlock(blockCache, i);
+  }
+
+  std::unique_ptr<IBlockchainCache> upperCache = blockCache.split(SPLIT_INDEX);
+  for (size_t i = BLOCK_COUNT + 1; i < bcCopy.size(); ++i) {
+    pushBlock(*upperCache, i);
+  }
+
+  for (IBlockchainCache* cache : { static_cast<IBlockchainCache*>(&blockCache), upperCache.get() }) {
+    uint32_t topIndex = cache->getTopBlockIndex();
+    for (bool useGenesis : { true, false }) {
+      for (size_t count : { currency.timestampCheckWindow(), currency.rewardBlocksWindow(), currency.difficultyBlocksCount(), size_t(topIndex) + 2 }) {
+        size_t from = topIndex + 1 - std::min<size_t>(count, topIndex + 1);
+        if (!useGenesis && from == 0) {
+          from = 1;
+        }
+
+        std::vector<uint64_t> expectedSizes(sizes.begin() + from, sizes.begin() + topIndex + 1);
+        std::vector<uint64_t> expectedTimestamps(timestamps.begin() + from, timestamps.begin() + topIndex + 1);
+        ASSERT_EQ(expectedSizes, cache->getLastBlocksSizes(count, topIndex, UseGenesis(useGenesis)));
+        ASSERT_EQ(expectedTimestamps, cache->getLastTimestamps(count, topIndex, UseGenesis(useGenesis)));
+        ASSERT_EQ(Common::medianValue(expectedSizes), cache->getLastBlocksSizesMedian(count, topIndex, UseGenesis(useGenesis)));
+      }
+    }
+  }
+}
@@ -0,0 +1,467 @@
+// Copyright (c) 2012-2017, The CryptoNote developers, The Bytecoin developers
+//
+// This file is part of Bytecoin.
+//
+// Bytecoin is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Bytecoin is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with Bytecoin.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "gtest/gtest.h"
+
+#include <algorithm>
+#include <ctime>
+#include <limits>
+
+#include "CryptoNoteCore/Account.h"
+#include "CryptoNoteCore/Core.h"
+#include "CryptoNoteCore/CoreConfig.h"
+#include "CryptoNoteCore/CryptoNoteFormatUtils.h"
+#include "CryptoNoteCore/CryptoNoteTools.h"
+#include "CryptoNoteCore/DatabaseBlockchainCacheFactory.h"
+#include "CryptoNoteCore/IUpgradeDetector.h"
+#include "CryptoNoteCore/TransactionExtra.h"
+#include "Logging/FileLogger.h"
+#include "System/Dispatcher.h"
+#include "DataBaseMock.h"
+#include "../Common/VectorMainChainStorage.h"
+#include "../TestGenerator/TestGenerator.h"
+
+using namespace CryptoNote;
+
+namespace {
+
+CoreConfig makeCoreConfig(uint64_t transactionPoolMaxSize = 0) {
+  CoreConfig config;
+  // batches are prepared on the validation thread pool, which exists only with more than one thread
+  config.setValidationThreadsCount(2);
+  config.setTransactionPoolMaxSize(transactionPoolMaxSize);
+  return config;
+}
+
+RawBlock makeRawBlock(const BlockTemplate& block, const std::list<Transaction>& transactions = {}) {
+  RawBlock rawBlock{toBinaryArray(block), {}};
+  for (const auto& transaction : transactions) {
+    rawBlock.transactions.push_back(toBinaryArray(transaction));
+  }
+
+  return rawBlock;
+}
+
+std::vector<Crypto::Hash> sorted(std::vector<Crypto::Hash> hashes) {
+  std::sort(hashes.begin(), hashes.end(), [](const Crypto::Hash& left, const Crypto::Hash& right) {
+    return std::lexicographical_compare(std::begin(left.data), std::end(left.data), std::begin(right.data), std::end(right.data));
+  });
+
+  return hashes;
+}
+
+}
+
+class CoreTests : public ::testing::Test {
+public:
+  explicit CoreTests(const CoreConfig& coreConfig = makeCoreConfig()) :
+    // the generator makes version 1 blocks, the genesis block emits the default money supply, so it's raised to keep block rewards
+    currency(CurrencyBuilder(logger).upgradeHeightV2(IUpgradeDetector::UNDEF_HEIGHT).upgradeHeightV3(IUpgradeDetector::UNDEF_HEIGHT)
+      .moneySupply(std::numeric_limits<uint64_t>::max()).currency()),
+    core(currency, logger, Checkpoints(logger), dispatcher,
+         std::unique_ptr<IBlockchainCacheFactory>(new DatabaseBlockchainCacheFactory(database, logger)),
+         createVectorMainChainStorage(currency), coreConfig),
+    generator(currency) {
+    minerAccount.generate();
+    core.load();
+  }
+
+  BlockTemplate makeNextBlock(const BlockTemplate& previous, const std::list<Transaction>& transactions = {}) {
+    BlockTemplate block;
+    EXPECT_TRUE(generator.constructBlock(block, previous, minerAccount, transactions));
+    return block;
+  }
+
+  std::error_code addNextBlock(BlockTemplate& block, const BlockTemplate& previous, const std::list<Transaction>& transactions = {}) {
+    block = makeNextBlock(previous, transactions);
+    return core.addBlock(makeRawBlock(block, transactions));
+  }
+
+  // adds empty blocks on top of the main chain until miner transaction outputs of the first ones are unlocked
+  std::vector<BlockTemplate> addUnlockedBlocks(size_t count) {
+    std::vector<BlockTemplate> blocks{core.getBlockByIndex(core.getTopBlockIndex())};
+    for (size_t i = 0; i < count + currency.minedMoneyUnlockWindow(); ++i) {
+      BlockTemplate block;
+      EXPECT_EQ(error::AddBlockErrorCode::ADDED_TO_MAIN, addNextBlock(block, blocks.back()));
+      blocks.push_back(block);
+    }
+
+    return std::vector<BlockTemplate>(blocks.begin() + 1, blocks.begin() + 1 + count);
+  }
+
+  // spends the largest output of the main chain transaction back to the miner, so transactions from the same source conflict
+  Transaction makeTransaction(const Transaction& sourceTransaction, uint64_t fee) {
+    auto output = std::max_element(sourceTransaction.outputs.begin(), sourceTransaction.outputs.end(),
+      [](const TransactionOutput& left, const TransactionOutput& right) { return left.amount < right.amount; });
+    size_t outputIndex = std::distance(sourceTransaction.outputs.begin(), output);
+
+    std::vector<uint32_t> globalIndexes;
+    EXPECT_TRUE(core.getTransactionGlobalIndexes(getObjectHash(sourceTransaction), globalIndexes));
+
+    TransactionSourceEntry source;
+    source.outputs.emplace_back(globalIndexes.at(outputIndex), boost::get<KeyOutput>(output->target).key);
+    source.realOutput = 0;
+    source.realTransactionPublicKey = getTransactionPublicKeyFromExtra(sourceTransaction.extra);
+    source.realOutputIndexInTransaction = outputIndex;
+    source.amount = output->amount;
+
+    Transaction transaction;
+    EXPECT_TRUE(constructTransaction(minerAccount.getAccountKeys(), {source}, {{source.amount - fee, minerAccount.getAccountKeys().address}},
+      {}, transaction, 0, logger));
+    return transaction;
+  }
+
+  Transaction makeTransaction(const BlockTemplate& sourceBlock, uint64_t fee) {
+    return makeTransaction(sourceBlock.baseTransaction, fee);
+  }
+
+  bool addTransactionToPool(const Transaction& transaction) {
+    return core.addTransactionToPool(toBinaryArray(transaction));
+  }
+
+  std::vector<Crypto::Hash> getTemplateTransactions(const Core& templateCore) {
+    BlockTemplate block;
+    Difficulty difficulty;
+    uint32_t height;
+    EXPECT_TRUE(templateCore.getBlockTemplate(block, minerAccount.getAccountKeys().address, {}, difficulty, height));
+    return sorted(block.transactionHashes);
+  }
+
+  // a core with the same main chain and pool, which has never built a template
+  std::vector<Crypto::Hash> getFreshTemplateTransactions() {
+    DataBaseMock freshDatabase;
+    Core freshCore(currency, logger, Checkpoints(logger), dispatcher,
+                   std::unique_ptr<IBlockchainCacheFactory>(new DatabaseBlockchainCacheFactory(freshDatabase, logger)),
+                   createVectorMainChainStorage(currency), makeCoreConfig());
+    freshCore.load();
+
+    auto results = freshCore.addBlocks(core.getBlocks(1, core.getTopBlockIndex()));
+    EXPECT_EQ(core.getTopBlockIndex(), results.size());
+    EXPECT_EQ(core.getTopBlockHash(), freshCore.getTopBlockHash());
+    for (const auto& transaction : core.getPoolTransactions()) {
+      EXPECT_TRUE(freshCore.addTransactionToPool(toBinaryArray(transaction)));
+    }
+
+    return getTemplateTransactions(freshCore);
+  }
+
+  BlockTemplate makeBlockFromFuture(const BlockTemplate& previous) {
+    BlockTemplate block = makeNextBlock(previous);
+    block.timestamp = time(nullptr) + 2 * currency.blockFutureTimeLimit();
+    return block;
+  }
+
+  // the block references one transaction, its blob can't be parsed
+  RawBlock makeBlockWithMalformedTransaction(const BlockTemplate& previous) {
+    BlockTemplate block;
+    EXPECT_TRUE(generator.constructBlockManuallyTx(block, previous, minerAccount, {Crypto::rand<Crypto::Hash>()}, 0));
+    RawBlock rawBlock = makeRawBlock(block);
+    rawBlock.transactions.push_back(BinaryArray{0xff, 0xff, 0xff});
+    return rawBlock;
+  }
+
+  std::vector<CachedBlock> makeCachedBlocks(const std::vector<BlockTemplate>& blocks) {
+    return std::vector<CachedBlock>(blocks.begin(), blocks.end());
+  }
+
+  std::vector<RawBlock> makeRawBlocks(const std::vector<BlockTemplate>& blocks) {
+    std::vector<RawBlock> rawBlocks;
+    for (const auto& block : blocks) {
+      rawBlocks.push_back(makeRawBlock(block));
+    }
+
+    return rawBlocks;
+  }
+
+  Logging::FileLogger logger;
+  Currency currency;
+  System::Dispatcher dispatcher;
+  DataBaseMock database;
+  Core core;
+  test_generator generator;
+  AccountBase minerAccount;
+};
+
+class CoreTestsWithPoolLimit : public CoreTests {
+public:
+  // two transactions with one input and one output fit, a third one evicts the cheapest
+  static const uint64_t TRANSACTION_POOL_MAX_SIZE = 500;
+
+  CoreTestsWithPoolLimit() : CoreTests(makeCoreConfig(TRANSACTION_POOL_MAX_SIZE)) {
+  }
+};
+
+TEST_F(CoreTests, addBlocksAddsValidBatchInOrder) {
+  auto block1 = makeNextBlock(currency.genesisBlock());
+  auto block2 = makeNextBlock(block1);
+  auto block3 = makeNextBlock(block2);
+  std::vector<BlockTemplate> blocks{block1, block2, block3};
+
+  auto results = core.addBlocks(makeCachedBlocks(blocks), makeRawBlocks(blocks));
+
+  ASSERT_EQ(3, results.size());
+  for (const auto& result : results) {
+    ASSERT_EQ(error::AddBlockErrorCode::ADDED_TO_MAIN, result);
+  }
+
+  ASSERT_EQ(3, core.getTopBlockIndex());
+  ASSERT_EQ(CachedBlock(block3).getBlockHash(), core.getTopBlockHash());
+}
+
+TEST_F(CoreTests, addBlocksStopsAfterFirstRejectedBlock) {
+  auto block1 = makeNextBlock(currency.genesisBlock());
+  auto block2 = makeNextBlock(block1);
+  auto invalidBlock = makeBlockFromFuture(block2);
+  auto block3 = makeNextBlock(block2);
+  std::vector<BlockTemplate> blocks{block1, block2, invalidBlock, block3};
+
+  auto results = core.addBlocks(makeCachedBlocks(blocks), makeRawBlocks(blocks));
+
+  ASSERT_EQ(3, results.size());
+  ASSERT_EQ(error::AddBlockErrorCode::ADDED_TO_MAIN, results[0]);
+  ASSERT_EQ(error::AddBlockErrorCode::ADDED_TO_MAIN, results[1]);
+  ASSERT_EQ(error::BlockValidationError::TIMESTAMP_TOO_FAR_IN_FUTURE, results[2]);
+  ASSERT_EQ(2, core.getTopBlockIndex());
+  ASSERT_FALSE(core.hasBlock(CachedBlock(invalidBlock).getBlockHash()));
+  ASSERT_FALSE(core.hasBlock(CachedBlock(block3).getBlockHash()));
+}
+
+TEST_F(CoreTests, addBlocksRejectsBlockWithMalformedTransaction) {
+  auto block1 = makeNextBlock(currency.genesisBlock());
+  auto malformedBlock = makeBlockWithMalformedTransaction(block1);
+  auto block2 = makeNextBlock(block1);
+  std::vector<RawBlock> rawBlocks{makeRawBlock(block1), malformedBlock, makeRawBlock(block2)};
+
+  auto results = core.addBlocks(std::move(rawBlocks));
+
+  ASSERT_EQ(2, results.size());
+  ASSERT_EQ(error::AddBlockErrorCode::ADDED_TO_MAIN, results[0]);
+  ASSERT_EQ(error::AddBlockErrorCode::DESERIALIZATION_FAILED, results[1]);
+  ASSERT_EQ(1, core.getTopBlockIndex());
+  ASSERT_FALSE(core.hasBlock(CachedBlock(block2).getBlockHash()));
+}
+
+TEST_F(CoreTests, addBlocksReportsDeserializationFailureAtPositionOfMalformedBlock) {
+  auto block1 = makeNextBlock(currency.genesisBlock());
+  auto block2 = makeNextBlock(block1);
+  auto block3 = makeNextBlock(block2);
+  std::vector<RawBlock> rawBlocks{makeRawBlock(block1), makeRawBlock(block2), RawBlock{BinaryArray{0xff, 0xff}, {}}, makeRawBlock(block3)};
+
+  auto results = core.addBlocks(std::move(rawBlocks));
+
+  ASSERT_EQ(3, results.size());
+  ASSERT_EQ(error::AddBlockErrorCode::ADDED_TO_MAIN, results[0]);
+  ASSERT_EQ(error::AddBlockErrorCode::ADDED_TO_MAIN, results[1]);
+  ASSERT_EQ(error::AddBlockErrorCode::DESERIALIZATION_FAILED, results[2]);
+  ASSERT_EQ(2, core.getTopBlockIndex());
+  ASSERT_FALSE(core.hasBlock(CachedBlock(block3).getBlockHash()));
+}
+
+TEST_F(CoreTests, addBlocksReportsDeserializationFailureOfFirstBlock) {
+  auto block1 = makeNextBlock(currency.genesisBlock());
+  std::vector<RawBlock> rawBlocks{RawBlock{BinaryArray{0xff, 0xff}, {}}, makeRawBlock(block1)};
+
+  auto results = core.addBlocks(std::move(rawBlocks));
+
+  ASSERT_EQ(1, results.size());
+  ASSERT_EQ(error::AddBlockErrorCode::DESERIALIZATION_FAILED, results[0]);
+  ASSERT_EQ(0, core.getTopBlockIndex());
+}
+
+TEST_F(CoreTests, addBlocksDoesntReportDeserializationFailureAfterRejectedBlock) {
+  auto block1 = makeNextBlock(currency.genesisBlock());
+  auto invalidBlock = makeBlockFromFuture(block1);
+  std::vector<RawBlock> rawBlocks{makeRawBlock(block1), makeRawBlock(invalidBlock), RawBlock{BinaryArray{0xff, 0xff}, {}}};
+
+  auto results = core.addBlocks(std::move(rawBlocks));
+
+  ASSERT_EQ(2, results.size());
+  ASSERT_EQ(error::AddBlockErrorCode::ADDED_TO_MAIN, results[0]);
+  ASSERT_EQ(error::BlockValidationError::TIMESTAMP_TOO_FAR_IN_FUTURE, results[1]);
+  ASSERT_EQ(1, core.getTopBlockIndex());
+}
+
+TEST_F(CoreTests, cachedBlockTemplateMatchesFreshBuildAfterPoolAdd) {
+  auto sourceBlocks = addUnlockedBlocks(2);
+  ASSERT_TRUE(addTransactionToPool(makeTransaction(sourceBlocks[0], currency.minimumFee())));
+  ASSERT_EQ(1, getTemplateTransactions(core).size());
+
+  ASSERT_TRUE(addTransactionToPool(makeTransaction(sourceBlocks[1], currency.minimumFee())));
+  auto statistics = core.getBlockTemplateCacheStatistics();
+  auto cachedTransactions = getTemplateTransactions(core);
+
+  ASSERT_EQ(statistics.rebuilds, core.getBlockTemplateCacheStatistics().rebuilds);
+  ASSERT_EQ(2, cachedTransactions.size());
+  ASSERT_EQ(getFreshTemplateTransactions(), cachedTransactions);
+}
+
+TEST_F(CoreTestsWithPoolLimit, cachedBlockTemplateMatchesFreshBuildAfterPoolRemoval) {
+  auto sourceBlocks = addUnlockedBlocks(3);
+  auto cheapTransaction = makeTransaction(sourceBlocks[0], currency.minimumFee());
+  ASSERT_TRUE(addTransactionToPool(cheapTransaction));
+  ASSERT_TRUE(addTransactionToPool(makeTransaction(sourceBlocks[1], 2 * currency.minimumFee())));
+  ASSERT_EQ(2, getTemplateTransactions(core).size());
+
+  ASSERT_TRUE(addTransactionToPool(makeTransaction(sourceBlocks[2], 3 * currency.minimumFee())));
+  ASSERT_EQ(2, core.getPoolTransactionCount());
+  auto cachedTransactions = getTemplateTransactions(core);
+
+  ASSERT_EQ(2, cachedTransactions.size());
+  ASSERT_EQ(0, std::count(cachedTransactions.begin(), cachedTransactions.end(), getObjectHash(cheapTransaction)));
+  ASSERT_EQ(getFreshTemplateTransactions(), cachedTransactions);
+}
+
+TEST_F(CoreTests, cachedBlockTemplateMatchesFreshBuildAfterBlockPush) {
+  auto sourceBlocks = addUnlockedBlocks(2);
+  auto minedTransaction = makeTransaction(sourceBlocks[0], currency.minimumFee());
+  ASSERT_TRUE(addTransactionToPool(minedTransaction));
+  ASSERT_TRUE(addTransactionToPool(makeTransaction(sourceBlocks[1], currency.minimumFee())));
+  ASSERT_EQ(2, getTemplateTransactions(core).size());
+
+  BlockTemplate block;
+  ASSERT_EQ(error::AddBlockErrorCode::ADDED_TO_MAIN, addNextBlock(block, core.getBlockByIndex(core.getTopBlockIndex()), {minedTransaction}));
+  auto cachedTransactions = getTemplateTransactions(core);
+
+  ASSERT_EQ(1, cachedTransactions.size());
+  ASSERT_EQ(getFreshTemplateTransactions(), cachedTransactions);
+}
+
+TEST_F(CoreTests, cachedBlockTemplateMatchesFreshBuildAfterReorganization) {
+  auto sourceBlocks = addUnlockedBlocks(2);
+  auto minedTransaction = makeTransaction(sourceBlocks[0], currency.minimumFee());
+  ASSERT_TRUE(addTransactionToPool(minedTransaction));
+  ASSERT_TRUE(addTransactionToPool(makeTransaction(sourceBlocks[1], currency.minimumFee())));
+  ASSERT_EQ(2, getTemplateTransactions(core).size());
+
+  auto splitBlock = core.getBlockByIndex(core.getTopBlockIndex() - 1);
+  BlockTemplate alternativeBlock1;
+  BlockTemplate alternativeBlock2;
+  ASSERT_EQ(error::AddBlockErrorCode::ADDED_TO_ALTERNATIVE, addNextBlock(alternativeBlock1, splitBlock, {minedTransaction}));
+  ASSERT_EQ(error::AddBlockErrorCode::ADDED_TO_ALTERNATIVE_AND_SWITCHED, addNextBlock(alternativeBlock2, alternativeBlock1));
+  auto cachedTransactions = getTemplateTransactions(core);
+
+  ASSERT_EQ(1, cachedTransactions.size());
+  ASSERT_EQ(getFreshTemplateTransactions(), cachedTransactions);
+}
+
+TEST_F(CoreTests, chainSwitchReturnsTransactionsOfDetachedBlocksToPool) {
+  auto sourceBlocks = addUnlockedBlocks(1);
+  auto transaction = makeTransaction(sourceBlocks[0], currency.minimumFee());
+  auto splitBlock = core.getBlockByIndex(core.getTopBlockIndex());
+  BlockTemplate detachedBlock;
+  ASSERT_EQ(error::AddBlockErrorCode::ADDED_TO_MAIN, addNextBlock(detachedBlock, splitBlock, {transaction}));
+  ASSERT_EQ(0, core.getPoolTransactionCount());
+
+  BlockTemplate alternativeBlock1;
+  BlockTemplate alternativeBlock2;
+  ASSERT_EQ(error::AddBlockErrorCode::ADDED_TO_ALTERNATIVE, addNextBlock(alternativeBlock1, splitBlock));
+  ASSERT_EQ(error::AddBlockErrorCode::ADDED_TO_ALTERNATIVE_AND_SWITCHED, addNextBlock(alternativeBlock2, alternativeBlock1));
+
+  ASSERT_EQ(std::vector<Crypto::Hash>{getObjectHash(transaction)}, core.getPoolTransactionHashes());
+}
+
+TEST_F(CoreTests, chainSwitchEvictsPoolTransactionsDoubleSpentByNewChain) {
+  auto sourceBlocks = addUnlockedBlocks(2);
+  auto poolTransaction = makeTransaction(sourceBlocks[0], currency.minimumFee());
+  auto doubleSpendingTransaction = makeTransaction(sourceBlocks[0], 2 * currency.minimumFee());
+  auto keptTransaction = makeTransaction(sourceBlocks[1], currency.minimumFee());
+  ASSERT_TRUE(addTransactionToPool(poolTransaction));
+  ASSERT_TRUE(addTransactionToPool(keptTransaction));
+
+  auto splitBlock = core.getBlockByIndex(core.getTopBlockIndex());
+  BlockTemplate detachedBlock;
+  ASSERT_EQ(error::AddBlockErrorCode::ADDED_TO_MAIN, addNextBlock(detachedBlock, splitBlock));
+
+  BlockTemplate alternativeBlock1;
+  BlockTemplate alternativeBlock2;
+  ASSERT_EQ(error::AddBlockErrorCode::ADDED_TO_ALTERNATIVE, addNextBlock(alternativeBlock1, splitBlock, {doubleSpendingTransaction}));
+  ASSERT_EQ(error::AddBlockErrorCode::ADDED_TO_ALTERNATIVE_AND_SWITCHED, addNextBlock(alternativeBlock2, alternativeBlock1));
+
+  ASSERT_EQ(std::vector<Crypto::Hash>{getObjectHash(keptTransaction)}, core.getPoolTransactionHashes());
+}
+
+TEST_F(CoreTests, chainSwitchEvictsPoolTransactionsSpendingOutputsOfDetachedBlocks) {
+  auto sourceBlocks = addUnlockedBlocks(1);
+  auto detachedTransaction = makeTransaction(sourceBlocks[0], currency.minimumFee());
+  auto splitBlock = core.getBlockByIndex(core.getTopBlockIndex());
+  BlockTemplate detachedBlock;
+  ASSERT_EQ(error::AddBlockErrorCode::ADDED_TO_MAIN, addNextBlock(detachedBlock, splitBlock, {detachedTransaction}));
+
+  auto poolTransaction = makeTransaction(detachedTransaction, currency.minimumFee());
+  ASSERT_TRUE(addTransactionToPool(poolTransaction));
+
+  BlockTemplate alternativeBlock1;
+  BlockTemplate alternativeBlock2;
+  ASSERT_EQ(error::AddBlockErrorCode::ADDED_TO_ALTERNATIVE, addNextBlock(alternativeBlock1, splitBlock));
+  ASSERT_EQ(error::AddBlockErrorCode::ADDED_TO_ALTERNATIVE_AND_SWITCHED, addNextBlock(alternativeBlock2, alternativeBlock1));
+
+  // the detached transaction itself is still valid and goes back to the pool
+  ASSERT_EQ(std::vector<Crypto::Hash>{getObjectHash(detachedTransaction)}, core.getPoolTransactionHashes());
+}
+
+TEST_F(CoreTests, chainSwitchToSplitChainEvictsPoolTransactionsSpendingReplacedOutputs) {
+  auto sourceBlocks = addUnlockedBlocks(3);
+  auto largestOutputAmount = [](const BlockTemplate& block) {
+    uint64_t amount = 0;
+    for (const auto& output : block.baseTransaction.outputs) {
+      amount = std::max(amount, output.amount);
+    }
+
+    return amount;
+  };
+
+  // transactions creating outputs of one amount, so the same global indexes get different keys in each chain
+  uint64_t amount = std::min({largestOutputAmount(sourceBlocks[0]), largestOutputAmount(sourceBlocks[1]), largestOutputAmount(sourceBlocks[2])}) -
+    currency.minimumFee();
+  auto detachedTransaction = makeTransaction(sourceBlocks[0], largestOutputAmount(sourceBlocks[0]) - amount);
+  auto replacingTransaction = makeTransaction(sourceBlocks[1], largestOutputAmount(sourceBlocks[1]) - amount);
+  auto leafTransaction = makeTransaction(sourceBlocks[2], largestOutputAmount(sourceBlocks[2]) - amount);
+
+  auto splitBlock = core.getBlockByIndex(core.getTopBlockIndex());
+  BlockTemplate detachedBlock1;
+  BlockTemplate detachedBlock2;
+  ASSERT_EQ(error::AddBlockErrorCode::ADDED_TO_MAIN, addNextBlock(detachedBlock1, splitBlock, {detachedTransaction}));
+  ASSERT_EQ(error::AddBlockErrorCode::ADDED_TO_MAIN, addNextBlock(detachedBlock2, detachedBlock1));
+
+  auto poolTransaction = makeTransaction(detachedTransaction, currency.minimumFee());
+  ASSERT_TRUE(addTransactionToPool(poolTransaction));
+
+  // the alternative chain is split above the fork, the new main chain has two segments there
+  BlockTemplate alternativeBlock1;
+  BlockTemplate alternativeBlock2;
+  BlockTemplate leafBlock2;
+  BlockTemplate leafBlock3;
+  ASSERT_EQ(error::AddBlockErrorCode::ADDED_TO_ALTERNATIVE, addNextBlock(alternativeBlock1, splitBlock, {replacingTransaction}));
+  ASSERT_EQ(error::AddBlockErrorCode::ADDED_TO_ALTERNATIVE, addNextBlock(alternativeBlock2, alternativeBlock1));
+  ASSERT_EQ(error::AddBlockErrorCode::ADDED_TO_ALTERNATIVE, addNextBlock(leafBlock2, alternativeBlock1, {leafTransaction}));
+  ASSERT_EQ(error::AddBlockErrorCode::ADDED_TO_ALTERNATIVE_AND_SWITCHED, addNextBlock(leafBlock3, leafBlock2));
+
+  ASSERT_EQ(std::vector<Crypto::Hash>{getObjectHash(detachedTransaction)}, core.getPoolTransactionHashes());
+}
+
+TEST_F(CoreTests, blockWithInvalidRingSignatureIsRejectedByValidationThreadPool) {
+  auto sourceBlocks = addUnlockedBlocks(2);
+  auto validTransaction = makeTransaction(sourceBlocks[0], currency.minimumFee());
+  auto invalidTransaction = makeTransaction(sourceBlocks[1], currency.minimumFee());
+  invalidTransaction.signatures[0][0].data[0] ^= 1;
+
+  auto topBlockIndex = core.getTopBlockIndex();
+  BlockTemplate block;
+  ASSERT_EQ(error::TransactionValidationError::INPUT_INVALID_SIGNATURES,
+    addNextBlock(block, core.getBlockByIndex(topBlockIndex), {validTransaction, invalidTransaction}));
+  ASSERT_EQ(topBlockIndex, core.getTopBlockIndex());
+}
@@ -15,6 +15,11 @@
 // You should have received a copy of the GNU Lesser General Public License
 // along with Bytecoin.  If not, see <http://www.gnu.org/licenses/>.
 
+#include <algorithm>
+#include <set>
+
+#include <boost/filesystem/operations.hpp>
+
 #include "gtest/gtest.h"
 
 #include "crypto/crypto.h"
@@ -25,6 +30,7 @@
 #include "CryptoNoteCore/TransactionValidatiorState.h"
 #include "DataBaseMock.h"
 #include <CryptoNoteCore/DBUtils.h>
+#include "CryptoNoteCore/MainChainSnapshot.h"
 #include "CryptoNoteCore/MemoryBlockchainCacheFactory.h"
 #include "Logging/FileLogger.h"
 #include "TestBlockchainGenerator.h"
@@ -42,6 +48,32 @@ Hash randomBlockHash() {
   return hash;
 }
 
+class TestMainChainStorage: public IMainChainStorage {
+public:
+  virtual void pushBlock(const RawBlock& rawBlock) override {
+    blocks.push_back(rawBlock);
+  }
+
+  virtual void popBlock() override {
+    blocks.pop_back();
+  }
+
+  virtual RawBlock getBlockByIndex(uint32_t index) const override {
+    return blocks.at(index);
+  }
+
+  virtual uint32_t getBlockCount() const override {
+    return static_cast<uint32_t>(blocks.size());
+  }
+
+  virtual void clear() override {
+    blocks.clear();
+  }
+
+private:
+  std::vector<RawBlock> blocks;
+};
+
 class DatabaseBlockchainCacheTests : public ::testing::Test {
 public:
   DatabaseBlockchainCacheTests()
@@ -74,6 +106,33 @@ public:
     return cnt;
   }
 
+  void pushBlockWithOutputs(uint64_t amount, size_t outputsCount, uint64_t unlockTime) {
+    pushBlockWithOutputs(blockchain, amount, outputsCount, unlockTime);
+  }
+
+  BlockTemplate pushBlockWithOutputs(DatabaseBlockchainCache& blockchain, uint64_t amount, size_t outputsCount, uint64_t unlockTime,
+                                     IMainChainStorage* storage = nullptr) {
+    BlockTemplate block;
+    block.majorVersion = BLOCK_MAJOR_VERSION_1;
+    block.minorVersion = BLOCK_MINOR_VERSION_0;
+    block.timestamp = blockchain.getTopBlockIndex() + 1;
+    block.previousBlockHash = blockchain.getTopBlockHash();
+    block.baseTransaction.version = CURRENT_TRANSACTION_VERSION;
+    block.baseTransaction.unlockTime = unlockTime;
+    block.baseTransaction.inputs.push_back(BaseInput{blockchain.getTopBlockIndex() + 1});
+    for (size_t i = 0; i < outputsCount; ++i) {
+      block.baseTransaction.outputs.push_back(TransactionOutput{amount, KeyOutput{Crypto::rand<PublicKey>()}});
+    }
+
+    if (storage != nullptr) {
+      storage->pushBlock({ toBinaryArray(block), {} });
+    }
+
+    TransactionValidatorState state;
+    blockchain.pushBlock(CachedBlock{block}, {}, state, 1, 1, 1, { toBinaryArray(block), {} });
+    return block;
+  }
+
   Currency currency;
   DataBaseMock database;
   Logging::FileLogger logger;
@@ -186,3 +245,354 @@ TEST_F(DatabaseBlockchainCacheTests, RawBlocksWithTxsSerialization) {
   ASSERT_EQ(deserializedRawBlock.block, rawBlock.block);
   ASSERT_EQ(deserializedRawBlock.transactions, rawBlock.transactions);
 }
+
+TEST_F(DatabaseBlockchainCacheTests, CheckIfSpentFindsKeyImageOfPushedBlock) {
+  KeyImage keyImage = Crypto::rand<KeyImage>();
+  TransactionValidatorState state;
+  state.spentKeyImages.insert(keyImage);
+
+  generator.generateEmptyBlocks(1);
+  const auto& block = generator.getBlockchain().back();
+  blockchain.pushBlock(CachedBlock{block}, {}, state, 0, 0, 0, { toBinaryArray(block), {} });
+
+  ASSERT_TRUE(blockchain.checkIfSpent(keyImage));
+  ASSERT_FALSE(blockchain.checkIfSpent(keyImage, blockchain.getTopBlockIndex() - 1));
+  ASSERT_FALSE(blockchain.checkIfSpent(Crypto::rand<KeyImage>()));
+}
+
+TEST_F(DatabaseBlockchainCacheTests, CheckIfSpentFindsKeyImageAfterReopen) {
+  KeyImage keyImage = Crypto::rand<KeyImage>();
+  TransactionValidatorState state;
+  state.spentKeyImages.insert(keyImage);
+
+  generator.generateEmptyBlocks(1);
+  const auto& block = generator.getBlockchain().back();
+  blockchain.pushBlock(CachedBlock{block}, {}, state, 0, 0, 0, { toBinaryArray(block), {} });
+
+  DatabaseBlockchainCache reopened(currency, database, blockchainCacheFactory, logger);
+  ASSERT_TRUE(reopened.checkIfSpent(keyImage));
+}
+
+TEST_F(DatabaseBlockchainCacheTests, CheckIfSpentDoesNotFindKeyImageAfterSplit) {
+  KeyImage keyImage = Crypto::rand<KeyImage>();
+  TransactionValidatorState state;
+  state.spentKeyImages.insert(keyImage);
+
+  DataBaseMock localDatabase;
+  DatabaseBlockchainCache local(currency, localDatabase, blockchainCacheFactory, logger);
+  TestBlockchainGenerator localGenerator(currency);
+  localGenerator.generateEmptyBlocks(1);
+  const auto& blocks = localGenerator.getBlockchain();
+  for (size_t i = 1; i < blocks.size(); ++i) { //Skip genesis block
+    TransactionValidatorState blockState = i + 1 == blocks.size() ? state : TransactionValidatorState();
+    local.pushBlock(CachedBlock{blocks[i]}, {}, blockState, 1, 1, 1, { toBinaryArray(blocks[i]), {} });
+  }
+
+  auto child = local.split(local.getTopBlockIndex());
+  ASSERT_FALSE(local.checkIfSpent(keyImage));
+  ASSERT_TRUE(child->checkIfSpent(keyImage));
+}
+
+TEST_F(DatabaseBlockchainCacheTests, GetRandomOutsByAmountReturnsOnlySpendableOutputs) {
+  const uint64_t AMOUNT = 7777;
+  const uint64_t LOCKED_UNTIL_BLOCK = 1000000;
+
+  pushBlockWithOutputs(AMOUNT, 5, 0);                  // global indexes 0..4
+  pushBlockWithOutputs(AMOUNT, 5, LOCKED_UNTIL_BLOCK); // 5..9, locked
+  uint32_t startBlockIndex = blockchain.getTopBlockIndex();
+  pushBlockWithOutputs(AMOUNT, 5, 0);                  // 10..14
+  for (uint32_t i = 0; i < currency.minedMoneyUnlockWindow(); ++i) {
+    pushBlockWithOutputs(AMOUNT, 0, 0);
+  }
+
+  pushBlockWithOutputs(AMOUNT, 5, 0);                  // 15..19, too young
+
+  auto outs = blockchain.getRandomOutsByAmount(AMOUNT, 20, blockchain.getTopBlockIndex());
+  std::sort(outs.begin(), outs.end());
+  ASSERT_EQ((std::vector<uint32_t>{0, 1, 2, 3, 4, 10, 11, 12, 13, 14}), outs);
+
+  outs = blockchain.getRandomOutsByAmount(AMOUNT, 20, blockchain.getTopBlockIndex(), startBlockIndex);
+  std::sort(outs.begin(), outs.end());
+  ASSERT_EQ((std::vector<uint32_t>{10, 11, 12, 13, 14}), outs);
+}
+
+TEST_F(DatabaseBlockchainCacheTests, GetRandomOutsByAmountPicksOutputsUniformly) {
+  const uint64_t AMOUNT = 7777;
+  const size_t OUTPUTS_COUNT = 20;
+  const size_t PICK_COUNT = 5;
+  const size_t ROUNDS = 2000;
+
+  pushBlockWithOutputs(AMOUNT, OUTPUTS_COUNT / 2, 0);
+  pushBlockWithOutputs(AMOUNT, OUTPUTS_COUNT / 2, 1000000); // every other candidate is filtered out
+  pushBlockWithOutputs(AMOUNT, OUTPUTS_COUNT / 2, 0);
+  for (uint32_t i = 0; i < currency.minedMoneyUnlockWindow(); ++i) {
+    pushBlockWithOutputs(AMOUNT, 0, 0);
+  }
+
+  std::vector<size_t> hits(OUTPUTS_COUNT * 3 / 2, 0);
+  for (size_t round = 0; round < ROUNDS; ++round) {
+    auto outs = blockchain.getRandomOutsByAmount(AMOUNT, PICK_COUNT, blockchain.getTopBlockIndex());
+    ASSERT_EQ(PICK_COUNT, outs.size());
+    ASSERT_EQ(PICK_COUNT, std::set<uint32_t>(outs.begin(), outs.end()).size());
+    for (auto globalIndex : outs) {
+      ASSERT_LT(globalIndex, hits.size());
+      ++hits[globalIndex];
+    }
+  }
+
+  const size_t expectedHits = ROUNDS * PICK_COUNT / OUTPUTS_COUNT;
+  for (size_t globalIndex = 0; globalIndex < hits.size(); ++globalIndex) {
+    if (globalIndex >= OUTPUTS_COUNT / 2 && globalIndex < OUTPUTS_COUNT) {
+      ASSERT_EQ(0, hits[globalIndex]);
+    } else {
+      ASSERT_GT(hits[globalIndex], expectedHits * 3 / 4) << "output " << globalIndex;
+      ASSERT_LT(hits[globalIndex], expectedHits * 5 / 4) << "output " << globalIndex;
+    }
+  }
+}
+
+TEST_F(DatabaseBlockchainCacheTests, KeyOutputsIndexAnswersAsDatabase) {
+  const uint64_t AMOUNT = 7777;
+  const uint64_t LOCKED_UNTIL_BLOCK = 1000000;
+
+  pushBlockWithOutputs(AMOUNT, 5, 0);                  // global indexes 0..4
+  pushBlockWithOutputs(AMOUNT, 5, LOCKED_UNTIL_BLOCK); // 5..9, locked
+  for (uint32_t i = 0; i < currency.minedMoneyUnlockWindow(); ++i) {
+    pushBlockWithOutputs(AMOUNT, 0, 0);
+  }
+
+  DatabaseBlockchainCache indexed(currency, database, blockchainCacheFactory, logger, "", 1024 * 1024);
+  uint32_t topBlockIndex = blockchain.getTopBlockIndex();
+
+  std::vector<uint32_t> unlockedIndexes{4, 0, 2, 2};
+  std::vector<PublicKey> expectedKeys;
+  std::vector<PublicKey> keys;
+  ASSERT_EQ(ExtractOutputKeysResult::SUCCESS, blockchain.extractKeyOutputKeys(AMOUNT, topBlockIndex, {unlockedIndexes.data(), unlockedIndexes.size()}, expectedKeys));
+  ASSERT_EQ(ExtractOutputKeysResult::SUCCESS, indexed.extractKeyOutputKeys(AMOUNT, topBlockIndex, {unlockedIndexes.data(), unlockedIndexes.size()}, keys));
+  ASSERT_EQ(3, keys.size());
+  ASSERT_EQ(expectedKeys, keys);
+
+  std::vector<uint32_t> lockedIndexes{1, 6};
+  keys.clear();
+  ASSERT_EQ(ExtractOutputKeysResult::OUTPUT_LOCKED, indexed.extractKeyOutputKeys(AMOUNT, topBlockIndex, {lockedIndexes.data(), lockedIndexes.size()}, keys));
+
+  auto batched = indexed.extractKeyOutputKeys(topBlockIndex, {KeyOutputKeysRequest{AMOUNT, unlockedIndexes}, KeyOutputKeysRequest{AMOUNT, lockedIndexes}});
+  ASSERT_EQ(2, batched.size());
+  ASSERT_EQ(ExtractOutputKeysResult::SUCCESS, batched[0].result);
+  ASSERT_EQ(expectedKeys, batched[0].publicKeys);
+  ASSERT_EQ(ExtractOutputKeysResult::OUTPUT_LOCKED, batched[1].result);
+
+  std::vector<uint32_t> allIndexes{0, 3, 5, 9};
+  std::vector<PackedOutIndex> expectedPackedOuts;
+  std::vector<PackedOutIndex> packedOuts;
+  ASSERT_EQ(ExtractOutputKeysResult::SUCCESS, blockchain.extractKeyOtputIndexes(AMOUNT, {allIndexes.data(), allIndexes.size()}, expectedPackedOuts));
+  ASSERT_EQ(ExtractOutputKeysResult::SUCCESS, indexed.extractKeyOtputIndexes(AMOUNT, {allIndexes.data(), allIndexes.size()}, packedOuts));
+  ASSERT_EQ(expectedPackedOuts.size(), packedOuts.size());
+  for (size_t i = 0; i < packedOuts.size(); ++i) {
+    ASSERT_EQ(expectedPackedOuts[i].packedValue, packedOuts[i].packedValue);
+  }
+
+  std::vector<uint32_t> missingIndexes{10};
+  ASSERT_EQ(ExtractOutputKeysResult::INVALID_GLOBAL_INDEX, indexed.extractKeyOtputIndexes(AMOUNT, {missingIndexes.data(), missingIndexes.size()}, packedOuts));
+
+  for (uint32_t blockIndex = 0; blockIndex <= topBlockIndex + 1; ++blockIndex) {
+    ASSERT_EQ(blockchain.getKeyOutputsCountForAmount(AMOUNT, blockIndex), indexed.getKeyOutputsCountForAmount(AMOUNT, blockIndex));
+  }
+
+  auto outs = indexed.getRandomOutsByAmount(AMOUNT, 20, topBlockIndex);
+  std::sort(outs.begin(), outs.end());
+  ASSERT_EQ((std::vector<uint32_t>{0, 1, 2, 3, 4}), outs);
+}
+
+TEST_F(DatabaseBlockchainCacheTests, KeyOutputsIndexFollowsPushAndSplit) {
+  const uint64_t AMOUNT = 7777;
+
+  pushBlockWithOutputs(AMOUNT, 5, 0);
+  DatabaseBlockchainCache indexed(currency, database, blockchainCacheFactory, logger, "", 1024 * 1024);
+  pushBlockWithOutputs(indexed, AMOUNT, 3, 0);
+  pushBlockWithOutputs(indexed, AMOUNT, 4, 0);
+  ASSERT_EQ(12, indexed.getKeyOutputsCountForAmount(AMOUNT, indexed.getTopBlockIndex() + 1));
+
+  auto child = indexed.split(indexed.getTopBlockIndex());
+  ASSERT_EQ(8, indexed.getKeyOutputsCountForAmount(AMOUNT, indexed.getTopBlockIndex() + 1));
+  std::vector<PackedOutIndex> packedOuts;
+  std::vector<uint32_t> splitIndexes{8};
+  ASSERT_EQ(ExtractOutputKeysResult::INVALID_GLOBAL_INDEX, indexed.extractKeyOtputIndexes(AMOUNT, {splitIndexes.data(), splitIndexes.size()}, packedOuts));
+
+  pushBlockWithOutputs(indexed, AMOUNT, 2, 0);
+
+  DatabaseBlockchainCache reopened(currency, database, blockchainCacheFactory, logger);
+  std::vector<uint32_t> allIndexes(10);
+  for (uint32_t i = 0; i < allIndexes.size(); ++i) {
+    allIndexes[i] = i;
+  }
+
+  std::vector<PublicKey> expectedKeys;
+  std::vector<PublicKey> keys;
+  ASSERT_EQ(ExtractOutputKeysResult::SUCCESS, reopened.extractKeyOutputKeys(AMOUNT, reopened.getTopBlockIndex(), {allIndexes.data(), allIndexes.size()}, expectedKeys));
+  ASSERT_EQ(ExtractOutputKeysResult::SUCCESS, indexed.extractKeyOutputKeys(AMOUNT, indexed.getTopBlockIndex(), {allIndexes.data(), allIndexes.size()}, keys));
+  ASSERT_EQ(10, keys.size());
+  ASSERT_EQ(expectedKeys, keys);
+}
+
+TEST_F(DatabaseBlockchainCacheTests, KeyOutputsIndexIsSavedAndLoaded) {
+  const uint64_t AMOUNT = 7777;
+  auto path = (boost::filesystem::temp_directory_path() / boost::filesystem::unique_path("keyoutputs_%%%%%%%%%%%%.bin")).string();
+
+  pushBlockWithOutputs(AMOUNT, 5, 0);
+  std::vector<uint32_t> indexes{0, 1, 2, 3, 4};
+  std::vector<PublicKey> expectedKeys;
+  {
+    DatabaseBlockchainCache indexed(currency, database, blockchainCacheFactory, logger, path, 1024 * 1024);
+    ASSERT_EQ(ExtractOutputKeysResult::SUCCESS, indexed.extractKeyOutputKeys(AMOUNT, indexed.getTopBlockIndex(), {indexes.data(), indexes.size()}, expectedKeys));
+    indexed.save();
+  }
+
+  ASSERT_TRUE(boost::filesystem::exists(path));
+
+  DatabaseBlockchainCache loaded(currency, database, blockchainCacheFactory, logger, path, 1024 * 1024);
+  std::vector<PublicKey> keys;
+  ASSERT_EQ(ExtractOutputKeysResult::SUCCESS, loaded.extractKeyOutputKeys(AMOUNT, loaded.getTopBlockIndex(), {indexes.data(), indexes.size()}, keys));
+  ASSERT_EQ(expectedKeys, keys);
+
+  boost::system::error_code ignoredErrorCode;
+  boost::filesystem::remove(path, ignoredErrorCode);
+}
+
+TEST_F(DatabaseBlockchainCacheTests, RawBlocksAreReadFromMainChainStorage) {
+  const uint64_t AMOUNT = 7777;
+
+  DataBaseMock indexesDatabase;
+  TestMainChainStorage storage;
+  storage.pushBlock({toBinaryArray(currency.genesisBlock()), {}});
+  DatabaseBlockchainCache indexes(currency, indexesDatabase, blockchainCacheFactory, logger, "", 0, &storage);
+  ASSERT_FALSE(indexes.keepsRawBlocks());
+
+  pushBlockWithOutputs(indexes, AMOUNT, 2, 0, &storage);
+  auto block = pushBlockWithOutputs(indexes, AMOUNT, 3, 0, &storage);
+  ASSERT_TRUE(indexesDatabase.blocks().empty());
+  ASSERT_EQ(toBinaryArray(block), indexes.getBlockByIndex(2).block);
+
+  auto baseTransactionHash = CachedTransaction(block.baseTransaction).getTransactionHash();
+  auto transactions = indexes.getRawTransactions({baseTransactionHash});
+  ASSERT_EQ(1, transactions.size());
+  ASSERT_EQ(toBinaryArray(block.baseTransaction), transactions[0]);
+
+  auto child = indexes.split(2);
+  ASSERT_EQ(1, indexes.getTopBlockIndex());
+  ASSERT_EQ(toBinaryArray(block), child->getBlockByIndex(2).block);
+  ASSERT_TRUE(child->keepsRawBlocks());
+}
+
+TEST_F(DatabaseBlockchainCacheTests, RawBlocksLocationMismatchRequiresNewDatabase) {
+  DataBaseMock indexesDatabase;
+  ASSERT_TRUE(DatabaseBlockchainCache::checkRawBlocksLocation(indexesDatabase, logger, true));
+
+  TestMainChainStorage storage;
+  storage.pushBlock({toBinaryArray(currency.genesisBlock()), {}});
+  DatabaseBlockchainCache indexes(currency, indexesDatabase, blockchainCacheFactory, logger, "", 0, &storage);
+
+  ASSERT_TRUE(DatabaseBlockchainCache::checkRawBlocksLocation(indexesDatabase, logger, true));
+  ASSERT_FALSE(DatabaseBlockchainCache::checkRawBlocksLocation(indexesDatabase, logger, false));
+  ASSERT_TRUE(DatabaseBlockchainCache::checkRawBlocksLocation(database, logger, false));
+  ASSERT_FALSE(DatabaseBlockchainCache::checkRawBlocksLocation(database, logger, true));
+}
+
+TEST_F(DatabaseBlockchainCacheTests, BatchedPushIsWrittenOnCommit) {
+  const uint64_t AMOUNT = 7777;
+  auto blocksCount = database.blocks().size();
+
+  blockchain.startPushBatch();
+  pushBlockWithOutputs(AMOUNT, 2, 0);
+  pushBlockWithOutputs(AMOUNT, 3, 0);
+  ASSERT_EQ(blocksCount, database.blocks().size());
+  ASSERT_EQ(5, blockchain.getKeyOutputsCountForAmount(AMOUNT, blockchain.getTopBlockIndex() + 1));
+
+  blockchain.commitPushBatch();
+  ASSERT_EQ(blocksCount + 2, database.blocks().size());
+
+  DatabaseBlockchainCache reopened(currency, database, blockchainCacheFactory, logger);
+  ASSERT_EQ(blockchain.getTopBlockHash(), reopened.getTopBlockHash());
+  ASSERT_EQ(5, reopened.getKeyOutputsCountForAmount(AMOUNT, reopened.getTopBlockIndex() + 1));
+}
+
+TEST_F(DatabaseBlockchainCacheTests, MainChainSnapshotIsntAffectedByLaterBlocks) {
+  const uint64_t AMOUNT = 7777;
+
+  auto block = pushBlockWithOutputs(blockchain, AMOUNT, 5, 0);
+  for (uint32_t i = 0; i < 2 * currency.minedMoneyUnlockWindow(); ++i) {
+    pushBlockWithOutputs(AMOUNT, 0, 0);
+  }
+
+  auto topBlockIndex = blockchain.getTopBlockIndex();
+  auto topBlockHash = blockchain.getTopBlockHash();
+  MainChainSnapshot snapshot(currency, blockchain.createDatabaseSnapshot(), topBlockIndex, topBlockHash, topBlockIndex, true);
+  pushBlockWithOutputs(AMOUNT, 5, 0);
+
+  ASSERT_EQ(topBlockIndex, snapshot.getBlockIndex(topBlockHash));
+  ASSERT_EQ(topBlockHash, CachedBlock(snapshot.getBlockByIndex(topBlockIndex)).getBlockHash());
+  ASSERT_EQ(blockchain.getCurrentCumulativeDifficulty(topBlockIndex) - blockchain.getCurrentCumulativeDifficulty(topBlockIndex - 1),
+            snapshot.getBlockDifficulty(topBlockIndex));
+  ASSERT_THROW(snapshot.getBlockIndex(blockchain.getTopBlockHash()), OutOfSnapshotError);
+  ASSERT_THROW(snapshot.getBlockInfos(topBlockIndex, 2), OutOfSnapshotError);
+
+  std::vector<uint32_t> globalIndexes;
+  std::vector<PublicKey> publicKeys;
+  ASSERT_TRUE(snapshot.getRandomOutputs(AMOUNT, 10, globalIndexes, publicKeys));
+  ASSERT_EQ((std::vector<uint32_t>{0, 1, 2, 3, 4}), globalIndexes);
+  for (size_t i = 0; i < publicKeys.size(); ++i) {
+    ASSERT_EQ(boost::get<KeyOutput>(block.baseTransaction.outputs[i].target).key, publicKeys[i]);
+  }
+}
+
+namespace {
+
+std::pair<uint64_t, bool> readSpentKeyImagesCount(IDataBase& database) {
+  auto batch = BlockchainReadBatch().requestSpentKeyImagesCount();
+  EXPECT_FALSE(database.read(batch));
+  return batch.extractResult().getSpentKeyImagesCount();
+}
+
+}
+
+TEST_F(DatabaseBlockchainCacheTests, SpentKeyImagesCountFollowsPushAndSplit) {
+  TransactionValidatorState state;
+  for (size_t i = 0; i < 3; ++i) {
+    state.spentKeyImages.insert(Crypto::rand<KeyImage>());
+  }
+
+  DataBaseMock localDatabase;
+  DatabaseBlockchainCache local(currency, localDatabase, blockchainCacheFactory, logger);
+  ASSERT_EQ(std::make_pair(uint64_t(0), true), readSpentKeyImagesCount(localDatabase));
+
+  TestBlockchainGenerator localGenerator(currency);
+  localGenerator.generateEmptyBlocks(1);
+  const auto& blocks = localGenerator.getBlockchain();
+  for (size_t i = 1; i < blocks.size(); ++i) { //Skip genesis block
+    TransactionValidatorState blockState = i + 1 == blocks.size() ? state : TransactionValidatorState();
+    local.pushBlock(CachedBlock{blocks[i]}, {}, blockState, 1, 1, 1, { toBinaryArray(blocks[i]), {} });
+  }
+
+  ASSERT_EQ(std::make_pair(uint64_t(3), true), readSpentKeyImagesCount(localDatabase));
+
+  auto child = local.split(local.getTopBlockIndex());
+  ASSERT_EQ(std::make_pair(uint64_t(0), true), readSpentKeyImagesCount(localDatabase));
+}
+
+TEST_F(DatabaseBlockchainCacheTests, SpentKeyImagesCountIsRestoredWhenMissing) {
+  KeyImage keyImage = Crypto::rand<KeyImage>();
+  TransactionValidatorState state;
+  state.spentKeyImages.insert(keyImage);
+
+  generator.generateEmptyBlocks(1);
+  const auto& block = generator.getBlockchain().back();
+  blockchain.pushBlock(CachedBlock{block}, {}, state, 0, 0, 0, { toBinaryArray(block), {} });
+
+  // databases written before the count was stored don't have it
+  database.baseState.erase(DB::serializeKey(DB::BLOCK_INDEX_TO_KEY_IMAGE_PREFIX, DB::SPENT_KEY_IMAGES_COUNT_KEY));
+  ASSERT_FALSE(readSpentKeyImagesCount(database).second);
+
+  DatabaseBlockchainCache reopened(currency, database, blockchainCacheFactory, logger);
+  ASSERT_EQ(std::make_pair(uint64_t(1), true), readSpentKeyImagesCount(database));
+  ASSERT_TRUE(reopened.checkIfSpent(keyImage));
+}
@@ -0,0 +1,303 @@
+// Copyright (c) 2012-2017, The CryptoNote developers, The Bytecoin developers
+//
+// This file is part of Bytecoin.
+//
+// Bytecoin is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Bytecoin is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with Bytecoin.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <gtest/gtest.h>
+
+#include "Common/StringOutputStream.h"
+#include "CryptoNoteCore/BlockchainReadBatch.h"
+#include "CryptoNoteCore/DatabaseCacheData.h"
+#include "CryptoNoteCore/DatabaseSchemeMigrator.h"
+#include "CryptoNoteCore/DBUtils.h"
+#include "Logging/ConsoleLogger.h"
+#include "Serialization/KVBinaryOutputStreamSerializer.h"
+
+#include "DataBaseMock.h"
+
+using namespace CryptoNote;
+
+namespace {
+
+const std::string LEGACY_INPUT_KEYS_BY_OUTPUT_KEY = "input-keys-output-key";
+
+template <class Value>
+std::string serializeKVBinary(const Value& value, const std::string& name) {
+  KVBinaryOutputStreamSerializer serializer;
+  serializer(const_cast<Value&>(value), name);
+
+  std::string result;
+  Common::StringOutputStream stream(result);
+  serializer.dump(stream);
+  return result;
+}
+
+template <class Key, class Value>
+void insertLegacyRecord(DataBaseMock& database, const std::string& prefix, const Key& key, const Value& value) {
+  database.baseState[serializeKVBinary(std::make_pair(prefix, key), prefix)] = serializeKVBinary(value, prefix);
+}
+
+class DatabaseSchemeMigratorTests : public ::testing::Test {
+public:
+  DatabaseSchemeMigratorTests() : logger(Logging::ERROR) {
+  }
+
+  BlockchainReadResult read(BlockchainReadBatch& batch) {
+    EXPECT_FALSE(database.read(batch));
+    return batch.extractResult();
+  }
+
+protected:
+  Logging::ConsoleLogger logger;
+  DataBaseMock database;
+};
+
+}
+
+TEST(DBUtils, integerKeysSortNumerically) {
+  auto key255 = DB::serializeKey(DB::BLOCK_INDEX_TO_BLOCK_INFO_PREFIX, uint32_t(255));
+  auto key256 = DB::serializeKey(DB::BLOCK_INDEX_TO_BLOCK_INFO_PREFIX, uint32_t(256));
+  ASSERT_EQ(DB::BLOCK_INDEX_TO_BLOCK_INFO_PREFIX.size() + sizeof(uint32_t), key255.size());
+  ASSERT_LT(key255, key256);
+
+  auto amountKey = DB::serializeKey(DB::KEY_OUTPUT_KEY_PREFIX, std::make_pair(uint64_t(1) << 32, uint32_t(0)));
+  auto smallerAmountKey = DB::serializeKey(DB::KEY_OUTPUT_KEY_PREFIX, std::make_pair(uint64_t(1), uint32_t(1000)));
+  ASSERT_EQ(DB::KEY_OUTPUT_KEY_PREFIX.size() + sizeof(uint64_t) + sizeof(uint32_t), amountKey.size());
+  ASSERT_LT(smallerAmountKey, amountKey);
+}
+
+TEST(DBUtils, integerValuesAreFixedWidth) {
+  uint64_t value = 0;
+  auto serialized = DB::serialize(uint64_t(0x0102030405060708), "value");
+  ASSERT_EQ(sizeof(value), serialized.size());
+  DB::deserialize(serialized, value, "value");
+  ASSERT_EQ(0x0102030405060708, value);
+}
+
+TEST_F(DatabaseSchemeMigratorTests, convertsKVBinaryRecords) {
+  const Crypto::Hash blockHash = Crypto::rand<Crypto::Hash>();
+  const Crypto::PublicKey outputKey = Crypto::rand<Crypto::PublicKey>();
+  const Crypto::KeyImage keyImage = Crypto::rand<Crypto::KeyImage>();
+
+  KeyOutputInfo outputInfo;
+  outputInfo.publicKey = outputKey;
+  outputInfo.transactionHash = Crypto::rand<Crypto::Hash>();
+  outputInfo.unlockTime = 10;
+  outputInfo.outputIndex = 2;
+
+  insertLegacyRecord(database, DB::BLOCK_INDEX_TO_BLOCK_HASH_PREFIX, DB::LAST_BLOCK_INDEX_KEY, uint32_t(300));
+  insertLegacyRecord(database, DB::BLOCK_HASH_TO_BLOCK_INDEX_PREFIX, blockHash, uint32_t(299));
+  insertLegacyRecord(database, DB::TRANSACTION_HASH_TO_TRANSACTION_INFO_PREFIX, DB::TRANSACTIONS_COUNT_KEY, uint64_t(1000));
+  insertLegacyRecord(database, DB::KEY_OUTPUT_AMOUNT_PREFIX, uint64_t(100), uint32_t(5));
+  insertLegacyRecord(database, DB::KEY_OUTPUT_KEY_PREFIX, std::make_pair(uint64_t(100), uint32_t(4)), outputInfo);
+  insertLegacyRecord(database, LEGACY_INPUT_KEYS_BY_OUTPUT_KEY, std::make_pair(outputKey, uint32_t(0)), keyImage);
+
+  DatabaseSchemeMigrator migrator(database, logger);
+  migrator.convertKVBinaryRecords();
+
+  ASSERT_EQ(6, database.baseState.size());
+
+  BlockchainReadBatch batch;
+  batch.requestLastBlockIndex()
+    .requestBlockIndexByBlockHash(blockHash)
+    .requestTransactionsCount()
+    .requestKeyOutputGlobalIndexesCountForAmount(100)
+    .requestKeyOutputInfo(100, 4)
+    .requestInputByOutputKey(outputKey, 0);
+  auto result = read(batch);
+
+  ASSERT_TRUE(result.getLastBlockIndex().second);
+  ASSERT_EQ(300, result.getLastBlockIndex().first);
+  ASSERT_EQ(299, result.getBlockIndexesByBlockHashes().at(blockHash));
+  ASSERT_EQ(1000, result.getTransactionsCount().first);
+  ASSERT_EQ(5, result.getKeyOutputGlobalIndexesCountForAmounts().at(100));
+
+  const KeyOutputInfo& convertedInfo = result.getKeyOutputInfo().at(std::make_pair(uint64_t(100), uint32_t(4)));
+  ASSERT_EQ(outputInfo.publicKey, convertedInfo.publicKey);
+  ASSERT_EQ(outputInfo.transactionHash, convertedInfo.transactionHash);
+  ASSERT_EQ(outputInfo.unlockTime, convertedInfo.unlockTime);
+  ASSERT_EQ(outputInfo.outputIndex, convertedInfo.outputIndex);
+
+  ASSERT_EQ(keyImage, result.getInputsByOutputKeys().at(std::make_pair(outputKey, uint32_t(0))));
+}
+
+TEST_F(DatabaseSchemeMigratorTests, convertsEveryRecordKind) {
+  const Crypto::Hash blockHash = Crypto::rand<Crypto::Hash>();
+  const Crypto::Hash transactionHash = Crypto::rand<Crypto::Hash>();
+  const Crypto::Hash paymentId = Crypto::rand<Crypto::Hash>();
+  const Crypto::KeyImage keyImage = Crypto::rand<Crypto::KeyImage>();
+  const Crypto::PublicKey outputKey = Crypto::rand<Crypto::PublicKey>();
+
+  CachedBlockInfo blockInfo;
+  blockInfo.blockHash = blockHash;
+  blockInfo.timestamp = 1500000000;
+  blockInfo.cumulativeDifficulty = 12345;
+  blockInfo.alreadyGeneratedCoins = 1000000;
+  blockInfo.alreadyGeneratedTransactions = 20;
+  blockInfo.blockSize = 300;
+
+  ExtendedTransactionInfo transactionInfo;
+  transactionInfo.blockIndex = 7;
+  transactionInfo.transactionIndex = 1;
+  transactionInfo.transactionHash = transactionHash;
+  transactionInfo.unlockTime = 17;
+  transactionInfo.outputs.push_back(KeyOutput{outputKey});
+  transactionInfo.globalIndexes = {4};
+  transactionInfo.amountToKeyIndexes[100] = {4};
+
+  PackedOutIndex packedOut;
+  packedOut.blockIndex = 7;
+  packedOut.transactionIndex = 1;
+  packedOut.outputIndex = 0;
+
+  KeyOutputInfo outputInfo;
+  outputInfo.publicKey = outputKey;
+  outputInfo.transactionHash = transactionHash;
+  outputInfo.unlockTime = 17;
+  outputInfo.outputIndex = 0;
+
+  RawBlock rawBlock;
+  rawBlock.block = {1, 2, 3};
+  rawBlock.transactions = {{4, 5}, {6}};
+
+  insertLegacyRecord(database, DB::BLOCK_INDEX_TO_KEY_IMAGE_PREFIX, uint32_t(7), std::vector<Crypto::KeyImage>{keyImage});
+  insertLegacyRecord(database, DB::BLOCK_INDEX_TO_TX_HASHES_PREFIX, uint32_t(7), std::vector<Crypto::Hash>{transactionHash});
+  database.baseState[serializeKVBinary(std::make_pair(DB::BLOCK_INDEX_TO_RAW_BLOCK_PREFIX, uint32_t(7)), DB::BLOCK_INDEX_TO_RAW_BLOCK_PREFIX)] =
+    DB::serialize(rawBlock, DB::BLOCK_INDEX_TO_RAW_BLOCK_PREFIX);
+  insertLegacyRecord(database, DB::BLOCK_HASH_TO_BLOCK_INDEX_PREFIX, blockHash, uint32_t(7));
+  insertLegacyRecord(database, DB::BLOCK_INDEX_TO_BLOCK_INFO_PREFIX, uint32_t(7), blockInfo);
+  insertLegacyRecord(database, DB::KEY_IMAGE_TO_BLOCK_INDEX_PREFIX, keyImage, uint32_t(7));
+  insertLegacyRecord(database, DB::BLOCK_INDEX_TO_BLOCK_HASH_PREFIX, DB::LAST_BLOCK_INDEX_KEY, uint32_t(7));
+  insertLegacyRecord(database, DB::TRANSACTION_HASH_TO_TRANSACTION_INFO_PREFIX, transactionHash, transactionInfo);
+  insertLegacyRecord(database, DB::TRANSACTION_HASH_TO_TRANSACTION_INFO_PREFIX, DB::TRANSACTIONS_COUNT_KEY, uint64_t(21));
+  insertLegacyRecord(database, DB::KEY_OUTPUT_AMOUNT_PREFIX, uint64_t(100), uint32_t(5));
+  insertLegacyRecord(database, DB::KEY_OUTPUT_AMOUNT_PREFIX, std::make_pair(uint64_t(100), uint32_t(4)), packedOut);
+  insertLegacyRecord(database, DB::CLOSEST_TIMESTAMP_BLOCK_INDEX_PREFIX, uint64_t(1500000000), uint32_t(7));
+  insertLegacyRecord(database, DB::PAYMENT_ID_TO_TX_HASH_PREFIX, paymentId, uint32_t(1));
+  insertLegacyRecord(database, DB::PAYMENT_ID_TO_TX_HASH_PREFIX, std::make_pair(paymentId, uint32_t(0)), transactionHash);
+  insertLegacyRecord(database, DB::TIMESTAMP_TO_BLOCKHASHES_PREFIX, uint64_t(1500000000), std::vector<Crypto::Hash>{blockHash});
+  insertLegacyRecord(database, DB::KEY_OUTPUT_AMOUNTS_COUNT_PREFIX, uint32_t(0), uint64_t(100));
+  insertLegacyRecord(database, DB::KEY_OUTPUT_AMOUNTS_COUNT_PREFIX, DB::KEY_OUTPUT_AMOUNTS_COUNT_KEY, uint32_t(1));
+  insertLegacyRecord(database, DB::KEY_OUTPUT_KEY_PREFIX, std::make_pair(uint64_t(100), uint32_t(4)), outputInfo);
+  insertLegacyRecord(database, LEGACY_INPUT_KEYS_BY_OUTPUT_KEY, outputKey, uint32_t(1));
+  insertLegacyRecord(database, LEGACY_INPUT_KEYS_BY_OUTPUT_KEY, std::make_pair(outputKey, uint32_t(0)), keyImage);
+
+  DatabaseSchemeMigrator migrator(database, logger);
+  migrator.convertKVBinaryRecords();
+
+  ASSERT_EQ(20, database.baseState.size());
+  for (const auto& record : database.baseState) {
+    ASSERT_NE(0x01, record.first[0]);
+  }
+
+  BlockchainReadBatch batch;
+  batch.requestSpentKeyImagesByBlock(7)
+    .requestTransactionHashesByBlock(7)
+    .requestRawBlock(7)
+    .requestBlockIndexByBlockHash(blockHash)
+    .requestCachedBlock(7)
+    .requestBlockIndexBySpentKeyImage(keyImage)
+    .requestLastBlockIndex()
+    .requestCachedTransaction(transactionHash)
+    .requestTransactionsCount()
+    .requestKeyOutputGlobalIndexesCountForAmount(100)
+    .requestKeyOutputGlobalIndexForAmount(100, 4)
+    .requestClosestTimestampBlockIndex(1500000000)
+    .requestTransactionCountByPaymentId(paymentId)
+    .requestTransactionHashByPaymentId(paymentId, 0)
+    .requestBlockHashesByTimestamp(1500000000)
+    .requestKeyOutputAmount(0)
+    .requestKeyOutputAmountsCount()
+    .requestKeyOutputInfo(100, 4)
+    .requestInputCountByOutputKey(outputKey)
+    .requestInputByOutputKey(outputKey, 0);
+  auto result = read(batch);
+
+  ASSERT_EQ(std::vector<Crypto::KeyImage>{keyImage}, result.getSpentKeyImagesByBlock().at(7));
+  ASSERT_EQ(std::vector<Crypto::Hash>{transactionHash}, result.getTransactionHashesByBlocks().at(7));
+  ASSERT_EQ(rawBlock.block, result.getRawBlocks().at(7).block);
+  ASSERT_EQ(rawBlock.transactions, result.getRawBlocks().at(7).transactions);
+  ASSERT_EQ(7, result.getBlockIndexesByBlockHashes().at(blockHash));
+
+  const CachedBlockInfo& convertedBlockInfo = result.getCachedBlocks().at(7);
+  ASSERT_EQ(blockInfo.blockHash, convertedBlockInfo.blockHash);
+  ASSERT_EQ(blockInfo.timestamp, convertedBlockInfo.timestamp);
+  ASSERT_EQ(blockInfo.cumulativeDifficulty, convertedBlockInfo.cumulativeDifficulty);
+  ASSERT_EQ(blockInfo.alreadyGeneratedCoins, convertedBlockInfo.alreadyGeneratedCoins);
+  ASSERT_EQ(blockInfo.alreadyGeneratedTransactions, convertedBlockInfo.alreadyGeneratedTransactions);
+  ASSERT_EQ(blockInfo.blockSize, convertedBlockInfo.blockSize);
+
+  ASSERT_EQ(7, result.getBlockIndexesBySpentKeyImages().at(keyImage));
+  ASSERT_EQ(7, result.getLastBlockIndex().first);
+
+  const ExtendedTransactionInfo& convertedTransactionInfo = result.getCachedTransactions().at(transactionHash);
+  ASSERT_EQ(transactionInfo.blockIndex, convertedTransactionInfo.blockIndex);
+  ASSERT_EQ(transactionInfo.transactionIndex, convertedTransactionInfo.transactionIndex);
+  ASSERT_EQ(transactionInfo.transactionHash, convertedTransactionInfo.transactionHash);
+  ASSERT_EQ(transactionInfo.unlockTime, convertedTransactionInfo.unlockTime);
+  ASSERT_EQ(1, convertedTransactionInfo.outputs.size());
+  ASSERT_EQ(outputKey, boost::get<KeyOutput>(convertedTransactionInfo.outputs[0]).key);
+  ASSERT_EQ(transactionInfo.globalIndexes, convertedTransactionInfo.globalIndexes);
+  ASSERT_EQ(transactionInfo.amountToKeyIndexes, convertedTransactionInfo.amountToKeyIndexes);
+
+  ASSERT_EQ(21, result.getTransactionsCount().first);
+  ASSERT_EQ(5, result.getKeyOutputGlobalIndexesCountForAmounts().at(100));
+  ASSERT_EQ(packedOut.packedValue, result.getKeyOutputGlobalIndexesForAmounts().at(std::make_pair(uint64_t(100), uint32_t(4))).packedValue);
+  ASSERT_EQ(7, result.getClosestTimestampBlockIndex().at(1500000000));
+  ASSERT_EQ(1, result.getTransactionCountByPaymentIds().at(paymentId));
+  ASSERT_EQ(transactionHash, result.getTransactionHashesByPaymentIds().at(std::make_pair(paymentId, uint32_t(0))));
+  ASSERT_EQ(std::vector<Crypto::Hash>{blockHash}, result.getBlockHashesByTimestamp().at(1500000000));
+  ASSERT_EQ(100, result.getKeyOutputAmounts().at(0));
+  ASSERT_EQ(1, result.getKeyOutputAmountsCount());
+
+  const KeyOutputInfo& convertedOutputInfo = result.getKeyOutputInfo().at(std::make_pair(uint64_t(100), uint32_t(4)));
+  ASSERT_EQ(outputInfo.publicKey, convertedOutputInfo.publicKey);
+  ASSERT_EQ(outputInfo.transactionHash, convertedOutputInfo.transactionHash);
+  ASSERT_EQ(outputInfo.unlockTime, convertedOutputInfo.unlockTime);
+  ASSERT_EQ(outputInfo.outputIndex, convertedOutputInfo.outputIndex);
+
+  ASSERT_EQ(1, result.getInputCountByOutputKeys().at(outputKey));
+  ASSERT_EQ(keyImage, result.getInputsByOutputKeys().at(std::make_pair(outputKey, uint32_t(0))));
+}
+
+TEST_F(DatabaseSchemeMigratorTests, keepsUnknownRecords) {
+  insertLegacyRecord(database, "unknown", uint32_t(1), uint32_t(1));
+  insertLegacyRecord(database, DB::BLOCK_HASH_TO_BLOCK_INDEX_PREFIX, Crypto::rand<Crypto::Hash>(), uint32_t(1));
+  auto unknownKey = serializeKVBinary(std::make_pair(std::string("unknown"), uint32_t(1)), "unknown");
+
+  DatabaseSchemeMigrator migrator(database, logger);
+  migrator.convertKVBinaryRecords();
+
+  ASSERT_EQ(2, database.baseState.size());
+  ASSERT_EQ(1, database.baseState.count(unknownKey));
+}
+
+TEST_F(DatabaseSchemeMigratorTests, convertsRecordsInSeveralBatches) {
+  const uint32_t BLOCK_COUNT = 25000;
+  for (uint32_t i = 0; i < BLOCK_COUNT; ++i) {
+    insertLegacyRecord(database, DB::BLOCK_INDEX_TO_BLOCK_HASH_PREFIX, DB::LAST_BLOCK_INDEX_KEY, i);
+    insertLegacyRecord(database, DB::BLOCK_INDEX_TO_TX_HASHES_PREFIX, i, std::vector<Crypto::Hash>{Crypto::rand<Crypto::Hash>()});
+  }
+
+  DatabaseSchemeMigrator migrator(database, logger);
+  migrator.convertKVBinaryRecords();
+
+  ASSERT_EQ(BLOCK_COUNT + 1, database.baseState.size());
+
+  BlockchainReadBatch batch;
+  batch.requestTransactionHashesByBlock(0).requestTransactionHashesByBlock(BLOCK_COUNT - 1);
+  auto result = read(batch);
+  ASSERT_EQ(2, result.getTransactionHashesByBlocks().size());
+}
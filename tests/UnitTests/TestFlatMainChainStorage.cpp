@@ -0,0 +1,227 @@
+// Copyright (c) 2012-2017, The CryptoNote developers, The Bytecoin developers
+//
+// This file is part of Bytecoin.
+//
+// Bytecoin is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Bytecoin is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with Bytecoin.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "gtest/gtest.h"
+
+#include <boost/filesystem/operations.hpp>
+
+#include "CryptoNoteCore/CryptoNoteTools.h"
+#include "CryptoNoteCore/Currency.h"
+#include "CryptoNoteCore/FlatMainChainStorage.h"
+#include "CryptoNoteCore/MainChainStorage.h"
+#include "Logging/ConsoleLogger.h"
+
+using namespace CryptoNote;
+
+namespace {
+
+class FlatMainChainStorageTests : public ::testing::Test {
+public:
+  FlatMainChainStorageTests() : currency(CurrencyBuilder(logger).currency()) {
+  }
+
+  void SetUp() override {
+    dir = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path("test_data_dir_%%%%%%%%%%%%");
+    boost::system::error_code ignoredErrorCode;
+    boost::filesystem::create_directory(dir, ignoredErrorCode);
+    segmentsFilename = (dir / "blocksegment").string();
+    offsetsFilename = (dir / "blockoffsets.bin").string();
+  }
+
+  void TearDown() override {
+    boost::system::error_code ignoredErrorCode;
+    boost::filesystem::remove_all(dir, ignoredErrorCode);
+  }
+
+  std::vector<RawBlock> generateRandomBlocks(size_t blocksNumber, size_t maxTransactionsPerBlock) {
+    std::vector<RawBlock> blocks;
+    for (size_t i = 0; i < blocksNumber; ++i) {
+      RawBlock block;
+      block.block.resize(10 + rand() % 20);
+      for (auto& byte : block.block) {
+        byte = static_cast<uint8_t>(rand());
+      }
+
+      block.transactions.resize(maxTransactionsPerBlock != 0 ? rand() % (maxTransactionsPerBlock + 1) : 0);
+      for (auto& transaction : block.transactions) {
+        transaction.resize(rand() % 20);
+        for (auto& byte : transaction) {
+          byte = static_cast<uint8_t>(rand());
+        }
+      }
+
+      blocks.push_back(block);
+    }
+
+    return blocks;
+  }
+
+  void assertBlocksEqual(const RawBlock& expected, const RawBlock& actual) {
+    ASSERT_EQ(expected.block, actual.block);
+    ASSERT_EQ(expected.transactions, actual.transactions);
+  }
+
+  void assertStorageContains(const IMainChainStorage& storage, const std::vector<RawBlock>& blocks) {
+    ASSERT_EQ(blocks.size(), storage.getBlockCount());
+    for (uint32_t i = 0; i < blocks.size(); ++i) {
+      assertBlocksEqual(blocks[i], storage.getBlockByIndex(i));
+    }
+  }
+
+  Logging::ConsoleLogger logger;
+  Currency currency;
+  boost::filesystem::path dir;
+  std::string segmentsFilename;
+  std::string offsetsFilename;
+};
+
+}
+
+TEST_F(FlatMainChainStorageTests, pushedBlocksAreRead) {
+  auto blocks = generateRandomBlocks(20, 5);
+  FlatMainChainStorage storage(segmentsFilename, offsetsFilename);
+  for (const auto& block : blocks) {
+    storage.pushBlock(block);
+  }
+
+  assertStorageContains(storage, blocks);
+  ASSERT_THROW(storage.getBlockByIndex(20), std::out_of_range);
+}
+
+TEST_F(FlatMainChainStorageTests, blockViewPointsToStoredParts) {
+  auto blocks = generateRandomBlocks(3, 5);
+  FlatMainChainStorage storage(segmentsFilename, offsetsFilename);
+  for (const auto& block : blocks) {
+    storage.pushBlock(block);
+  }
+
+  auto view = storage.getBlockView(1);
+  ASSERT_EQ(blocks[1].block, BinaryArray(view.block.getData(), view.block.getData() + view.block.getSize()));
+  ASSERT_EQ(blocks[1].transactions.size(), view.transactions.size());
+  for (size_t i = 0; i < view.transactions.size(); ++i) {
+    ASSERT_EQ(blocks[1].transactions[i], BinaryArray(view.transactions[i].getData(), view.transactions[i].getData() + view.transactions[i].getSize()));
+  }
+}
+
+TEST_F(FlatMainChainStorageTests, blocksArePersisted) {
+  auto blocks = generateRandomBlocks(20, 5);
+  {
+    FlatMainChainStorage storage(segmentsFilename, offsetsFilename);
+    for (const auto& block : blocks) {
+      storage.pushBlock(block);
+    }
+  }
+
+  FlatMainChainStorage storage(segmentsFilename, offsetsFilename);
+  assertStorageContains(storage, blocks);
+}
+
+TEST_F(FlatMainChainStorageTests, popBlockRemovesTopBlock) {
+  auto blocks = generateRandomBlocks(10, 5);
+  auto newBlocks = generateRandomBlocks(3, 5);
+  FlatMainChainStorage storage(segmentsFilename, offsetsFilename);
+  for (const auto& block : blocks) {
+    storage.pushBlock(block);
+  }
+
+  for (size_t i = 0; i < newBlocks.size(); ++i) {
+    storage.popBlock();
+    blocks.pop_back();
+  }
+
+  for (const auto& block : newBlocks) {
+    storage.pushBlock(block);
+    blocks.push_back(block);
+  }
+
+  assertStorageContains(storage, blocks);
+}
+
+TEST_F(FlatMainChainStorageTests, blocksSpanSeveralSegments) {
+  const uint64_t SEGMENT_SIZE = 200;
+  auto blocks = generateRandomBlocks(50, 5);
+  RawBlock largeBlock;
+  largeBlock.block.assign(SEGMENT_SIZE * 2, 7);
+  blocks.insert(blocks.begin() + 25, largeBlock);
+
+  {
+    FlatMainChainStorage storage(segmentsFilename, offsetsFilename, SEGMENT_SIZE);
+    for (const auto& block : blocks) {
+      storage.pushBlock(block);
+    }
+
+    assertStorageContains(storage, blocks);
+    ASSERT_TRUE(boost::filesystem::exists(segmentsFilename + ".00003"));
+
+    // popping back to the first segment and pushing again reuses the segments
+    for (size_t i = 0; i < 40; ++i) {
+      storage.popBlock();
+      blocks.pop_back();
+    }
+
+    for (const auto& block : generateRandomBlocks(30, 5)) {
+      storage.pushBlock(block);
+      blocks.push_back(block);
+    }
+
+    assertStorageContains(storage, blocks);
+  }
+
+  FlatMainChainStorage storage(segmentsFilename, offsetsFilename, SEGMENT_SIZE);
+  assertStorageContains(storage, blocks);
+}
+
+TEST_F(FlatMainChainStorageTests, getBlocksReturnsRangeWithinStorage) {
+  auto blocks = generateRandomBlocks(10, 5);
+  FlatMainChainStorage storage(segmentsFilename, offsetsFilename);
+  for (const auto& block : blocks) {
+    storage.pushBlock(block);
+  }
+
+  auto range = storage.getBlocks(3, 4);
+  ASSERT_EQ(4, range.size());
+  for (size_t i = 0; i < range.size(); ++i) {
+    assertBlocksEqual(blocks[3 + i], range[i]);
+  }
+
+  ASSERT_EQ(2, storage.getBlocks(8, 100).size());
+  ASSERT_TRUE(storage.getBlocks(10, 1).empty());
+}
+
+TEST_F(FlatMainChainStorageTests, createAddsGenesisBlock) {
+  auto storage = createFlatMainChainStorage(dir.string(), currency, logger);
+  ASSERT_EQ(1, storage->getBlockCount());
+  ASSERT_EQ(toBinaryArray(currency.genesisBlock()), storage->getBlockByIndex(0).block);
+}
+
+TEST_F(FlatMainChainStorageTests, createConvertsSwappedStorage) {
+  auto blocksFilename = (dir / currency.blocksFileName()).string();
+  auto indexesFilename = (dir / currency.blockIndexesFileName()).string();
+  auto blocks = generateRandomBlocks(30, 5);
+  {
+    MainChainStorage swappedStorage(blocksFilename, indexesFilename);
+    for (const auto& block : blocks) {
+      swappedStorage.pushBlock(block);
+    }
+  }
+
+  auto storage = createFlatMainChainStorage(dir.string(), currency, logger);
+  assertStorageContains(*storage, blocks);
+  ASSERT_FALSE(boost::filesystem::exists(blocksFilename));
+  ASSERT_FALSE(boost::filesystem::exists(indexesFilename));
+  ASSERT_TRUE(boost::filesystem::exists(dir / currency.blockOffsetsFileName()));
+}
@@ -0,0 +1,218 @@
+// Copyright (c) 2012-2017, The CryptoNote developers, The Bytecoin developers
+//
+// This file is part of Bytecoin.
+//
+// Bytecoin is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Bytecoin is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with Bytecoin.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <cstring>
+
+#include <gtest/gtest.h>
+
+#include <System/Dispatcher.h>
+#include <System/Ipv4Address.h>
+#include <System/TcpConnection.h>
+#include <System/TcpConnector.h>
+#include <System/TcpListener.h>
+
+#include "P2p/LevinProtocol.h"
+
+using namespace CryptoNote;
+
+namespace {
+
+const System::Ipv4Address LISTEN_ADDRESS("127.0.0.1");
+const uint16_t LISTEN_PORT = 6667;
+
+const uint32_t TEST_COMMAND = 1001;
+
+// wire layout of the Levin header, kept here to check the encoders against the protocol rather than against themselves
+#pragma pack(push)
+#pragma pack(1)
+struct LevinHeader {
+  uint64_t signature;
+  uint64_t bodySize;
+  bool haveToReturnData;
+  uint32_t command;
+  int32_t returnCode;
+  uint32_t flags;
+  uint32_t protocolVersion;
+};
+#pragma pack(pop)
+
+LevinHeader decodeHeader(const BinaryArray& packet) {
+  LevinHeader header;
+  EXPECT_LE(sizeof(header), packet.size());
+  memcpy(&header, packet.data(), sizeof(header));
+  return header;
+}
+
+BinaryArray decodeBody(const BinaryArray& packet) {
+  return BinaryArray(packet.begin() + sizeof(LevinHeader), packet.end());
+}
+
+BinaryArray makeBody(size_t size) {
+  BinaryArray body(size);
+  for (size_t i = 0; i < size; ++i) {
+    body[i] = static_cast<uint8_t>(i * 7);
+  }
+
+  return body;
+}
+
+class LevinProtocolTests : public testing::Test {
+public:
+  LevinProtocolTests() : listener(dispatcher, LISTEN_ADDRESS, LISTEN_PORT) {
+    senderConnection = System::TcpConnector(dispatcher).connect(LISTEN_ADDRESS, LISTEN_PORT);
+    receiverConnection = listener.accept();
+  }
+
+  BinaryArray readRaw(size_t size) {
+    BinaryArray data(size);
+    size_t offset = 0;
+    while (offset < size) {
+      size_t read = receiverConnection.read(data.data() + offset, size - offset);
+      EXPECT_NE(0, read);
+      if (read == 0) {
+        break;
+      }
+
+      offset += read;
+    }
+
+    return data;
+  }
+
+protected:
+  System::Dispatcher dispatcher;
+  System::TcpListener listener;
+  System::TcpConnection senderConnection;
+  System::TcpConnection receiverConnection;
+};
+
+}
+
+TEST_F(LevinProtocolTests, encodeMessageWritesRequestHeader) {
+  auto body = makeBody(100);
+  auto packet = LevinProtocol::encodeMessage(TEST_COMMAND, body, true);
+
+  ASSERT_EQ(sizeof(LevinHeader) + body.size(), packet.size());
+  auto header = decodeHeader(packet);
+  ASSERT_EQ(0x0101010101012101ULL, header.signature);
+  ASSERT_EQ(body.size(), header.bodySize);
+  ASSERT_TRUE(header.haveToReturnData);
+  ASSERT_EQ(TEST_COMMAND, header.command);
+  ASSERT_EQ(0, header.returnCode);
+  ASSERT_EQ(1, header.flags);
+  ASSERT_EQ(1, header.protocolVersion);
+  ASSERT_EQ(body, decodeBody(packet));
+}
+
+TEST_F(LevinProtocolTests, encodeMessageOfNotificationDoesntRequestResponse) {
+  auto packet = LevinProtocol::encodeMessage(TEST_COMMAND, makeBody(10), false);
+
+  auto header = decodeHeader(packet);
+  ASSERT_FALSE(header.haveToReturnData);
+  ASSERT_EQ(1, header.flags);
+}
+
+TEST_F(LevinProtocolTests, encodeReplyWritesResponseHeader) {
+  auto body = makeBody(100);
+  auto packet = LevinProtocol::encodeReply(TEST_COMMAND, body, -7);
+
+  ASSERT_EQ(sizeof(LevinHeader) + body.size(), packet.size());
+  auto header = decodeHeader(packet);
+  ASSERT_EQ(0x0101010101012101ULL, header.signature);
+  ASSERT_EQ(body.size(), header.bodySize);
+  ASSERT_FALSE(header.haveToReturnData);
+  ASSERT_EQ(TEST_COMMAND, header.command);
+  ASSERT_EQ(-7, header.returnCode);
+  ASSERT_EQ(2, header.flags);
+  ASSERT_EQ(1, header.protocolVersion);
+  ASSERT_EQ(body, decodeBody(packet));
+}
+
+TEST_F(LevinProtocolTests, encodeMessageOfEmptyBodyWritesHeaderOnly) {
+  auto packet = LevinProtocol::encodeMessage(TEST_COMMAND, BinaryArray(), false);
+
+  ASSERT_EQ(sizeof(LevinHeader), packet.size());
+  ASSERT_EQ(0, decodeHeader(packet).bodySize);
+}
+
+TEST_F(LevinProtocolTests, sendPacketWritesPacketUnchanged) {
+  auto packet = LevinProtocol::encodeReply(TEST_COMMAND, makeBody(1000), LEVIN_PROTOCOL_RETCODE_SUCCESS);
+  LevinProtocol(senderConnection).sendPacket(packet);
+
+  ASSERT_EQ(packet, readRaw(packet.size()));
+}
+
+TEST_F(LevinProtocolTests, sendMessageWritesEncodedMessage) {
+  auto body = makeBody(1000);
+  LevinProtocol(senderConnection).sendMessage(TEST_COMMAND, body, true);
+
+  ASSERT_EQ(LevinProtocol::encodeMessage(TEST_COMMAND, body, true), readRaw(sizeof(LevinHeader) + body.size()));
+}
+
+TEST_F(LevinProtocolTests, sendReplyWritesEncodedReply) {
+  auto body = makeBody(1000);
+  LevinProtocol(senderConnection).sendReply(TEST_COMMAND, body, LEVIN_PROTOCOL_RETCODE_SUCCESS);
+
+  ASSERT_EQ(LevinProtocol::encodeReply(TEST_COMMAND, body, LEVIN_PROTOCOL_RETCODE_SUCCESS), readRaw(sizeof(LevinHeader) + body.size()));
+}
+
+TEST_F(LevinProtocolTests, readCommandDecodesSentCommand) {
+  auto body = makeBody(1000);
+  LevinProtocol(senderConnection).sendPacket(LevinProtocol::encodeMessage(TEST_COMMAND, body, true));
+
+  LevinProtocol::Command command;
+  ASSERT_TRUE(LevinProtocol(receiverConnection).readCommand(command));
+  ASSERT_EQ(TEST_COMMAND, command.command);
+  ASSERT_FALSE(command.isNotify);
+  ASSERT_FALSE(command.isResponse);
+  ASSERT_TRUE(command.needReply());
+  ASSERT_EQ(body, command.buf);
+}
+
+TEST_F(LevinProtocolTests, readCommandDecodesSentNotification) {
+  auto body = makeBody(1000);
+  LevinProtocol(senderConnection).sendPacket(LevinProtocol::encodeMessage(TEST_COMMAND, body, false));
+
+  LevinProtocol::Command command;
+  ASSERT_TRUE(LevinProtocol(receiverConnection).readCommand(command));
+  ASSERT_EQ(TEST_COMMAND, command.command);
+  ASSERT_TRUE(command.isNotify);
+  ASSERT_FALSE(command.isResponse);
+  ASSERT_FALSE(command.needReply());
+  ASSERT_EQ(body, command.buf);
+}
+
+TEST_F(LevinProtocolTests, readCommandDecodesSentReply) {
+  auto body = makeBody(1000);
+  LevinProtocol(senderConnection).sendPacket(LevinProtocol::encodeReply(TEST_COMMAND, body, LEVIN_PROTOCOL_RETCODE_SUCCESS));
+
+  LevinProtocol::Command command;
+  ASSERT_TRUE(LevinProtocol(receiverConnection).readCommand(command));
+  ASSERT_EQ(TEST_COMMAND, command.command);
+  ASSERT_TRUE(command.isResponse);
+  ASSERT_FALSE(command.needReply());
+  ASSERT_EQ(body, command.buf);
+}
+
+TEST_F(LevinProtocolTests, readCommandDecodesSentEmptyNotification) {
+  LevinProtocol(senderConnection).sendPacket(LevinProtocol::encodeMessage(TEST_COMMAND, BinaryArray(), false));
+
+  LevinProtocol::Command command;
+  ASSERT_TRUE(LevinProtocol(receiverConnection).readCommand(command));
+  ASSERT_EQ(TEST_COMMAND, command.command);
+  ASSERT_TRUE(command.buf.empty());
+}
@@ -0,0 +1,146 @@
+// Copyright (c) 2012-2017, The CryptoNote developers, The Bytecoin developers
+//
+// This file is part of Bytecoin.
+//
+// Bytecoin is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Bytecoin is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with Bytecoin.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <limits>
+
+#include <gtest/gtest.h>
+
+#include <boost/uuid/random_generator.hpp>
+
+#include <Logging/ConsoleLogger.h>
+#include <System/Dispatcher.h>
+
+#include "P2p/NetNode.h"
+
+using namespace CryptoNote;
+
+namespace {
+
+const int RELAYED_COMMAND = 2002;
+const uint32_t MARKER_COMMAND = 2003;
+
+class RelayNotifyTests : public testing::Test {
+public:
+  RelayNotifyTests() : logger(Logging::ERROR), data(100, 42) {
+  }
+
+  net_connection_id addConnection(CryptoNoteConnectionContext::state state, uint8_t version = 1, PeerIdType peerId = 1) {
+    auto id = generator();
+    auto it = connections.emplace(id, P2pConnectionContext(dispatcher, logger, System::TcpConnection())).first;
+    it->second.m_connection_id = id;
+    it->second.m_state = state;
+    it->second.version = version;
+    it->second.peerId = peerId;
+    return id;
+  }
+
+  // a marker is queued after the relay so that the queue of every connection can be read without blocking
+  std::vector<P2pMessage> popRelayedMessages(const net_connection_id& id) {
+    auto& connection = connections.at(id);
+    connection.pushMessage(P2pMessage(P2pMessage::NOTIFY, MARKER_COMMAND, BinaryArray()));
+    auto messages = connection.popBuffer();
+    EXPECT_EQ(MARKER_COMMAND, messages.back().command);
+    messages.pop_back();
+    return messages;
+  }
+
+protected:
+  Logging::ConsoleLogger logger;
+  System::Dispatcher dispatcher;
+  boost::uuids::random_generator generator;
+  ConnectionContainer connections;
+  BinaryArray data;
+};
+
+}
+
+TEST_F(RelayNotifyTests, relayQueuesSamePacketToAllConnections) {
+  std::vector<net_connection_id> ids = {
+    addConnection(CryptoNoteConnectionContext::state_normal),
+    addConnection(CryptoNoteConnectionContext::state_normal, 2),
+    addConnection(CryptoNoteConnectionContext::state_synchronizing)
+  };
+
+  relayNotifyToConnections(connections, RELAYED_COMMAND, data, nullptr, 0, std::numeric_limits<uint8_t>::max());
+
+  std::shared_ptr<const BinaryArray> packet;
+  for (const auto& id : ids) {
+    auto messages = popRelayedMessages(id);
+    ASSERT_EQ(1, messages.size());
+    ASSERT_EQ(P2pMessage::NOTIFY, messages[0].type);
+    ASSERT_EQ(RELAYED_COMMAND, messages[0].command);
+
+    if (!packet) {
+      packet = messages[0].packet;
+    }
+
+    ASSERT_EQ(packet.get(), messages[0].packet.get());
+  }
+
+  ASSERT_EQ(LevinProtocol::encodeMessage(RELAYED_COMMAND, data, false), *packet);
+}
+
+TEST_F(RelayNotifyTests, relaySkipsExcludedConnection) {
+  auto relayedId = addConnection(CryptoNoteConnectionContext::state_normal);
+  auto excludedId = addConnection(CryptoNoteConnectionContext::state_normal);
+
+  relayNotifyToConnections(connections, RELAYED_COMMAND, data, &excludedId, 0, std::numeric_limits<uint8_t>::max());
+
+  ASSERT_EQ(1, popRelayedMessages(relayedId).size());
+  ASSERT_TRUE(popRelayedMessages(excludedId).empty());
+}
+
+TEST_F(RelayNotifyTests, relaySkipsConnectionsWithoutHandshake) {
+  auto relayedId = addConnection(CryptoNoteConnectionContext::state_normal);
+  auto noPeerId = addConnection(CryptoNoteConnectionContext::state_normal, 1, 0);
+  auto beforeHandshakeId = addConnection(CryptoNoteConnectionContext::state_befor_handshake);
+
+  relayNotifyToConnections(connections, RELAYED_COMMAND, data, nullptr, 0, std::numeric_limits<uint8_t>::max());
+
+  ASSERT_EQ(1, popRelayedMessages(relayedId).size());
+  ASSERT_TRUE(popRelayedMessages(noPeerId).empty());
+  ASSERT_TRUE(popRelayedMessages(beforeHandshakeId).empty());
+}
+
+TEST_F(RelayNotifyTests, relaySkipsConnectionsNotReadyForNotifications) {
+  auto relayedId = addConnection(CryptoNoteConnectionContext::state_synchronizing);
+  std::vector<net_connection_id> skippedIds = {
+    addConnection(CryptoNoteConnectionContext::state_idle),
+    addConnection(CryptoNoteConnectionContext::state_sync_required),
+    addConnection(CryptoNoteConnectionContext::state_pool_sync_required),
+    addConnection(CryptoNoteConnectionContext::state_shutdown)
+  };
+
+  relayNotifyToConnections(connections, RELAYED_COMMAND, data, nullptr, 0, std::numeric_limits<uint8_t>::max());
+
+  ASSERT_EQ(1, popRelayedMessages(relayedId).size());
+  for (const auto& id : skippedIds) {
+    ASSERT_TRUE(popRelayedMessages(id).empty());
+  }
+}
+
+TEST_F(RelayNotifyTests, relaySkipsConnectionsOutOfVersionRange) {
+  auto olderId = addConnection(CryptoNoteConnectionContext::state_normal, 1);
+  auto relayedId = addConnection(CryptoNoteConnectionContext::state_normal, 2);
+  auto newerId = addConnection(CryptoNoteConnectionContext::state_normal, 3);
+
+  relayNotifyToConnections(connections, RELAYED_COMMAND, data, nullptr, 2, 2);
+
+  ASSERT_TRUE(popRelayedMessages(olderId).empty());
+  ASSERT_EQ(1, popRelayedMessages(relayedId).size());
+  ASSERT_TRUE(popRelayedMessages(newerId).empty());
+}
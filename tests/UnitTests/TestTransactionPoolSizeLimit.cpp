@@ -0,0 +1,183 @@
+// Copyright (c) 2012-2017, The CryptoNote developers, The Bytecoin developers
+//
+// This file is part of Bytecoin.
+//
+// Bytecoin is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Bytecoin is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with Bytecoin.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "gtest/gtest.h"
+
+#include "CryptoNoteConfig.h"
+#include "CryptoNoteCore/TransactionPool.h"
+#include "CryptoNoteCore/TransactionValidatiorState.h"
+#include "Logging/ConsoleLogger.h"
+
+using namespace CryptoNote;
+
+namespace {
+
+const uint64_t OUTPUT_AMOUNT = 1000000;
+
+class TransactionPoolSizeLimit : public ::testing::Test {
+public:
+  TransactionPoolSizeLimit() : logger(Logging::ERROR) {
+  }
+
+protected:
+  Logging::ConsoleLogger logger;
+
+  CachedTransaction createTransaction(uint64_t fee, size_t extraSize = 0) {
+    Transaction transaction;
+    transaction.version = CURRENT_TRANSACTION_VERSION;
+    transaction.unlockTime = 0;
+
+    KeyInput input;
+    input.amount = OUTPUT_AMOUNT + fee;
+    input.outputIndexes.push_back(0);
+    input.keyImage = Crypto::rand<Crypto::KeyImage>();
+    transaction.inputs.push_back(input);
+    transaction.signatures.push_back({Crypto::Signature()});
+
+    TransactionOutput output;
+    output.amount = OUTPUT_AMOUNT;
+    output.target = KeyOutput{Crypto::rand<Crypto::PublicKey>()};
+    transaction.outputs.push_back(output);
+
+    transaction.extra.assign(extraSize, 0);
+    return CachedTransaction(std::move(transaction));
+  }
+
+  bool push(TransactionPool& pool, const CachedTransaction& transaction, std::vector<Crypto::Hash>& evicted) {
+    TransactionValidatorState state;
+    state.spentKeyImages.insert(boost::get<KeyInput>(transaction.getTransaction().inputs[0]).keyImage);
+    return pool.pushTransaction(CachedTransaction(transaction), std::move(state), evicted);
+  }
+
+  size_t transactionSize(const CachedTransaction& transaction) {
+    return transaction.getTransactionBinaryArray().size();
+  }
+};
+
+TEST_F(TransactionPoolSizeLimit, unlimitedPoolAcceptsEverything) {
+  TransactionPool pool(logger);
+  std::vector<Crypto::Hash> evicted;
+  for (uint64_t fee = 10; fee > 0; --fee) {
+    ASSERT_TRUE(push(pool, createTransaction(fee), evicted));
+  }
+
+  ASSERT_TRUE(evicted.empty());
+  ASSERT_EQ(10, pool.getTransactionCount());
+  ASSERT_EQ(0, pool.getStatistics().maxSize);
+}
+
+TEST_F(TransactionPoolSizeLimit, lowestFeeRateTransactionIsEvictedWhenPoolIsFull) {
+  auto cheap = createTransaction(10);
+  auto medium = createTransaction(20);
+  auto expensive = createTransaction(30);
+  ASSERT_EQ(transactionSize(cheap), transactionSize(expensive));
+
+  TransactionPool pool(logger, transactionSize(cheap) * 2);
+  std::vector<Crypto::Hash> evicted;
+  ASSERT_TRUE(push(pool, medium, evicted));
+  ASSERT_TRUE(push(pool, cheap, evicted));
+  ASSERT_TRUE(evicted.empty());
+
+  ASSERT_TRUE(push(pool, expensive, evicted));
+  ASSERT_EQ(std::vector<Crypto::Hash>{cheap.getTransactionHash()}, evicted);
+  ASSERT_FALSE(pool.checkIfTransactionPresent(cheap.getTransactionHash()));
+  ASSERT_TRUE(pool.checkIfTransactionPresent(medium.getTransactionHash()));
+  ASSERT_TRUE(pool.checkIfTransactionPresent(expensive.getTransactionHash()));
+
+  auto statistics = pool.getStatistics();
+  ASSERT_EQ(1, statistics.evictedTransactions);
+  ASSERT_EQ(transactionSize(medium) + transactionSize(expensive), statistics.size);
+}
+
+TEST_F(TransactionPoolSizeLimit, transactionWithLowerFeeRateIsRejectedWhenPoolIsFull) {
+  auto first = createTransaction(20);
+  auto second = createTransaction(30);
+  auto cheap = createTransaction(10);
+
+  TransactionPool pool(logger, transactionSize(first) * 2);
+  std::vector<Crypto::Hash> evicted;
+  ASSERT_TRUE(push(pool, first, evicted));
+  ASSERT_TRUE(push(pool, second, evicted));
+
+  ASSERT_FALSE(push(pool, cheap, evicted));
+  ASSERT_TRUE(evicted.empty());
+  ASSERT_EQ(2, pool.getTransactionCount());
+  ASSERT_EQ(1, pool.getStatistics().rejectedLowFeeRate);
+}
+
+TEST_F(TransactionPoolSizeLimit, largeTransactionEvictsSeveralCheaperOnes) {
+  auto small1 = createTransaction(10);
+  auto small2 = createTransaction(11);
+  auto small3 = createTransaction(100);
+  size_t smallSize = transactionSize(small1);
+
+  TransactionPool pool(logger, smallSize * 3);
+  std::vector<Crypto::Hash> evicted;
+  ASSERT_TRUE(push(pool, small1, evicted));
+  ASSERT_TRUE(push(pool, small2, evicted));
+  ASSERT_TRUE(push(pool, small3, evicted));
+
+  // almost twice as large as a small transaction, so two of them have to go
+  auto large = createTransaction(1000, smallSize - 8);
+  ASSERT_GT(transactionSize(large), smallSize);
+  ASSERT_LE(transactionSize(large), smallSize * 2);
+  ASSERT_TRUE(push(pool, large, evicted));
+
+  std::vector<Crypto::Hash> expected{small2.getTransactionHash(), small1.getTransactionHash()};
+  ASSERT_EQ(expected, evicted);
+  ASSERT_EQ(2, pool.getTransactionCount());
+  ASSERT_LE(pool.getStatistics().size, smallSize * 3);
+}
+
+TEST_F(TransactionPoolSizeLimit, transactionLargerThanPoolIsRejected) {
+  auto transaction = createTransaction(1000);
+
+  TransactionPool pool(logger, transactionSize(transaction) - 1);
+  std::vector<Crypto::Hash> evicted;
+  ASSERT_FALSE(push(pool, transaction, evicted));
+  ASSERT_EQ(1, pool.getStatistics().rejectedTooLarge);
+}
+
+TEST_F(TransactionPoolSizeLimit, evictedTransactionKeyImagesAreReleased) {
+  auto cheap = createTransaction(10);
+  auto expensive = createTransaction(30);
+
+  TransactionPool pool(logger, transactionSize(cheap));
+  std::vector<Crypto::Hash> evicted;
+  ASSERT_TRUE(push(pool, cheap, evicted));
+  ASSERT_TRUE(push(pool, expensive, evicted));
+
+  const auto& keyImages = pool.getPoolTransactionValidationState().spentKeyImages;
+  ASSERT_EQ(1, keyImages.size());
+  ASSERT_EQ(1, keyImages.count(boost::get<KeyInput>(expensive.getTransaction().inputs[0]).keyImage));
+}
+
+TEST_F(TransactionPoolSizeLimit, transactionsByPriorityAreOrderedByFeeRate) {
+  TransactionPool pool(logger);
+  std::vector<Crypto::Hash> evicted;
+  ASSERT_TRUE(push(pool, createTransaction(20), evicted));
+  ASSERT_TRUE(push(pool, createTransaction(30), evicted));
+  ASSERT_TRUE(push(pool, createTransaction(10), evicted));
+
+  auto transactions = pool.getPoolTransactionsByPriority();
+  ASSERT_EQ(3, transactions.size());
+  ASSERT_EQ(30, transactions[0]->getTransactionFee());
+  ASSERT_EQ(20, transactions[1]->getTransactionFee());
+  ASSERT_EQ(10, transactions[2]->getTransactionFee());
+}
+
+}
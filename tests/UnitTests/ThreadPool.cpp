@@ -0,0 +1,73 @@
+// Copyright (c) 2012-2017, The CryptoNote developers, The Bytecoin developers
+//
+// This file is part of Bytecoin.
+//
+// Bytecoin is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Bytecoin is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with Bytecoin.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <gtest/gtest.h>
+#include "Common/ThreadPool.h"
+
+#include <atomic>
+#include <stdexcept>
+#include <vector>
+
+using namespace Common;
+
+TEST(ThreadPool, parallelForCallsTaskForEveryIndexOnce) {
+  ThreadPool pool(4);
+  std::vector<std::atomic<int>> calls(1000);
+  for (auto& counter : calls) {
+    counter = 0;
+  }
+
+  pool.parallelFor(calls.size(), [&calls] (size_t index) {
+    ++calls[index];
+  });
+
+  for (auto& counter : calls) {
+    ASSERT_EQ(1, counter.load());
+  }
+}
+
+TEST(ThreadPool, parallelForWithZeroCountReturnsImmediately) {
+  ThreadPool pool(2);
+  bool called = false;
+  pool.parallelFor(0, [&called] (size_t) { called = true; });
+  ASSERT_FALSE(called);
+}
+
+TEST(ThreadPool, parallelForRethrowsTaskException) {
+  ThreadPool pool(2);
+  ASSERT_THROW(pool.parallelFor(100, [] (size_t index) {
+    if (index == 42) {
+      throw std::runtime_error("task failed");
+    }
+  }), std::runtime_error);
+
+  std::atomic<size_t> sum(0);
+  pool.parallelFor(10, [&sum] (size_t index) { sum += index; });
+  ASSERT_EQ(45, sum.load());
+}
+
+TEST(ThreadPool, destructorExecutesPostedTasks) {
+  std::atomic<int> executed(0);
+  {
+    ThreadPool pool(3);
+    for (int i = 0; i < 100; ++i) {
+      pool.post([&executed] { ++executed; });
+    }
+  }
+
+  ASSERT_EQ(100, executed.load());
+}